@@ -0,0 +1,655 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/graph_diff.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "onnx/common/graph_hash.h"
+
+namespace ONNX_NAMESPACE {
+
+namespace {
+
+bool isNode(const Node* n) {
+  return n->kind() != kParam && n->kind() != kUndefined &&
+      n->kind() != kCaptured && n->kind() != kReturn;
+}
+
+std::vector<Node*> topologicalNodes(Graph& g) {
+  std::vector<Node*> nodes;
+  for (Node* n : g.nodes()) {
+    if (isNode(n)) {
+      nodes.push_back(n);
+    }
+  }
+  return nodes;
+}
+
+// Counts the elements of a and b that are out of tolerance. The loop has
+// no early exit and no data-dependent control flow, so it vectorizes.
+template <typename T>
+void compareValues(
+    const T* a,
+    const T* b,
+    size_t n,
+    const GraphDiffOptions& options,
+    InitializerDiff* diff) {
+  const T atol = static_cast<T>(options.atol);
+  const T rtol = static_cast<T>(options.rtol);
+  size_t mismatches = 0;
+  T max_abs_diff = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const T abs_diff = std::abs(a[i] - b[i]);
+    // Equal infinities have a NaN difference; NaNs only match NaNs.
+    const bool equal = (a[i] == b[i]) | ((a[i] != a[i]) & (b[i] != b[i])) |
+        (abs_diff <= atol + rtol * std::abs(b[i]));
+    mismatches += equal ? 0 : 1;
+    max_abs_diff = abs_diff > max_abs_diff ? abs_diff : max_abs_diff;
+  }
+  diff->num_mismatches = mismatches;
+  diff->max_abs_diff = static_cast<double>(max_abs_diff);
+}
+
+template <typename T>
+size_t storedElements(const Tensor& t);
+template <>
+size_t storedElements<float>(const Tensor& t) {
+  return t.is_raw_data() ? t.raw_data_size() / sizeof(float)
+                         : t.floats().size();
+}
+template <>
+size_t storedElements<double>(const Tensor& t) {
+  return t.is_raw_data() ? t.raw_data_size() / sizeof(double)
+                         : t.doubles().size();
+}
+
+// Compares the values of two tensors of the same type and shape. Returns
+// false if they are equal (within tolerance).
+template <typename T>
+bool valuesDiffer(
+    const Tensor& a,
+    const Tensor& b,
+    const GraphDiffOptions& options,
+    InitializerDiff* diff) {
+  const size_t n = static_cast<size_t>(a.size_from_dim(0));
+  if (a.is_segment() || b.is_segment() || storedElements<T>(a) != n ||
+      storedElements<T>(b) != n) {
+    return !SameTensor(a, b);
+  }
+  compareValues(a.data<T>(), b.data<T>(), n, options, diff);
+  return diff->num_mismatches > 0;
+}
+
+// Value::unique() is dense within a graph, so per-value state is kept in
+// vectors indexed by it.
+size_t numValues(Graph& g) {
+  size_t num_values = 0;
+  for (const Value* input : g.inputs()) {
+    num_values = std::max(num_values, input->unique() + 1);
+  }
+  for (const Node* n : g.nodes()) {
+    for (const Value* output : n->outputs()) {
+      num_values = std::max(num_values, output->unique() + 1);
+    }
+  }
+  return num_values;
+}
+
+// For each name of `b`, the index of the same name in `a`, or -1; `next`
+// is where b[0] is expected in `a`. The lists compared usually hold their
+// common names in the same order, so the name after the last match is
+// tried first and `a` is only indexed by name once that fails.
+std::vector<int64_t> matchNames(
+    const std::vector<std::string>& a,
+    const std::vector<std::string>& b,
+    size_t next = 0) {
+  std::vector<int64_t> match(b.size(), -1);
+  std::unordered_map<std::string, size_t> index;
+  for (size_t j = 0; j < b.size(); ++j) {
+    if (next < a.size() && a[next] == b[j]) {
+      match[j] = static_cast<int64_t>(next++);
+      continue;
+    }
+    if (index.empty()) {
+      for (size_t i = 0; i < a.size(); ++i) {
+        index.emplace(a[i], i);
+      }
+    }
+    auto it = index.find(b[j]);
+    if (it != index.end()) {
+      match[j] = static_cast<int64_t>(it->second);
+      next = it->second + 1;
+    }
+  }
+  return match;
+}
+
+// The matched node of every node of a graph. Nodes have no dense index,
+// so they are looked up by the unique() of their first output; the rare
+// nodes without outputs go into a map.
+class NodeMatches {
+ public:
+  explicit NodeMatches(Graph& g) : by_output_(numValues(g), nullptr) {}
+
+  Node* get(const Node* n) const {
+    if (n->outputs().empty()) {
+      auto it = without_outputs_.find(n);
+      return it == without_outputs_.end() ? nullptr : it->second;
+    }
+    return by_output_[n->outputs()[0]->unique()];
+  }
+
+  void set(const Node* n, Node* match) {
+    if (n->outputs().empty()) {
+      without_outputs_[n] = match;
+    } else {
+      by_output_[n->outputs()[0]->unique()] = match;
+    }
+  }
+
+ private:
+  std::vector<Node*> by_output_;
+  std::unordered_map<const Node*, Node*> without_outputs_;
+};
+
+class GraphDiffer {
+ public:
+  GraphDiffer(Graph& before, Graph& after, const GraphDiffOptions& options)
+      : before_(before),
+        after_(after),
+        options_(options),
+        before_hasher_(before, false),
+        after_hasher_(after, false),
+        before_matches_(before),
+        after_matches_(after),
+        value_matches_(numValues(after), nullptr),
+        same_graph_([this](Graph& a, Graph& b) {
+          return DiffGraphs(a, b, options_).empty();
+        }) {}
+
+  GraphDiff run();
+
+ private:
+  void pair(Node* a, Node* b) {
+    before_matches_.set(a, b);
+    after_matches_.set(b, a);
+    for (size_t i = 0; i < a->outputs().size() && i < b->outputs().size();
+         ++i) {
+      value_matches_[b->outputs()[i]->unique()] = a->outputs()[i];
+    }
+  }
+  // The value of `before` corresponding to `vb`, or null.
+  Value* counterpart(Value* vb) const {
+    return value_matches_[vb->unique()];
+  }
+  bool inputsCorrespond(Node* a, Node* b) const;
+  std::vector<std::string> attributeChanges(Node* a, Node* b);
+  uint64_t hash(GraphHasher& hasher, const Node* n) const {
+    // A node's first output hashes its node, and is cheaper to look up.
+    return n->outputs().empty() ? hasher.hash(n)
+                                : hasher.hash(n->outputs()[0]);
+  }
+
+  void matchNamedValues();
+  void matchByHash();
+  void matchByInputs();
+  void matchByName();
+  void diffInitializer(
+      const std::string& name,
+      const Tensor& a,
+      const Tensor& b);
+  void diffGraphOutputs();
+
+  Graph& before_;
+  Graph& after_;
+  const GraphDiffOptions& options_;
+  GraphHasher before_hasher_;
+  GraphHasher after_hasher_;
+  std::vector<Node*> before_nodes_;
+  std::vector<Node*> after_nodes_;
+  NodeMatches before_matches_;
+  NodeMatches after_matches_;
+  // The value of `before` matching each value of `after`, by unique().
+  std::vector<Value*> value_matches_;
+  // Whether each of after_nodes_ was matched by hash, and found to agree
+  // exactly with its match in all but its inputs.
+  std::vector<bool> identical_;
+  // Compares subgraph attributes whose hashes are equal.
+  const SameGraphFunction same_graph_;
+  GraphDiff diff_;
+};
+
+bool GraphDiffer::inputsCorrespond(Node* a, Node* b) const {
+  if (a->inputs().size() != b->inputs().size()) {
+    return false;
+  }
+  for (size_t i = 0; i < b->inputs().size(); ++i) {
+    Value* vb = b->inputs()[i];
+    if (vb->node()->kind() == kUndefined) {
+      if (a->inputs()[i]->node()->kind() != kUndefined) {
+        return false;
+      }
+    } else if (counterpart(vb) != a->inputs()[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> GraphDiffer::attributeChanges(Node* a, Node* b) {
+  std::vector<std::string> changes;
+  std::vector<Symbol> names_a = a->attributeNames();
+  std::vector<Symbol> names_b = b->attributeNames();
+  for (Symbol name : names_a) {
+    if (!b->hasAttribute(name) ||
+        before_hasher_.attributeHash(a, name) !=
+            after_hasher_.attributeHash(b, name) ||
+        !SameAttribute(a, b, name, same_graph_)) {
+      changes.push_back(name.toString());
+    }
+  }
+  for (Symbol name : names_b) {
+    if (!a->hasAttribute(name)) {
+      changes.push_back(name.toString());
+    }
+  }
+  std::sort(changes.begin(), changes.end());
+  return changes;
+}
+
+void GraphDiffer::matchByHash() {
+  // Sort (hash, position) pairs to find the nodes with equal hashes. Equal
+  // nodes are only matched, in topological order, if both graphs have the
+  // same number of them, and only if they agree exactly, so that a hash
+  // collision is never taken for equality; otherwise which goes with which
+  // is left to the later steps. Inputs are checked once all nodes are
+  // matched.
+  auto keys = [this](GraphHasher& hasher, const std::vector<Node*>& nodes) {
+    std::vector<std::pair<uint64_t, size_t>> keys;
+    keys.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      keys.emplace_back(hash(hasher, nodes[i]), i);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  };
+  const auto a = keys(before_hasher_, before_nodes_);
+  const auto b = keys(after_hasher_, after_nodes_);
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (a[i].first < b[j].first) {
+      ++i;
+    } else if (b[j].first < a[i].first) {
+      ++j;
+    } else {
+      const uint64_t h = a[i].first;
+      size_t i_end = i;
+      size_t j_end = j;
+      while (i_end < a.size() && a[i_end].first == h) {
+        ++i_end;
+      }
+      while (j_end < b.size() && b[j_end].first == h) {
+        ++j_end;
+      }
+      if (i_end - i == j_end - j) {
+        for (; i < i_end; ++i, ++j) {
+          Node* before = before_nodes_[a[i].second];
+          Node* after = after_nodes_[b[j].second];
+          if (SameLocal(before, after, same_graph_)) {
+            pair(before, after);
+            identical_[b[j].second] = true;
+          }
+        }
+      }
+      i = i_end;
+      j = j_end;
+    }
+  }
+}
+
+void GraphDiffer::matchByInputs() {
+  for (Node* b : after_nodes_) {
+    if (after_matches_.get(b) != nullptr) {
+      continue;
+    }
+    const uint64_t local_hash = after_hasher_.localHash(b);
+    Node* match = nullptr;
+    for (size_t i = 0; i < b->inputs().size() && match == nullptr; ++i) {
+      Value* va = counterpart(b->inputs()[i]);
+      if (va == nullptr) {
+        continue;
+      }
+      for (const Use& use : va->uses()) {
+        Node* a = use.user;
+        if (use.offset != i || a->kind() != b->kind() || !isNode(a) ||
+            before_matches_.get(a) != nullptr) {
+          continue;
+        }
+        if (inputsCorrespond(a, b) ||
+            before_hasher_.localHash(a) == local_hash) {
+          match = a;
+          break;
+        }
+      }
+    }
+    if (match != nullptr) {
+      pair(match, b);
+    }
+  }
+}
+
+void GraphDiffer::matchByName() {
+  std::vector<Node*> a_nodes;
+  std::vector<std::string> a_names;
+  for (Node* a : before_nodes_) {
+    if (before_matches_.get(a) == nullptr && !a->outputs().empty()) {
+      a_nodes.push_back(a);
+      a_names.push_back(a->outputs()[0]->uniqueName());
+    }
+  }
+  if (a_nodes.empty()) {
+    return;
+  }
+  std::vector<Node*> b_nodes;
+  std::vector<std::string> b_names;
+  for (Node* b : after_nodes_) {
+    if (after_matches_.get(b) == nullptr && !b->outputs().empty()) {
+      b_nodes.push_back(b);
+      b_names.push_back(b->outputs()[0]->uniqueName());
+    }
+  }
+  const std::vector<int64_t> match = matchNames(a_names, b_names);
+  for (size_t j = 0; j < b_nodes.size(); ++j) {
+    Node* a = match[j] >= 0 ? a_nodes[match[j]] : nullptr;
+    if (a != nullptr && a->kind() == b_nodes[j]->kind() &&
+        before_matches_.get(a) == nullptr) {
+      pair(a, b_nodes[j]);
+    }
+  }
+}
+
+// The graph inputs and captured values of a graph, which are matched by
+// name, and the initializer of each graph input.
+struct NamedValues {
+  std::vector<Value*> values;
+  std::vector<std::string> names;
+  // The initializer of each value by Value::unique(), or null.
+  std::vector<const Tensor*> initializers;
+
+  bool isInput(const Value* v) const {
+    return v->node()->kind() == kParam && initializers[v->unique()] == nullptr;
+  }
+};
+
+NamedValues namedValues(Graph& g) {
+  NamedValues named;
+  for (Value* input : g.inputs()) {
+    named.values.push_back(input);
+  }
+  for (Node* n : g.nodes()) {
+    if (n->kind() == kCaptured) {
+      named.values.push_back(n->output());
+    }
+  }
+  named.names.reserve(named.values.size());
+  for (const Value* v : named.values) {
+    named.names.push_back(v->uniqueName());
+  }
+  // Initializers usually are the last graph inputs, in the same order.
+  const auto& names = g.initializer_names();
+  const size_t num_inputs = g.inputs().size();
+  const std::vector<int64_t> values = matchNames(
+      named.names,
+      names,
+      num_inputs >= names.size() ? num_inputs - names.size() : 0);
+  named.initializers.assign(numValues(g), nullptr);
+  for (size_t k = 0; k < names.size(); ++k) {
+    if (values[k] >= 0) {
+      named.initializers[named.values[values[k]]->unique()] =
+          &g.initializers()[k];
+    }
+  }
+  return named;
+}
+
+void GraphDiffer::matchNamedValues() {
+  // Graph inputs that aren't initializers.
+  const NamedValues before = namedValues(before_);
+  const NamedValues after = namedValues(after_);
+  const std::vector<int64_t> values = matchNames(before.names, after.names);
+  std::vector<bool> kept_input(before.values.size(), false);
+  for (size_t j = 0; j < after.values.size(); ++j) {
+    Value* b = after.values[j];
+    Value* a = values[j] >= 0 ? before.values[values[j]] : nullptr;
+    if (a != nullptr) {
+      value_matches_[b->unique()] = a;
+      kept_input[values[j]] = after.isInput(b);
+    }
+    if (after.isInput(b) && (a == nullptr || !before.isInput(a))) {
+      diff_.added_inputs.push_back(after.names[j]);
+    }
+  }
+  for (size_t i = 0; i < before.values.size(); ++i) {
+    if (before.isInput(before.values[i]) && !kept_input[i]) {
+      diff_.removed_inputs.push_back(before.names[i]);
+    }
+  }
+
+  // Initializers.
+  const auto& before_names = before_.initializer_names();
+  const auto& after_names = after_.initializer_names();
+  const std::vector<int64_t> initializers =
+      matchNames(before_names, after_names);
+  std::vector<bool> kept(before_names.size(), false);
+  for (int64_t i : initializers) {
+    if (i >= 0) {
+      kept[i] = true;
+    }
+  }
+  for (size_t i = 0; i < before_names.size(); ++i) {
+    if (!kept[i]) {
+      InitializerDiff d;
+      d.kind = InitializerDiff::Removed;
+      d.name = before_names[i];
+      diff_.initializers.push_back(d);
+    }
+  }
+  for (size_t j = 0; j < after_names.size(); ++j) {
+    if (initializers[j] < 0) {
+      InitializerDiff d;
+      d.kind = InitializerDiff::Added;
+      d.name = after_names[j];
+      diff_.initializers.push_back(d);
+    } else {
+      diffInitializer(
+          after_names[j],
+          before_.initializers()[initializers[j]],
+          after_.initializers()[j]);
+    }
+  }
+}
+
+void GraphDiffer::diffInitializer(
+    const std::string& name,
+    const Tensor& a,
+    const Tensor& b) {
+  InitializerDiff d;
+  d.name = name;
+  if (a.elem_type() != b.elem_type()) {
+    d.kind = InitializerDiff::TypeChanged;
+  } else if (a.sizes() != b.sizes()) {
+    d.kind = InitializerDiff::ShapeChanged;
+  } else {
+    d.kind = InitializerDiff::ValuesChanged;
+    bool differ;
+    if (a.elem_type() == TensorProto_DataType_FLOAT) {
+      differ = valuesDiffer<float>(a, b, options_, &d);
+    } else if (a.elem_type() == TensorProto_DataType_DOUBLE) {
+      differ = valuesDiffer<double>(a, b, options_, &d);
+    } else {
+      differ = !SameTensor(a, b);
+    }
+    if (!differ) {
+      return;
+    }
+  }
+  diff_.initializers.push_back(d);
+}
+
+void GraphDiffer::diffGraphOutputs() {
+  std::unordered_set<std::string> before;
+  std::unordered_set<std::string> after;
+  for (const Value* v : before_.outputs()) {
+    before.insert(v->uniqueName());
+  }
+  for (const Value* v : after_.outputs()) {
+    after.insert(v->uniqueName());
+  }
+  for (const Value* v : before_.outputs()) {
+    if (!after.count(v->uniqueName())) {
+      diff_.removed_outputs.push_back(v->uniqueName());
+    }
+  }
+  for (const Value* v : after_.outputs()) {
+    if (!before.count(v->uniqueName())) {
+      diff_.added_outputs.push_back(v->uniqueName());
+    }
+  }
+}
+
+GraphDiff GraphDiffer::run() {
+  before_nodes_ = topologicalNodes(before_);
+  after_nodes_ = topologicalNodes(after_);
+  identical_.assign(after_nodes_.size(), false);
+  matchNamedValues();
+
+  matchByHash();
+  matchByInputs();
+  matchByName();
+  matchByInputs();
+
+  for (Node* a : before_nodes_) {
+    if (before_matches_.get(a) == nullptr) {
+      diff_.removed.push_back(a);
+    }
+  }
+  for (size_t j = 0; j < after_nodes_.size(); ++j) {
+    Node* b = after_nodes_[j];
+    Node* a = after_matches_.get(b);
+    if (a == nullptr) {
+      diff_.added.push_back(b);
+      continue;
+    }
+    if (identical_[j] && inputsCorrespond(a, b)) {
+      ++diff_.num_unchanged;
+      continue;
+    }
+    NodeDiff d;
+    d.before = a;
+    d.after = b;
+    d.attributes = attributeChanges(a, b);
+    d.inputs_changed = !inputsCorrespond(a, b) ||
+        a->outputs().size() != b->outputs().size();
+    if (d.attributes.empty() && !d.inputs_changed) {
+      ++diff_.num_unchanged;
+    } else {
+      diff_.modified.push_back(std::move(d));
+    }
+  }
+
+  diffGraphOutputs();
+  return std::move(diff_);
+}
+
+std::string describe(const Node* n) {
+  std::string s = n->kind().toString();
+  if (!n->outputs().empty()) {
+    s += " -> " + n->outputs()[0]->uniqueName();
+  }
+  return s;
+}
+
+} // namespace
+
+GraphDiff DiffGraphs(
+    Graph& before,
+    Graph& after,
+    const GraphDiffOptions& options) {
+  return GraphDiffer(before, after, options).run();
+}
+
+void PrintGraphDiff(std::ostream& out, const GraphDiff& diff) {
+  for (const auto& name : diff.removed_inputs) {
+    out << "- input " << name << "\n";
+  }
+  for (const auto& name : diff.added_inputs) {
+    out << "+ input " << name << "\n";
+  }
+  for (const auto& name : diff.removed_outputs) {
+    out << "- output " << name << "\n";
+  }
+  for (const auto& name : diff.added_outputs) {
+    out << "+ output " << name << "\n";
+  }
+  for (const Node* n : diff.removed) {
+    out << "- node " << describe(n) << "\n";
+  }
+  for (const Node* n : diff.added) {
+    out << "+ node " << describe(n) << "\n";
+  }
+  for (const auto& d : diff.modified) {
+    out << "~ node " << describe(d.before);
+    if (d.before->outputs().empty() || d.after->outputs().empty() ||
+        d.before->outputs()[0]->uniqueName() !=
+            d.after->outputs()[0]->uniqueName()) {
+      out << " (now " << describe(d.after) << ")";
+    }
+    const char* sep = ":";
+    if (!d.attributes.empty()) {
+      out << sep << " attributes";
+      for (const auto& name : d.attributes) {
+        out << " " << name;
+      }
+      sep = ";";
+    }
+    if (d.inputs_changed) {
+      out << sep << " inputs";
+    }
+    out << "\n";
+  }
+  for (const auto& d : diff.initializers) {
+    switch (d.kind) {
+      case InitializerDiff::Added:
+        out << "+ initializer " << d.name << "\n";
+        break;
+      case InitializerDiff::Removed:
+        out << "- initializer " << d.name << "\n";
+        break;
+      case InitializerDiff::TypeChanged:
+        out << "~ initializer " << d.name << ": type\n";
+        break;
+      case InitializerDiff::ShapeChanged:
+        out << "~ initializer " << d.name << ": shape\n";
+        break;
+      case InitializerDiff::ValuesChanged:
+        out << "~ initializer " << d.name << ": values";
+        if (d.num_mismatches > 0) {
+          out << " (" << d.num_mismatches
+              << " out of tolerance, max abs diff " << d.max_abs_diff << ")";
+        }
+        out << "\n";
+        break;
+    }
+  }
+  out << diff.num_unchanged << " nodes unchanged, " << diff.modified.size()
+      << " modified, " << diff.removed.size() << " removed, "
+      << diff.added.size() << " added, " << diff.initializers.size()
+      << " initializers changed\n";
+}
+
+} // namespace ONNX_NAMESPACE
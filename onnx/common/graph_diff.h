@@ -0,0 +1,85 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <ostream>
+
+#include "onnx/common/ir.h"
+
+namespace ONNX_NAMESPACE {
+
+struct GraphDiffOptions {
+  // Floating point initializer elements x (before) and y (after) count as
+  // equal if |x - y| <= atol + rtol * |y|. Other data must match exactly.
+  double atol = 0;
+  double rtol = 0;
+};
+
+// A node of the first graph and its counterpart in the second that differ
+// in attributes or in where their inputs come from.
+struct NodeDiff {
+  Node* before;
+  Node* after;
+  // Names of the attributes that were added, removed or changed.
+  std::vector<std::string> attributes;
+  // Whether the number of inputs or any input's source changed.
+  bool inputs_changed;
+};
+
+struct InitializerDiff {
+  enum Kind { Added, Removed, TypeChanged, ShapeChanged, ValuesChanged };
+  Kind kind;
+  std::string name;
+  // For ValuesChanged floating point data, the number of elements out of
+  // tolerance and the largest absolute difference.
+  size_t num_mismatches = 0;
+  double max_abs_diff = 0;
+};
+
+struct GraphDiff {
+  // Number of nodes matched with an identical counterpart.
+  size_t num_unchanged = 0;
+  std::vector<Node*> removed;
+  std::vector<Node*> added;
+  std::vector<NodeDiff> modified;
+  std::vector<InitializerDiff> initializers;
+  // Graph inputs (other than initializers) and outputs, by name.
+  std::vector<std::string> removed_inputs;
+  std::vector<std::string> added_inputs;
+  std::vector<std::string> removed_outputs;
+  std::vector<std::string> added_outputs;
+
+  bool empty() const {
+    return removed.empty() && added.empty() && modified.empty() &&
+        initializers.empty() && removed_inputs.empty() &&
+        added_inputs.empty() && removed_outputs.empty() &&
+        added_outputs.empty();
+  }
+};
+
+// Structural diff of two graphs (subgraphs are compared as attributes).
+//
+// Nodes are aligned in three steps:
+//  1. nodes with equal GraphHasher hashes (not hashing initializer data)
+//     are matched if they also compare equal exactly (SameLocal, with
+//     subgraphs diffed); these compute the same thing from the same
+//     inputs;
+//  2. in topological order, an unmatched node of `after` is matched with
+//     an unmatched node of `before` of the same kind that uses the
+//     counterpart of one of its inputs in the same position, if all of
+//     their inputs correspond or they have the same attributes;
+//  3. remaining nodes are matched by kind and first output name, after
+//     which step 2 is repeated.
+// Matched nodes that differ in attributes or inputs are reported as
+// modified, the others as removed or added. Initializers are matched by
+// name and compared by type, shape and value.
+GraphDiff DiffGraphs(
+    Graph& before,
+    Graph& after,
+    const GraphDiffOptions& options = GraphDiffOptions());
+
+// Prints one line per difference, followed by a summary.
+void PrintGraphDiff(std::ostream& out, const GraphDiff& diff);
+
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,622 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/graph_hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ONNX_NAMESPACE {
+
+namespace {
+
+const uint64_t kPrime1 = 11400714785074694791ULL;
+const uint64_t kPrime2 = 14029467366897019727ULL;
+const uint64_t kPrime3 = 1609587929392839161ULL;
+const uint64_t kPrime4 = 9650029242287828579ULL;
+const uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const unsigned char* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t xxhRound(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  acc = rotl(acc, 31);
+  return acc * kPrime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t v) {
+  acc ^= xxhRound(0, v);
+  return acc * kPrime1 + kPrime4;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+// Accumulates a sequence of 64-bit words into one hash, the same way XXH64
+// folds in the tail of its input.
+class HashBuilder {
+ public:
+  explicit HashBuilder(uint64_t seed) : h_(seed + kPrime5) {}
+
+  HashBuilder& add(uint64_t v) {
+    h_ ^= xxhRound(0, v);
+    h_ = rotl(h_, 27) * kPrime1 + kPrime4;
+    return *this;
+  }
+
+  HashBuilder& add(const std::string& s) {
+    return add(HashBytes(s.data(), s.size()));
+  }
+
+  uint64_t get() const {
+    return avalanche(h_);
+  }
+
+ private:
+  uint64_t h_;
+};
+
+// Seeds that keep the different kinds of hashed objects apart.
+enum HashSeed : uint64_t {
+  kTensorSeed = 1,
+  kInputSeed,
+  kUndefinedSeed,
+  kCapturedSeed,
+  kNodeSeed,
+  kOutputSeed,
+  kAttributeSeed,
+  kGraphSeed,
+};
+
+template <typename T>
+bool bytesOf(
+    const std::vector<T>& values,
+    const void** data,
+    size_t* size) {
+  *data = values.data();
+  *size = values.size() * sizeof(T);
+  return true;
+}
+
+template <typename Narrow, typename Wide>
+bool narrowedBytesOf(
+    const std::vector<Wide>& values,
+    std::vector<char>* buffer,
+    const void** data,
+    size_t* size) {
+  std::vector<Narrow> narrowed(values.begin(), values.end());
+  buffer->resize(narrowed.size() * sizeof(Narrow));
+  if (!narrowed.empty()) {
+    std::memcpy(buffer->data(), narrowed.data(), buffer->size());
+  }
+  *data = buffer->data();
+  *size = buffer->size();
+  return true;
+}
+
+// Points *data and *size at the Tensor's data in its raw_data
+// representation: in the Tensor itself or, for types the typed fields
+// store wider, narrowed into *buffer. Returns false for strings, which
+// have no raw_data representation, and for unknown types.
+bool rawBytes(
+    const Tensor& t,
+    std::vector<char>* buffer,
+    const void** data,
+    size_t* size) {
+  if (t.is_raw_data()) {
+    *data = t.raw_data_ptr();
+    *size = t.raw_data_size();
+    return true;
+  }
+  switch (t.elem_type()) {
+    case TensorProto_DataType_FLOAT:
+    case TensorProto_DataType_COMPLEX64:
+      return bytesOf(t.floats(), data, size);
+    case TensorProto_DataType_DOUBLE:
+    case TensorProto_DataType_COMPLEX128:
+      return bytesOf(t.doubles(), data, size);
+    case TensorProto_DataType_INT32:
+      return bytesOf(t.int32s(), data, size);
+    case TensorProto_DataType_INT64:
+      return bytesOf(t.int64s(), data, size);
+    case TensorProto_DataType_UINT64:
+      return bytesOf(t.uint64s(), data, size);
+    case TensorProto_DataType_UINT32:
+      return narrowedBytesOf<uint32_t>(t.uint64s(), buffer, data, size);
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_INT8:
+    case TensorProto_DataType_UINT8:
+      return narrowedBytesOf<uint8_t>(t.int32s(), buffer, data, size);
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_UINT16:
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_BFLOAT16:
+      return narrowedBytesOf<uint16_t>(t.int32s(), buffer, data, size);
+    default:
+      return false;
+  }
+}
+
+template <typename T>
+uint64_t hashValues(const std::vector<T>& values) {
+  return HashBytes(values.data(), values.size() * sizeof(T));
+}
+
+// Hash of the Tensor's data in its raw_data representation.
+uint64_t hashTensorData(const Tensor& t) {
+  std::vector<char> buffer;
+  const void* data;
+  size_t size;
+  if (rawBytes(t, &buffer, &data, &size)) {
+    return HashBytes(data, size);
+  }
+  if (t.elem_type() == TensorProto_DataType_STRING) {
+    HashBuilder builder(kTensorSeed);
+    for (const auto& s : t.strings()) {
+      builder.add(s);
+    }
+    return builder.get();
+  }
+  return 0;
+}
+
+// Bitwise, so that -0.0 and 0.0 differ as they do in the hashes.
+template <typename T>
+bool sameBits(const std::vector<T>& a, const std::vector<T>& b) {
+  return a.size() == b.size() &&
+      (a.empty() ||
+       std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+void hashDims(HashBuilder& builder, const std::vector<Dimension>& dims) {
+  builder.add(dims.size());
+  for (const auto& dim : dims) {
+    // Symbolic dims are named; only their being symbolic is hashed.
+    builder.add(dim.is_int ? static_cast<uint64_t>(dim.dim) : ~uint64_t(0));
+  }
+}
+
+} // namespace
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  const unsigned char* const end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    // Four independent lanes, 32 bytes per iteration.
+    const unsigned char* const limit = end - 32;
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+    do {
+      v1 = xxhRound(v1, read64(p));
+      v2 = xxhRound(v2, read64(p + 8));
+      v3 = xxhRound(v3, read64(p + 16));
+      v4 = xxhRound(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = mergeRound(h, v1);
+    h = mergeRound(h, v2);
+    h = mergeRound(h, v3);
+    h = mergeRound(h, v4);
+  } else {
+    h = seed + kPrime5;
+  }
+
+  h += static_cast<uint64_t>(size);
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxhRound(0, read64(p));
+    h = rotl(h, 27) * kPrime1 + kPrime4;
+  }
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+    h = rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    h ^= (*p) * kPrime5;
+    h = rotl(h, 11) * kPrime1;
+  }
+  return avalanche(h);
+}
+
+uint64_t HashTensor(const Tensor& t) {
+  HashBuilder builder(kTensorSeed);
+  builder.add(static_cast<uint64_t>(t.elem_type()));
+  builder.add(t.sizes().size());
+  for (int64_t dim : t.sizes()) {
+    builder.add(static_cast<uint64_t>(dim));
+  }
+  if (t.is_segment()) {
+    builder.add(static_cast<uint64_t>(t.segment_begin()));
+    builder.add(static_cast<uint64_t>(t.segment_end()));
+  }
+  return builder.add(hashTensorData(t)).get();
+}
+
+bool SameTensor(const Tensor& a, const Tensor& b) {
+  if (a.elem_type() != b.elem_type() || a.sizes() != b.sizes() ||
+      a.is_segment() != b.is_segment() ||
+      (a.is_segment() &&
+       (a.segment_begin() != b.segment_begin() ||
+        a.segment_end() != b.segment_end()))) {
+    return false;
+  }
+  std::vector<char> buffer_a;
+  std::vector<char> buffer_b;
+  const void* data_a;
+  const void* data_b;
+  size_t size_a;
+  size_t size_b;
+  const bool raw_a = rawBytes(a, &buffer_a, &data_a, &size_a);
+  const bool raw_b = rawBytes(b, &buffer_b, &data_b, &size_b);
+  if (raw_a != raw_b) {
+    return false;
+  }
+  if (!raw_a) {
+    // Only strings have no raw bytes; data of an undefined or unknown
+    // type cannot be compared, so it is never the same.
+    return a.elem_type() == TensorProto_DataType_STRING &&
+        a.strings() == b.strings();
+  }
+  return size_a == size_b &&
+      (size_a == 0 || std::memcmp(data_a, data_b, size_a) == 0);
+}
+
+bool SameAttribute(
+    const Node* a,
+    const Node* b,
+    Symbol name,
+    const SameGraphFunction& same_graph) {
+  const AttributeValue* x = a->findAttribute(name);
+  const AttributeValue* y = b->findAttribute(name);
+  if (x == nullptr || y == nullptr || x->kind() != y->kind()) {
+    return false;
+  }
+  auto same_graphs = [&same_graph](
+                         const std::shared_ptr<Graph>& g,
+                         const std::shared_ptr<Graph>& h) {
+    return g == h || (same_graph && same_graph(*g, *h));
+  };
+  switch (x->kind()) {
+    case AttributeKind::f: {
+      const double f = static_cast<const FloatAttr*>(x)->value();
+      const double g = static_cast<const FloatAttr*>(y)->value();
+      return std::memcmp(&f, &g, sizeof(f)) == 0;
+    }
+    case AttributeKind::fs:
+      return sameBits(
+          static_cast<const FloatsAttr*>(x)->value(),
+          static_cast<const FloatsAttr*>(y)->value());
+    case AttributeKind::i:
+      return static_cast<const IntAttr*>(x)->value() ==
+          static_cast<const IntAttr*>(y)->value();
+    case AttributeKind::is:
+      return static_cast<const IntsAttr*>(x)->value() ==
+          static_cast<const IntsAttr*>(y)->value();
+    case AttributeKind::s:
+      return static_cast<const StringAttr*>(x)->value() ==
+          static_cast<const StringAttr*>(y)->value();
+    case AttributeKind::ss:
+      return static_cast<const StringsAttr*>(x)->value() ==
+          static_cast<const StringsAttr*>(y)->value();
+    case AttributeKind::t:
+      return SameTensor(
+          static_cast<const TensorAttr*>(x)->value(),
+          static_cast<const TensorAttr*>(y)->value());
+    case AttributeKind::ts: {
+      const auto& ts = static_cast<const TensorsAttr*>(x)->value();
+      const auto& us = static_cast<const TensorsAttr*>(y)->value();
+      if (ts.size() != us.size()) {
+        return false;
+      }
+      for (size_t i = 0; i < ts.size(); ++i) {
+        if (!SameTensor(ts[i], us[i])) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case AttributeKind::g:
+      return same_graphs(
+          static_cast<const GraphAttr*>(x)->value(),
+          static_cast<const GraphAttr*>(y)->value());
+    case AttributeKind::gs: {
+      const auto& gs = static_cast<const GraphsAttr*>(x)->value();
+      const auto& hs = static_cast<const GraphsAttr*>(y)->value();
+      if (gs.size() != hs.size()) {
+        return false;
+      }
+      for (size_t i = 0; i < gs.size(); ++i) {
+        if (!same_graphs(gs[i], hs[i])) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SameLocal(
+    const Node* a,
+    const Node* b,
+    const SameGraphFunction& same_graph) {
+  if (a->kind() != b->kind() || a->has_domain() != b->has_domain() ||
+      (a->has_domain() && a->domain() != b->domain()) ||
+      a->inputs().size() != b->inputs().size() ||
+      a->outputs().size() != b->outputs().size()) {
+    return false;
+  }
+  // Attribute names are unique, so with as many of them, each name of a
+  // being in b makes the sets equal.
+  const std::vector<Symbol> names = a->attributeNames();
+  if (names.size() != b->attributeNames().size()) {
+    return false;
+  }
+  for (Symbol name : names) {
+    if (!SameAttribute(a, b, name, same_graph)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+GraphHasher::GraphHasher(Graph& g, bool hash_initializer_data)
+    : GraphHasher(g, nullptr, hash_initializer_data) {}
+
+GraphHasher::GraphHasher(
+    Graph& g,
+    const GraphHasher* parent,
+    bool hash_initializer_data)
+    : parent_(parent),
+      hash_initializer_data_(hash_initializer_data),
+      graph_hash_(0),
+      has_scope_(false) {
+  run(g);
+}
+
+uint64_t GraphHasher::hash(const Value* v) const {
+  ONNX_ASSERTM(
+      v->unique() < values_.size() && values_[v->unique()] == v,
+      "Value %s is not in the hashed graph", v->uniqueName().c_str());
+  return value_hashes_[v->unique()];
+}
+
+uint64_t GraphHasher::hash(const Node* n) const {
+  auto it = std::lower_bound(
+      node_hashes_.begin(),
+      node_hashes_.end(),
+      std::make_pair(n, uint64_t(0)));
+  ONNX_ASSERTM(
+      it != node_hashes_.end() && it->first == n,
+      "Node is not in the hashed graph");
+  return it->second;
+}
+
+void GraphHasher::run(Graph& g) {
+  std::unordered_map<std::string, const Tensor*> initializers;
+  if (hash_initializer_data_) {
+    for (size_t i = 0; i < g.initializers().size(); ++i) {
+      initializers.emplace(g.initializer_names()[i], &g.initializers()[i]);
+    }
+  }
+
+  // Value hashes are indexed by Value::unique(), which is dense within a
+  // graph; this is much faster than a map for large graphs.
+  size_t num_values = 0;
+  for (const Value* input : g.inputs()) {
+    num_values = std::max(num_values, input->unique() + 1);
+  }
+  for (const Node* n : g.nodes()) {
+    for (const Value* output : n->outputs()) {
+      num_values = std::max(num_values, output->unique() + 1);
+    }
+  }
+  values_.resize(num_values, nullptr);
+  value_hashes_.resize(num_values);
+
+  HashBuilder graph_builder(kGraphSeed);
+  graph_builder.add(g.inputs().size());
+  for (size_t i = 0; i < g.inputs().size(); ++i) {
+    const Value* input = g.inputs()[i];
+    HashBuilder builder(kInputSeed);
+    builder.add(i);
+    builder.add(static_cast<uint64_t>(input->elemType()));
+    hashDims(builder, input->sizes());
+    auto it = initializers.find(input->uniqueName());
+    if (it != initializers.end()) {
+      builder.add(HashTensor(*it->second));
+    }
+    const uint64_t h = builder.get();
+    addToScope(input, h);
+    graph_builder.add(h);
+  }
+
+  std::vector<uint64_t> node_hashes;
+  size_t num_nodes = 0;
+  for (Node* n : g.nodes()) {
+    ++num_nodes;
+    if (n->kind() == kUndefined) {
+      addToScope(n->outputs()[0], HashBuilder(kUndefinedSeed).get());
+    } else if (n->kind() == kCaptured) {
+      const Value* v = n->outputs()[0];
+      addToScope(v, parent_ != nullptr
+              ? parent_->lookupCaptured(v->uniqueName())
+              : HashBuilder(kCapturedSeed).add(v->uniqueName()).get());
+    }
+  }
+  node_hashes.reserve(num_nodes);
+  node_hashes_.reserve(num_nodes);
+  for (Node* n : g.nodes()) {
+    if (n->kind() != kUndefined && n->kind() != kCaptured) {
+      node_hashes.push_back(hashNode(n));
+    }
+  }
+  std::sort(node_hashes_.begin(), node_hashes_.end());
+
+  graph_builder.add(g.outputs().size());
+  for (const Value* output : g.outputs()) {
+    graph_builder.add(hash(output));
+  }
+  // Node order within a topological sort is arbitrary.
+  std::sort(node_hashes.begin(), node_hashes.end());
+  for (uint64_t h : node_hashes) {
+    graph_builder.add(h);
+  }
+  graph_hash_ = graph_builder.get();
+}
+
+uint64_t GraphHasher::hashNode(Node* n) {
+  HashBuilder builder(kNodeSeed);
+  builder.add(localHash(n));
+  for (const Value* input : n->inputs()) {
+    builder.add(hash(input));
+  }
+  const uint64_t h = builder.get();
+  node_hashes_.emplace_back(n, h);
+  for (size_t i = 0; i < n->outputs().size(); ++i) {
+    addToScope(n->outputs()[i], HashBuilder(kOutputSeed).add(h).add(i).get());
+  }
+  return h;
+}
+
+uint64_t GraphHasher::localHash(Node* n) {
+  HashBuilder builder(kNodeSeed);
+  builder.add(hashSymbol(n->kind()));
+  if (n->has_domain()) {
+    builder.add(n->domain());
+  }
+  builder.add(n->inputs().size());
+  builder.add(n->outputs().size());
+  // attributeNames() is in insertion order. Each attribute hash covers its
+  // name, so sorting the hashes makes the order irrelevant.
+  std::vector<uint64_t> attribute_hashes;
+  for (Symbol name : n->attributeNames()) {
+    attribute_hashes.push_back(attributeHash(n, name));
+  }
+  std::sort(attribute_hashes.begin(), attribute_hashes.end());
+  for (uint64_t h : attribute_hashes) {
+    builder.add(h);
+  }
+  return builder.get();
+}
+
+uint64_t GraphHasher::attributeHash(Node* n, Symbol name) {
+  HashBuilder builder(kAttributeSeed);
+  builder.add(hashSymbol(name));
+  const AttributeKind kind = n->kindOf(name);
+  builder.add(static_cast<uint64_t>(kind));
+  switch (kind) {
+    case AttributeKind::f: {
+      const double f = n->f(name);
+      builder.add(HashBytes(&f, sizeof(f)));
+      break;
+    }
+    case AttributeKind::fs:
+      builder.add(hashValues(n->fs(name)));
+      break;
+    case AttributeKind::i:
+      builder.add(static_cast<uint64_t>(n->i(name)));
+      break;
+    case AttributeKind::is:
+      builder.add(hashValues(n->is(name)));
+      break;
+    case AttributeKind::s:
+      builder.add(n->s(name));
+      break;
+    case AttributeKind::ss:
+      builder.add(n->ss(name).size());
+      for (const auto& s : n->ss(name)) {
+        builder.add(s);
+      }
+      break;
+    case AttributeKind::t:
+      builder.add(HashTensor(n->t(name)));
+      break;
+    case AttributeKind::ts:
+      builder.add(n->ts(name).size());
+      for (const auto& t : n->ts(name)) {
+        builder.add(HashTensor(t));
+      }
+      break;
+    case AttributeKind::g:
+      builder.add(hashSubgraph(*n->g(name)));
+      break;
+    case AttributeKind::gs:
+      builder.add(n->gs(name).size());
+      for (const auto& g : n->gs(name)) {
+        builder.add(hashSubgraph(*g));
+      }
+      break;
+  }
+  return builder.get();
+}
+
+uint64_t GraphHasher::hashSymbol(Symbol s) {
+  // Symbol::toString() takes a lock, so each symbol is hashed only once.
+  auto it = symbol_hashes_.find(static_cast<uint32_t>(s));
+  if (it == symbol_hashes_.end()) {
+    const char* str = s.toString();
+    it = symbol_hashes_.emplace(static_cast<uint32_t>(s), HashBytes(str, std::strlen(str))).first;
+  }
+  return it->second;
+}
+
+uint64_t GraphHasher::hashSubgraph(Graph& g) {
+  if (!has_scope_) {
+    // Values hashed from now on are added by addToScope.
+    has_scope_ = true;
+    for (size_t i = 0; i < values_.size(); ++i) {
+      if (values_[i] != nullptr) {
+        scope_[values_[i]->uniqueName()] = value_hashes_[i];
+      }
+    }
+  }
+  return GraphHasher(g, this, hash_initializer_data_).hash();
+}
+
+uint64_t GraphHasher::lookupCaptured(const std::string& name) const {
+  auto it = scope_.find(name);
+  if (it != scope_.end()) {
+    return it->second;
+  }
+  if (parent_ != nullptr) {
+    return parent_->lookupCaptured(name);
+  }
+  // Not defined in any enclosing graph we know of.
+  return HashBuilder(kCapturedSeed).add(name).get();
+}
+
+void GraphHasher::addToScope(const Value* v, uint64_t h) {
+  values_[v->unique()] = v;
+  value_hashes_[v->unique()] = h;
+  if (has_scope_) {
+    scope_[v->uniqueName()] = h;
+  }
+}
+
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,117 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+
+#include "onnx/common/ir.h"
+
+namespace ONNX_NAMESPACE {
+
+// XXH64 of `size` bytes at `data`. Reads are in host byte order, so
+// hashes are only comparable between hosts of the same endianness.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Hash of a Tensor's type, dims and values. The values are hashed in their
+// raw_data representation, so a Tensor hashes the same whether its data is
+// stored in raw_data or in the typed fields. The name is not hashed.
+uint64_t HashTensor(const Tensor& t);
+
+// Exact counterparts of the hashes, to confirm that equal hashes are not a
+// collision. Like the hashes, they compare floating point values bitwise
+// (so -0.0 and 0.0 differ) and tensor data in its raw_data representation.
+// Subgraphs are compared with same_graph, or by identity if it is empty.
+using SameGraphFunction = std::function<bool(Graph&, Graph&)>;
+
+// Same type, dims, segment and values; the name is not compared. Tensors
+// of an undefined or unknown type are never the same.
+bool SameTensor(const Tensor& a, const Tensor& b);
+
+// Whether both nodes have the attribute, with the same kind and value.
+bool SameAttribute(
+    const Node* a,
+    const Node* b,
+    Symbol name,
+    const SameGraphFunction& same_graph = SameGraphFunction());
+
+// Same kind, domain, number of inputs and outputs and attributes: what
+// GraphHasher::localHash hashes.
+bool SameLocal(
+    const Node* a,
+    const Node* b,
+    const SameGraphFunction& same_graph = SameGraphFunction());
+
+// Structural, name-independent hashes over a Graph.
+//
+// Every Value gets a Merkle-style hash:
+//  - a graph input hashes its position, elem_type, rank and static dims
+//    (symbolic dims only count as "symbolic"), plus the HashTensor of its
+//    initializer if it has one;
+//  - a node output hashes its node's hash and its output index, where a
+//    node's hash covers its kind, domain, attributes (by name, with graph
+//    attributes hashed recursively) and the hashes of its inputs;
+//  - a value captured by a subgraph hashes like the value it refers to.
+//
+// Value names, node names and doc strings are ignored, so two graphs that
+// differ only in naming get the same hashes, and equal nodes (computing
+// the same thing from equal inputs) get equal hashes, wherever they are.
+// The graph's hash combines its input and output hashes with the hashes
+// of all of its nodes, so unused nodes count too.
+//
+// Hashes are computed once, in the constructor; the Graph must not be
+// modified while a GraphHasher refers to it. With hash_initializer_data
+// false, initializer values are not hashed, so graph inputs with an
+// initializer hash like any other graph input.
+class GraphHasher {
+ public:
+  explicit GraphHasher(Graph& g, bool hash_initializer_data = true);
+
+  uint64_t hash() const {
+    return graph_hash_;
+  }
+
+  // Hash of a Value or Node of the graph (not of a subgraph).
+  uint64_t hash(const Value* v) const;
+  uint64_t hash(const Node* n) const;
+
+  // Hash of a node's kind, domain, number of inputs and outputs and
+  // attributes, but not of its inputs. Any node of the graph or of its
+  // subgraphs can be hashed.
+  uint64_t localHash(Node* n);
+
+  // Hash of one attribute of a node: its name, kind and value.
+  uint64_t attributeHash(Node* n, Symbol name);
+
+ private:
+  GraphHasher(Graph& g, const GraphHasher* parent, bool hash_initializer_data);
+
+  void run(Graph& g);
+  uint64_t hashNode(Node* n);
+  uint64_t hashSymbol(Symbol s);
+  uint64_t hashSubgraph(Graph& g);
+  uint64_t lookupCaptured(const std::string& name) const;
+  void addToScope(const Value* v, uint64_t h);
+
+  const GraphHasher* parent_;
+  const bool hash_initializer_data_;
+  uint64_t graph_hash_;
+  // Hashed values and their hashes, by Value::unique().
+  std::vector<const Value*> values_;
+  std::vector<uint64_t> value_hashes_;
+  // Sorted by node once all nodes are hashed; for large graphs, this is
+  // much cheaper to build than a map.
+  std::vector<std::pair<const Node*, uint64_t>> node_hashes_;
+  // Value hashes by name, for the subgraphs that capture them. Only
+  // filled once the first subgraph is seen.
+  bool has_scope_;
+  std::unordered_map<std::string, uint64_t> scope_;
+  std::unordered_map<uint32_t, uint64_t> symbol_hashes_;
+};
+
+inline uint64_t HashGraph(Graph& g) {
+  return GraphHasher(g).hash();
+}
+
+} // namespace ONNX_NAMESPACE
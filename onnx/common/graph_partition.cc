@@ -0,0 +1,437 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/graph_partition.h"
+
+#include <deque>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "onnx/common/assertions.h"
+#include "onnx/common/ir_pb_converter.h"
+
+namespace ONNX_NAMESPACE {
+
+namespace {
+
+size_t elementSize(int32_t elem_type) {
+  switch (elem_type) {
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_INT8:
+    case TensorProto_DataType_UINT8:
+      return 1;
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_BFLOAT16:
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_UINT16:
+      return 2;
+    case TensorProto_DataType_FLOAT:
+    case TensorProto_DataType_INT32:
+    case TensorProto_DataType_UINT32:
+      return 4;
+    case TensorProto_DataType_DOUBLE:
+    case TensorProto_DataType_INT64:
+    case TensorProto_DataType_UINT64:
+    case TensorProto_DataType_COMPLEX64:
+      return 8;
+    case TensorProto_DataType_COMPLEX128:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+size_t valueBytes(const Value* v, size_t unknown_bytes) {
+  const size_t width = elementSize(v->elemType());
+  if (width == 0 || !v->has_sizes()) {
+    return unknown_bytes;
+  }
+  size_t bytes = width;
+  for (const auto& d : v->sizes()) {
+    if (!d.is_int || d.dim < 0) {
+      return unknown_bytes;
+    }
+    bytes *= static_cast<size_t>(d.dim);
+  }
+  return bytes;
+}
+
+// Uses the dims rather than the data, so lazy initializers stay lazy.
+size_t tensorBytes(const Tensor& t) {
+  const size_t width = elementSize(t.elem_type());
+  if (width == 0) {
+    size_t bytes = 0;
+    for (const auto& s : t.strings()) {
+      bytes += s.size();
+    }
+    return bytes;
+  }
+  size_t bytes = width;
+  for (int64_t d : t.sizes()) {
+    bytes *= static_cast<size_t>(d);
+  }
+  return bytes;
+}
+
+void collectCapturedNames(Graph& g, std::vector<std::string>* names) {
+  for (Node* n : g.nodes()) {
+    if (n->kind() == kCaptured) {
+      names->push_back(n->output()->uniqueName());
+    }
+    for (Symbol name : n->attributeNames()) {
+      if (n->kindOf(name) == AttributeKind::g) {
+        collectCapturedNames(*n->g(name), names);
+      } else if (n->kindOf(name) == AttributeKind::gs) {
+        for (const auto& subgraph : n->gs(name)) {
+          collectCapturedNames(*subgraph, names);
+        }
+      }
+    }
+  }
+}
+
+// The nodes of a graph in topological order, with the Values each uses:
+// its inputs and the outer Values its subgraphs capture.
+struct NodeUses {
+  explicit NodeUses(Graph& g) {
+    std::unordered_map<std::string, Value*> values;
+    for (Value* v : g.inputs()) {
+      values.emplace(v->uniqueName(), v);
+    }
+    for (Node* n : g.nodes()) {
+      if (n->kind() == kUndefined || n->kind() == kCaptured) {
+        continue;
+      }
+      for (Value* v : n->outputs()) {
+        values.emplace(v->uniqueName(), v);
+      }
+      nodes.push_back(n);
+    }
+
+    uses.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      Node* n = nodes[i];
+      std::unordered_set<Value*> seen;
+      for (Value* v : n->inputs()) {
+        if (v->node()->kind() != kUndefined && seen.insert(v).second) {
+          uses[i].push_back(v);
+        }
+      }
+      std::vector<std::string> captured;
+      for (Symbol name : n->attributeNames()) {
+        if (n->kindOf(name) == AttributeKind::g) {
+          collectCapturedNames(*n->g(name), &captured);
+        } else if (n->kindOf(name) == AttributeKind::gs) {
+          for (const auto& subgraph : n->gs(name)) {
+            collectCapturedNames(*subgraph, &captured);
+          }
+        }
+      }
+      for (const auto& name : captured) {
+        auto it = values.find(name);
+        if (it != values.end() && seen.insert(it->second).second) {
+          uses[i].push_back(it->second);
+        }
+      }
+    }
+  }
+
+  std::vector<Node*> nodes;
+  std::vector<std::vector<Value*>> uses;
+};
+
+// Returns the first nodes of each partition, followed by the number of
+// nodes, or nothing if no split meets the bounds. dp[k][i] is the least
+// cut of the first i nodes into k + 1 partitions.
+std::vector<size_t> splitPoints(
+    size_t num_partitions,
+    const std::vector<double>& prefix_cost,
+    const std::vector<size_t>& cut,
+    const std::vector<std::vector<size_t>>& min_start,
+    double lo,
+    double hi) {
+  const size_t n = prefix_cost.size() - 1;
+  const size_t kInf = std::numeric_limits<size_t>::max();
+  std::vector<std::vector<size_t>> dp(
+      num_partitions, std::vector<size_t>(n + 1, kInf));
+  std::vector<std::vector<size_t>> parent(
+      num_partitions, std::vector<size_t>(n + 1, 0));
+  for (size_t i = 1; i <= n; ++i) {
+    if (min_start[0][i] == 0 && prefix_cost[i] >= lo && prefix_cost[i] <= hi) {
+      dp[0][i] = 0;
+    }
+  }
+  for (size_t k = 1; k < num_partitions; ++k) {
+    // Candidate starts j of the last partition, by increasing j and cost.
+    std::deque<size_t> window;
+    size_t next = k;
+    for (size_t i = k + 1; i <= n; ++i) {
+      while (next < i && prefix_cost[next] <= prefix_cost[i] - lo) {
+        if (dp[k - 1][next] != kInf) {
+          const size_t total = dp[k - 1][next] + cut[next];
+          while (!window.empty() &&
+                 dp[k - 1][window.back()] + cut[window.back()] >= total) {
+            window.pop_back();
+          }
+          window.push_back(next);
+        }
+        ++next;
+      }
+      while (!window.empty() &&
+             (window.front() < min_start[k][i] ||
+              prefix_cost[window.front()] < prefix_cost[i] - hi)) {
+        window.pop_front();
+      }
+      if (!window.empty()) {
+        dp[k][i] = dp[k - 1][window.front()] + cut[window.front()];
+        parent[k][i] = window.front();
+      }
+    }
+  }
+  if (dp[num_partitions - 1][n] == kInf) {
+    return {};
+  }
+  std::vector<size_t> points(num_partitions + 1, 0);
+  points[num_partitions] = n;
+  for (size_t k = num_partitions - 1; k > 0; --k) {
+    points[k] = parent[k][points[k + 1]];
+  }
+  return points;
+}
+
+} // namespace
+
+GraphPartitioning PartitionGraph(
+    Graph& g,
+    const GraphPartitionOptions& options) {
+  const NodeUses node_uses(g);
+  const std::vector<Node*>& nodes = node_uses.nodes;
+  const size_t n = nodes.size();
+  const size_t num_partitions = options.num_partitions;
+  ONNX_ASSERTM(
+      num_partitions >= 1 && num_partitions <= n,
+      "Cannot split %zu nodes into %zu partitions",
+      n,
+      num_partitions);
+  ONNX_ASSERTM(
+      options.memory_caps.empty() ||
+          options.memory_caps.size() == num_partitions,
+      "Expected %zu memory caps, got %zu",
+      num_partitions,
+      options.memory_caps.size());
+
+  std::unordered_map<const Value*, size_t> producer;
+  for (size_t i = 0; i < n; ++i) {
+    for (Value* v : nodes[i]->outputs()) {
+      producer[v] = i;
+    }
+  }
+  std::unordered_map<const Value*, size_t> initializer_ids;
+  std::unordered_map<std::string, size_t> initializer_by_name;
+  for (size_t i = 0; i < g.initializer_names().size(); ++i) {
+    initializer_by_name.emplace(g.initializer_names()[i], i);
+  }
+  std::vector<size_t> initializer_bytes;
+  for (Value* v : g.inputs()) {
+    auto it = initializer_by_name.find(v->uniqueName());
+    if (it != initializer_by_name.end()) {
+      initializer_ids.emplace(v, initializer_bytes.size());
+      initializer_bytes.push_back(tensorBytes(g.initializers()[it->second]));
+    }
+  }
+
+  // The last node using each Value produced by a node.
+  std::unordered_map<const Value*, size_t> last_use;
+  std::vector<std::vector<size_t>> node_initializers(n);
+  for (size_t i = 0; i < n; ++i) {
+    for (Value* v : node_uses.uses[i]) {
+      if (producer.count(v) != 0) {
+        last_use[v] = i;
+      }
+      auto it = initializer_ids.find(v);
+      if (it != initializer_ids.end()) {
+        node_initializers[i].push_back(it->second);
+      }
+    }
+  }
+
+  // cut[b] is the bytes live across the boundary before node b.
+  std::vector<long long> delta(n + 2, 0);
+  for (const auto& use : last_use) {
+    const size_t p = producer.at(use.first);
+    if (use.second > p) {
+      const long long bytes = static_cast<long long>(
+          valueBytes(use.first, options.unknown_value_bytes));
+      delta[p + 1] += bytes;
+      delta[use.second + 1] -= bytes;
+    }
+  }
+  std::vector<size_t> cut(n + 1, 0);
+  long long live = 0;
+  for (size_t b = 0; b <= n; ++b) {
+    live += delta[b];
+    cut[b] = static_cast<size_t>(live);
+  }
+
+  std::vector<double> prefix_cost(n + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    const double cost = options.node_cost ? options.node_cost(nodes[i]) : 1.0;
+    prefix_cost[i + 1] = prefix_cost[i] + std::max(cost, 0.0);
+  }
+
+  // min_start[k][i] is the first node a partition k ending before node i
+  // can start at within its memory cap (i if none).
+  std::vector<std::vector<size_t>> min_start(
+      num_partitions, std::vector<size_t>(n + 1, 0));
+  for (size_t k = 0; k < num_partitions; ++k) {
+    const size_t cap = options.memory_caps.empty() ? 0 : options.memory_caps[k];
+    if (cap == 0) {
+      continue;
+    }
+    std::vector<size_t> counts(initializer_bytes.size(), 0);
+    size_t memory = 0;
+    size_t start = 0;
+    for (size_t i = 1; i <= n; ++i) {
+      for (size_t id : node_initializers[i - 1]) {
+        if (counts[id]++ == 0) {
+          memory += initializer_bytes[id];
+        }
+      }
+      while (memory > cap && start < i) {
+        for (size_t id : node_initializers[start]) {
+          if (--counts[id] == 0) {
+            memory -= initializer_bytes[id];
+          }
+        }
+        ++start;
+      }
+      min_start[k][i] = start;
+    }
+  }
+
+  const double total = prefix_cost[n];
+  const double average = total / static_cast<double>(num_partitions);
+  const double slack = 1e-9 * std::max(total, 1.0);
+  std::vector<size_t> points;
+  for (double imbalance = std::max(options.max_imbalance, 0.0);;
+       imbalance = imbalance > 0 ? 2 * imbalance : 0.05) {
+    const bool unbounded = imbalance >= static_cast<double>(num_partitions);
+    const double lo = unbounded ? -slack : (1 - imbalance) * average - slack;
+    const double hi = unbounded ? std::numeric_limits<double>::infinity()
+                                : (1 + imbalance) * average + slack;
+    points = splitPoints(num_partitions, prefix_cost, cut, min_start, lo, hi);
+    if (!points.empty() || unbounded) {
+      break;
+    }
+  }
+  ONNX_ASSERTM(
+      !points.empty(),
+      "Cannot split the graph into %zu partitions within the memory caps",
+      num_partitions);
+
+  GraphPartitioning result;
+  std::unordered_set<const Value*> graph_outputs(
+      g.outputs().begin(), g.outputs().end());
+  for (size_t k = 0; k < num_partitions; ++k) {
+    const size_t begin = points[k];
+    const size_t end = points[k + 1];
+    GraphPartition partition;
+    partition.cost = prefix_cost[end] - prefix_cost[begin];
+    std::unordered_set<size_t> used_initializers;
+    std::unordered_set<const Value*> inputs;
+    for (size_t i = begin; i < end; ++i) {
+      partition.nodes.push_back(nodes[i]);
+      for (size_t id : node_initializers[i]) {
+        if (used_initializers.insert(id).second) {
+          partition.memory_bytes += initializer_bytes[id];
+        }
+      }
+      for (Value* v : node_uses.uses[i]) {
+        auto it = producer.find(v);
+        if (it != producer.end() && it->second < begin &&
+            inputs.insert(v).second) {
+          partition.inputs.push_back(v);
+        }
+      }
+      for (Value* v : nodes[i]->outputs()) {
+        auto it = last_use.find(v);
+        if ((it != last_use.end() && it->second >= end) ||
+            graph_outputs.count(v) != 0) {
+          partition.outputs.push_back(v);
+        }
+      }
+    }
+    if (k > 0) {
+      result.cut_bytes += cut[begin];
+    }
+    result.partitions.push_back(std::move(partition));
+  }
+  return result;
+}
+
+std::vector<ModelProto> ExportPartitions(
+    const ModelProto& mp_in,
+    const std::shared_ptr<Graph>& g,
+    const GraphPartitioning& partitioning) {
+  ModelProto full = PrepareOutput(mp_in);
+  ExportModelProto(&full, g);
+  const GraphProto& fg = full.graph();
+
+  const NodeUses node_uses(*g);
+  ONNX_ASSERT(static_cast<size_t>(fg.node_size()) == node_uses.nodes.size());
+  std::unordered_map<const Node*, size_t> node_index;
+  for (size_t i = 0; i < node_uses.nodes.size(); ++i) {
+    node_index.emplace(node_uses.nodes[i], i);
+  }
+
+  std::vector<ModelProto> models;
+  for (size_t k = 0; k < partitioning.partitions.size(); ++k) {
+    const GraphPartition& partition = partitioning.partitions[k];
+    ModelProto m = PrepareOutput(mp_in);
+    GraphProto* pg = m.mutable_graph();
+    pg->set_name(fg.name() + "_partition" + ONNX_NAMESPACE::to_string(k));
+
+    std::unordered_set<std::string> used;
+    std::unordered_set<std::string> produced;
+    for (Node* n : partition.nodes) {
+      const size_t i = node_index.at(n);
+      *pg->add_node() = fg.node(static_cast<int>(i));
+      for (Value* v : node_uses.uses[i]) {
+        used.insert(v->uniqueName());
+      }
+      for (Value* v : n->outputs()) {
+        produced.insert(v->uniqueName());
+      }
+    }
+
+    std::unordered_set<std::string> boundary;
+    for (const auto& input : fg.input()) {
+      if (used.count(input.name()) != 0) {
+        *pg->add_input() = input;
+      }
+    }
+    for (Value* v : partition.inputs) {
+      encodeValueInfo(pg->add_input(), v);
+    }
+    for (Value* v : partition.outputs) {
+      encodeValueInfo(pg->add_output(), v);
+      boundary.insert(v->uniqueName());
+    }
+    for (const auto& initializer : fg.initializer()) {
+      if (used.count(initializer.name()) != 0) {
+        *pg->add_initializer() = initializer;
+      }
+    }
+    for (const auto& info : fg.value_info()) {
+      if (produced.count(info.name()) != 0 &&
+          boundary.count(info.name()) == 0) {
+        *pg->add_value_info() = info;
+      }
+    }
+    models.push_back(std::move(m));
+  }
+  return models;
+}
+
+} // namespace ONNX_NAMESPACE
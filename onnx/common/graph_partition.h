@@ -0,0 +1,67 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <functional>
+
+#include "onnx/common/ir.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+
+struct GraphPartitionOptions {
+  size_t num_partitions = 2;
+  // The cost of running a node, e.g. its estimated time; every node costs
+  // 1 if unset. Nodes with subgraphs are placed as a whole.
+  std::function<double(const Node*)> node_cost;
+  // The most initializer bytes each partition may hold, 0 meaning no
+  // bound; no bounds if empty. An initializer used in several partitions
+  // counts in each.
+  std::vector<size_t> memory_caps;
+  // Partitions cost within (1 +/- max_imbalance) times the average when
+  // that is possible; otherwise the bound is doubled until it is.
+  double max_imbalance = 0.1;
+  // The size assumed for Values without a static shape.
+  size_t unknown_value_bytes = 4096;
+};
+
+struct GraphPartition {
+  // In topological order.
+  std::vector<Node*> nodes;
+  double cost = 0;
+  size_t memory_bytes = 0;
+  // Values computed by earlier partitions that this one uses.
+  std::vector<Value*> inputs;
+  // Values this partition computes that later partitions use, and the
+  // graph outputs it computes.
+  std::vector<Value*> outputs;
+};
+
+struct GraphPartitioning {
+  std::vector<GraphPartition> partitions;
+  // The bytes of the Values passed from each partition to the next,
+  // summed over the boundaries. A Value used several partitions later is
+  // counted at each boundary it crosses, as when partitions run as a
+  // pipeline.
+  size_t cut_bytes = 0;
+};
+
+// Splits the nodes of g into options.num_partitions partitions, each a
+// contiguous range of g's topological order, so that partitions only use
+// Values of earlier ones. Among the splits that respect the memory caps
+// and balance, one with the fewest cut_bytes is chosen (by dynamic
+// programming, in O(num_partitions * nodes) after a linear scan of the
+// graph). Fails with an assert_error if the memory caps cannot be met.
+GraphPartitioning PartitionGraph(Graph& g, const GraphPartitionOptions& options);
+
+// Exports each partition of g as a standalone model: its graph inputs are
+// the graph inputs of g it uses and its boundary inputs, its outputs are
+// its boundary outputs, and it holds the initializers it uses. The models
+// take their metadata (IR version, opsets, ...) from mp_in.
+std::vector<ModelProto> ExportPartitions(
+    const ModelProto& mp_in,
+    const std::shared_ptr<Graph>& g,
+    const GraphPartitioning& partitioning);
+
+} // namespace ONNX_NAMESPACE
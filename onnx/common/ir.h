@@ -8,10 +8,13 @@
 #include <cstdint>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -105,13 +108,18 @@ struct AttributeValue {
 
 template<typename T, AttributeKind Kind>
 struct ScalarAttributeValue final : public AttributeValue {
-  using ConstructorType = const T &;
+  // Taken by value so that large payloads (e.g. the Tensor of a Constant
+  // node) can be moved in rather than copied.
+  using ConstructorType = T;
   using ValueType = T;
   ScalarAttributeValue(Symbol name, ConstructorType value_)
-  : AttributeValue(name), value_(value_) {}
+  : AttributeValue(name), value_(std::move(value_)) {}
   ValueType & value() {
     return value_;
   }
+  const ValueType & value() const {
+    return value_;
+  }
   virtual Ptr clone() const override {
     return Ptr(new ScalarAttributeValue(name, value_));
   }
@@ -131,6 +139,9 @@ struct VectorAttributeValue final : public AttributeValue {
   ValueType & value() {
     return value_;
   }
+  const ValueType & value() const {
+    return value_;
+  }
   virtual AttributeKind kind() const override { return Kind; }
   virtual std::unique_ptr<AttributeValue> clone() const override {
     auto copy = value_;
@@ -161,10 +172,14 @@ template<typename Derived>
 struct Attributes {
   Attributes() {}
   void copyAttributes(const Attributes & rhs) {
+    This()->recordAttributesReplaced(std::move(values_));
     values_.clear();
     values_.reserve(rhs.values_.size());
     for(auto & i : rhs.values_) {
       values_.push_back(i->clone());
+      if (isGraphKind(i->kind())) {
+        This()->noteGraphAttribute();
+      }
     }
   }
   bool hasAttribute(Symbol name) const {
@@ -173,8 +188,15 @@ struct Attributes {
   AttributeKind kindOf(Symbol name) const {
     return (*find(name,true))->kind();
   }
+  // The attribute named name, or nullptr if it is not set, in one lookup.
+  const AttributeValue* findAttribute(Symbol name) const {
+    auto it = find(name,false);
+    return it == values_.end() ? nullptr : it->get();
+  }
   Derived* removeAttribute(Symbol name) {
-    values_.erase(find(name,true));
+    auto it = find(name,true);
+    This()->recordAttributeEdit(name, std::move(*it), it - values_.begin());
+    values_.erase(it);
     return This();
   }
   bool hasAttributes() const {
@@ -210,6 +232,8 @@ struct Attributes {
   #undef CREATE_ACCESSOR
 
 private:
+  // Graph undoes the edits recorded during a transaction.
+  friend struct Graph;
   Derived* This() {
     return static_cast<Derived*>(this);
   }
@@ -217,9 +241,14 @@ private:
   Derived* set(Symbol name, typename T::ConstructorType v) {
     auto it = find(name, false);
     auto nv = AVPtr(new T(name, std::forward<typename T::ConstructorType>(v)));
+    if (isGraphKind(nv->kind())) {
+      This()->noteGraphAttribute();
+    }
     if(it == values_.end()) {
+      This()->recordAttributeEdit(name, nullptr, kAttributeSet);
       values_.push_back(std::move(nv));
     } else {
+      This()->recordAttributeEdit(name, std::move(*it), kAttributeSet);
       *it = std::move(nv);
     }
     return This();
@@ -230,7 +259,12 @@ private:
     T* child = static_cast<T*>(it->get());
     return child->value();
   }
+  static bool isGraphKind(AttributeKind kind) {
+    return kind == AttributeKind::g || kind == AttributeKind::gs;
+  }
   using AVPtr = AttributeValue::Ptr;
+  // The index recorded for an attribute that was set rather than removed.
+  static constexpr size_t kAttributeSet = std::numeric_limits<size_t>::max();
   // NB: For determinism, we use a vector rather than a hash map.  This does
   // mean that lookups are O(n), so you shouldn't use Attributes to store
   // a big pile of messages.
@@ -296,9 +330,15 @@ private:
   int32_t elem_type_;
   bool has_sizes_;
   std::vector<Dimension> sizes_;
+  // see Graph::beginTransaction
+  uint64_t recorded_in_ = 0;
+
+  // Saves the state of this value before its first edit in a transaction.
+  void recordEdit(); //defined after graph
 
 public:
   Value* setElemType(int32_t elem_type) {
+    recordEdit();
     elem_type_ = elem_type;
     return this;
   }
@@ -307,6 +347,7 @@ public:
   }
   bool has_sizes() const { return has_sizes_; }
   Value* setSizes(std::vector<Dimension> sizes) {
+    recordEdit();
     has_sizes_ = true;
     sizes_ = std::move(sizes);
     return this;
@@ -326,11 +367,13 @@ public:
     return ONNX_NAMESPACE::to_string(unique());
   }
   Value* setUniqueName(std::string name) {
+    recordEdit();
     has_unique_name_ = true;
     unique_name_ = std::move(name);
     return this;
   }
   Value* setStage(size_t s) {
+    recordEdit();
     stage_ = s;
     return this;
   }
@@ -378,6 +421,7 @@ public:
 
 struct Node : public Attributes<Node> {
   ONNX_DISALLOW_COPY_AND_ASSIGN(Node);
+  friend struct Attributes<Node>;
   friend struct Graph;
   friend struct Value;
   friend graph_node_list;
@@ -404,15 +448,22 @@ private:
 
   const NodeKind kind_;
   std::vector<Value*> inputs_;
+  // input_uses_[i] is the position of this node's use of input i in that
+  // Value's uses_, so uses can be found and removed in constant time.
+  std::vector<size_t> input_uses_;
   std::vector<Value*> outputs_;
   Graph* graph_;
   size_t stage_;
+  // Increases along the node list; see Graph::nodesOfKind.
+  uint64_t position_ = 0;
   bool has_name_;
   std::string name_;
   bool has_domain_;
   std::string domain_;
   bool has_doc_string_;
   std::string doc_string_;
+  // see Graph::beginTransaction
+  uint64_t recorded_in_ = 0;
 
 protected:
   Node(Graph * graph_, NodeKind kind_); //defined after graph
@@ -425,16 +476,18 @@ public:
     return name_;
   }
   void setName(std::string name) {
+    recordEdit();
     has_name_ = true;
     name_ = std::move(name);
   }
-  bool has_domain() {
+  bool has_domain() const {
     return has_domain_;
   }
   const std::string& domain() const {
     return domain_;
   }
   void setDomain(std::string domain) {
+    recordEdit();
     has_domain_ = true;
     domain_ = std::move(domain);
   }
@@ -445,6 +498,7 @@ public:
     return doc_string_;
   }
   void setDocString(std::string doc_string) {
+    recordEdit();
     has_doc_string_ = true;
     doc_string_ = std::move(doc_string);
   }
@@ -461,6 +515,7 @@ public:
     return stage_;
   }
   Node* setStage(size_t s) {
+    recordEdit();
     stage_ = s;
     return this;
   }
@@ -550,6 +605,9 @@ public:
   // Result:  %3 = f(%1, %2, %4)
   Value* addInput(Value * node) {
     ONNX_ASSERT(graph_ == node->owningGraph());
+    recordEdit();
+    node->recordEdit();
+    input_uses_.push_back(node->uses_.size());
     node->uses_.emplace_back(this, inputs_.size());
     inputs_.push_back(node);
     return node;
@@ -564,7 +622,9 @@ public:
   Value * replaceInput(size_t i, Value * newValue) {
     ONNX_ASSERT(newValue->owningGraph() == graph_);
     Value * old = dropInput(i);
+    newValue->recordEdit();
     inputs_[i] = newValue;
+    input_uses_[i] = newValue->uses_.size();
     newValue->uses_.emplace_back(this, i);
     return old;
   }
@@ -587,12 +647,17 @@ public:
   }
 
   Value* addOutput() {
+    recordEdit();
     outputs_.push_back(new Value(this, outputs_.size()));
     return outputs_.back();
   }
 
   void eraseOutput(size_t i);
 
+  // Erases the outputs at `offsets`, which must have no uses, in one pass
+  // over the outputs rather than one per erased output.
+  void eraseOutputs(std::vector<size_t> offsets);
+
   // Insert unattached 'this' node after 'n' in the topological order.
   // Returns this (for chaining).
   //
@@ -619,15 +684,7 @@ public:
   // Result:  %3 = f(%1, %2)
   //          %4 = g(%3)
   //          %5 = h(%1)
-  Node* insertAfter(Node * n) {
-    ONNX_ASSERT(!inGraphList() && n->inGraphList());
-    Node * next = n->next();
-    n->next() = this;
-    this->prev() = n;
-    this->next() = next;
-    next->prev() = this;
-    return this;
-  }
+  Node* insertAfter(Node * n); //defined after graph
 
   // Move 'this' (already in the graph) after 'n' in the topological order.
   //
@@ -667,10 +724,11 @@ public:
     // everything after this input shifts left,
     // so we need to update their use offsets to match
     for(size_t j = i+1; j < inputs_.size(); j++) {
-      auto it = findUseForInput(j);
-      it->offset--;
+      inputs_[j]->recordEdit();
+      findUseForInput(j)->offset--;
     }
     inputs_.erase(inputs_.begin() + i);
+    input_uses_.erase(input_uses_.begin() + i);
   }
 
   // Remove all inputs from a node.
@@ -682,11 +740,18 @@ public:
     for(size_t i = 0; i < inputs().size(); ++i)
       dropInput(i);
     inputs_.clear();
+    input_uses_.clear();
   }
 
   // Check whether this node is before node n in the graph.
+  // O(1) when both are in the node list.
   bool isBefore(Node* n);
 
+  // Increases along the node list of the graph; see Graph::nodesOfKind.
+  uint64_t position() const {
+    return position_;
+  }
+
   // iterators of the node list starting at this node
   // useful for resuming a search starting at this node
   graph_node_list_iterator iterator();
@@ -728,21 +793,31 @@ private:
   // Lookup iterator in use list of _input i_ that corresponds to its use of _this_
   use_list::iterator findUseForInput(size_t i) {
     auto & input_uses = inputs_[i]->uses_;
-    // O(N) on the use list, but unless we get nodes with +100 uses
-    // vector traversal still is probably faster than linked list
-    auto use_it = std::find(input_uses.begin(), input_uses.end(), Use(this, i));
-    ONNX_ASSERT(use_it != input_uses.end());
+    auto use_it = input_uses.begin() + input_uses_[i];
+    ONNX_ASSERT(*use_it == Use(this, i));
     return use_it;
   }
 
   // remove the use of input i, this sets input i to nullptr, but
   // is only used internally to Node before setting it to a new value
   // or erasing the entry from the list.
+  //
+  // The last use of the input takes the place of the removed one, so this
+  // is O(1) however many uses the input has. Use lists are thus ordered
+  // by the sequence of edits, not by when each use was added.
   Value* dropInput(size_t i) {
     ONNX_ASSERT(i < inputs_.size());
     auto input_node = inputs_[i];
+    auto & input_uses = input_node->uses_;
     auto use_it = findUseForInput(i);
-    input_node->uses_.erase(use_it);
+    recordEdit();
+    input_node->recordEdit();
+    if (use_it + 1 != input_uses.end()) {
+      input_uses.back().user->recordEdit();
+      *use_it = input_uses.back();
+      use_it->user->input_uses_[use_it->offset] = use_it - input_uses.begin();
+    }
+    input_uses.pop_back();
     inputs_[i] = nullptr;
     return input_node;
   }
@@ -751,15 +826,14 @@ private:
     ONNX_ASSERT(next() != nullptr || prev() == nullptr);
     return next() != nullptr;
   }
-  void removeFromList() {
-    ONNX_ASSERT(inGraphList());
-    Node * next = this->next();
-    Node * prev = this->prev();
-    prev->next() = next;
-    next->prev() = prev;
-    this->next() = nullptr;
-    this->prev() = nullptr;
-  }
+  void removeFromList(); //defined after graph
+  // Called when a graph or graphs attribute is set on this node.
+  void noteGraphAttribute(); //defined after graph
+  // Save the state of this node, or an attribute it had, before its first
+  // edit in a transaction; see Graph::beginTransaction.
+  void recordEdit(); //defined after graph
+  void recordAttributeEdit(Symbol name, AttributeValue::Ptr old, size_t index); //defined after graph
+  void recordAttributesReplaced(std::vector<AttributeValue::Ptr> old); //defined after graph
 
 protected:
   // subclasses must override
@@ -847,6 +921,141 @@ private:
   std::unordered_set<const Value*> all_values;
   size_t next_unique_;
 
+  // The state of the graph objects edited in a transaction, as they were
+  // before their first edit, and the objects created and freed since.
+  struct EditLog {
+    // Nodes and values edited in this transaction have recorded_in_ == id,
+    // and those created in it id + 1.
+    uint64_t id;
+
+    struct SavedNode {
+      explicit SavedNode(Node * n)
+      : node(n)
+      , next_in_graph{n->next_in_graph[0], n->next_in_graph[1]}
+      , inputs(n->inputs_)
+      , input_uses(n->input_uses_)
+      , outputs(n->outputs_)
+      , stage(n->stage_)
+      , position(n->position_)
+      , has_name(n->has_name_)
+      , name(n->name_)
+      , has_domain(n->has_domain_)
+      , domain(n->domain_)
+      , has_doc_string(n->has_doc_string_)
+      , doc_string(n->doc_string_) {}
+      void restore() {
+        node->next_in_graph[0] = next_in_graph[0];
+        node->next_in_graph[1] = next_in_graph[1];
+        node->inputs_ = std::move(inputs);
+        node->input_uses_ = std::move(input_uses);
+        node->outputs_ = std::move(outputs);
+        node->stage_ = stage;
+        node->position_ = position;
+        node->has_name_ = has_name;
+        node->name_ = std::move(name);
+        node->has_domain_ = has_domain;
+        node->domain_ = std::move(domain);
+        node->has_doc_string_ = has_doc_string;
+        node->doc_string_ = std::move(doc_string);
+      }
+      Node * node;
+      Node * next_in_graph[2];
+      std::vector<Value*> inputs;
+      std::vector<size_t> input_uses;
+      std::vector<Value*> outputs;
+      size_t stage;
+      uint64_t position;
+      bool has_name;
+      std::string name;
+      bool has_domain;
+      std::string domain;
+      bool has_doc_string;
+      std::string doc_string;
+    };
+    struct SavedValue {
+      explicit SavedValue(Value * v)
+      : value(v)
+      , offset(v->offset_)
+      , stage(v->stage_)
+      , uses(v->uses_)
+      , has_unique_name(v->has_unique_name_)
+      , unique_name(v->unique_name_)
+      , elem_type(v->elem_type_)
+      , has_sizes(v->has_sizes_)
+      , sizes(v->sizes_) {}
+      void restore() {
+        value->offset_ = offset;
+        value->stage_ = stage;
+        value->uses_ = std::move(uses);
+        value->has_unique_name_ = has_unique_name;
+        value->unique_name_ = std::move(unique_name);
+        value->elem_type_ = elem_type;
+        value->has_sizes_ = has_sizes;
+        value->sizes_ = std::move(sizes);
+      }
+      Value * value;
+      size_t offset;
+      size_t stage;
+      use_list uses;
+      bool has_unique_name;
+      std::string unique_name;
+      int32_t elem_type;
+      bool has_sizes;
+      std::vector<Dimension> sizes;
+    };
+    // An attribute set (index kAttributeSet, old null if it was new) or
+    // removed from index, or all attributes replaced by copyAttributes.
+    struct AttributeEdit {
+      Node * node;
+      Symbol name;
+      AttributeValue::Ptr old;
+      size_t index;
+      bool replaced_all;
+      std::vector<AttributeValue::Ptr> old_values;
+    };
+    struct InitializerEdit {
+      enum Kind { Added, TensorErased, NameErased, Replaced } kind;
+      size_t index;
+      Tensor tensor;
+      std::string name;
+    };
+
+    std::vector<SavedNode> nodes;
+    std::vector<SavedValue> values;
+    std::vector<AttributeEdit> attributes;
+    std::vector<InitializerEdit> initializers;
+    // The indices of the initializers already saved by mutableInitializer
+    // since the last erase, which shifts them.
+    std::vector<bool> replaced_initializers;
+    std::vector<Node*> created_nodes;
+    std::vector<Value*> created_values;
+    // Freed nodes are only deleted on commit.
+    std::vector<Node*> freed_nodes;
+    std::vector<Value*> freed_values;
+    // The subgraphs of the nodes, which are in transactions of their own.
+    std::vector<std::shared_ptr<Graph>> subgraphs;
+
+    size_t next_unique;
+    size_t new_node_stage;
+    size_t num_nodes;
+    bool has_name;
+    std::string name;
+    bool has_doc_string;
+    std::string doc_string;
+    std::vector<OpSetID> opset_versions;
+  };
+  // Set while a transaction is open.
+  std::unique_ptr<EditLog> edit_log_;
+  uint64_t num_transactions_ = 0;
+
+  // the nodes in the node list by kind, keyed by position
+  std::unordered_map<NodeKind, std::map<uint64_t, Node*>> nodes_by_kind_;
+  size_t num_nodes_ = 0;
+  // kinds of the nodes that have been given subgraphs
+  std::unordered_set<NodeKind> kinds_with_subgraphs_;
+  // false while concurrent attribute edits are allowed
+  bool record_subgraph_kinds_ = true;
+
   size_t new_node_stage_;
 
   // holds outputs in a way that can be reflected
@@ -887,26 +1096,30 @@ public:
   }
 
   void addInitializer(Tensor initializer, std::string name) {
+    if (edit_log_) {
+      logInitializerEdit(EditLog::InitializerEdit::Added, 0, Tensor(), std::string());
+    }
     initializers_.push_back(std::move(initializer));
     initializer_names_.push_back(std::move(name));
   }
   void eraseInitializer(std::string name) {
-    initializers_.erase(
-        std::remove_if(
-            initializers_.begin(),
-            initializers_.end(),
-            [&name](Tensor& initializer) {
-              return initializer.name() == name;
-            }),
-        initializers_.end());
-    initializer_names_.erase(
-        std::remove(
-            initializer_names_.begin(),
-            initializer_names_.end(),
-            name),
-        initializer_names_.end());
+    std::vector<bool> tensors(initializers_.size());
+    for (size_t i = 0; i < initializers_.size(); i++) {
+      tensors[i] = initializers_[i].name() == name;
+    }
+    std::vector<bool> names(initializer_names_.size());
+    for (size_t i = 0; i < initializer_names_.size(); i++) {
+      names[i] = initializer_names_[i] == name;
+    }
+    eraseInitializersAt(tensors, names);
   }
   void clearInitializers() {
+    if (edit_log_) {
+      eraseInitializersAt(
+          std::vector<bool>(initializers_.size(), true),
+          std::vector<bool>(initializer_names_.size(), true));
+      return;
+    }
     initializers_.clear();
     initializer_names_.clear();
   }
@@ -916,6 +1129,22 @@ public:
   const std::vector<std::string>& initializer_names() {
     return initializer_names_;
   }
+  // For passes that rewrite the data of an initializer in place. In a
+  // transaction the tensor is copied on the first call for each index, so
+  // passes should only call this for the tensors they rewrite.
+  Tensor& mutableInitializer(size_t i) {
+    if (edit_log_) {
+      auto & replaced = edit_log_->replaced_initializers;
+      if (replaced.size() <= i) {
+        replaced.resize(initializers_.size());
+      }
+      if (!replaced[i]) {
+        replaced[i] = true;
+        logInitializerEdit(EditLog::InitializerEdit::Replaced, i, initializers_[i], std::string());
+      }
+    }
+    return initializers_[i];
+  }
   std::vector<Tensor>::const_iterator getInitializer(const std::string& name) {
     for (auto it = initializers_.cbegin(); it != initializers_.cend(); ++it) {
       if (name == it->name()) {
@@ -1035,6 +1264,39 @@ public:
     return n;
   }
 
+  // The nodes of the given kind in the node list, in topological order. The
+  // keys only order nodes of this graph, and those of the nodes around an
+  // insertion change when it finds no free position between its neighbours.
+  //
+  // This index is updated in O(log n) on each removal, and in amortized
+  // O(log^2 n) on each insertion, so passes can visit the nodes of a kind
+  // without walking the whole list.
+  const std::map<uint64_t, Node*>& nodesOfKind(NodeKind kind) const {
+    static const std::map<uint64_t, Node*> empty;
+    auto it = nodes_by_kind_.find(kind);
+    return it == nodes_by_kind_.end() ? empty : it->second;
+  }
+
+  // The number of nodes in the node list.
+  size_t numNodes() const {
+    return num_nodes_;
+  }
+
+  // The kinds of the nodes that have been given graph or graphs attributes.
+  // The nodes that hold subgraphs now are among the nodes of these kinds.
+  const std::unordered_set<NodeKind>& kindsWithSubgraphs() const {
+    return kinds_with_subgraphs_;
+  }
+
+  // While paused, nodes given graph or graphs attributes are not recorded
+  // in kindsWithSubgraphs(), so that threads can set the attributes of
+  // distinct nodes concurrently. Resuming records the kinds of all nodes
+  // that hold subgraphs by then.
+  void pauseSubgraphKinds() {
+    record_subgraph_kinds_ = false;
+  }
+  void resumeSubgraphKinds(); //defined after Node
+
   //Adds to graph initializer list, initializer names list, and as a graph input
   //Also syncs the initializer name, tensor name, and value name
   Value* addInitializerAndInput(const Tensor& initializer, std::string name) {
@@ -1062,6 +1324,24 @@ public:
     eraseInput(v->offset());
   }
 
+  //Like eraseInitializerAndInput for each of values, but in one pass over
+  //the initializers and inputs rather than one per value
+  void eraseInitializersAndInputs(const std::vector<Value*>& values) {
+    std::unordered_set<std::string> names;
+    std::vector<size_t> offsets;
+    offsets.reserve(values.size());
+    for (Value* v : values) {
+      names.insert(v->uniqueName());
+      offsets.push_back(v->offset());
+    }
+    std::vector<bool> erased(initializers_.size());
+    for (size_t i = 0; i < initializers_.size(); i++) {
+      erased[i] = names.count(initializer_names_[i]) != 0;
+    }
+    eraseInitializersAt(erased, erased);
+    input_->eraseOutputs(std::move(offsets));
+  }
+
   ~Graph() {
     for (const Node * n : all_nodes)
       delete n;
@@ -1069,6 +1349,75 @@ public:
       delete v;
   }
 
+  // Transactions let a caller try edits, such as a speculative pass, and
+  // keep them with commitTransaction or undo them all with
+  // rollbackTransaction, which restores the graph exactly: the node order,
+  // the order of each use list, attributes, initializers and the subgraphs
+  // of the nodes. Node and Value pointers taken before the transaction stay
+  // valid after either.
+  //
+  // Rather than copying the graph, beginTransaction starts an edit log, so
+  // it costs O(1) plus the number of nodes holding subgraphs, however large
+  // the graph. Each node or value is saved on its first edit, so an
+  // edit costs the same as outside a transaction after that, and rollback
+  // is O(k log n) in the k objects edited. Transactions do not nest.
+  void beginTransaction() {
+    ONNX_ASSERTM(!edit_log_, "a transaction is already open");
+    std::unique_ptr<EditLog> log(new EditLog());
+    log->id = 2 * ++num_transactions_;
+    log->next_unique = next_unique_;
+    log->new_node_stage = new_node_stage_;
+    log->num_nodes = num_nodes_;
+    log->has_name = has_name_;
+    log->name = name_;
+    log->has_doc_string = has_doc_string_;
+    log->doc_string = doc_string_;
+    log->opset_versions = opset_versions_;
+    std::unordered_set<const Graph*> seen;
+    auto add_subgraph = [&](const std::shared_ptr<Graph> & g) {
+      if (g && seen.insert(g.get()).second) {
+        log->subgraphs.push_back(g);
+      }
+    };
+    for (NodeKind kind : kinds_with_subgraphs_) {
+      for (const auto & kv : nodesOfKind(kind)) {
+        for (const auto & a : kv.second->values_) {
+          if (a->kind() == AttributeKind::g) {
+            add_subgraph(static_cast<GraphAttr*>(a.get())->value());
+          } else if (a->kind() == AttributeKind::gs) {
+            for (const auto & g : static_cast<GraphsAttr*>(a.get())->value()) {
+              add_subgraph(g);
+            }
+          }
+        }
+      }
+    }
+    for (const auto & g : log->subgraphs) {
+      g->beginTransaction();
+    }
+    edit_log_ = std::move(log);
+  }
+
+  bool inTransaction() const {
+    return edit_log_ != nullptr;
+  }
+
+  // Keeps the edits of the open transaction.
+  void commitTransaction() {
+    ONNX_ASSERTM(edit_log_, "no transaction is open");
+    std::unique_ptr<EditLog> log = std::move(edit_log_);
+    for (const auto & g : log->subgraphs) {
+      g->commitTransaction();
+    }
+    for (Node * n : log->freed_nodes) {
+      all_nodes.erase(n);
+      delete n;
+    }
+  }
+
+  // Undoes the edits of the open transaction.
+  void rollbackTransaction(); //defined after graph
+
   std::string toString() const {
     std::ostringstream oss;
     oss << *this;
@@ -1100,9 +1449,93 @@ private:
     return p;
   }
 
+  // The gap between the positions of adjacent nodes when they are appended,
+  // leaving room for 20 insertions in between.
+  static constexpr uint64_t kPositionGap = uint64_t(1) << 20;
+
+  // Gives n, just linked into the node list, a position between its
+  // neighbours and adds it to nodes_by_kind_. When they leave no room, the
+  // nodes around n are relabeled.
+  void indexNode(Node * n) {
+    Node * prev = n->prev();
+    Node * next = n->next();
+    uint64_t lo = prev == output_ ? 0 : prev->position_;
+    if (next == output_ && lo <= std::numeric_limits<uint64_t>::max() - kPositionGap) {
+      n->position_ = lo + kPositionGap;
+    } else if (next != output_ && next->position_ - lo >= 2) {
+      n->position_ = lo + (next->position_ - lo) / 2;
+    } else {
+      relabelAround(n);
+      ++num_nodes_;
+      return;
+    }
+    nodes_by_kind_[n->kind()].emplace(n->position_, n);
+    ++num_nodes_;
+  }
+
+  void unindexNode(Node * n) {
+    auto it = nodes_by_kind_.find(n->kind());
+    ONNX_ASSERT(it != nodes_by_kind_.end());
+    it->second.erase(n->position_);
+    --num_nodes_;
+  }
+
+  // Gives n, which has no position yet, and the nodes around it evenly
+  // spread positions, as in an order-maintenance list: it picks the
+  // smallest aligned range of 2^b positions around n that holds at most
+  // 2^(b/2) nodes, so that larger ranges may be fuller. Repeated insertions
+  // at one place then relabel O(log n) nodes each, amortized, rather than
+  // the whole list.
+  void relabelAround(Node * n) {
+    const uint64_t anchor = n->prev() == output_ ? 0 : n->prev()->position_;
+    for (int bits = 2; bits <= 64; ++bits) {
+      const uint64_t mask = bits == 64 ? std::numeric_limits<uint64_t>::max()
+                                       : (uint64_t(1) << bits) - 1;
+      const uint64_t base = anchor & ~mask;
+      const uint64_t max_nodes = uint64_t(1) << (bits / 2);
+      Node * first = n;
+      Node * last = n;
+      uint64_t count = 1;
+      while (count <= max_nodes && first->prev() != output_ &&
+             first->prev()->position_ >= base) {
+        first = first->prev();
+        ++count;
+      }
+      while (count <= max_nodes && last->next() != output_ &&
+             last->next()->position_ - base <= mask) {
+        last = last->next();
+        ++count;
+      }
+      if (count > max_nodes) {
+        continue;
+      }
+      // The new positions may be old ones of other nodes in the range, so
+      // all of them are taken out of the index first.
+      for (Node * p = first; p != last->next(); p = p->next()) {
+        if (p != n) {
+          p->recordEdit();
+          nodes_by_kind_[p->kind()].erase(p->position_);
+        }
+      }
+      const uint64_t step = mask / (count + 1);
+      uint64_t position = base;
+      for (Node * p = first; p != last->next(); p = p->next()) {
+        position += step;
+        p->position_ = position;
+        nodes_by_kind_[p->kind()].emplace(position, p);
+      }
+      return;
+    }
+    ONNX_ASSERTM(false, "too many nodes to give them positions");
+  }
+
   void freeNode(Node * n) {
     auto it = all_nodes.find(n);
     ONNX_ASSERT(it != all_nodes.end());
+    if (edit_log_) {
+      edit_log_->freed_nodes.push_back(n);
+      return;
+    }
     delete *it;
     all_nodes.erase(it);
   }
@@ -1110,6 +1543,70 @@ private:
     auto it = all_values.find(v);
     ONNX_ASSERT(it != all_values.end());
     all_values.erase(it);
+    if (edit_log_) {
+      edit_log_->freed_values.push_back(v);
+    }
+  }
+
+  void logInitializerEdit(
+      EditLog::InitializerEdit::Kind kind,
+      size_t index,
+      Tensor tensor,
+      std::string name) {
+    edit_log_->initializers.emplace_back();
+    auto & edit = edit_log_->initializers.back();
+    edit.kind = kind;
+    edit.index = index;
+    edit.tensor = std::move(tensor);
+    edit.name = std::move(name);
+  }
+
+  // Erases the initializer tensors and names at the indices marked. In a
+  // transaction, each batch is logged from its last index so that rollback
+  // reinserts it from the first.
+  void eraseInitializersAt(
+      const std::vector<bool> & tensors,
+      const std::vector<bool> & names) {
+    const size_t first_edit = edit_log_ ? edit_log_->initializers.size() : 0;
+    if (edit_log_) {
+      edit_log_->replaced_initializers.clear();
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < initializers_.size(); i++) {
+      if (tensors[i]) {
+        if (edit_log_) {
+          logInitializerEdit(EditLog::InitializerEdit::TensorErased, i,
+                             std::move(initializers_[i]), std::string());
+        }
+      } else {
+        if (kept != i) {
+          initializers_[kept] = std::move(initializers_[i]);
+        }
+        kept++;
+      }
+    }
+    initializers_.resize(kept);
+    const size_t first_name_edit = edit_log_ ? edit_log_->initializers.size() : 0;
+    kept = 0;
+    for (size_t i = 0; i < initializer_names_.size(); i++) {
+      if (names[i]) {
+        if (edit_log_) {
+          logInitializerEdit(EditLog::InitializerEdit::NameErased, i,
+                             Tensor(), std::move(initializer_names_[i]));
+        }
+      } else {
+        if (kept != i) {
+          initializer_names_[kept] = std::move(initializer_names_[i]);
+        }
+        kept++;
+      }
+    }
+    initializer_names_.resize(kept);
+    if (edit_log_) {
+      auto & edits = edit_log_->initializers;
+      std::reverse(edits.begin() + first_edit, edits.begin() + first_name_edit);
+      std::reverse(edits.begin() + first_name_edit, edits.end());
+    }
   }
 };
 
@@ -1118,7 +1615,12 @@ inline Value::Value(Node *node_, size_t offset_)
       stage_(node_->graph_->new_node_stage_), has_unique_name_(false),
       elem_type_(ONNX_NAMESPACE::TensorProto_DataType_UNDEFINED),
       has_sizes_(false) {
-  node_->graph_->all_values.emplace(this);
+  Graph * graph = node_->graph_;
+  graph->all_values.emplace(this);
+  if (graph->edit_log_) {
+    recorded_in_ = graph->edit_log_->id + 1;
+    graph->edit_log_->created_values.push_back(this);
+  }
 }
 
 inline Graph * Value::owningGraph() {
@@ -1129,10 +1631,22 @@ inline const Graph * Value::owningGraph() const {
   return node()->owningGraph();
 }
 
+inline void Value::recordEdit() {
+  Graph::EditLog * log = node_->graph_->edit_log_.get();
+  if (log != nullptr && recorded_in_ < log->id) {
+    recorded_in_ = log->id;
+    log->values.emplace_back(this);
+  }
+}
+
 inline void Value::replaceAllUsesWith(Value * newValue) {
   ONNX_ASSERT(owningGraph() == newValue->owningGraph());
+  recordEdit();
+  newValue->recordEdit();
   for(auto u : uses()) {
+    u.user->recordEdit();
     u.user->inputs_[u.offset] = newValue;
+    u.user->input_uses_[u.offset] = newValue->uses_.size();
     newValue->uses_.push_back(u);
   }
   uses_.clear();
@@ -1146,19 +1660,83 @@ inline Node::Node(Graph * graph_, NodeKind kind_) :
   has_domain_(false),
   has_doc_string_(false) {
   graph_->all_nodes.emplace(this);
+  if (graph_->edit_log_) {
+    recorded_in_ = graph_->edit_log_->id + 1;
+    graph_->edit_log_->created_nodes.push_back(this);
+  }
+}
+
+inline void Node::recordEdit() {
+  Graph::EditLog * log = graph_->edit_log_.get();
+  if (log != nullptr && recorded_in_ < log->id) {
+    recorded_in_ = log->id;
+    log->nodes.emplace_back(this);
+  }
+}
+
+inline void Node::recordAttributeEdit(
+    Symbol name, AttributeValue::Ptr old, size_t index) {
+  Graph::EditLog * log = graph_->edit_log_.get();
+  if (log != nullptr && recorded_in_ != log->id + 1) {
+    log->attributes.emplace_back();
+    auto & edit = log->attributes.back();
+    edit.node = this;
+    edit.name = name;
+    edit.old = std::move(old);
+    edit.index = index;
+    edit.replaced_all = false;
+  }
+}
+
+inline void Node::recordAttributesReplaced(std::vector<AttributeValue::Ptr> old) {
+  Graph::EditLog * log = graph_->edit_log_.get();
+  if (log != nullptr && recorded_in_ != log->id + 1) {
+    log->attributes.emplace_back();
+    auto & edit = log->attributes.back();
+    edit.node = this;
+    edit.index = 0;
+    edit.replaced_all = true;
+    edit.old_values = std::move(old);
+  }
 }
 
 inline void Node::eraseOutput(size_t i) {
   ONNX_ASSERT(i < outputs_.size());
   ONNX_ASSERT(outputs_[i]->uses().size() == 0);
+  recordEdit();
   Value * n = outputs_[i];
   outputs_.erase(outputs_.begin() + i);
   owningGraph()->freeValue(n);
   for(size_t j = i; j < outputs_.size(); j++) {
+    outputs_[j]->recordEdit();
     outputs_[j]->offset_--;
   }
 }
 
+inline void Node::eraseOutputs(std::vector<size_t> offsets) {
+  std::sort(offsets.begin(), offsets.end());
+  offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+  recordEdit();
+  size_t kept = 0;
+  size_t next = 0;
+  for (size_t i = 0; i < outputs_.size(); i++) {
+    Value * v = outputs_[i];
+    if (next < offsets.size() && offsets[next] == i) {
+      ONNX_ASSERT(v->uses().size() == 0);
+      owningGraph()->freeValue(v);
+      next++;
+      continue;
+    }
+    if (v->offset_ != kept) {
+      v->recordEdit();
+      v->offset_ = kept;
+    }
+    outputs_[kept++] = v;
+  }
+  ONNX_ASSERT(next == offsets.size());
+  outputs_.resize(kept);
+}
+
 inline bool Node::isBefore(Node* n) {
   if (n == nullptr || this == n) {
     // Bail out early.
@@ -1173,6 +1751,9 @@ inline bool Node::isBefore(Node* n) {
     return false;
   }
   ONNX_ASSERT(n->inGraphList());
+  if (inGraphList() && this != graph_->output_ && n != graph_->output_) {
+    return position_ < n->position_;
+  }
   for (Node* p = next(); p != *graph_->end(); p = p->next()) {
     if (p == n) {
       return true;
@@ -1181,6 +1762,52 @@ inline bool Node::isBefore(Node* n) {
   return false;
 }
 
+inline Node* Node::insertAfter(Node * n) {
+  ONNX_ASSERT(!inGraphList() && n->inGraphList());
+  Node * next = n->next();
+  recordEdit();
+  n->recordEdit();
+  next->recordEdit();
+  n->next() = this;
+  this->prev() = n;
+  this->next() = next;
+  next->prev() = this;
+  graph_->indexNode(this);
+  return this;
+}
+
+inline void Node::removeFromList() {
+  ONNX_ASSERT(inGraphList());
+  graph_->unindexNode(this);
+  Node * next = this->next();
+  Node * prev = this->prev();
+  recordEdit();
+  prev->recordEdit();
+  next->recordEdit();
+  prev->next() = next;
+  next->prev() = prev;
+  this->next() = nullptr;
+  this->prev() = nullptr;
+}
+
+inline void Node::noteGraphAttribute() {
+  if (graph_->record_subgraph_kinds_) {
+    graph_->kinds_with_subgraphs_.insert(kind_);
+  }
+}
+
+inline void Graph::resumeSubgraphKinds() {
+  record_subgraph_kinds_ = true;
+  for (Node* n : nodes()) {
+    for (const auto & a : n->values_) {
+      if (Node::isGraphKind(a->kind())) {
+        kinds_with_subgraphs_.insert(n->kind());
+        break;
+      }
+    }
+  }
+}
+
 inline void Node::destroy() {
   ONNX_ASSERT(inGraphList());
   while(outputs().size() > 0)
@@ -1190,6 +1817,96 @@ inline void Node::destroy() {
   graph_->freeNode(this);
 }
 
+inline void Graph::rollbackTransaction() {
+  ONNX_ASSERTM(edit_log_, "no transaction is open");
+  std::unique_ptr<EditLog> log = std::move(edit_log_);
+  for (const auto & g : log->subgraphs) {
+    g->rollbackTransaction();
+  }
+  // Take the edited nodes out of the kind index before their positions
+  // are restored, and put those in the list back after.
+  auto for_edited_nodes_in_list = [&](const std::function<void(Node*)> & f) {
+    for (const auto & saved : log->nodes) {
+      if (saved.node->inGraphList() && saved.node != output_) {
+        f(saved.node);
+      }
+    }
+  };
+  auto unindex = [this](Node * n) {
+    nodes_by_kind_[n->kind()].erase(n->position_);
+  };
+  for_edited_nodes_in_list(unindex);
+  for (Node * n : log->created_nodes) {
+    if (n->inGraphList()) {
+      unindex(n);
+    }
+  }
+  for (auto & saved : log->nodes) {
+    saved.restore();
+  }
+  for (auto & saved : log->values) {
+    saved.restore();
+  }
+  for (auto it = log->attributes.rbegin(); it != log->attributes.rend(); ++it) {
+    auto & values = it->node->values_;
+    if (it->replaced_all) {
+      values = std::move(it->old_values);
+    } else if (it->index != Attributes<Node>::kAttributeSet) {
+      values.insert(values.begin() + it->index, std::move(it->old));
+    } else {
+      auto attribute = it->node->find(it->name, true);
+      if (it->old) {
+        *attribute = std::move(it->old);
+      } else {
+        values.erase(attribute);
+      }
+    }
+  }
+  for (Node * n : log->created_nodes) {
+    all_nodes.erase(n);
+    delete n;
+  }
+  // Values both created and freed in the transaction are in both lists;
+  // they are skipped here, before the created ones are deleted.
+  for (Value * v : log->freed_values) {
+    if (v->recorded_in_ != log->id + 1) {
+      all_values.insert(v);
+    }
+  }
+  for (Value * v : log->created_values) {
+    all_values.erase(v);
+    delete v;
+  }
+  for_edited_nodes_in_list([this](Node * n) {
+    nodes_by_kind_[n->kind()].emplace(n->position_, n);
+  });
+  for (auto it = log->initializers.rbegin(); it != log->initializers.rend(); ++it) {
+    switch (it->kind) {
+      case EditLog::InitializerEdit::Added:
+        initializers_.pop_back();
+        initializer_names_.pop_back();
+        break;
+      case EditLog::InitializerEdit::TensorErased:
+        initializers_.insert(initializers_.begin() + it->index, std::move(it->tensor));
+        break;
+      case EditLog::InitializerEdit::NameErased:
+        initializer_names_.insert(initializer_names_.begin() + it->index, std::move(it->name));
+        break;
+      case EditLog::InitializerEdit::Replaced:
+        initializers_[it->index] = std::move(it->tensor);
+        break;
+    }
+  }
+  next_unique_ = log->next_unique;
+  new_node_stage_ = log->new_node_stage;
+  num_nodes_ = log->num_nodes;
+  has_name_ = log->has_name;
+  name_ = std::move(log->name);
+  has_doc_string_ = log->has_doc_string;
+  doc_string_ = std::move(log->doc_string);
+  opset_versions_ = std::move(log->opset_versions);
+}
+
 /************* All nodes not required to be defined before Graph **************/
 
 inline graph_node_list_iterator Node::iterator() {
@@ -0,0 +1,949 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/ir_binary_format.h"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "onnx/common/ir_pb_converter.h"
+
+namespace ONNX_NAMESPACE {
+
+namespace {
+
+const char kMagic[8] = {'O', 'N', 'N', 'X', 'I', 'R', 'B', '1'};
+const uint32_t kFormatVersion = 1;
+const uint64_t kHeaderSize = 64;
+const uint64_t kPayloadAlignment = 64;
+
+// String index of an absent name.
+const uint32_t kNoString = std::numeric_limits<uint32_t>::max();
+// Value references that do not point into the graph's value table.
+const uint64_t kUndefinedValue = std::numeric_limits<uint64_t>::max();
+const uint64_t kCapturedValue = kUndefinedValue - 1;
+// How deeply subgraphs may nest, as protobuf limits message recursion.
+const size_t kMaxGraphDepth = 100;
+
+enum class TensorStorage : uint8_t {
+  None,
+  Raw,
+  Floats,
+  Doubles,
+  Int32s,
+  Int64s,
+  Uint64s,
+  Strings,
+  // Indices as a payload, followed by a nested tensor of the values.
+  Sparse
+};
+
+// header: magic, version, number of graphs and, for each of the string
+// table, graph records, model info and payload sections, its offset and
+// size. Offsets are absolute; payload offsets inside tensor records are
+// relative to the payload section.
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_graphs;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  uint64_t graphs_offset;
+  uint64_t graphs_size;
+  uint64_t model_info_offset;
+  uint64_t model_info_size;
+};
+static_assert(sizeof(Header) == kHeaderSize, "Unexpected header size");
+
+bool isLittleEndianHost() {
+  const uint16_t one = 1;
+  uint8_t first_byte;
+  std::memcpy(&first_byte, &one, 1);
+  return first_byte == 1;
+}
+
+uint64_t alignUp(uint64_t offset) {
+  return (offset + kPayloadAlignment - 1) & ~(kPayloadAlignment - 1);
+}
+
+// Part 1: IR to binary
+
+class BinaryGraphWriter {
+ public:
+  explicit BinaryGraphWriter(const std::shared_ptr<Graph>& root) {
+    graphs_.push_back(root.get());
+  }
+
+  void write(const std::string& path, const ModelProto* model_info) {
+    // Subgraphs found while encoding a graph are appended to graphs_.
+    std::vector<std::string> records;
+    for (size_t i = 0; i < graphs_.size(); ++i) {
+      records.emplace_back();
+      writeGraph(records.back(), *graphs_[i]);
+    }
+
+    std::string graphs;
+    uint64_t record_offset = records.size() * sizeof(uint64_t);
+    for (const auto& record : records) {
+      put<uint64_t>(graphs, record_offset);
+      record_offset += record.size();
+    }
+    for (const auto& record : records) {
+      graphs += record;
+    }
+
+    std::string strings;
+    put<uint64_t>(strings, strings_.size());
+    for (const std::string* s : strings_) {
+      put<uint64_t>(strings, s->size());
+      strings += *s;
+    }
+
+    std::string model;
+    if (model_info != nullptr) {
+      PrepareOutput(*model_info).SerializeToString(&model);
+    }
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.num_graphs = static_cast<uint32_t>(graphs_.size());
+    header.strings_offset = kHeaderSize;
+    header.strings_size = strings.size();
+    header.graphs_offset = header.strings_offset + header.strings_size;
+    header.graphs_size = graphs.size();
+    header.model_info_offset = header.graphs_offset + header.graphs_size;
+    header.model_info_size = model.size();
+    const uint64_t payloads_offset =
+        alignUp(header.model_info_offset + header.model_info_size);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      fail_convert("Unable to open ", path, " for writing");
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(strings.data(), strings.size());
+    out.write(graphs.data(), graphs.size());
+    out.write(model.data(), model.size());
+    const char padding[kPayloadAlignment] = {};
+    uint64_t offset = header.model_info_offset + header.model_info_size;
+    for (const auto& payload : payloads_) {
+      const uint64_t aligned = payloads_offset + payload.offset;
+      out.write(padding, aligned - offset);
+      out.write(payload.data, payload.size);
+      offset = aligned + payload.size;
+    }
+    if (!out) {
+      fail_convert("Failed to write ", path);
+    }
+  }
+
+ private:
+  struct Payload {
+    const char* data;
+    uint64_t size;
+    uint64_t offset;
+  };
+
+  template <typename T>
+  static void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void putString(std::string& out, const std::string& s) {
+    auto it = string_index_.find(s);
+    if (it == string_index_.end()) {
+      it = string_index_.emplace(s, static_cast<uint32_t>(strings_.size())).first;
+      strings_.push_back(&it->first);
+    }
+    put<uint32_t>(out, it->second);
+  }
+
+  void putOptionalString(std::string& out, bool present, const std::string& s) {
+    if (present) {
+      putString(out, s);
+    } else {
+      put<uint32_t>(out, kNoString);
+    }
+  }
+
+  uint64_t addPayload(const void* data, uint64_t size) {
+    const uint64_t offset = alignUp(payload_size_);
+    payloads_.push_back({static_cast<const char*>(data), size, offset});
+    payload_size_ = offset + size;
+    return offset;
+  }
+
+  template <typename T>
+  void putPayload(std::string& out, const std::vector<T>& values) {
+    put<uint64_t>(out, addPayload(values.data(), values.size() * sizeof(T)));
+    put<uint64_t>(out, values.size());
+  }
+
+  uint32_t graphIndex(Graph* g) {
+    graphs_.push_back(g);
+    return static_cast<uint32_t>(graphs_.size() - 1);
+  }
+
+  void writeValue(std::string& out, Value* v) {
+    putOptionalString(out, v->has_unique_name(), v->uniqueName());
+    put<int32_t>(out, v->elemType());
+    put<uint8_t>(out, v->has_sizes());
+    put<uint64_t>(out, v->sizes().size());
+    for (const auto& dim : v->sizes()) {
+      put<uint8_t>(out, dim.is_int);
+      if (dim.is_int) {
+        put<int64_t>(out, dim.dim);
+      } else {
+        putString(out, dim.param);
+      }
+    }
+  }
+
+  void writeTensor(std::string& out, const Tensor& t) {
+    putOptionalString(out, t.hasName(), t.name());
+    put<int32_t>(out, t.elem_type());
+    put<uint64_t>(out, t.sizes().size());
+    for (int64_t dim : t.sizes()) {
+      put<int64_t>(out, dim);
+    }
+    put<uint8_t>(out, t.is_segment());
+    put<int64_t>(out, t.is_segment() ? t.segment_begin() : 0);
+    put<int64_t>(out, t.is_segment() ? t.segment_end() : 0);
+
+    if (t.is_sparse()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Sparse));
+      putPayload(out, t.sparse_indices());
+      writeTensor(out, t.sparse_values());
+    } else if (t.is_raw_data()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Raw));
+      put<uint64_t>(out, addPayload(t.raw_data_ptr(), t.raw_data_size()));
+      put<uint64_t>(out, t.raw_data_size());
+    } else if (!t.floats().empty()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Floats));
+      putPayload(out, t.floats());
+    } else if (!t.doubles().empty()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Doubles));
+      putPayload(out, t.doubles());
+    } else if (!t.int32s().empty()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Int32s));
+      putPayload(out, t.int32s());
+    } else if (!t.int64s().empty()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Int64s));
+      putPayload(out, t.int64s());
+    } else if (!t.uint64s().empty()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Uint64s));
+      putPayload(out, t.uint64s());
+    } else if (!t.strings().empty()) {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::Strings));
+      put<uint64_t>(out, t.strings().size());
+      for (const auto& s : t.strings()) {
+        putString(out, s);
+      }
+    } else {
+      put<uint8_t>(out, static_cast<uint8_t>(TensorStorage::None));
+    }
+  }
+
+  void writeAttribute(std::string& out, Node* n, Symbol name) {
+    putString(out, name.toString());
+    const AttributeKind kind = n->kindOf(name);
+    put<uint8_t>(out, static_cast<uint8_t>(kind));
+    switch (kind) {
+      case AttributeKind::f:
+        put<double>(out, n->f(name));
+        break;
+      case AttributeKind::fs:
+        put<uint64_t>(out, n->fs(name).size());
+        out.append(
+            reinterpret_cast<const char*>(n->fs(name).data()),
+            n->fs(name).size() * sizeof(double));
+        break;
+      case AttributeKind::i:
+        put<int64_t>(out, n->i(name));
+        break;
+      case AttributeKind::is:
+        put<uint64_t>(out, n->is(name).size());
+        out.append(
+            reinterpret_cast<const char*>(n->is(name).data()),
+            n->is(name).size() * sizeof(int64_t));
+        break;
+      case AttributeKind::s:
+        putString(out, n->s(name));
+        break;
+      case AttributeKind::ss:
+        put<uint64_t>(out, n->ss(name).size());
+        for (const auto& s : n->ss(name)) {
+          putString(out, s);
+        }
+        break;
+      case AttributeKind::t:
+        writeTensor(out, n->t(name));
+        break;
+      case AttributeKind::ts:
+        put<uint64_t>(out, n->ts(name).size());
+        for (const auto& t : n->ts(name)) {
+          writeTensor(out, t);
+        }
+        break;
+      case AttributeKind::g:
+        put<uint32_t>(out, graphIndex(n->g(name).get()));
+        break;
+      case AttributeKind::gs:
+        put<uint64_t>(out, n->gs(name).size());
+        for (const auto& g : n->gs(name)) {
+          put<uint32_t>(out, graphIndex(g.get()));
+        }
+        break;
+    }
+  }
+
+  void writeValueRef(
+      std::string& out,
+      const std::unordered_map<const Value*, uint64_t>& value_index,
+      Value* v) {
+    auto it = value_index.find(v);
+    if (it != value_index.end()) {
+      put<uint64_t>(out, it->second);
+    } else if (v->node()->kind() == kUndefined) {
+      put<uint64_t>(out, kUndefinedValue);
+    } else {
+      // Captured from an enclosing graph; resolved by name on load.
+      put<uint64_t>(out, kCapturedValue);
+      putString(out, v->uniqueName());
+    }
+  }
+
+  void writeGraph(std::string& out, Graph& g) {
+    putOptionalString(out, g.has_name(), g.name());
+    putOptionalString(out, g.has_doc_string(), g.docString());
+    put<uint64_t>(out, g.opset_versions_mutable().size());
+    for (const auto& opset : g.opset_versions_mutable()) {
+      putString(out, opset.domain());
+      put<int64_t>(out, opset.version());
+    }
+
+    std::unordered_map<const Value*, uint64_t> value_index;
+    put<uint64_t>(out, g.inputs().size());
+    for (Value* input : g.inputs()) {
+      value_index.emplace(input, value_index.size());
+      writeValue(out, input);
+    }
+
+    std::vector<Node*> nodes;
+    for (Node* node : g.nodes()) {
+      if (node->kind() != kUndefined && node->kind() != kCaptured) {
+        nodes.push_back(node);
+      }
+    }
+    put<uint64_t>(out, nodes.size());
+    for (Node* node : nodes) {
+      putString(out, node->kind().toString());
+      putOptionalString(out, node->has_name(), node->name());
+      putOptionalString(out, node->has_domain(), node->domain());
+      putOptionalString(out, node->has_doc_string(), node->docString());
+      put<uint64_t>(out, node->outputs().size());
+      for (Value* output : node->outputs()) {
+        value_index.emplace(output, value_index.size());
+        writeValue(out, output);
+      }
+      put<uint64_t>(out, node->attributeNames().size());
+      for (Symbol name : node->attributeNames()) {
+        writeAttribute(out, node, name);
+      }
+    }
+    // Inputs are written after all outputs so that they can refer forward.
+    for (Node* node : nodes) {
+      put<uint64_t>(out, node->inputs().size());
+      for (Value* input : node->inputs()) {
+        writeValueRef(out, value_index, input);
+      }
+    }
+
+    put<uint64_t>(out, g.outputs().size());
+    for (Value* output : g.outputs()) {
+      writeValueRef(out, value_index, output);
+      // Graph outputs may carry type information of their own.
+      put<int32_t>(out, output->elemType());
+      put<uint64_t>(out, output->sizes().size());
+      for (const auto& dim : output->sizes()) {
+        put<uint8_t>(out, dim.is_int);
+        if (dim.is_int) {
+          put<int64_t>(out, dim.dim);
+        } else {
+          putString(out, dim.param);
+        }
+      }
+    }
+
+    put<uint64_t>(out, g.initializers().size());
+    for (size_t i = 0; i < g.initializers().size(); ++i) {
+      putString(out, g.initializer_names()[i]);
+      writeTensor(out, g.initializers()[i]);
+    }
+  }
+
+  std::vector<Graph*> graphs_;
+  std::unordered_map<std::string, uint32_t> string_index_;
+  std::vector<const std::string*> strings_;
+  std::vector<Payload> payloads_;
+  uint64_t payload_size_ = 0;
+};
+
+// Part 2: binary to IR
+
+// The contents of a file, kept alive by `owner`.
+struct FileData {
+  std::shared_ptr<const void> owner;
+  const char* data;
+  uint64_t size;
+};
+
+FileData mapFile(const std::string& path) {
+  FileData file;
+#ifdef _WIN32
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) {
+    fail_convert("Unable to open ", path);
+  }
+  file.size = static_cast<uint64_t>(in.tellg());
+  // Over-allocate so that the payload section can be 64-byte aligned.
+  auto buffer = std::make_shared<std::vector<char>>(file.size + kPayloadAlignment);
+  const uintptr_t base = reinterpret_cast<uintptr_t>(buffer->data());
+  char* data = buffer->data() + (alignUp(base) - base);
+  in.seekg(0);
+  in.read(data, file.size);
+  if (!in) {
+    fail_convert("Failed to read ", path);
+  }
+  file.owner = buffer;
+  file.data = data;
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fail_convert("Unable to open ", path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    fail_convert("Unable to read ", path);
+  }
+  file.size = static_cast<uint64_t>(st.st_size);
+  void* addr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    fail_convert("Unable to map ", path);
+  }
+  const uint64_t size = file.size;
+  file.owner = std::shared_ptr<const void>(
+      addr, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+  file.data = static_cast<const char*>(addr);
+#endif
+  return file;
+}
+
+// Bounds-checked cursor over a section of the file.
+class Reader {
+ public:
+  Reader(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  template <typename T>
+  T get() {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  const char* take(uint64_t size) {
+    if (size > static_cast<uint64_t>(end_ - pos_)) {
+      fail_convert("Truncated ONNX IR binary file");
+    }
+    const char* p = pos_;
+    pos_ += size;
+    return p;
+  }
+
+  // Reads an element count, rejecting counts that cannot possibly fit in
+  // the rest of the section.
+  uint64_t count(uint64_t min_element_size = 1) {
+    const uint64_t n = get<uint64_t>();
+    if (n > static_cast<uint64_t>(end_ - pos_) / min_element_size) {
+      fail_convert("Corrupt ONNX IR binary file: bad element count");
+    }
+    return n;
+  }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+class BinaryGraphReader {
+ public:
+  explicit BinaryGraphReader(const std::string& path) : file_(mapFile(path)) {
+    if (!isLittleEndianHost()) {
+      fail_convert("ONNX IR binary files require a little-endian host");
+    }
+    if (file_.size < kHeaderSize) {
+      fail_convert(path, " is not an ONNX IR binary file");
+    }
+    std::memcpy(&header_, file_.data, sizeof(header_));
+    if (std::memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0) {
+      fail_convert(path, " is not an ONNX IR binary file");
+    }
+    if (header_.version != kFormatVersion) {
+      fail_convert("Unsupported ONNX IR binary format version ", header_.version);
+    }
+    payloads_offset_ = alignUp(header_.model_info_offset + header_.model_info_size);
+
+    Reader strings = section(header_.strings_offset, header_.strings_size);
+    const uint64_t num_strings = strings.count(sizeof(uint64_t));
+    strings_.reserve(num_strings);
+    for (uint64_t i = 0; i < num_strings; ++i) {
+      const uint64_t size = strings.get<uint64_t>();
+      strings_.emplace_back(strings.take(size), size);
+    }
+    symbols_.resize(num_strings);
+    has_symbol_.resize(num_strings, false);
+
+    Reader graphs = section(header_.graphs_offset, header_.graphs_size);
+    if (header_.num_graphs > header_.graphs_size / sizeof(uint64_t)) {
+      fail_convert("Corrupt ONNX IR binary file: bad graph count");
+    }
+    graph_offsets_.resize(header_.num_graphs);
+    graphs_read_.resize(header_.num_graphs, false);
+    for (auto& offset : graph_offsets_) {
+      offset = graphs.get<uint64_t>();
+      if (offset > header_.graphs_size) {
+        fail_convert("Corrupt ONNX IR binary file: bad graph offset");
+      }
+    }
+    if (graph_offsets_.empty()) {
+      fail_convert("Corrupt ONNX IR binary file: no graph");
+    }
+  }
+
+  // Subgraphs are read recursively, and nesting is limited to
+  // kMaxGraphDepth. The writer refers to each graph once, so a graph
+  // referred to again (nested in itself, or shared by several attributes)
+  // is rejected: otherwise each reference decodes another copy, which a
+  // small file can make exponentially many.
+  std::unique_ptr<Graph> readGraph(uint32_t index) {
+    if (index >= graph_offsets_.size()) {
+      fail_convert("Corrupt ONNX IR binary file: bad graph index");
+    }
+    if (graphs_read_[index]) {
+      fail_convert("Corrupt ONNX IR binary file: graph referenced more than once");
+    }
+    if (graph_depth_ >= kMaxGraphDepth) {
+      fail_convert("Corrupt ONNX IR binary file: subgraphs nested too deeply");
+    }
+    graphs_read_[index] = true;
+    ++graph_depth_;
+    const char* graphs = file_.data + header_.graphs_offset;
+    Reader r(graphs + graph_offsets_[index], graphs + header_.graphs_size);
+    std::unique_ptr<Graph> g(new Graph());
+
+    uint32_t name = r.get<uint32_t>();
+    if (name != kNoString) {
+      g->setName(string(name));
+    }
+    uint32_t doc_string = r.get<uint32_t>();
+    if (doc_string != kNoString) {
+      g->setDocString(string(doc_string));
+    }
+    const uint64_t num_opsets = r.count();
+    for (uint64_t i = 0; i < num_opsets; ++i) {
+      const std::string domain = string(r.get<uint32_t>());
+      g->opset_versions_mutable().emplace_back(domain, r.get<int64_t>());
+    }
+
+    // Mirrors graphProtoToGraph: a dummy node stands for missing optional
+    // inputs, and values captured from an enclosing graph get kCaptured
+    // nodes.
+    Node* undefined = g->create(kUndefined, 1);
+    g->appendNode(undefined);
+    undefined->outputs()[0]->setUniqueName("");
+
+    std::vector<Value*> values;
+    const uint64_t num_inputs = r.count();
+    for (uint64_t i = 0; i < num_inputs; ++i) {
+      Value* v = g->addInput();
+      readValue(r, v);
+      values.push_back(v);
+    }
+
+    std::vector<Node*> nodes;
+    const uint64_t num_nodes = r.count();
+    nodes.reserve(num_nodes);
+    for (uint64_t i = 0; i < num_nodes; ++i) {
+      const Symbol kind = symbol(r.get<uint32_t>());
+      const uint32_t node_name = r.get<uint32_t>();
+      const uint32_t domain = r.get<uint32_t>();
+      const uint32_t node_doc_string = r.get<uint32_t>();
+      const uint64_t num_outputs = r.count();
+      Node* n = g->create(kind, num_outputs);
+      g->appendNode(n);
+      if (node_name != kNoString) {
+        n->setName(string(node_name));
+      }
+      if (domain != kNoString) {
+        n->setDomain(string(domain));
+      }
+      if (node_doc_string != kNoString) {
+        n->setDocString(string(node_doc_string));
+      }
+      for (Value* output : n->outputs()) {
+        readValue(r, output);
+        values.push_back(output);
+      }
+      const uint64_t num_attributes = r.count();
+      for (uint64_t j = 0; j < num_attributes; ++j) {
+        readAttribute(r, n);
+      }
+      nodes.push_back(n);
+    }
+
+    std::unordered_map<std::string, Value*> captured;
+    auto read_value_ref = [&]() -> Value* {
+      const uint64_t ref = r.get<uint64_t>();
+      if (ref == kUndefinedValue) {
+        return undefined->outputs()[0];
+      }
+      if (ref == kCapturedValue) {
+        std::string captured_name = string(r.get<uint32_t>());
+        auto it = captured.find(captured_name);
+        if (it == captured.end()) {
+          Node* capture = g->create(kCaptured, 1);
+          g->appendNode(capture);
+          capture->outputs()[0]->setUniqueName(captured_name);
+          it = captured.emplace(std::move(captured_name), capture->outputs()[0]).first;
+        }
+        return it->second;
+      }
+      if (ref >= values.size()) {
+        fail_convert("Corrupt ONNX IR binary file: bad value reference");
+      }
+      return values[ref];
+    };
+
+    for (Node* n : nodes) {
+      const uint64_t num_node_inputs = r.count(sizeof(uint64_t));
+      for (uint64_t j = 0; j < num_node_inputs; ++j) {
+        n->addInput(read_value_ref());
+      }
+    }
+
+    const uint64_t num_outputs = r.count();
+    for (uint64_t i = 0; i < num_outputs; ++i) {
+      Value* v = read_value_ref();
+      v->setElemType(r.get<int32_t>());
+      v->setSizes(readDims(r));
+      g->registerOutput(v);
+    }
+
+    const uint64_t num_initializers = r.count();
+    for (uint64_t i = 0; i < num_initializers; ++i) {
+      std::string initializer_name = string(r.get<uint32_t>());
+      g->addInitializer(readTensor(r), std::move(initializer_name));
+    }
+    --graph_depth_;
+    return g;
+  }
+
+  void readModelInfo(ModelProto* model_info) {
+    // ParseFromArray takes an int size.
+    if (header_.model_info_size >
+        static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+      fail_convert("Corrupt ONNX IR binary file: bad model info");
+    }
+    Reader r = section(header_.model_info_offset, header_.model_info_size);
+    const char* data = r.take(header_.model_info_size);
+    if (!model_info->ParseFromArray(data, static_cast<int>(header_.model_info_size))) {
+      fail_convert("Corrupt ONNX IR binary file: bad model info");
+    }
+  }
+
+ private:
+  Reader section(uint64_t offset, uint64_t size) {
+    if (offset > file_.size || size > file_.size - offset) {
+      fail_convert("Corrupt ONNX IR binary file: bad section");
+    }
+    return Reader(file_.data + offset, file_.data + offset + size);
+  }
+
+  std::string string(uint32_t index) {
+    if (index >= strings_.size()) {
+      fail_convert("Corrupt ONNX IR binary file: bad string index");
+    }
+    return std::string(strings_[index].first, strings_[index].second);
+  }
+
+  // Interns each distinct string at most once per file.
+  Symbol symbol(uint32_t index) {
+    if (index >= strings_.size()) {
+      fail_convert("Corrupt ONNX IR binary file: bad string index");
+    }
+    if (!has_symbol_[index]) {
+      symbols_[index] = Symbol(string(index));
+      has_symbol_[index] = true;
+    }
+    return symbols_[index];
+  }
+
+  std::vector<Dimension> readDims(Reader& r) {
+    std::vector<Dimension> dims;
+    const uint64_t num_dims = r.count();
+    dims.reserve(num_dims);
+    for (uint64_t i = 0; i < num_dims; ++i) {
+      if (r.get<uint8_t>()) {
+        dims.emplace_back(r.get<int64_t>());
+      } else {
+        dims.emplace_back(string(r.get<uint32_t>()));
+      }
+    }
+    return dims;
+  }
+
+  void readValue(Reader& r, Value* v) {
+    const uint32_t name = r.get<uint32_t>();
+    if (name != kNoString) {
+      v->setUniqueName(string(name));
+    }
+    v->setElemType(r.get<int32_t>());
+    const bool has_sizes = r.get<uint8_t>() != 0;
+    std::vector<Dimension> dims = readDims(r);
+    if (has_sizes) {
+      v->setSizes(std::move(dims));
+    }
+  }
+
+  const char* payload(uint64_t offset, uint64_t size) {
+    const uint64_t begin = payloads_offset_ + offset;
+    if (begin < payloads_offset_ || begin > file_.size || size > file_.size - begin) {
+      fail_convert("Corrupt ONNX IR binary file: bad payload");
+    }
+    return file_.data + begin;
+  }
+
+  template <typename T>
+  void readPayload(Reader& r, std::vector<T>& field) {
+    const uint64_t offset = r.get<uint64_t>();
+    const uint64_t count = r.get<uint64_t>();
+    if (count > file_.size / sizeof(T)) {
+      fail_convert("Corrupt ONNX IR binary file: bad payload");
+    }
+    const char* data = payload(offset, count * sizeof(T));
+    field.resize(count);
+    std::memcpy(field.data(), data, count * sizeof(T));
+  }
+
+  // The values of a sparse tensor are read with `sparse_values` set, and
+  // can't be sparse themselves, which also bounds the recursion.
+  Tensor readTensor(Reader& r, bool sparse_values = false) {
+    Tensor t;
+    const uint32_t name = r.get<uint32_t>();
+    if (name != kNoString) {
+      t.setName(string(name));
+    }
+    t.elem_type() = r.get<int32_t>();
+    const uint64_t num_dims = r.count(sizeof(int64_t));
+    t.sizes().resize(num_dims);
+    std::memcpy(t.sizes().data(), r.take(num_dims * sizeof(int64_t)), num_dims * sizeof(int64_t));
+    const bool is_segment = r.get<uint8_t>() != 0;
+    const int64_t segment_begin = r.get<int64_t>();
+    const int64_t segment_end = r.get<int64_t>();
+    if (is_segment) {
+      t.set_segment_begin_and_end(segment_begin, segment_end);
+    }
+
+    switch (static_cast<TensorStorage>(r.get<uint8_t>())) {
+      case TensorStorage::None:
+        break;
+      case TensorStorage::Raw: {
+        const uint64_t offset = r.get<uint64_t>();
+        const uint64_t size = r.get<uint64_t>();
+        t.set_external_raw_data(file_.owner, payload(offset, size), size);
+        break;
+      }
+      case TensorStorage::Floats:
+        readPayload(r, t.floats());
+        break;
+      case TensorStorage::Doubles:
+        readPayload(r, t.doubles());
+        break;
+      case TensorStorage::Int32s:
+        readPayload(r, t.int32s());
+        break;
+      case TensorStorage::Int64s:
+        readPayload(r, t.int64s());
+        break;
+      case TensorStorage::Uint64s:
+        readPayload(r, t.uint64s());
+        break;
+      case TensorStorage::Strings: {
+        const uint64_t num_strings = r.count(sizeof(uint32_t));
+        t.strings().reserve(num_strings);
+        for (uint64_t i = 0; i < num_strings; ++i) {
+          t.strings().push_back(string(r.get<uint32_t>()));
+        }
+        break;
+      }
+      case TensorStorage::Sparse: {
+        if (sparse_values) {
+          fail_convert("Corrupt ONNX IR binary file: nested sparse tensor");
+        }
+        std::vector<int64_t> indices;
+        readPayload(r, indices);
+        Tensor values = readTensor(r, true);
+        if (values.elem_type() != t.elem_type() ||
+            values.sizes().size() != 1 ||
+            values.sizes()[0] != static_cast<int64_t>(indices.size())) {
+          fail_convert("Corrupt ONNX IR binary file: bad sparse values");
+        }
+        const int64_t num_elements = std::accumulate(
+            t.sizes().begin(),
+            t.sizes().end(),
+            (int64_t)1,
+            std::multiplies<int64_t>{});
+        for (size_t i = 0; i < indices.size(); ++i) {
+          if (indices[i] < 0 || indices[i] >= num_elements ||
+              (i > 0 && indices[i] <= indices[i - 1])) {
+            fail_convert("Corrupt ONNX IR binary file: bad sparse index");
+          }
+        }
+        t.set_sparse_data(std::move(values), std::move(indices));
+        break;
+      }
+      default:
+        fail_convert("Corrupt ONNX IR binary file: bad tensor storage");
+    }
+    return t;
+  }
+
+  void readAttribute(Reader& r, Node* n) {
+    const Symbol name = symbol(r.get<uint32_t>());
+    switch (static_cast<AttributeKind>(r.get<uint8_t>())) {
+      case AttributeKind::f:
+        n->f_(name, r.get<double>());
+        break;
+      case AttributeKind::fs: {
+        std::vector<double> values(r.count(sizeof(double)));
+        std::memcpy(values.data(), r.take(values.size() * sizeof(double)), values.size() * sizeof(double));
+        n->fs_(name, std::move(values));
+        break;
+      }
+      case AttributeKind::i:
+        n->i_(name, r.get<int64_t>());
+        break;
+      case AttributeKind::is: {
+        std::vector<int64_t> values(r.count(sizeof(int64_t)));
+        std::memcpy(values.data(), r.take(values.size() * sizeof(int64_t)), values.size() * sizeof(int64_t));
+        n->is_(name, std::move(values));
+        break;
+      }
+      case AttributeKind::s:
+        n->s_(name, string(r.get<uint32_t>()));
+        break;
+      case AttributeKind::ss: {
+        std::vector<std::string> values;
+        const uint64_t num_values = r.count(sizeof(uint32_t));
+        values.reserve(num_values);
+        for (uint64_t i = 0; i < num_values; ++i) {
+          values.push_back(string(r.get<uint32_t>()));
+        }
+        n->ss_(name, std::move(values));
+        break;
+      }
+      case AttributeKind::t:
+        n->t_(name, readTensor(r));
+        break;
+      case AttributeKind::ts: {
+        std::vector<Tensor> values;
+        const uint64_t num_values = r.count();
+        values.reserve(num_values);
+        for (uint64_t i = 0; i < num_values; ++i) {
+          values.push_back(readTensor(r));
+        }
+        n->ts_(name, std::move(values));
+        break;
+      }
+      case AttributeKind::g:
+        n->g_(name, std::shared_ptr<Graph>(readGraph(r.get<uint32_t>())));
+        break;
+      case AttributeKind::gs: {
+        std::vector<std::shared_ptr<Graph>> values;
+        const uint64_t num_values = r.count(sizeof(uint32_t));
+        values.reserve(num_values);
+        for (uint64_t i = 0; i < num_values; ++i) {
+          values.emplace_back(readGraph(r.get<uint32_t>()));
+        }
+        n->gs_(name, std::move(values));
+        break;
+      }
+      default:
+        fail_convert("Corrupt ONNX IR binary file: bad attribute kind");
+    }
+  }
+
+  FileData file_;
+  Header header_;
+  uint64_t payloads_offset_;
+  std::vector<std::pair<const char*, uint64_t>> strings_;
+  std::vector<Symbol> symbols_;
+  std::vector<bool> has_symbol_;
+  std::vector<uint64_t> graph_offsets_;
+  std::vector<bool> graphs_read_;
+  size_t graph_depth_ = 0;
+};
+
+} // namespace
+
+void SaveGraphBinary(
+    const std::string& path,
+    const std::shared_ptr<Graph>& g,
+    const ModelProto* model_info) {
+  ONNX_ASSERT(g != nullptr);
+  if (!isLittleEndianHost()) {
+    fail_convert("ONNX IR binary files require a little-endian host");
+  }
+  BinaryGraphWriter(g).write(path, model_info);
+}
+
+std::unique_ptr<Graph> LoadGraphBinary(const std::string& path, ModelProto* model_info) {
+  BinaryGraphReader reader(path);
+  std::unique_ptr<Graph> g = reader.readGraph(0);
+  if (model_info != nullptr) {
+    reader.readModelInfo(model_info);
+  }
+  return g;
+}
+
+void ModelProtoToGraphBinary(const ModelProto& mp, const std::string& path) {
+  std::shared_ptr<Graph> g(ImportModelProto(mp));
+  if (g == nullptr) {
+    fail_convert("Unable to import ModelProto (the IR version may be too old)");
+  }
+  SaveGraphBinary(path, g, &mp);
+}
+
+ModelProto GraphBinaryToModelProto(const std::string& path) {
+  ModelProto mp;
+  std::shared_ptr<Graph> g(LoadGraphBinary(path, &mp));
+  ExportModelProto(&mp, g);
+  return mp;
+}
+
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,55 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include "onnx/common/ir.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+
+// Native binary serialization of the IR Graph.
+//
+// Unlike a serialized ModelProto, a file in this format can be used
+// without parsing the tensor data: LoadGraphBinary memory-maps the file
+// and makes raw initializers and tensor attributes refer to the mapping.
+// Offsets are 64-bit, so there is no 2GB limit. Layout:
+//
+//   header          magic, version, section offsets (64 bytes)
+//   string table    every value name, op type, attribute name, domain and
+//                   string attribute, stored once and referenced by index
+//   graph records   offset table, then one record per graph (the root
+//                   graph first, then subgraphs). A record holds the graph
+//                   inputs, the node table (each node with its output
+//                   values), the graph outputs and the initializers;
+//                   values are referenced by their position in the graph
+//   model info      a serialized ModelProto without graph, carrying the
+//                   model level fields (ir_version, producer, ...)
+//   payloads        tensor data, each starting on a 64-byte boundary
+//
+// All integers are little-endian; saving and loading require a
+// little-endian host. Errors are reported by throwing ConvertError.
+
+// Writes `g` to `path`. `model_info` supplies the model level fields
+// (everything but the graph) and may be null.
+void SaveGraphBinary(
+    const std::string& path,
+    const std::shared_ptr<Graph>& g,
+    const ModelProto* model_info = nullptr);
+
+// Memory-maps `path` and reconstructs the Graph stored in it. Raw tensor
+// data is not copied: it refers to the mapping (which stays alive as long
+// as any such Tensor does) until it is mutated. Tensors that were stored
+// in typed fields are copied into the Tensor. If `model_info` is non-null
+// it receives the model level fields.
+std::unique_ptr<Graph> LoadGraphBinary(
+    const std::string& path,
+    ModelProto* model_info = nullptr);
+
+// Conversions between ModelProto and the binary format. They preserve
+// everything that ImportModelProto/ExportModelProto preserve.
+void ModelProtoToGraphBinary(const ModelProto& mp, const std::string& path);
+
+ModelProto GraphBinaryToModelProto(const std::string& path);
+
+} // namespace ONNX_NAMESPACE
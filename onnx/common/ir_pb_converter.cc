@@ -2,28 +2,33 @@
 // Adventurous users should note that the APIs will probably change.
 
 #include "onnx/common/ir_pb_converter.h"
+#include "onnx/common/parallel.h"
 
-namespace ONNX_NAMESPACE {
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 
-// Part 1: convert ONNX Protobuf to IR
-std::unique_ptr<Graph> graphProtoToGraph(const GraphProto& gp, bool nested);
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
 
-Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto & tp) {
-  Tensor ret;
+namespace ONNX_NAMESPACE {
 
-  ret.sizes().reserve(tp.dims_size());
-  for (int i = 0; i < tp.dims_size(); i++) {
-    ret.sizes().push_back(tp.dims(i));
-  }
+using google::protobuf::io::CodedOutputStream;
 
-  ret.elem_type() = tp.data_type();
+// Part 1: convert ONNX Protobuf to IR
+std::unique_ptr<Graph> graphProtoToGraph(
+    const GraphProto& gp,
+    bool nested,
+    size_t num_threads = 1,
+    const std::shared_ptr<const ModelProto>& lazy_owner = nullptr);
+
+void decodeTensorProtoData(const ONNX_NAMESPACE::TensorProto & tp, Tensor * t) {
+  // RepeatedField iterators are plain pointers, so the numeric assign()s
+  // below are bulk copies rather than per-element appends.
   switch(tp.data_type()) {
   case ONNX_NAMESPACE::TensorProto_DataType_FLOAT:
   case ONNX_NAMESPACE::TensorProto_DataType_COMPLEX64: {
-    ret.floats().reserve(tp.float_data_size());
-    for (int i = 0; i < tp.float_data_size(); i++) {
-      ret.floats().push_back(tp.float_data(i));
-    }
+    t->floats().assign(tp.float_data().begin(), tp.float_data().end());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_FLOAT16:
@@ -34,40 +39,25 @@ Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto & tp) {
   case ONNX_NAMESPACE::TensorProto_DataType_INT32:
   case ONNX_NAMESPACE::TensorProto_DataType_UINT8:
   case ONNX_NAMESPACE::TensorProto_DataType_UINT16: {
-    ret.int32s().reserve(tp.int32_data_size());
-    for (int i = 0; i < tp.int32_data_size(); i++) {
-      ret.int32s().push_back(tp.int32_data(i));
-    }
+    t->int32s().assign(tp.int32_data().begin(), tp.int32_data().end());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_INT64: {
-    ret.int64s().reserve(tp.int64_data_size());
-    for (int i = 0; i < tp.int64_data_size(); i++) {
-      ret.int64s().push_back(tp.int64_data(i));
-    }
+    t->int64s().assign(tp.int64_data().begin(), tp.int64_data().end());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_UINT32:
   case ONNX_NAMESPACE::TensorProto_DataType_UINT64: {
-    ret.uint64s().reserve(tp.uint64_data_size());
-    for (int i = 0; i < tp.uint64_data_size(); i++) {
-      ret.uint64s().push_back(tp.uint64_data(i));
-    }
+    t->uint64s().assign(tp.uint64_data().begin(), tp.uint64_data().end());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_DOUBLE:
   case ONNX_NAMESPACE::TensorProto_DataType_COMPLEX128: {
-    ret.doubles().reserve(tp.double_data_size());
-    for (int i = 0; i < tp.double_data_size(); i++) {
-      ret.doubles().push_back(tp.double_data(i));
-    }
+    t->doubles().assign(tp.double_data().begin(), tp.double_data().end());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_STRING: {
-    ret.strings().reserve(tp.string_data_size());
-    for (int i = 0; i < tp.string_data_size(); i++) {
-      ret.strings().push_back(tp.string_data(i));
-    }
+    t->strings().assign(tp.string_data().begin(), tp.string_data().end());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_UNDEFINED:
@@ -77,9 +67,19 @@ Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto & tp) {
   // The only way to know if we should be using raw_data or
   // <type>_data is to look at which of them is size zero.
   if (tp.has_raw_data()) {
-    ret.set_raw_data(tp.raw_data());
+    t->set_raw_data(tp.raw_data());
   }
+}
+
+// Converts everything but the data.
+Tensor tensorProtoToTensorMetadata(const ONNX_NAMESPACE::TensorProto & tp) {
+  Tensor ret;
 
+  ret.sizes().assign(tp.dims().begin(), tp.dims().end());
+  ret.elem_type() = tp.data_type();
+  if (tp.data_type() == ONNX_NAMESPACE::TensorProto_DataType_UNDEFINED) {
+    fail_convert("Unknown tensor data type");
+  }
   if (tp.has_name()) {
     ret.setName(tp.name());
   }
@@ -89,6 +89,12 @@ Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto & tp) {
   return ret;
 }
 
+Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto & tp) {
+  Tensor ret = tensorProtoToTensorMetadata(tp);
+  decodeTensorProtoData(tp, &ret);
+  return ret;
+}
+
 void convertAttribute(const ONNX_NAMESPACE::AttributeProto & ap, Node * n) {
   Symbol sym = Symbol(ap.name());
   switch(ap.type()) {
@@ -158,7 +164,7 @@ void convertAttribute(const ONNX_NAMESPACE::AttributeProto & ap, Node * n) {
   }
 }
 
-void convertAttributes(ONNX_NAMESPACE::NodeProto & np, Node * n) {
+void convertAttributes(const ONNX_NAMESPACE::NodeProto & np, Node * n) {
   for (int i = 0; i < np.attribute_size(); i++) {
     convertAttribute(np.attribute(i), n);
   }
@@ -177,7 +183,11 @@ std::vector<Dimension> tensorShapeProtoToDimensions(const ONNX_NAMESPACE::Tensor
   return dims;
 }
 
-std::unique_ptr<Graph> graphProtoToGraph(const ONNX_NAMESPACE::GraphProto& gp, bool nested) {
+std::unique_ptr<Graph> graphProtoToGraph(
+    const ONNX_NAMESPACE::GraphProto& gp,
+    bool nested,
+    size_t num_threads,
+    const std::shared_ptr<const ModelProto>& lazy_owner) {
   std::unique_ptr<Graph> g(new Graph());
 
   if (gp.has_name()) {
@@ -197,16 +207,27 @@ std::unique_ptr<Graph> graphProtoToGraph(const ONNX_NAMESPACE::GraphProto& gp, b
   // 4) initialize inputs of the Return sentinel node
   // 5) fill in type info for graph outputs, and register them as outputs
   // 5) fill in type info for Values from the value_info list in the graph
+  //
+  // With num_threads > 1, node attributes (which hold Constant tensors and
+  // nested subgraphs) and initializers are converted concurrently once all
+  // Nodes exist; each work item only writes to its own Node or slot, so the
+  // resulting graph is identical to the sequential one.
+  //
+  // With a lazy_owner, initializers only get their metadata; their data is
+  // decoded from the TensorProto (kept alive by lazy_owner) on first use.
 
   // In ONNX proto land, Values are just strings. We are going to make
   // objects out of them, and equal strings must be mapped to the same
   // Value object.
   std::unordered_map<std::string, Value*> value_by_name_of;
+  value_by_name_of.reserve(1 + gp.input_size() + gp.node_size());
 
   // We initialize Node inputs in a separate pass from the Nodes
-  // themselves. To do so, we need to have access to the names of the
-  // inputs.
-  std::unordered_map<Node*, std::vector<std::string>> inputs_by_node;
+  // themselves. To do so, we remember which NodeProto each Node came
+  // from (in creation order) and read the input names straight from it,
+  // rather than copying them out.
+  std::vector<std::pair<Node*, const ONNX_NAMESPACE::NodeProto*>> node_protos;
+  node_protos.reserve(gp.node_size());
 
   {
     // ONNX represents optional arguments in two ways
@@ -221,7 +242,7 @@ std::unique_ptr<Graph> graphProtoToGraph(const ONNX_NAMESPACE::GraphProto& gp, b
   }
 
   for (int i = 0; i < gp.input_size(); i++) {
-    auto vip = gp.input(i);
+    const auto& vip = gp.input(i);
     auto v = g->addInput();
     v->setElemType(vip.type().tensor_type().elem_type());
     v->setSizes(tensorShapeProtoToDimensions(vip.type().tensor_type().shape()));
@@ -230,7 +251,7 @@ std::unique_ptr<Graph> graphProtoToGraph(const ONNX_NAMESPACE::GraphProto& gp, b
   }
 
   for (int i = 0; i < gp.node_size(); i++) {
-    auto np = gp.node(i);
+    const auto& np = gp.node(i);
     auto * n = g->create(Symbol(np.op_type()), /* num_outputs = */ np.output_size());
     g->appendNode(n);
     for (int j = 0; j < np.output_size(); j++) {
@@ -240,13 +261,10 @@ std::unique_ptr<Graph> graphProtoToGraph(const ONNX_NAMESPACE::GraphProto& gp, b
       out->setUniqueName(np.output(j));
       value_by_name_of[np.output(j)] = out;
     }
-    convertAttributes(np, n);
-    std::vector<std::string> inputs;
-    inputs.reserve(np.input_size());
-    for (int j = 0; j < np.input_size(); j++) {
-      inputs.push_back(np.input(j));
+    if (num_threads <= 1) {
+      convertAttributes(np, n);
     }
-    inputs_by_node[n] = inputs;
+    node_protos.emplace_back(n, &np);
     if (np.has_doc_string()) {
       n->setDocString(np.doc_string());
     }
@@ -258,66 +276,98 @@ std::unique_ptr<Graph> graphProtoToGraph(const ONNX_NAMESPACE::GraphProto& gp, b
     }
   }
 
-  for (auto n : g->nodes()) {
-    auto search = inputs_by_node.find(n);
-    if (search == inputs_by_node.end()) {
-      continue;
+  if (num_threads > 1) {
+    // Workers only write to their own Node; the kinds of the nodes given
+    // subgraphs are recorded in g once they are done.
+    g->pauseSubgraphKinds();
+    parallel_for(node_protos.size(), num_threads, [&node_protos](size_t i) {
+      convertAttributes(*node_protos[i].second, node_protos[i].first);
+    });
+    g->resumeSubgraphKinds();
+  }
+
+  // Returns the Value named `name`. In a nested block an undefined
+  // reference may be a captured value, for which we create a dummy node
+  // that we ignore later.
+  auto lookup_or_capture = [&](const std::string& name) -> Value* {
+    auto it = value_by_name_of.find(name);
+    if (it != value_by_name_of.end()) {
+      return it->second;
     }
-    for (auto input : search->second) {
-      if (!value_by_name_of.count(input) && nested) {
-        // Undefined reference to an input in a nested block. This may be a
-        // captured value. Create a dummy node that we ignore later.
-        auto * undef = g->create(kCaptured, 1);
-        g->appendNode(undef);
-        undef->outputs()[0]->setUniqueName(input);
-        value_by_name_of[input] = undef->outputs()[0];
-      }
+    if (!nested) {
+      return value_by_name_of.at(name);
+    }
+    auto * undef = g->create(kCaptured, 1);
+    g->appendNode(undef);
+    undef->outputs()[0]->setUniqueName(name);
+    value_by_name_of[name] = undef->outputs()[0];
+    return undef->outputs()[0];
+  };
 
-      n->addInput(value_by_name_of.at(input));
+  for (const auto& entry : node_protos) {
+    Node* n = entry.first;
+    const auto& np = *entry.second;
+    for (int j = 0; j < np.input_size(); j++) {
+      n->addInput(lookup_or_capture(np.input(j)));
     }
   }
 
   for (int i = 0; i < gp.output_size(); i++) {
-    if (!value_by_name_of.count(gp.output(i).name()) && nested) {
-      // Same captured value logic as above. We can consider outputs of a
-      // graph to be "inputs" of a dummy "output" node. The same lexical
-      // scoping rules are valid here, thus we need to add a dummy node
-      // in the case of an undefined reference
-      auto * undef = g->create(kCaptured, 1);
-      g->appendNode(undef);
-      undef->outputs()[0]->setUniqueName(gp.output(i).name());
-      value_by_name_of[gp.output(i).name()] = undef->outputs()[0];
-    }
-    value_by_name_of[gp.output(i).name()]->setElemType(gp.output(i).type().tensor_type().elem_type());
-    value_by_name_of[gp.output(i).name()]->setSizes(tensorShapeProtoToDimensions(gp.output(i).type().tensor_type().shape()));
-    g->registerOutput(value_by_name_of[gp.output(i).name()]);
+    // We can consider outputs of a graph to be "inputs" of a dummy
+    // "output" node, so the same lexical scoping rules apply.
+    const auto& vip = gp.output(i);
+    Value* v = lookup_or_capture(vip.name());
+    v->setElemType(vip.type().tensor_type().elem_type());
+    v->setSizes(tensorShapeProtoToDimensions(vip.type().tensor_type().shape()));
+    g->registerOutput(v);
   }
 
   for (int i = 0; i < gp.value_info_size(); i++) {
-    value_by_name_of[gp.value_info(i).name()]->setElemType(gp.value_info(i).type().tensor_type().elem_type());
-    if (gp.value_info(i).type().tensor_type().has_shape()) {
-      value_by_name_of[gp.value_info(i).name()]->setSizes(
-          tensorShapeProtoToDimensions(
-              gp.value_info(i).type().tensor_type().shape()));
+    const auto& vip = gp.value_info(i);
+    Value* v = value_by_name_of[vip.name()];
+    v->setElemType(vip.type().tensor_type().elem_type());
+    if (vip.type().tensor_type().has_shape()) {
+      v->setSizes(tensorShapeProtoToDimensions(vip.type().tensor_type().shape()));
     }
   }
 
-  for (int i = 0; i < gp.initializer_size(); i++) {
-    auto init = tensorProtoToTensor(gp.initializer(i));
-    g->addInitializer(init, init.name());
+  if (lazy_owner) {
+    for (int i = 0; i < gp.initializer_size(); i++) {
+      const auto& tp = gp.initializer(i);
+      Tensor t = tensorProtoToTensorMetadata(tp);
+      t.set_lazy_source(std::shared_ptr<const TensorProto>(lazy_owner, &tp));
+      g->addInitializer(std::move(t), tp.name());
+    }
+  } else if (num_threads > 1) {
+    std::vector<Tensor> initializers(gp.initializer_size());
+    parallel_for(initializers.size(), num_threads, [&gp, &initializers](size_t i) {
+      initializers[i] = tensorProtoToTensor(gp.initializer(static_cast<int>(i)));
+    });
+    for (int i = 0; i < gp.initializer_size(); i++) {
+      g->addInitializer(std::move(initializers[i]), gp.initializer(i).name());
+    }
+  } else {
+    for (int i = 0; i < gp.initializer_size(); i++) {
+      const auto& tp = gp.initializer(i);
+      g->addInitializer(tensorProtoToTensor(tp), tp.name());
+    }
   }
 
   return g;
 }
 
-std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp) {
+std::unique_ptr<Graph> importModelProto(
+    const ModelProto& mp,
+    size_t num_threads,
+    const std::shared_ptr<const ModelProto>& lazy_owner) {
   if (!mp.has_ir_version()) {
     return nullptr;
   } else if (mp.ir_version() == 1) {
     return nullptr;
   }
 
-  std::unique_ptr<Graph> g(graphProtoToGraph(mp.graph(), false));
+  std::unique_ptr<Graph> g(graphProtoToGraph(
+      mp.graph(), false, resolve_num_threads(num_threads), lazy_owner));
   for (int i = 0; i < mp.opset_import_size(); i++) {
     OpSetID new_opset_version(mp.opset_import(i).domain(), mp.opset_import(i).version());
     g->opset_versions_mutable().emplace_back(std::move(new_opset_version));
@@ -325,15 +375,134 @@ std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp) {
   return g;
 }
 
+std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp, size_t num_threads) {
+  return importModelProto(mp, num_threads, nullptr);
+}
+
+std::unique_ptr<Graph> ImportModelProtoLazy(
+    const std::shared_ptr<const ModelProto>& mp,
+    size_t num_threads) {
+  return importModelProto(*mp, num_threads, mp);
+}
+
 
 // Part 2: convert IR to ONNX Protobuf
 std::string value_name(Value* n) {
   return n->uniqueName();
 }
 
-void encodeGraph(GraphProto * p_g, const std::shared_ptr<Graph> & g);
+// With encode_body unset, only the name, doc string, inputs and outputs
+// are encoded.
+void encodeGraph(
+    GraphProto * p_g,
+    const std::shared_ptr<Graph> & g,
+    size_t num_threads = 1,
+    bool use_raw_data = false,
+    bool encode_body = true);
+
+// Appends `values` to `field` with a single bulk copy. The element types
+// are separate template parameters because protobuf's int64 typedef is not
+// always the same type as int64_t.
+template <typename F, typename T>
+void appendRepeated(google::protobuf::RepeatedField<F>* field, const std::vector<T>& values) {
+  if (values.empty()) {
+    return;
+  }
+  const int old_size = field->size();
+  field->Resize(old_size + static_cast<int>(values.size()), F());
+  std::copy(values.begin(), values.end(), field->mutable_data() + old_size);
+}
+
+// Packs `values` into the little-endian raw_data layout of a tensor whose
+// elements are `Elem`. Same-width types are copied with a single memcpy;
+// narrower element types (e.g. INT8 stored in int32_data) are truncated
+// element by element.
+template <typename Elem, typename T>
+std::string packRawData(const std::vector<T>& values) {
+  std::string raw(values.size() * sizeof(Elem), '\0');
+  if (std::is_same<Elem, T>::value) {
+    if (!values.empty()) {
+      std::memcpy(&raw[0], values.data(), raw.size());
+    }
+  } else {
+    for (size_t i = 0; i < values.size(); ++i) {
+      Elem e = static_cast<Elem>(values[i]);
+      std::memcpy(&raw[i * sizeof(Elem)], &e, sizeof(Elem));
+    }
+  }
+  return raw;
+}
 
-void encodeTensor(ONNX_NAMESPACE::TensorProto * p, const Tensor & tensor) {
+bool isLittleEndianHost() {
+  const uint32_t one = 1;
+  unsigned char first_byte;
+  std::memcpy(&first_byte, &one, 1);
+  return first_byte == 1;
+}
+
+// Stores the typed payload of `tensor` in p->raw_data. Returns false when
+// that is not possible (string tensors, or a big-endian host, since
+// raw_data is always little-endian), in which case nothing is written.
+bool encodeRawData(ONNX_NAMESPACE::TensorProto * p, const Tensor & tensor) {
+  static const bool little_endian = isLittleEndianHost();
+  if (!little_endian) {
+    return false;
+  }
+  switch(tensor.elem_type()) {
+  case ONNX_NAMESPACE::TensorProto_DataType_FLOAT:
+  case ONNX_NAMESPACE::TensorProto_DataType_COMPLEX64:
+    p->set_raw_data(packRawData<float>(tensor.floats()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_FLOAT16:
+  case ONNX_NAMESPACE::TensorProto_DataType_BFLOAT16:
+  case ONNX_NAMESPACE::TensorProto_DataType_UINT16:
+    p->set_raw_data(packRawData<uint16_t>(tensor.int32s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_INT16:
+    p->set_raw_data(packRawData<int16_t>(tensor.int32s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_BOOL:
+  case ONNX_NAMESPACE::TensorProto_DataType_UINT8:
+    p->set_raw_data(packRawData<uint8_t>(tensor.int32s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_INT8:
+    p->set_raw_data(packRawData<int8_t>(tensor.int32s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_INT32:
+    p->set_raw_data(packRawData<int32_t>(tensor.int32s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_INT64:
+    p->set_raw_data(packRawData<int64_t>(tensor.int64s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_UINT32:
+    p->set_raw_data(packRawData<uint32_t>(tensor.uint64s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_UINT64:
+    p->set_raw_data(packRawData<uint64_t>(tensor.uint64s()));
+    return true;
+  case ONNX_NAMESPACE::TensorProto_DataType_DOUBLE:
+  case ONNX_NAMESPACE::TensorProto_DataType_COMPLEX128:
+    p->set_raw_data(packRawData<double>(tensor.doubles()));
+    return true;
+  default:
+    return false;
+  }
+}
+
+void copyTensorProtoData(ONNX_NAMESPACE::TensorProto * p, const ONNX_NAMESPACE::TensorProto & source) {
+  p->mutable_float_data()->CopyFrom(source.float_data());
+  p->mutable_int32_data()->CopyFrom(source.int32_data());
+  p->mutable_string_data()->CopyFrom(source.string_data());
+  p->mutable_int64_data()->CopyFrom(source.int64_data());
+  p->mutable_double_data()->CopyFrom(source.double_data());
+  p->mutable_uint64_data()->CopyFrom(source.uint64_data());
+  if (source.has_raw_data()) {
+    p->set_raw_data(source.raw_data());
+  }
+}
+
+// Encodes everything but the data.
+void encodeTensorMetadata(ONNX_NAMESPACE::TensorProto * p, const Tensor & tensor) {
   if (tensor.hasName()) {
     p->set_name(tensor.name());
   }
@@ -343,16 +512,33 @@ void encodeTensor(ONNX_NAMESPACE::TensorProto * p, const Tensor & tensor) {
     segment.set_end(tensor.segment_end());
     p->mutable_segment()->CopyFrom(segment);
   }
-  for(auto d : tensor.sizes()) {
-    p->add_dims(d);
-  }
+  appendRepeated(p->mutable_dims(), tensor.sizes());
   p->set_data_type(tensor.elem_type());
+}
+
+void encodeTensor(ONNX_NAMESPACE::TensorProto * p, const Tensor & tensor, bool use_raw_data = false) {
+  if (tensor.is_sparse()) {
+    // TensorProto has no sparse form: encode a dense copy, so that the
+    // Tensor itself stays sparse.
+    Tensor dense = tensor;
+    dense.densify();
+    encodeTensor(p, dense, use_raw_data);
+    return;
+  }
+  encodeTensorMetadata(p, tensor);
+  const TensorProto* source = tensor.lazy_source();
+  if (source != nullptr && (!use_raw_data || source->has_raw_data())) {
+    // The data was never decoded, so it is unchanged: pass it through.
+    copyTensorProtoData(p, *source);
+    return;
+  }
+  if (use_raw_data && tensor.raw_data_size() == 0 && encodeRawData(p, tensor)) {
+    return;
+  }
   switch(tensor.elem_type()) {
   case ONNX_NAMESPACE::TensorProto_DataType_FLOAT:
   case ONNX_NAMESPACE::TensorProto_DataType_COMPLEX64: {
-    for (float x : tensor.floats()) {
-      p->add_float_data(x);
-    }
+    appendRepeated(p->mutable_float_data(), tensor.floats());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_FLOAT16:
@@ -363,32 +549,25 @@ void encodeTensor(ONNX_NAMESPACE::TensorProto * p, const Tensor & tensor) {
   case ONNX_NAMESPACE::TensorProto_DataType_INT32:
   case ONNX_NAMESPACE::TensorProto_DataType_UINT8:
   case ONNX_NAMESPACE::TensorProto_DataType_UINT16: {
-    for (int32_t x : tensor.int32s()) {
-      p->add_int32_data(x);
-    }
+    appendRepeated(p->mutable_int32_data(), tensor.int32s());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_INT64: {
-    for (int64_t x : tensor.int64s()) {
-      p->add_int64_data(x);
-    }
+    appendRepeated(p->mutable_int64_data(), tensor.int64s());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_UINT32:
   case ONNX_NAMESPACE::TensorProto_DataType_UINT64: {
-    for (uint64_t x : tensor.uint64s()) {
-      p->add_uint64_data(x);
-    }
+    appendRepeated(p->mutable_uint64_data(), tensor.uint64s());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_DOUBLE:
   case ONNX_NAMESPACE::TensorProto_DataType_COMPLEX128: {
-    for (double x : tensor.doubles()) {
-      p->add_double_data(x);
-    }
+    appendRepeated(p->mutable_double_data(), tensor.doubles());
     break;
   }
   case ONNX_NAMESPACE::TensorProto_DataType_STRING: {
+    p->mutable_string_data()->Reserve(static_cast<int>(tensor.strings().size()));
     for (const std::string& x : tensor.strings()) {
       p->add_string_data(x);
     }
@@ -397,8 +576,8 @@ void encodeTensor(ONNX_NAMESPACE::TensorProto * p, const Tensor & tensor) {
   case ONNX_NAMESPACE::TensorProto_DataType_UNDEFINED:
     fail_convert("Unknown tensor data type");
   }
-  if (!tensor.raw().empty()) {
-    p->set_raw_data(tensor.raw());
+  if (tensor.raw_data_size() != 0) {
+    p->set_raw_data(tensor.raw_data_ptr(), tensor.raw_data_size());
   }
 }
 
@@ -482,7 +661,61 @@ void encodeValueInfo(ONNX_NAMESPACE::ValueInfoProto* v, Value* n) {
   encodeTypeProtoTensorType(tensor_type, n);
 }
 
-void encodeGraph(GraphProto * p_g, const std::shared_ptr<Graph> & g) {
+// Appends `node` to p_g, along with the value_info of its outputs that
+// are not graph outputs. Attributes are left to the caller unless
+// encode_attributes is set.
+NodeProto* encodeNode(
+    GraphProto * p_g,
+    Node * node,
+    const std::unordered_set<Value*>& graph_outputs,
+    bool encode_attributes) {
+  auto p_n = p_g->add_node();
+  for(auto input : node->inputs()) {
+    if (input->node()->kind() == kUndefined) {
+      p_n->add_input("");
+    } else {
+      p_n->add_input(value_name(input));
+    }
+  }
+  for(auto output : node->outputs()) {
+    p_n->add_output(value_name(output));
+    // only save it if
+    //  - it has actual information worth saving
+    //  - it's not already saved in the graph outputs value info
+    if (graph_outputs.find(output) != graph_outputs.end()) {
+      continue;
+    }
+    if (output->elemType() == TensorProto_DataType_UNDEFINED &&
+        output->sizes().empty()) {
+      continue;
+    }
+    ValueInfoProto* v = p_g->add_value_info();
+    encodeValueInfo(v, output);
+  }
+  p_n->set_op_type(node->kind().toString());
+  if (encode_attributes) {
+    for(auto attr_name : node->attributeNames()) {
+      addAttribute(p_n, node, attr_name);
+    }
+  }
+  if (node->has_doc_string()) {
+    p_n->set_doc_string(node->docString());
+  }
+  if (node->has_name()) {
+    p_n->set_name(node->name());
+  }
+  if (node->has_domain()) {
+    p_n->set_domain(node->domain());
+  }
+  return p_n;
+}
+
+void encodeGraph(
+    GraphProto * p_g,
+    const std::shared_ptr<Graph> & g,
+    size_t num_threads,
+    bool use_raw_data,
+    bool encode_body) {
   ONNX_ASSERT(p_g != nullptr);
 
   if (g->has_name()) {
@@ -504,60 +737,53 @@ void encodeGraph(GraphProto * p_g, const std::shared_ptr<Graph> & g) {
 
   std::unordered_set<Value*> graph_outputs(g->outputs().begin(), g->outputs().end());
 
+  // With num_threads > 1 the NodeProtos are laid out sequentially and their
+  // attributes (tensors, subgraphs) are encoded afterwards, concurrently.
+  std::vector<std::pair<NodeProto*, Node*>> deferred_attributes;
+
+  if (!encode_body) {
+    return;
+  }
+
   for (auto node : g->nodes()) {
     if (node->kind() == kUndefined || node->kind() == kCaptured) {
       // Undefined nodes are used to represent optional inputs that are not provided.
       continue;
     }
-    auto p_n = p_g->add_node();
-    for(auto input : node->inputs()) {
-      if (input->node()->kind() == kUndefined) {
-        p_n->add_input("");
-      } else {
-        p_n->add_input(value_name(input));
-      }
+    auto p_n = encodeNode(p_g, node, graph_outputs, num_threads <= 1);
+    if (num_threads > 1) {
+      deferred_attributes.emplace_back(p_n, node);
     }
-    for(auto output : node->outputs()) {
-      p_n->add_output(value_name(output));
-      // only save it if
-      //  - it has actual information worth saving
-      //  - it's not already saved in the graph outputs value info
-      if (graph_outputs.find(output) != graph_outputs.end()) {
-        continue;
-      }
-      if (output->elemType() == TensorProto_DataType_UNDEFINED &&
-          output->sizes().empty()) {
-        continue;
-      }
-      ValueInfoProto* v = p_g->add_value_info();
-      encodeValueInfo(v, output);
-    }
-    p_n->set_op_type(node->kind().toString());
+  }
+
+  parallel_for(deferred_attributes.size(), num_threads, [&deferred_attributes](size_t i) {
+    auto p_n = deferred_attributes[i].first;
+    auto node = deferred_attributes[i].second;
     for(auto attr_name : node->attributeNames()) {
       addAttribute(p_n, node, attr_name);
     }
-    if (node->has_doc_string()) {
-      p_n->set_doc_string(node->docString());
-    }
-    if (node->has_name()) {
-      p_n->set_name(node->name());
-    }
-    if (node->has_domain()) {
-      p_n->set_domain(node->domain());
-    }
-  }
+  });
 
   auto num_initializers = g->initializers().size();
   for (unsigned int i = 0; i < num_initializers; i++) {
     auto p = p_g->add_initializer();
     p->set_name(g->initializer_names()[i]);
-    encodeTensor(p, g->initializers()[i]);
   }
+  parallel_for(num_initializers, num_threads, [&p_g, &g, use_raw_data](size_t i) {
+    encodeTensor(
+        p_g->mutable_initializer(static_cast<int>(i)),
+        g->initializers()[i],
+        use_raw_data);
+  });
 }
 
-void ExportModelProto(ModelProto* p_m, const std::shared_ptr<Graph>& g) {
+void ExportModelProto(
+    ModelProto* p_m,
+    const std::shared_ptr<Graph>& g,
+    size_t num_threads,
+    bool use_raw_data) {
   GraphProto* p_g = p_m->mutable_graph();
-  encodeGraph(p_g, g);
+  encodeGraph(p_g, g, resolve_num_threads(num_threads), use_raw_data);
   // Add new opset_versions
   p_m->clear_opset_import();
   for (const OpSetID& opset : g->opset_versions_mutable()) {
@@ -567,6 +793,135 @@ void ExportModelProto(ModelProto* p_m, const std::shared_ptr<Graph>& g) {
   }
 }
 
+namespace {
+
+// Tag of a string/bytes/message field in the protobuf wire format.
+uint32_t lengthDelimitedTag(int field_number) {
+  return (static_cast<uint32_t>(field_number) << 3) | 2;
+}
+
+// The streaming exporter writes ModelProto.graph as a sequence of
+// GraphProto chunks; parsers merge repeated occurrences of a message field,
+// so this parses as a single GraphProto.
+void writeGraphChunk(CodedOutputStream* out, const GraphProto& chunk) {
+  out->WriteTag(lengthDelimitedTag(ModelProto::kGraphFieldNumber));
+  out->WriteVarint64(chunk.ByteSizeLong());
+  chunk.SerializeWithCachedSizes(out);
+}
+
+// Writes `g`'s initializer `i` as its own chunk. Raw data is written
+// straight from the Tensor (or from the TensorProto it was lazily imported
+// from) instead of being copied into a TensorProto first.
+void writeInitializerChunk(
+    CodedOutputStream* out,
+    const std::shared_ptr<Graph>& g,
+    size_t i,
+    bool use_raw_data) {
+  const Tensor& tensor = g->initializers()[i];
+  const char* raw_data = nullptr;
+  size_t raw_data_size = 0;
+  if (tensor.lazy_source() != nullptr) {
+    if (tensor.lazy_source()->has_raw_data()) {
+      raw_data = tensor.lazy_source()->raw_data().data();
+      raw_data_size = tensor.lazy_source()->raw_data().size();
+    }
+  } else if (tensor.is_raw_data()) {
+    raw_data = tensor.raw_data_ptr();
+    raw_data_size = tensor.raw_data_size();
+  }
+
+  if (raw_data == nullptr) {
+    GraphProto chunk;
+    TensorProto* p = chunk.add_initializer();
+    p->set_name(g->initializer_names()[i]);
+    encodeTensor(p, tensor, use_raw_data);
+    writeGraphChunk(out, chunk);
+    return;
+  }
+
+  TensorProto p;
+  p.set_name(g->initializer_names()[i]);
+  encodeTensorMetadata(&p, tensor);
+  const uint32_t raw_data_tag = lengthDelimitedTag(TensorProto::kRawDataFieldNumber);
+  const size_t tensor_size = p.ByteSizeLong() +
+      CodedOutputStream::VarintSize32(raw_data_tag) +
+      CodedOutputStream::VarintSize64(raw_data_size) + raw_data_size;
+  const uint32_t initializer_tag = lengthDelimitedTag(GraphProto::kInitializerFieldNumber);
+  const size_t chunk_size = CodedOutputStream::VarintSize32(initializer_tag) +
+      CodedOutputStream::VarintSize64(tensor_size) + tensor_size;
+
+  out->WriteTag(lengthDelimitedTag(ModelProto::kGraphFieldNumber));
+  out->WriteVarint64(chunk_size);
+  out->WriteTag(initializer_tag);
+  out->WriteVarint64(tensor_size);
+  p.SerializeWithCachedSizes(out);
+  out->WriteTag(raw_data_tag);
+  out->WriteVarint64(raw_data_size);
+  // WriteRaw takes an int size.
+  const size_t max_write = size_t(1) << 30;
+  for (size_t offset = 0; offset < raw_data_size; offset += max_write) {
+    out->WriteRaw(
+        raw_data + offset,
+        static_cast<int>(std::min(max_write, raw_data_size - offset)));
+  }
+}
+
+} // namespace
+
+bool ExportModelProto(
+    google::protobuf::io::ZeroCopyOutputStream* output,
+    const ModelProto& model_info,
+    const std::shared_ptr<Graph>& g,
+    bool use_raw_data) {
+  CodedOutputStream out(output);
+
+  ModelProto header = PrepareOutput(model_info);
+  header.clear_opset_import();
+  for (const OpSetID& opset : g->opset_versions_mutable()) {
+    OperatorSetIdProto *opset_version_output = header.add_opset_import();
+    opset_version_output->set_domain(opset.domain());
+    opset_version_output->set_version(opset.version());
+  }
+  header.SerializeToCodedStream(&out);
+
+  // One chunk with the graph's name and signature, then one per node and
+  // one per initializer, so that at most one of them is held in memory.
+  {
+    GraphProto chunk;
+    encodeGraph(&chunk, g, 1, use_raw_data, false);
+    writeGraphChunk(&out, chunk);
+  }
+  std::unordered_set<Value*> graph_outputs(g->outputs().begin(), g->outputs().end());
+  for (auto node : g->nodes()) {
+    if (node->kind() == kUndefined || node->kind() == kCaptured) {
+      continue;
+    }
+    GraphProto chunk;
+    encodeNode(&chunk, node, graph_outputs, true);
+    writeGraphChunk(&out, chunk);
+    if (out.HadError()) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < g->initializers().size(); i++) {
+    writeInitializerChunk(&out, g, i, use_raw_data);
+    if (out.HadError()) {
+      return false;
+    }
+  }
+  return !out.HadError();
+}
+
+bool ExportModelProto(
+    int fd,
+    const ModelProto& model_info,
+    const std::shared_ptr<Graph>& g,
+    bool use_raw_data) {
+  google::protobuf::io::FileOutputStream output(fd);
+  const bool ok = ExportModelProto(&output, model_info, g, use_raw_data);
+  return output.Flush() && ok;
+}
+
 ModelProto PrepareOutput(const ModelProto& mp_in) {
   ModelProto mp_out{};
 
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <google/protobuf/io/zero_copy_stream.h>
+
 #include "onnx/common/ir.h"
 #include "onnx/onnx_pb.h"
 
@@ -33,11 +35,60 @@ class ConvertError final : public std::runtime_error {
 #define fail_convert(...) \
   throw ConvertError(MakeString(__VA_ARGS__));
 
-void ExportModelProto(ModelProto* p_m, const std::shared_ptr<Graph>& g);
+// num_threads controls how many threads are used to encode initializers
+// and node attributes (tensors, subgraphs); 0 means one per hardware
+// thread. The output does not depend on the number of threads.
+//
+// If use_raw_data is set, numeric initializers are always written to
+// raw_data instead of the typed <type>_data fields.
+void ExportModelProto(
+    ModelProto* p_m,
+    const std::shared_ptr<Graph>& g,
+    size_t num_threads = 1,
+    bool use_raw_data = false);
+
+// Streaming variants of ExportModelProto: rather than building the output
+// ModelProto, they write its serialized form to `output` (or to the file
+// descriptor `fd`) while walking the IR. Nodes and initializers are encoded
+// one at a time, each as a separate chunk of the graph field, which parsers
+// merge into a single GraphProto; raw initializer data is written without
+// being copied. Model level fields (ir_version, producer, ...) are taken
+// from `model_info`, whose graph is ignored.
+//
+// Parsing the output yields the same ModelProto as ExportModelProto,
+// though the bytes differ. Returns false if writing failed.
+bool ExportModelProto(
+    google::protobuf::io::ZeroCopyOutputStream* output,
+    const ModelProto& model_info,
+    const std::shared_ptr<Graph>& g,
+    bool use_raw_data = false);
+
+bool ExportModelProto(
+    int fd,
+    const ModelProto& model_info,
+    const std::shared_ptr<Graph>& g,
+    bool use_raw_data = false);
 
-std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp);
+// num_threads controls how many threads are used to convert initializers
+// and node attributes (tensors, subgraphs); 0 means one per hardware
+// thread. The resulting Graph does not depend on the number of threads.
+std::unique_ptr<Graph> ImportModelProto(
+    const ModelProto& mp,
+    size_t num_threads = 1);
+
+// Like ImportModelProto, but initializers are imported lazily: each one
+// only gets its name, type and dims, and keeps a reference into `mp` from
+// which its data is decoded the first time it is accessed. Initializers
+// whose data is never accessed are copied through unchanged by
+// ExportModelProto.
+std::unique_ptr<Graph> ImportModelProtoLazy(
+    const std::shared_ptr<const ModelProto>& mp,
+    size_t num_threads = 1);
 
 ModelProto PrepareOutput(const ModelProto& mp_in);
 
+// Sets v's name, element type and dims from n.
+void encodeValueInfo(ValueInfoProto* v, Value* n);
+
 void assertNonNull(std::shared_ptr<Graph> g);
 } // namespace ONNX_NAMESPACE
@@ -0,0 +1,77 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ONNX_NAMESPACE {
+
+// Returns the number of threads to use when the caller asked for
+// `num_threads`, where 0 means "one per hardware thread".
+inline size_t resolve_num_threads(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  return std::max<size_t>(num_threads, 1);
+}
+
+// Calls fn(i) for every i in [0, n), using up to `num_threads` threads
+// (the calling thread included). Indices are handed out one at a time,
+// so items of very different cost are still balanced across threads.
+//
+// fn must only touch state owned by item i; results should be written to
+// pre-sized slots and stitched together by the caller, which keeps the
+// outcome independent of scheduling.
+//
+// If any call throws, no new items are started and the first exception
+// is rethrown on the calling thread once all workers have stopped.
+template <typename F>
+void parallel_for(size_t n, size_t num_threads, const F& fn) {
+  num_threads = std::min(resolve_num_threads(num_threads), n);
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < n; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&]() {
+    for (size_t i = next++; i < n && !failed; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> guard(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t t = 1; t < num_threads; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,381 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/repeated_subgraphs.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "onnx/common/graph_hash.h"
+
+namespace ONNX_NAMESPACE {
+
+RepeatedSubgraph::RepeatedSubgraph(std::vector<std::vector<Node*>> instances)
+    : instances_(std::move(instances)) {
+  ONNX_ASSERT(instances_.size() >= 2);
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    ONNX_ASSERT(instances_[i].size() == instances_[0].size());
+    for (size_t k = 0; k < instances_[i].size(); ++k) {
+      positions_.emplace(instances_[i][k], std::make_pair(i, k));
+    }
+  }
+}
+
+int RepeatedSubgraph::instanceOf(const Node* n) const {
+  auto it = positions_.find(n);
+  return it == positions_.end() ? -1 : static_cast<int>(it->second.first);
+}
+
+Node* RepeatedSubgraph::counterpart(const Node* n, size_t instance) const {
+  auto it = positions_.find(n);
+  ONNX_ASSERTM(it != positions_.end(), "Node is not in the repeated subgraph");
+  return instances_[instance][it->second.second];
+}
+
+std::vector<Value*> RepeatedSubgraph::inputs(size_t instance) const {
+  std::vector<Value*> result;
+  for (Node* n : instances_[instance]) {
+    for (Value* input : n->inputs()) {
+      if (instanceOf(input->node()) != static_cast<int>(instance)) {
+        result.push_back(input);
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<Value*> RepeatedSubgraph::outputs(size_t instance) const {
+  std::vector<Value*> result;
+  for (size_t k = 0; k < size(); ++k) {
+    for (size_t o = 0; o < instances_[instance][k]->outputs().size(); ++o) {
+      bool used_outside = false;
+      for (size_t i = 0; i < instances_.size() && !used_outside; ++i) {
+        for (const Use& use : instances_[i][k]->outputs()[o]->uses()) {
+          if (instanceOf(use.user) != static_cast<int>(i)) {
+            used_outside = true;
+            break;
+          }
+        }
+      }
+      if (used_outside) {
+        result.push_back(instances_[instance][k]->outputs()[o]);
+      }
+    }
+  }
+  return result;
+}
+
+namespace {
+
+uint64_t combine(uint64_t h, uint64_t v) {
+  return HashBytes(&v, sizeof(v), h);
+}
+
+bool isNode(const Node* n) {
+  return n->kind() != kParam && n->kind() != kUndefined &&
+      n->kind() != kCaptured && n->kind() != kReturn;
+}
+
+class RepetitionFinder {
+ public:
+  explicit RepetitionFinder(Graph& g) : g_(g) {}
+
+  std::vector<RepeatedSubgraph> run(size_t min_nodes);
+
+ private:
+  // Where a node is during the current growth: its instance and the index
+  // of its tuple.
+  struct Member {
+    size_t instance;
+    size_t tuple;
+  };
+
+  void computeSignatures();
+  // The initializer `v` names, or nullptr if it is not one.
+  const Tensor* initializerOf(const Value* v) const;
+  // Whether a and b agree in all that their signatures hash.
+  bool sameLocal(Node* a, Node* b) const;
+  void grow(const std::vector<Node*>& anchors);
+  bool tryAdd(const std::vector<Node*>& tuple);
+  void prune();
+  // Whether the i-th input of n comes from inside the instance, and from
+  // where: -1 if not, or else the tuple and output offset of its producer.
+  std::pair<int64_t, size_t> inputSource(Node* n, size_t i, size_t instance) const;
+
+  Graph& g_;
+  std::unordered_map<std::string, const Tensor*> initializers_;
+  std::unordered_map<const Node*, size_t> order_;
+  std::unordered_map<const Node*, uint64_t> signatures_;
+  std::unordered_set<const Node*> taken_;
+
+  std::vector<std::vector<Node*>> tuples_;
+  std::vector<bool> alive_;
+  std::unordered_map<const Node*, Member> members_;
+};
+
+const Tensor* RepetitionFinder::initializerOf(const Value* v) const {
+  if (v->node()->kind() != kParam) {
+    return nullptr;
+  }
+  auto it = initializers_.find(v->uniqueName());
+  return it == initializers_.end() ? nullptr : it->second;
+}
+
+void RepetitionFinder::computeSignatures() {
+  for (size_t i = 0; i < g_.initializers().size(); ++i) {
+    initializers_.emplace(g_.initializer_names()[i], &g_.initializers()[i]);
+  }
+
+  GraphHasher hasher(g_, false);
+  for (Node* n : g_.nodes()) {
+    if (!isNode(n)) {
+      continue;
+    }
+    order_.emplace(n, order_.size());
+    uint64_t h = hasher.localHash(n);
+    for (const Value* input : n->inputs()) {
+      // Other inputs may come from anywhere: the first of a chain of
+      // blocks reads a graph input where the others read node outputs.
+      const NodeKind kind = input->node()->kind();
+      if (kind == kUndefined) {
+        h = combine(h, 1);
+        continue;
+      }
+      const Tensor* initializer = initializerOf(input);
+      if (!initializer) {
+        h = combine(h, 2);
+      } else {
+        // Initializers must agree in type and shape; what they hold can
+        // differ between instances.
+        h = combine(h, 3);
+        h = combine(h, static_cast<uint64_t>(initializer->elem_type()));
+        h = combine(h, initializer->sizes().size());
+        for (int64_t dim : initializer->sizes()) {
+          h = combine(h, static_cast<uint64_t>(dim));
+        }
+      }
+    }
+    signatures_.emplace(n, h);
+  }
+}
+
+bool RepetitionFinder::sameLocal(Node* a, Node* b) const {
+  // Subgraphs are compared by identity.
+  if (!SameLocal(a, b)) {
+    return false;
+  }
+  for (size_t j = 0; j < a->inputs().size(); ++j) {
+    const Value* x = a->inputs()[j];
+    const Value* y = b->inputs()[j];
+    const bool x_empty = x->node()->kind() == kUndefined;
+    if (x_empty != (y->node()->kind() == kUndefined)) {
+      return false;
+    }
+    const Tensor* tx = x_empty ? nullptr : initializerOf(x);
+    const Tensor* ty = x_empty ? nullptr : initializerOf(y);
+    if ((tx == nullptr) != (ty == nullptr) ||
+        (tx &&
+         (tx->elem_type() != ty->elem_type() || tx->sizes() != ty->sizes()))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RepetitionFinder::tryAdd(const std::vector<Node*>& tuple) {
+  const uint64_t signature = signatures_.at(tuple[0]);
+  std::unordered_set<const Node*> seen;
+  for (Node* n : tuple) {
+    if (!isNode(n) || taken_.count(n) || members_.count(n) ||
+        !seen.insert(n).second || signatures_.at(n) != signature) {
+      return false;
+    }
+  }
+  // Signatures only narrow the search: check that they didn't collide.
+  for (size_t m = 1; m < tuple.size(); ++m) {
+    if (!sameLocal(tuple[0], tuple[m])) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < tuple.size(); ++i) {
+    members_.emplace(tuple[i], Member{i, tuples_.size()});
+  }
+  tuples_.push_back(tuple);
+  return true;
+}
+
+void RepetitionFinder::grow(const std::vector<Node*>& anchors) {
+  tuples_.clear();
+  members_.clear();
+  tryAdd(anchors);
+  const size_t k = anchors.size();
+  std::vector<Node*> tuple(k);
+  // tuples_ grows while it is walked.
+  for (size_t t = 0; t < tuples_.size(); ++t) {
+    const std::vector<Node*> current = tuples_[t];
+    // Producers of each input.
+    for (size_t j = 0; j < current[0]->inputs().size(); ++j) {
+      for (size_t m = 0; m < k; ++m) {
+        tuple[m] = current[m]->inputs()[j]->node();
+      }
+      if (isNode(tuple[0])) {
+        tryAdd(tuple);
+      }
+    }
+    // Users of each output, matched up by signature and input offset.
+    // Users that share both can't be told apart and are left out.
+    for (size_t o = 0; o < current[0]->outputs().size(); ++o) {
+      std::vector<std::vector<std::pair<std::pair<uint64_t, size_t>, Node*>>> users(k);
+      bool same_shape = true;
+      for (size_t m = 0; m < k && same_shape; ++m) {
+        for (const Use& use : current[m]->outputs()[o]->uses()) {
+          if (isNode(use.user)) {
+            users[m].emplace_back(
+                std::make_pair(signatures_.at(use.user), use.offset), use.user);
+          }
+        }
+        std::sort(users[m].begin(), users[m].end());
+        same_shape = users[m].size() == users[0].size();
+      }
+      if (!same_shape) {
+        continue;
+      }
+      for (size_t r = 0; r < users[0].size(); ++r) {
+        const auto& key = users[0][r].first;
+        if ((r > 0 && users[0][r - 1].first == key) ||
+            (r + 1 < users[0].size() && users[0][r + 1].first == key)) {
+          continue;
+        }
+        bool match = true;
+        for (size_t m = 0; m < k && match; ++m) {
+          match = users[m][r].first == key;
+          tuple[m] = users[m][r].second;
+        }
+        if (match) {
+          tryAdd(tuple);
+        }
+      }
+    }
+  }
+}
+
+std::pair<int64_t, size_t> RepetitionFinder::inputSource(
+    Node* n,
+    size_t i,
+    size_t instance) const {
+  const Value* input = n->inputs()[i];
+  auto it = members_.find(input->node());
+  if (it == members_.end() || it->second.instance != instance ||
+      !alive_[it->second.tuple]) {
+    return std::make_pair(int64_t(-1), size_t(0));
+  }
+  return std::make_pair(
+      static_cast<int64_t>(it->second.tuple), input->offset());
+}
+
+void RepetitionFinder::prune() {
+  alive_.assign(tuples_.size(), true);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t t = 0; t < tuples_.size(); ++t) {
+      if (!alive_[t]) {
+        continue;
+      }
+      const std::vector<Node*>& tuple = tuples_[t];
+      bool consistent = true;
+      for (size_t j = 0; j < tuple[0]->inputs().size() && consistent; ++j) {
+        const auto source = inputSource(tuple[0], j, 0);
+        for (size_t m = 1; m < tuple.size() && consistent; ++m) {
+          consistent = inputSource(tuple[m], j, m) == source;
+        }
+      }
+      if (!consistent) {
+        alive_[t] = false;
+        changed = true;
+      }
+    }
+  }
+}
+
+std::vector<RepeatedSubgraph> RepetitionFinder::run(size_t min_nodes) {
+  computeSignatures();
+
+  // Candidate anchors: nodes grouped by signature, least common first.
+  std::unordered_map<uint64_t, std::vector<Node*>> groups;
+  for (Node* n : g_.nodes()) {
+    if (isNode(n)) {
+      groups[signatures_.at(n)].push_back(n);
+    }
+  }
+  std::vector<std::vector<Node*>*> candidates;
+  for (auto& group : groups) {
+    if (group.second.size() >= 2) {
+      candidates.push_back(&group.second);
+    }
+  }
+  std::sort(
+      candidates.begin(),
+      candidates.end(),
+      [this](const std::vector<Node*>* a, const std::vector<Node*>* b) {
+        if (a->size() != b->size()) {
+          return a->size() < b->size();
+        }
+        return order_.at(a->front()) < order_.at(b->front());
+      });
+
+  std::vector<RepeatedSubgraph> result;
+  for (const std::vector<Node*>* candidate : candidates) {
+    std::vector<Node*> anchors;
+    for (Node* n : *candidate) {
+      if (!taken_.count(n)) {
+        anchors.push_back(n);
+      }
+    }
+    if (anchors.size() < 2) {
+      continue;
+    }
+    grow(anchors);
+    prune();
+
+    std::vector<size_t> kept;
+    for (size_t t = 0; t < tuples_.size(); ++t) {
+      if (alive_[t]) {
+        kept.push_back(t);
+      }
+    }
+    if (kept.size() < min_nodes) {
+      continue;
+    }
+    // Order nodes topologically; since edges inside the instances match,
+    // the order of the first instance works for all of them.
+    std::sort(kept.begin(), kept.end(), [this](size_t a, size_t b) {
+      return order_.at(tuples_[a][0]) < order_.at(tuples_[b][0]);
+    });
+    std::vector<std::vector<Node*>> instances(anchors.size());
+    for (size_t m = 0; m < anchors.size(); ++m) {
+      for (size_t t : kept) {
+        instances[m].push_back(tuples_[t][m]);
+        taken_.insert(tuples_[t][m]);
+      }
+    }
+    std::sort(
+        instances.begin(),
+        instances.end(),
+        [this](const std::vector<Node*>& a, const std::vector<Node*>& b) {
+          return order_.at(a[0]) < order_.at(b[0]);
+        });
+    result.emplace_back(std::move(instances));
+  }
+  return result;
+}
+
+} // namespace
+
+std::vector<RepeatedSubgraph> FindRepeatedSubgraphs(
+    Graph& g,
+    size_t min_nodes) {
+  return RepetitionFinder(g).run(std::max(min_nodes, size_t(1)));
+}
+
+} // namespace ONNX_NAMESPACE
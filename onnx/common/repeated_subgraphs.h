@@ -0,0 +1,85 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <unordered_map>
+
+#include "onnx/common/ir.h"
+
+namespace ONNX_NAMESPACE {
+
+// A group of isomorphic, disjoint sets of nodes of a Graph, such as the
+// repeated blocks of a transformer or ResNet stage. Instances may differ
+// in the initializers and other values they read from outside, but
+// node(i, k) and node(j, k) always have the same kind, domain and
+// attributes, read initializers of the same type and shape, and read
+// values computed inside their instance from corresponding nodes.
+// Subgraph attributes are compared by identity, so nodes holding them
+// (Loop, If, ...) only correspond if they share the same Graph.
+//
+// A pass can thus work out a rewrite on one instance and replay it on the
+// others through counterpart().
+class RepeatedSubgraph {
+ public:
+  explicit RepeatedSubgraph(std::vector<std::vector<Node*>> instances);
+
+  size_t numInstances() const {
+    return instances_.size();
+  }
+  // Number of nodes in each instance.
+  size_t size() const {
+    return instances_[0].size();
+  }
+
+  // The nodes of an instance, in topological order. Instances are ordered
+  // by their position in the graph.
+  const std::vector<Node*>& instance(size_t i) const {
+    return instances_[i];
+  }
+  Node* node(size_t instance, size_t k) const {
+    return instances_[instance][k];
+  }
+
+  // The instance `n` belongs to, or -1 if it belongs to none.
+  int instanceOf(const Node* n) const;
+
+  // The node of `instance` that corresponds to `n`, which must belong to
+  // one of the instances.
+  Node* counterpart(const Node* n, size_t instance) const;
+
+  // The values an instance reads from outside itself, one per use, in
+  // node and then input order; inputs(i)[k] and inputs(j)[k] are used by
+  // corresponding nodes.
+  std::vector<Value*> inputs(size_t instance) const;
+
+  // The values of an instance used outside it (or returned by the graph),
+  // listed by node and then output; a value is listed if its counterpart
+  // in any instance is used outside.
+  std::vector<Value*> outputs(size_t instance) const;
+
+ private:
+  std::vector<std::vector<Node*>> instances_;
+  // Instance and index of every node.
+  std::unordered_map<const Node*, std::pair<size_t, size_t>> positions_;
+};
+
+// Finds the repeated subgraphs of `g` (not of its subgraphs) with at least
+// `min_nodes` nodes per instance. Every node belongs to at most one of the
+// results.
+//
+// Nodes are first grouped by a local hash (GraphHasher::localHash plus,
+// for each input, whether it is empty, an initializer of a given type and
+// shape, or any other value). Starting from the nodes sharing
+// the least common hash, corresponding nodes are grown in lockstep along
+// input and output edges; each is compared exactly to its counterpart in
+// the first instance, so hash collisions are never matched. Nodes whose
+// edges don't match in all instances are then pruned until what is left
+// is isomorphic.
+//
+// Results are greedy, not maximal: blocks may come back split in parts.
+std::vector<RepeatedSubgraph> FindRepeatedSubgraphs(
+    Graph& g,
+    size_t min_nodes = 2);
+
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,374 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/sparsity.h"
+
+#include <cstring>
+
+namespace ONNX_NAMESPACE {
+
+namespace {
+
+enum class Field { Raw, Floats, Doubles, Int32s, Int64s, Uint64s };
+
+// The elements of a tensor as they are stored: `count` values of `width`
+// bytes at `data`. An element is zero if its bits masked by `value_bits`
+// (all but the sign of floating point types) are zero.
+struct ElementView {
+  Field field;
+  const char* data;
+  size_t count;
+  size_t width;
+  uint64_t value_bits;
+};
+
+// The raw data size of one element of the types supported here, or 0.
+size_t rawElementSize(int32_t elem_type) {
+  switch (elem_type) {
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_INT8:
+    case TensorProto_DataType_UINT8:
+      return 1;
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_BFLOAT16:
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_UINT16:
+      return 2;
+    case TensorProto_DataType_FLOAT:
+    case TensorProto_DataType_INT32:
+    case TensorProto_DataType_UINT32:
+      return 4;
+    case TensorProto_DataType_DOUBLE:
+    case TensorProto_DataType_INT64:
+    case TensorProto_DataType_UINT64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+bool viewElements(const Tensor& t, ElementView* view) {
+  const size_t raw_width = rawElementSize(t.elem_type());
+  if (raw_width == 0) {
+    return false;
+  }
+  switch (t.elem_type()) {
+    case TensorProto_DataType_FLOAT:
+      view->value_bits = 0x7FFFFFFFull;
+      break;
+    case TensorProto_DataType_DOUBLE:
+      view->value_bits = 0x7FFFFFFFFFFFFFFFull;
+      break;
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_BFLOAT16:
+      view->value_bits = 0x7FFFull;
+      break;
+    default:
+      view->value_bits = ~0ull;
+      break;
+  }
+  if (t.is_raw_data()) {
+    view->field = Field::Raw;
+    view->data = t.raw_data_ptr();
+    view->width = raw_width;
+    view->count = t.raw_data_size() / raw_width;
+    return true;
+  }
+  switch (t.elem_type()) {
+    case TensorProto_DataType_FLOAT:
+      view->field = Field::Floats;
+      view->data = reinterpret_cast<const char*>(t.floats().data());
+      view->count = t.floats().size();
+      view->width = sizeof(float);
+      break;
+    case TensorProto_DataType_DOUBLE:
+      view->field = Field::Doubles;
+      view->data = reinterpret_cast<const char*>(t.doubles().data());
+      view->count = t.doubles().size();
+      view->width = sizeof(double);
+      break;
+    case TensorProto_DataType_INT64:
+      view->field = Field::Int64s;
+      view->data = reinterpret_cast<const char*>(t.int64s().data());
+      view->count = t.int64s().size();
+      view->width = sizeof(int64_t);
+      break;
+    case TensorProto_DataType_UINT32:
+    case TensorProto_DataType_UINT64:
+      view->field = Field::Uint64s;
+      view->data = reinterpret_cast<const char*>(t.uint64s().data());
+      view->count = t.uint64s().size();
+      view->width = sizeof(uint64_t);
+      break;
+    default:
+      // The narrower types are stored one value per int32.
+      view->field = Field::Int32s;
+      view->data = reinterpret_cast<const char*>(t.int32s().data());
+      view->count = t.int32s().size();
+      view->width = sizeof(int32_t);
+      break;
+  }
+  return true;
+}
+
+size_t numElements(const Tensor& t) {
+  size_t n = 1;
+  for (int64_t dim : t.sizes()) {
+    n *= static_cast<size_t>(dim);
+  }
+  return n;
+}
+
+// Sets zero[i] to 1 if element i is zero, else 0. Like the scans of
+// special_values.cc this is branch-free and vectorizes; elements are
+// loaded with memcpy as raw data need not be aligned.
+template <typename Bits>
+void maskZeros(const char* data, size_t n, Bits value_bits, uint8_t* zero) {
+  for (size_t i = 0; i < n; ++i) {
+    Bits bits;
+    std::memcpy(&bits, data + i * sizeof(Bits), sizeof(Bits));
+    zero[i] = (bits & value_bits) == 0;
+  }
+}
+
+void maskZeros(const ElementView& view, uint8_t* zero) {
+  switch (view.width) {
+    case 1:
+      maskZeros<uint8_t>(
+          view.data, view.count, static_cast<uint8_t>(view.value_bits), zero);
+      break;
+    case 2:
+      maskZeros<uint16_t>(
+          view.data, view.count, static_cast<uint16_t>(view.value_bits), zero);
+      break;
+    case 4:
+      maskZeros<uint32_t>(
+          view.data, view.count, static_cast<uint32_t>(view.value_bits), zero);
+      break;
+    default:
+      maskZeros<uint64_t>(view.data, view.count, view.value_bits, zero);
+      break;
+  }
+}
+
+size_t countSet(const std::vector<uint8_t>& flags) {
+  size_t count = 0;
+  for (uint8_t flag : flags) {
+    count += flag;
+  }
+  return count;
+}
+
+// Fills in the counts of stats from the zero mask of a tensor.
+void countZeros(
+    const std::vector<uint8_t>& zero,
+    const std::vector<int64_t>& sizes,
+    SparsityStats* stats) {
+  stats->num_elements = zero.size();
+  stats->zeros = countSet(zero);
+  const size_t cols = sizes.empty() ? 1 : static_cast<size_t>(sizes.back());
+  if (cols < 4) {
+    return;
+  }
+  const size_t rows = zero.size() / cols;
+  const size_t blocks_per_row = cols / 4;
+
+  // Four mask bytes of a 1x4 block are all zero exactly if they read as
+  // 0x01010101 in either byte order.
+  std::vector<uint8_t> zero_1x4(rows * blocks_per_row);
+  for (size_t r = 0; r < rows; ++r) {
+    const uint8_t* row = zero.data() + r * cols;
+    uint8_t* blocks = zero_1x4.data() + r * blocks_per_row;
+    for (size_t b = 0; b < blocks_per_row; ++b) {
+      uint32_t word;
+      std::memcpy(&word, row + 4 * b, sizeof(word));
+      blocks[b] = word == 0x01010101u;
+    }
+  }
+  stats->blocks_1x4 = zero_1x4.size();
+  stats->zero_blocks_1x4 = countSet(zero_1x4);
+
+  stats->blocks_4x4 = (rows / 4) * blocks_per_row;
+  for (size_t r = 0; r + 4 <= rows; r += 4) {
+    const uint8_t* blocks = zero_1x4.data() + r * blocks_per_row;
+    size_t zero_blocks = 0;
+    for (size_t b = 0; b < blocks_per_row; ++b) {
+      zero_blocks += blocks[b] & blocks[b + blocks_per_row] &
+          blocks[b + 2 * blocks_per_row] & blocks[b + 3 * blocks_per_row];
+    }
+    stats->zero_blocks_4x4 += zero_blocks;
+  }
+}
+
+template <typename T>
+void gatherValues(
+    const std::vector<T>& dense,
+    const std::vector<int64_t>& indices,
+    std::vector<T>& values) {
+  values.resize(indices.size());
+  for (size_t k = 0; k < indices.size(); ++k) {
+    values[k] = dense[indices[k]];
+  }
+}
+
+template <typename T>
+void scatterValues(
+    const std::vector<T>& values,
+    const std::vector<int64_t>& indices,
+    size_t n,
+    std::vector<T>& dense) {
+  dense.assign(n, T());
+  for (size_t k = 0; k < indices.size(); ++k) {
+    dense[indices[k]] = values[k];
+  }
+}
+
+} // namespace
+
+void densifySparseData(
+    const Tensor& values,
+    const std::vector<int64_t>& indices,
+    Tensor* t) {
+  ElementView view;
+  ONNX_ASSERTM(
+      viewElements(values, &view) && view.count == indices.size(),
+      "Bad sparse data for tensor %s",
+      t->name().c_str());
+  const size_t n = numElements(*t);
+  for (int64_t index : indices) {
+    ONNX_ASSERTM(
+        index >= 0 && static_cast<size_t>(index) < n,
+        "Sparse index %lld out of range for tensor %s",
+        static_cast<long long>(index),
+        t->name().c_str());
+  }
+  switch (view.field) {
+    case Field::Raw: {
+      std::string dense(n * view.width, '\0');
+      for (size_t k = 0; k < indices.size(); ++k) {
+        std::memcpy(
+            &dense[indices[k] * view.width],
+            view.data + k * view.width,
+            view.width);
+      }
+      t->set_raw_data(std::move(dense));
+      break;
+    }
+    case Field::Floats:
+      scatterValues(values.floats(), indices, n, t->floats());
+      break;
+    case Field::Doubles:
+      scatterValues(values.doubles(), indices, n, t->doubles());
+      break;
+    case Field::Int32s:
+      scatterValues(values.int32s(), indices, n, t->int32s());
+      break;
+    case Field::Int64s:
+      scatterValues(values.int64s(), indices, n, t->int64s());
+      break;
+    case Field::Uint64s:
+      scatterValues(values.uint64s(), indices, n, t->uint64s());
+      break;
+  }
+}
+
+SparsityStats AnalyzeSparsity(const Tensor& t) {
+  SparsityStats stats;
+  std::vector<uint8_t> zero;
+  if (t.is_sparse()) {
+    ElementView view;
+    if (!viewElements(t.sparse_values(), &view)) {
+      return stats;
+    }
+    const std::vector<int64_t>& indices = t.sparse_indices();
+    std::vector<uint8_t> value_zero(view.count);
+    maskZeros(view, value_zero.data());
+    zero.assign(numElements(t), 1);
+    for (size_t k = 0; k < indices.size() && k < view.count; ++k) {
+      if (indices[k] >= 0 && static_cast<size_t>(indices[k]) < zero.size()) {
+        zero[indices[k]] = value_zero[k];
+      }
+    }
+  } else {
+    ElementView view;
+    if (!viewElements(t, &view)) {
+      return stats;
+    }
+    zero.resize(view.count);
+    maskZeros(view, zero.data());
+  }
+  countZeros(zero, t.sizes(), &stats);
+  return stats;
+}
+
+bool SparsifyTensor(Tensor& t, double min_zero_fraction) {
+  ElementView view;
+  if (t.is_sparse() || !viewElements(t, &view) || view.count == 0) {
+    return false;
+  }
+  // Only elements with all bits zero are dropped, so that -0.0 survives.
+  view.value_bits = ~0ull;
+  std::vector<uint8_t> zero(view.count);
+  maskZeros(view, zero.data());
+  const size_t zeros = countSet(zero);
+  const size_t nonzeros = view.count - zeros;
+  if (double(zeros) < min_zero_fraction * double(view.count) ||
+      nonzeros * (sizeof(int64_t) + view.width) >= view.count * view.width) {
+    return false;
+  }
+
+  std::vector<int64_t> indices;
+  indices.reserve(nonzeros);
+  for (size_t i = 0; i < view.count; ++i) {
+    if (!zero[i]) {
+      indices.push_back(static_cast<int64_t>(i));
+    }
+  }
+  Tensor values;
+  values.elem_type() = t.elem_type();
+  values.sizes().push_back(static_cast<int64_t>(nonzeros));
+  switch (view.field) {
+    case Field::Raw: {
+      std::string raw(nonzeros * view.width, '\0');
+      for (size_t k = 0; k < nonzeros; ++k) {
+        std::memcpy(
+            &raw[k * view.width],
+            view.data + indices[k] * view.width,
+            view.width);
+      }
+      values.set_raw_data(std::move(raw));
+      break;
+    }
+    case Field::Floats:
+      gatherValues(t.floats(), indices, values.floats());
+      break;
+    case Field::Doubles:
+      gatherValues(t.doubles(), indices, values.doubles());
+      break;
+    case Field::Int32s:
+      gatherValues(t.int32s(), indices, values.int32s());
+      break;
+    case Field::Int64s:
+      gatherValues(t.int64s(), indices, values.int64s());
+      break;
+    case Field::Uint64s:
+      gatherValues(t.uint64s(), indices, values.uint64s());
+      break;
+  }
+  t.set_sparse_data(std::move(values), std::move(indices));
+  return true;
+}
+
+std::vector<InitializerSparsityReport> AnalyzeInitializerSparsity(Graph& g) {
+  std::vector<InitializerSparsityReport> reports;
+  const auto& names = g.initializer_names();
+  const auto& tensors = g.initializers();
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    if (rawElementSize(tensors[i].elem_type()) != 0) {
+      reports.push_back({names[i], AnalyzeSparsity(tensors[i]), i});
+    }
+  }
+  return reports;
+}
+
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,51 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include "onnx/common/ir.h"
+
+namespace ONNX_NAMESPACE {
+
+// How sparse a tensor is. Blocks tile the last two dimensions, with the
+// leading dimensions folded into the rows (a 1-D tensor is a single row);
+// partial blocks at the edges are not counted. A 1x4 block spans four
+// columns of one row, a 4x4 block four columns of four rows. Zeros of
+// either sign count as zero.
+struct SparsityStats {
+  size_t num_elements = 0;
+  size_t zeros = 0;
+  size_t blocks_1x4 = 0;
+  size_t zero_blocks_1x4 = 0;
+  size_t blocks_4x4 = 0;
+  size_t zero_blocks_4x4 = 0;
+
+  double zero_fraction() const {
+    return num_elements == 0 ? 0. : double(zeros) / double(num_elements);
+  }
+};
+
+// Analyzes a tensor of a floating point, integer or BOOL type; other
+// types (STRING, COMPLEX*) have no elements counted. Sparse tensors are
+// analyzed without being densified.
+SparsityStats AnalyzeSparsity(const Tensor& t);
+
+// Makes a dense tensor sparse (see Tensor::set_sparse_data) if at least
+// `min_zero_fraction` of its elements are zero and the sparse form, with
+// 8-byte indices, is smaller. Returns whether it did. Unlike in the
+// analysis, -0.0 is kept as a value, so densifying restores the tensor
+// bit for bit.
+bool SparsifyTensor(Tensor& t, double min_zero_fraction);
+
+struct InitializerSparsityReport {
+  std::string name;
+  SparsityStats stats;
+  // The position of the initializer in Graph::initializers().
+  size_t index;
+};
+
+// Analyzes each initializer of g of a supported type, in initializer
+// order.
+std::vector<InitializerSparsityReport> AnalyzeInitializerSparsity(Graph& g);
+
+} // namespace ONNX_NAMESPACE
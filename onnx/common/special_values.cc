@@ -0,0 +1,172 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/special_values.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ONNX_NAMESPACE {
+
+namespace {
+
+// IEEE 754 layouts, as masks over the bits of a value.
+template <typename Bits, Bits kSign, Bits kExponent, Bits kMantissa>
+struct FloatFormat {
+  using bits_type = Bits;
+  static constexpr Bits sign = kSign;
+  static constexpr Bits exponent = kExponent;
+  static constexpr Bits mantissa = kMantissa;
+};
+
+using Half = FloatFormat<uint16_t, 0x8000, 0x7C00, 0x03FF>;
+using Single = FloatFormat<uint32_t, 0x80000000u, 0x7F800000u, 0x007FFFFFu>;
+using Double = FloatFormat<
+    uint64_t,
+    0x8000000000000000ull,
+    0x7FF0000000000000ull,
+    0x000FFFFFFFFFFFFFull>;
+
+// The loops below work on the bit patterns with branch-free integer
+// operations, which compilers vectorize. Elements are loaded with memcpy
+// as raw and external data need not be aligned.
+
+template <typename Format, typename Storage>
+void countValues(const Storage* data, size_t n, SpecialValueCounts* counts) {
+  using Bits = typename Format::bits_type;
+  // Counters as wide as the values keep all lanes of a vector busy; blocks
+  // are short enough for 16-bit counters not to overflow.
+  const size_t kBlockSize = 4096;
+  for (size_t begin = 0; begin < n; begin += kBlockSize) {
+    const size_t end = std::min(n, begin + kBlockSize);
+    Bits denormals = 0;
+    Bits nans = 0;
+    Bits infs = 0;
+    for (size_t i = begin; i < end; ++i) {
+      Storage stored;
+      std::memcpy(&stored, data + i, sizeof(Storage));
+      const Bits bits = static_cast<Bits>(stored);
+      const Bits exponent = bits & Format::exponent;
+      const Bits has_mantissa = (bits & Format::mantissa) != 0;
+      denormals += (exponent == 0) & has_mantissa;
+      nans += (exponent == Format::exponent) & has_mantissa;
+      infs += (exponent == Format::exponent) & !has_mantissa;
+    }
+    counts->denormals += denormals;
+    counts->nans += nans;
+    counts->infs += infs;
+  }
+  counts->num_elements += n;
+}
+
+template <typename Format, typename Storage>
+void flushValues(Storage* data, size_t n) {
+  using Bits = typename Format::bits_type;
+  for (size_t i = 0; i < n; ++i) {
+    Storage stored;
+    std::memcpy(&stored, data + i, sizeof(Storage));
+    const Bits bits = static_cast<Bits>(stored);
+    const Bits flushed =
+        (bits & Format::exponent) == 0 ? bits & Format::sign : bits;
+    stored = static_cast<Storage>(flushed);
+    std::memcpy(data + i, &stored, sizeof(Storage));
+  }
+}
+
+} // namespace
+
+SpecialValueCounts CountSpecialValues(const Tensor& t) {
+  SpecialValueCounts counts;
+  const char* raw = t.is_raw_data() ? t.raw_data_ptr() : nullptr;
+  const size_t raw_size = t.is_raw_data() ? t.raw_data_size() : 0;
+  switch (t.elem_type()) {
+    case TensorProto_DataType_FLOAT:
+      if (raw != nullptr) {
+        countValues<Single>(
+            reinterpret_cast<const uint32_t*>(raw), raw_size / 4, &counts);
+      } else {
+        countValues<Single>(
+            reinterpret_cast<const uint32_t*>(t.floats().data()),
+            t.floats().size(),
+            &counts);
+      }
+      break;
+    case TensorProto_DataType_DOUBLE:
+      if (raw != nullptr) {
+        countValues<Double>(
+            reinterpret_cast<const uint64_t*>(raw), raw_size / 8, &counts);
+      } else {
+        countValues<Double>(
+            reinterpret_cast<const uint64_t*>(t.doubles().data()),
+            t.doubles().size(),
+            &counts);
+      }
+      break;
+    case TensorProto_DataType_FLOAT16:
+      // Typed FLOAT16 data is stored one value per int32.
+      if (raw != nullptr) {
+        countValues<Half>(
+            reinterpret_cast<const uint16_t*>(raw), raw_size / 2, &counts);
+      } else {
+        countValues<Half>(t.int32s().data(), t.int32s().size(), &counts);
+      }
+      break;
+    default:
+      break;
+  }
+  return counts;
+}
+
+size_t FlushTensorDenormalsToZero(Tensor& t) {
+  const size_t denormals = CountSpecialValues(t).denormals;
+  if (denormals > 0) {
+    FlushCountedTensorDenormalsToZero(t);
+  }
+  return denormals;
+}
+
+void FlushCountedTensorDenormalsToZero(Tensor& t) {
+  // The mutable data<T>() and mutable_raw_data_ptr() copy lazy and external
+  // data into the Tensor; for raw data data<T>() points to the bytes.
+  switch (t.elem_type()) {
+    case TensorProto_DataType_FLOAT: {
+      auto* data = reinterpret_cast<uint32_t*>(t.data<float>());
+      flushValues<Single>(
+          data, t.is_raw_data() ? t.raw_data_size() / 4 : t.floats().size());
+      break;
+    }
+    case TensorProto_DataType_DOUBLE: {
+      auto* data = reinterpret_cast<uint64_t*>(t.data<double>());
+      flushValues<Double>(
+          data, t.is_raw_data() ? t.raw_data_size() / 8 : t.doubles().size());
+      break;
+    }
+    case TensorProto_DataType_FLOAT16:
+      if (t.is_raw_data()) {
+        auto* data = reinterpret_cast<uint16_t*>(t.mutable_raw_data_ptr());
+        flushValues<Half>(data, t.raw_data_size() / 2);
+      } else {
+        flushValues<Half>(t.int32s().data(), t.int32s().size());
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+std::vector<InitializerValueReport> ScanInitializerValues(Graph& g) {
+  std::vector<InitializerValueReport> reports;
+  const auto& names = g.initializer_names();
+  const auto& tensors = g.initializers();
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    const int32_t type = tensors[i].elem_type();
+    if (type == TensorProto_DataType_FLOAT ||
+        type == TensorProto_DataType_DOUBLE ||
+        type == TensorProto_DataType_FLOAT16) {
+      reports.push_back({names[i], CountSpecialValues(tensors[i])});
+    }
+  }
+  return reports;
+}
+
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,47 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include "onnx/common/ir.h"
+
+namespace ONNX_NAMESPACE {
+
+// Numbers of special values in a floating point tensor. Denormals
+// (subnormals) are slow to compute with on most x86 CPUs unless FTZ/DAZ
+// is enabled.
+struct SpecialValueCounts {
+  size_t num_elements = 0;
+  size_t denormals = 0;
+  size_t nans = 0;
+  size_t infs = 0;
+
+  bool any() const {
+    return denormals + nans + infs > 0;
+  }
+};
+
+// Counts the special values of a FLOAT, DOUBLE or FLOAT16 tensor; other
+// types have no elements counted. Raw, typed and external data are
+// supported.
+SpecialValueCounts CountSpecialValues(const Tensor& t);
+
+// Replaces each denormal of a FLOAT, DOUBLE or FLOAT16 tensor with a zero
+// of the same sign, and returns how many were replaced. The data is only
+// written (and thus materialized) if it has denormals.
+size_t FlushTensorDenormalsToZero(Tensor& t);
+
+// Like FlushTensorDenormalsToZero, but writes the data without counting
+// the denormals first, for callers that already know there are some.
+void FlushCountedTensorDenormalsToZero(Tensor& t);
+
+struct InitializerValueReport {
+  std::string name;
+  SpecialValueCounts counts;
+};
+
+// Counts the special values of each floating point initializer of g,
+// in initializer order.
+std::vector<InitializerValueReport> ScanInitializerValues(Graph& g);
+
+} // namespace ONNX_NAMESPACE
@@ -3,14 +3,34 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <type_traits>
 #include "onnx/common/assertions.h"
 #include "onnx/onnx_pb.h"
 
 namespace ONNX_NAMESPACE {
 
+struct Tensor;
+
+// Fills the data fields of `t` (typed fields or raw data) from `tp`.
+// Defined in ir_pb_converter.cc; used to materialize lazy Tensors.
+void decodeTensorProtoData(const ONNX_NAMESPACE::TensorProto& tp, Tensor* t);
+
+// Fills the data fields of `t` with the dense form of the sparse data
+// `values` at `indices`. Defined in sparsity.cc; used to densify sparse
+// Tensors.
+void densifySparseData(
+    const Tensor& values,
+    const std::vector<int64_t>& indices,
+    Tensor* t);
+
 struct Tensor final {
 private:
   bool is_segment_;
@@ -29,7 +49,152 @@ private:
   std::vector<std::string> string_data_;
 
   bool is_raw_data_;
-  std::string raw_data_;
+  // raw_data_ is mutable so that raw() can copy external bytes into it.
+  mutable std::string raw_data_;
+
+  // Raw bytes that live outside of this Tensor, e.g. in a memory-mapped
+  // file. external_owner_ keeps them alive. They are never written
+  // through: non-const accessors first copy them into raw_data_.
+  std::shared_ptr<const void> external_owner_;
+  const char* external_data_;
+  size_t external_size_;
+
+  // Data of a lazily imported Tensor: the TensorProto it was imported
+  // from, decoded on first access to the data. The metadata (name, sizes,
+  // elem_type, segment) is always set.
+  std::shared_ptr<const ONNX_NAMESPACE::TensorProto> lazy_source_;
+
+  // Data of a sparse Tensor: the row-major indices of the elements it
+  // stores, in ascending order, and a 1-D Tensor of their values. All
+  // other elements are zero. The data fields stay empty until the data is
+  // first accessed, which densifies the Tensor.
+  std::vector<int64_t> sparse_indices_;
+  std::shared_ptr<const Tensor> sparse_values_;
+
+  // An atomic flag that is copied and moved by value along with the Tensor.
+  class DeferredFlag {
+   public:
+    DeferredFlag() : value_(false) {}
+    DeferredFlag(const DeferredFlag& other) noexcept : value_(other.get()) {}
+    DeferredFlag& operator=(const DeferredFlag& other) noexcept {
+      set(other.get());
+      return *this;
+    }
+    bool get() const {
+      return value_.load(std::memory_order_acquire);
+    }
+    void set(bool value) {
+      value_.store(value, std::memory_order_release);
+    }
+
+   private:
+    std::atomic<bool> value_;
+  };
+
+  // Set while the data fields still have to be filled in from lazy_source_
+  // or the sparse data. The const accessors do that, so several threads
+  // may be reading a Tensor while one of them fills it in: they do it
+  // under deferred_data_mutex(), and only clear this flag once the data is
+  // complete. lazy_source_ and the sparse data are only released by
+  // non-const accessors.
+  DeferredFlag has_deferred_data_;
+
+  // One of a fixed set of mutexes, shared by the Tensors hashing to it.
+  // Recursive, since densifying reads the values Tensor.
+  std::recursive_mutex& deferred_data_mutex() const {
+    static std::recursive_mutex mutexes[64];
+    return mutexes[(reinterpret_cast<uintptr_t>(this) >> 6) % 64];
+  }
+
+  // Copying reads the fields const accessors may be filling in.
+  std::unique_lock<std::recursive_mutex> lock_deferred_data() const {
+    if (has_deferred_data_.get() || external_data_ != nullptr) {
+      return std::unique_lock<std::recursive_mutex>(deferred_data_mutex());
+    }
+    return std::unique_lock<std::recursive_mutex>();
+  }
+
+  // Decoding and densifying only fill in data the Tensor logically already
+  // has, so they are done from const accessors too. The data is built in a
+  // separate Tensor so that readers never see it half done.
+  void materialize_lazy_data() const {
+    if (!has_deferred_data_.get()) {
+      return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(deferred_data_mutex());
+    if (!has_deferred_data_.get()) {
+      return;
+    }
+    Tensor data;
+    data.has_name_ = has_name_;
+    data.name_ = name_;
+    data.elem_type_ = elem_type_;
+    data.sizes_ = sizes_;
+    if (lazy_source_) {
+      decodeTensorProtoData(*lazy_source_, &data);
+    } else {
+      densifySparseData(*sparse_values_, sparse_indices_, &data);
+    }
+    Tensor* self = const_cast<Tensor*>(this);
+    self->float_data_ = std::move(data.float_data_);
+    self->double_data_ = std::move(data.double_data_);
+    self->int32_data_ = std::move(data.int32_data_);
+    self->int64_data_ = std::move(data.int64_data_);
+    self->uint64_data_ = std::move(data.uint64_data_);
+    self->string_data_ = std::move(data.string_data_);
+    raw_data_ = std::move(data.raw_data_);
+    self->has_deferred_data_.set(false);
+  }
+
+  // Also releases the source of the data, which only non-const access may
+  // do.
+  void materialize_lazy_data() {
+    static_cast<const Tensor*>(this)->materialize_lazy_data();
+    lazy_source_.reset();
+    reset_sparse_data();
+  }
+
+  void reset_sparse_data() {
+    sparse_indices_.clear();
+    sparse_values_.reset();
+  }
+
+  void materialize_raw_data() {
+    materialize_lazy_data();
+    if (external_data_ != nullptr) {
+      if (raw_data_.size() != external_size_) {
+        raw_data_.assign(external_data_, external_size_);
+      }
+      external_owner_.reset();
+      external_data_ = nullptr;
+      external_size_ = 0;
+    }
+  }
+
+  Tensor(const Tensor& other, std::unique_lock<std::recursive_mutex>)
+  : is_segment_(other.is_segment_)
+  , segment_begin_(other.segment_begin_)
+  , segment_end_(other.segment_end_)
+  , has_name_(other.has_name_)
+  , name_(other.name_)
+  , elem_type_(other.elem_type_)
+  , sizes_(other.sizes_)
+  , float_data_(other.float_data_)
+  , double_data_(other.double_data_)
+  , int32_data_(other.int32_data_)
+  , int64_data_(other.int64_data_)
+  , uint64_data_(other.uint64_data_)
+  , string_data_(other.string_data_)
+  , is_raw_data_(other.is_raw_data_)
+  , raw_data_(other.raw_data_)
+  , external_owner_(other.external_owner_)
+  , external_data_(other.external_data_)
+  , external_size_(other.external_size_)
+  , lazy_source_(other.lazy_source_)
+  , sparse_indices_(other.sparse_indices_)
+  , sparse_values_(other.sparse_values_)
+  , has_deferred_data_(other.has_deferred_data_)
+  {}
 
   template <typename F, typename T>
   void bin_func(const F& f, T* ptr, const T* a_ptr);
@@ -48,8 +213,22 @@ private:
   , has_name_(false)
   , elem_type_(ONNX_NAMESPACE::TensorProto_DataType_UNDEFINED)
   , is_raw_data_(false)
+  , external_data_(nullptr)
+  , external_size_(0)
   {}
 
+  // Reading a Tensor, copying it included, is safe from several threads at
+  // once, even while its data is first materialized.
+  Tensor(const Tensor& other) : Tensor(other, other.lock_deferred_data()) {}
+  Tensor(Tensor&&) = default;
+  Tensor& operator=(const Tensor& other) {
+    if (this != &other) {
+      *this = Tensor(other);
+    }
+    return *this;
+  }
+  Tensor& operator=(Tensor&&) = default;
+
   const std::vector<int64_t>& sizes() const {
     return sizes_;
   }
@@ -74,60 +253,189 @@ private:
   }
 
   std::vector<std::string>& strings() {
+    materialize_lazy_data();
     return string_data_;
   }
 
   const std::vector<std::string>& strings() const {
+    materialize_lazy_data();
     return string_data_;
   }
 
   std::vector<float>& floats() {
+    materialize_lazy_data();
     return float_data_;
   }
 
   const std::vector<float>& floats() const {
+    materialize_lazy_data();
     return float_data_;
   }
 
   std::vector<double>& doubles() {
+    materialize_lazy_data();
     return double_data_;
   }
 
   const std::vector<double>& doubles() const {
+    materialize_lazy_data();
     return double_data_;
   }
 
   std::vector<int32_t>& int32s() {
+    materialize_lazy_data();
     return int32_data_;
   }
 
   const std::vector<int32_t>& int32s() const {
+    materialize_lazy_data();
     return int32_data_;
   }
 
   std::vector<int64_t>& int64s() {
+    materialize_lazy_data();
     return int64_data_;
   }
 
   const std::vector<int64_t>& int64s() const {
+    materialize_lazy_data();
     return int64_data_;
   }
 
   std::vector<uint64_t>& uint64s() {
+    materialize_lazy_data();
     return uint64_data_;
   }
 
   const std::vector<uint64_t>& uint64s() const {
+    materialize_lazy_data();
     return uint64_data_;
   }
 
+  // Prefer raw_data_ptr()/raw_data_size() on hot paths: for external raw
+  // data this copies the bytes into the Tensor on first call.
   const std::string& raw() const {
+    materialize_lazy_data();
+    if (external_data_ != nullptr) {
+      std::lock_guard<std::recursive_mutex> lock(deferred_data_mutex());
+      if (raw_data_.size() != external_size_) {
+        raw_data_.assign(external_data_, external_size_);
+      }
+    }
     return raw_data_;
   }
 
   void set_raw_data(std::string raw_data) {
     is_raw_data_ = true;
     raw_data_ = std::move(raw_data);
+    lazy_source_.reset();
+    reset_sparse_data();
+    has_deferred_data_.set(false);
+    external_owner_.reset();
+    external_data_ = nullptr;
+    external_size_ = 0;
+  }
+
+  // Makes this Tensor's raw data refer to `size` bytes at `data`, which
+  // must stay valid for as long as `owner` is alive. No copy is made until
+  // the data is mutated (through data<T>()) or raw() is called.
+  void set_external_raw_data(
+      std::shared_ptr<const void> owner,
+      const char* data,
+      size_t size) {
+    is_raw_data_ = true;
+    raw_data_.clear();
+    lazy_source_.reset();
+    reset_sparse_data();
+    has_deferred_data_.set(false);
+    external_owner_ = std::move(owner);
+    external_data_ = data;
+    external_size_ = size;
+  }
+
+  bool has_external_raw_data() const {
+    return external_data_ != nullptr;
+  }
+
+  // Makes the data of this Tensor come from `source`, decoded when it is
+  // first accessed. The caller sets the metadata.
+  void set_lazy_source(std::shared_ptr<const ONNX_NAMESPACE::TensorProto> source) {
+    is_raw_data_ = source->has_raw_data();
+    lazy_source_ = std::move(source);
+    reset_sparse_data();
+    has_deferred_data_.set(true);
+  }
+
+  // The TensorProto this Tensor's data has not been decoded from yet, or
+  // null. Also null once the dims or elem_type were changed: the source
+  // then no longer describes the Tensor, so its data may not be passed
+  // through unchanged, and has to be decoded to be exported.
+  const ONNX_NAMESPACE::TensorProto* lazy_source() const {
+    if (!has_deferred_data_.get() || !lazy_source_ ||
+        lazy_source_->data_type() != elem_type_ ||
+        lazy_source_->dims_size() != static_cast<int>(sizes_.size()) ||
+        !std::equal(sizes_.begin(), sizes_.end(), lazy_source_->dims().begin())) {
+      return nullptr;
+    }
+    return lazy_source_.get();
+  }
+
+  // Makes this Tensor sparse: its elements at the row-major `indices`
+  // (ascending) have the values of the 1-D Tensor `values`, of the same
+  // elem_type, and all others are zero. The caller sets the metadata. The
+  // dense data is only built when it is accessed, or by densify(); the
+  // sparse_* accessors below do not densify.
+  void set_sparse_data(Tensor values, std::vector<int64_t> indices) {
+    float_data_.clear();
+    double_data_.clear();
+    int32_data_.clear();
+    int64_data_.clear();
+    uint64_data_.clear();
+    string_data_.clear();
+    raw_data_.clear();
+    lazy_source_.reset();
+    external_owner_.reset();
+    external_data_ = nullptr;
+    external_size_ = 0;
+    is_raw_data_ = values.is_raw_data();
+    sparse_values_ = std::make_shared<const Tensor>(std::move(values));
+    sparse_indices_ = std::move(indices);
+    has_deferred_data_.set(true);
+  }
+
+  bool is_sparse() const {
+    return has_deferred_data_.get() && sparse_values_ != nullptr;
+  }
+
+  const std::vector<int64_t>& sparse_indices() const {
+    ONNX_ASSERT(is_sparse());
+    return sparse_indices_;
+  }
+
+  const Tensor& sparse_values() const {
+    ONNX_ASSERT(is_sparse());
+    return *sparse_values_;
+  }
+
+  void densify() {
+    materialize_lazy_data();
+  }
+
+  const char* raw_data_ptr() const {
+    materialize_lazy_data();
+    return external_data_ != nullptr ? external_data_ : raw_data_.data();
+  }
+
+  // Like raw_data_ptr(), but copies external raw data into the Tensor first
+  // so that the bytes can be written, as the mutable data<T>() does.
+  char* mutable_raw_data_ptr() {
+    materialize_raw_data();
+    return &raw_data_[0];
+  }
+
+  size_t raw_data_size() const {
+    materialize_lazy_data();
+    return external_data_ != nullptr ? external_size_ : raw_data_.size();
   }
 
   template <typename T>
@@ -216,7 +524,9 @@ private:
 #define define_data(type, field)                  \
   template <>                                     \
   inline type* Tensor::data<type>() {             \
+    materialize_lazy_data();                      \
     if (is_raw_data_) {                           \
+      materialize_raw_data();                     \
       return (type*)&raw_data_.data()[0];         \
     } else {                                      \
       return field.data();                        \
@@ -225,8 +535,9 @@ private:
                                                   \
   template <>                                     \
   inline const type* Tensor::data<type>() const { \
+    materialize_lazy_data();                      \
     if (is_raw_data_) {                           \
-      return (type*)(raw_data_.data());           \
+      return (type*)(raw_data_ptr());             \
     } else {                                      \
       return field.data();                        \
     }                                             \
@@ -240,6 +551,11 @@ define_data(uint64_t, uint64_data_);
 define_data(std::string, string_data_);
 #undef define_data
 
+// Vectors of Tensors move rather than copy them when they grow.
+static_assert(
+    std::is_nothrow_move_constructible<Tensor>::value,
+    "Tensor moves must not throw");
+
 template <typename F, typename T>
 inline void Tensor::bin_func(const F& f, T* ptr, const T* a_ptr) {
   const int64_t num_elements = size_from_dim(0);
@@ -0,0 +1,339 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/common/weight_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include "onnx/common/ir_pb_converter.h"
+
+namespace ONNX_NAMESPACE {
+
+namespace {
+
+bool isLittleEndianHost() {
+  const uint16_t one = 1;
+  uint8_t first_byte;
+  std::memcpy(&first_byte, &one, 1);
+  return first_byte == 1;
+}
+
+size_t alignUp(size_t offset) {
+  const size_t a = WeightArena::kAlignment;
+  return (offset + a - 1) / a * a;
+}
+
+// Typed data is stored one value per element of these fields; raw data
+// narrows each value to `width` bytes.
+enum class Field { Floats, Doubles, Int32s, Int64s, Uint64s };
+
+bool rawLayout(int32_t elem_type, Field* field, size_t* width) {
+  switch (elem_type) {
+    case TensorProto_DataType_FLOAT:
+    case TensorProto_DataType_COMPLEX64:
+      *field = Field::Floats;
+      *width = 4;
+      return true;
+    case TensorProto_DataType_DOUBLE:
+    case TensorProto_DataType_COMPLEX128:
+      *field = Field::Doubles;
+      *width = 8;
+      return true;
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_INT8:
+    case TensorProto_DataType_UINT8:
+      *field = Field::Int32s;
+      *width = 1;
+      return true;
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_BFLOAT16:
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_UINT16:
+      *field = Field::Int32s;
+      *width = 2;
+      return true;
+    case TensorProto_DataType_INT32:
+      *field = Field::Int32s;
+      *width = 4;
+      return true;
+    case TensorProto_DataType_INT64:
+      *field = Field::Int64s;
+      *width = 8;
+      return true;
+    case TensorProto_DataType_UINT32:
+      *field = Field::Uint64s;
+      *width = 4;
+      return true;
+    case TensorProto_DataType_UINT64:
+      *field = Field::Uint64s;
+      *width = 8;
+      return true;
+    default:
+      return false;
+  }
+}
+
+size_t fieldSize(const Tensor& t, Field field) {
+  switch (field) {
+    case Field::Floats:
+      return t.floats().size();
+    case Field::Doubles:
+      return t.doubles().size();
+    case Field::Int32s:
+      return t.int32s().size();
+    case Field::Int64s:
+      return t.int64s().size();
+    case Field::Uint64s:
+      return t.uint64s().size();
+  }
+  return 0;
+}
+
+// The size of the raw form of t's data, if it can live in an arena.
+bool payloadSize(const Tensor& t, size_t* size) {
+  Field field;
+  size_t width;
+  if (t.is_sparse() || !rawLayout(t.elem_type(), &field, &width)) {
+    return false;
+  }
+  *size = t.is_raw_data() ? t.raw_data_size() : fieldSize(t, field) * width;
+  return true;
+}
+
+template <typename Narrow, typename Wide>
+void narrowInto(const std::vector<Wide>& values, char* out) {
+  for (size_t i = 0; i < values.size(); ++i) {
+    const Narrow v = static_cast<Narrow>(values[i]);
+    std::memcpy(out + i * sizeof(Narrow), &v, sizeof(Narrow));
+  }
+}
+
+template <typename T>
+void copyInto(const std::vector<T>& values, char* out) {
+  if (!values.empty()) {
+    std::memcpy(out, values.data(), values.size() * sizeof(T));
+  }
+}
+
+// Writes the raw form of t's data, of payloadSize bytes, to out.
+void writePayload(const Tensor& t, char* out) {
+  if (t.is_raw_data()) {
+    if (t.raw_data_size() > 0) {
+      std::memcpy(out, t.raw_data_ptr(), t.raw_data_size());
+    }
+    return;
+  }
+  switch (t.elem_type()) {
+    case TensorProto_DataType_FLOAT:
+    case TensorProto_DataType_COMPLEX64:
+      copyInto(t.floats(), out);
+      break;
+    case TensorProto_DataType_DOUBLE:
+    case TensorProto_DataType_COMPLEX128:
+      copyInto(t.doubles(), out);
+      break;
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_INT8:
+    case TensorProto_DataType_UINT8:
+      narrowInto<uint8_t>(t.int32s(), out);
+      break;
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_BFLOAT16:
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_UINT16:
+      narrowInto<uint16_t>(t.int32s(), out);
+      break;
+    case TensorProto_DataType_INT32:
+      copyInto(t.int32s(), out);
+      break;
+    case TensorProto_DataType_INT64:
+      copyInto(t.int64s(), out);
+      break;
+    case TensorProto_DataType_UINT32:
+      narrowInto<uint32_t>(t.uint64s(), out);
+      break;
+    case TensorProto_DataType_UINT64:
+      copyInto(t.uint64s(), out);
+      break;
+    default:
+      break;
+  }
+}
+
+// A Tensor with t's metadata and no data.
+Tensor metadataOf(const Tensor& t) {
+  Tensor out;
+  if (t.hasName()) {
+    out.setName(t.name());
+  }
+  out.elem_type() = t.elem_type();
+  out.sizes() = t.sizes();
+  if (t.is_segment()) {
+    out.set_segment_begin_and_end(t.segment_begin(), t.segment_end());
+  }
+  return out;
+}
+
+} // namespace
+
+WeightArena::WeightArena(Graph& g)
+    : graph_(g), data_(nullptr), size_(0), capacity_(0), live_size_(0), hole_size_(0) {
+  // Payloads are written in host byte order, which has to be the
+  // little-endian order of raw_data.
+  ONNX_ASSERTM(isLittleEndianHost(), "WeightArena requires a little-endian host");
+  pack();
+}
+
+void WeightArena::allocate(size_t capacity) {
+  block_.reset(new char[capacity + kAlignment], std::default_delete<char[]>());
+  const uintptr_t address = reinterpret_cast<uintptr_t>(block_.get());
+  data_ = block_.get() + (kAlignment - address % kAlignment) % kAlignment;
+  capacity_ = capacity;
+}
+
+void WeightArena::repack(size_t headroom) {
+  const std::vector<Tensor>& tensors = graph_.initializers();
+  const size_t kNone = static_cast<size_t>(-1);
+  std::vector<size_t> offsets(tensors.size(), kNone);
+  std::vector<size_t> sizes(tensors.size(), 0);
+  size_t total = 0;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    if (payloadSize(tensors[i], &sizes[i])) {
+      offsets[i] = alignUp(total);
+      total = offsets[i] + sizes[i];
+    }
+  }
+
+  // The old block stays alive until every Tensor refers to the new one.
+  std::shared_ptr<char> old_block = block_;
+  allocate(headroom > 0 ? alignUp(total) + headroom : total);
+  const std::shared_ptr<const void> owner(block_);
+  entries_.clear();
+  live_size_ = 0;
+  hole_size_ = 0;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    if (offsets[i] == kNone) {
+      continue;
+    }
+    writePayload(tensors[i], data_ + offsets[i]);
+    Tensor t = metadataOf(tensors[i]);
+    t.set_external_raw_data(owner, data_ + offsets[i], sizes[i]);
+    graph_.mutableInitializer(i) = std::move(t);
+    entries_[graph_.initializer_names()[i]] = Entry{offsets[i], sizes[i]};
+    live_size_ += sizes[i];
+  }
+  size_ = total;
+}
+
+void WeightArena::pack() {
+  repack(0);
+}
+
+Value* WeightArena::append(const Tensor& initializer, std::string name) {
+  size_t bytes;
+  if (!payloadSize(initializer, &bytes)) {
+    return graph_.addInitializerAndInput(initializer, std::move(name));
+  }
+  if (alignUp(size_) + bytes > capacity_) {
+    repack(std::max(capacity_, bytes));
+  }
+  const size_t offset = alignUp(size_);
+  writePayload(initializer, data_ + offset);
+  Tensor t = metadataOf(initializer);
+  t.set_external_raw_data(std::shared_ptr<const void>(block_), data_ + offset, bytes);
+  entries_[name] = Entry{offset, bytes};
+  live_size_ += bytes;
+  size_ = offset + bytes;
+  return graph_.addInitializerAndInput(t, std::move(name));
+}
+
+void WeightArena::erase(Value* v) {
+  auto it = entries_.find(v->uniqueName());
+  if (it != entries_.end()) {
+    live_size_ -= it->second.size;
+    hole_size_ += it->second.size;
+    entries_.erase(it);
+  }
+  graph_.eraseInitializerAndInput(v);
+  if (hole_size_ > live_size_) {
+    pack();
+  }
+}
+
+bool WeightArena::holds(const Tensor& t, const Entry& entry) const {
+  return t.has_external_raw_data() && t.raw_data_ptr() == data_ + entry.offset &&
+      t.raw_data_size() == entry.size;
+}
+
+bool WeightArena::find(const std::string& name, Entry* entry) const {
+  auto it = entries_.find(name);
+  if (it == entries_.end()) {
+    return false;
+  }
+  auto tensor = graph_.getInitializer(name);
+  if (tensor == graph_.initializers().end() || !holds(*tensor, it->second)) {
+    return false;
+  }
+  *entry = it->second;
+  return true;
+}
+
+void ExportModelProtoWithExternalData(
+    ModelProto* p_m,
+    const std::shared_ptr<Graph>& g,
+    WeightArena& arena,
+    const std::string& data_path,
+    const std::string& location) {
+  arena.pack();
+  std::ofstream out(data_path, std::ios::binary | std::ios::trunc);
+  out.write(arena.data(), static_cast<std::streamsize>(arena.size()));
+  out.close();
+  if (!out) {
+    fail_convert("Unable to write external data to ", data_path);
+  }
+
+  // While exporting, the initializers held by the arena are swapped for
+  // their metadata, so that their data is not copied into p_m.
+  std::vector<std::pair<size_t, WeightArena::Entry>> external;
+  std::vector<Tensor> held;
+  for (size_t i = 0; i < g->initializers().size(); ++i) {
+    WeightArena::Entry entry;
+    if (arena.find(g->initializer_names()[i], &entry)) {
+      external.emplace_back(i, entry);
+      Tensor metadata = metadataOf(g->initializers()[i]);
+      held.push_back(std::move(g->mutableInitializer(i)));
+      g->mutableInitializer(i) = std::move(metadata);
+    }
+  }
+  auto restore = [&]() {
+    for (size_t k = 0; k < external.size(); ++k) {
+      g->mutableInitializer(external[k].first) = std::move(held[k]);
+    }
+  };
+  try {
+    ExportModelProto(p_m, g);
+  } catch (...) {
+    restore();
+    throw;
+  }
+  restore();
+
+  GraphProto* p_g = p_m->mutable_graph();
+  for (const auto& e : external) {
+    TensorProto* tp = p_g->mutable_initializer(static_cast<int>(e.first));
+    tp->set_data_location(TensorProto::EXTERNAL);
+    auto add_entry = [tp](const std::string& key, const std::string& value) {
+      StringStringEntryProto* kv = tp->add_external_data();
+      kv->set_key(key);
+      kv->set_value(value);
+    };
+    add_entry("location", location);
+    add_entry("offset", ONNX_NAMESPACE::to_string(e.second.offset));
+    add_entry("length", ONNX_NAMESPACE::to_string(e.second.size));
+  }
+}
+
+} // namespace ONNX_NAMESPACE
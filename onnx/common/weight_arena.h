@@ -0,0 +1,100 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "onnx/common/ir.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+
+// One contiguous, 64-byte-aligned block holding the initializer data of a
+// Graph, each payload at a 64-byte-aligned offset.
+//
+// Initializers in the arena have external raw data (see
+// Tensor::set_external_raw_data) pointing into the block, in the
+// little-endian raw_data representation of their type, so SIMD consumers
+// can rely on the alignment. Mutating such a Tensor copies its data out of
+// the arena as usual; the next pack() moves it back in. STRING and sparse
+// initializers keep their own storage, as do the initializers of
+// subgraphs.
+//
+// The arena refers to the Graph, which must outlive it. Initializers
+// erased or replaced other than through the arena leave holes until the
+// next pack(). Requires a little-endian host, which the constructor
+// asserts.
+class WeightArena {
+ public:
+  static const size_t kAlignment = 64;
+
+  struct Entry {
+    size_t offset;
+    size_t size;
+  };
+
+  // Packs the initializers of g into a new arena.
+  explicit WeightArena(Graph& g);
+
+  // Like Graph::addInitializerAndInput, with the data of `initializer`
+  // appended to the arena. The block grows geometrically, repacking into
+  // a new block when it is full.
+  Value* append(const Tensor& initializer, std::string name);
+
+  // Like Graph::eraseInitializerAndInput. The payload is left as a hole,
+  // and the arena is compacted once holes outweigh the live payloads.
+  void erase(Value* v);
+
+  // Moves the data of all initializers of the graph that can live in the
+  // arena into a new block, without holes.
+  void pack();
+
+  const char* data() const {
+    return data_;
+  }
+
+  // The bytes in use, holes included.
+  size_t size() const {
+    return size_;
+  }
+
+  // The bytes of the payloads of initializers still in the arena.
+  size_t live_size() const {
+    return live_size_;
+  }
+
+  // The payload of the initializer `name`, if it is still in the arena.
+  bool find(const std::string& name, Entry* entry) const;
+
+ private:
+  // Whether the Tensor's data is the payload `entry` of the arena.
+  bool holds(const Tensor& t, const Entry& entry) const;
+  void allocate(size_t capacity);
+  // Packs into a block with `headroom` bytes free after the payloads.
+  void repack(size_t headroom);
+
+  Graph& graph_;
+  std::shared_ptr<char> block_;
+  char* data_;
+  size_t size_;
+  size_t capacity_;
+  size_t live_size_;
+  size_t hole_size_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+// Exports g like ExportModelProto, except that the initializers held by
+// `arena` (after packing it) are stored as external data: the arena block
+// is written to `data_path` as is, and each of those TensorProtos gets
+// data_location EXTERNAL with the "location" (`location`, the data file
+// relative to the model), "offset" and "length" keys.
+void ExportModelProtoWithExternalData(
+    ModelProto* p_m,
+    const std::shared_ptr<Graph>& g,
+    WeightArena& arena,
+    const std::string& data_path,
+    const std::string& location);
+
+} // namespace ONNX_NAMESPACE
@@ -8,6 +8,7 @@
 #include "onnx/defs/function.h"
 #include "onnx/defs/schema.h"
 #include "onnx/optimizer/optimize.h"
+#include "onnx/optimizer/optimizer_cache.h"
 #include "onnx/py_utils.h"
 #include "onnx/shape_inference/implementation.h"
 #include "onnx/version_converter/convert.h"
@@ -16,6 +17,45 @@ namespace ONNX_NAMESPACE {
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+// Optimizes a serialized model, going through the optimizer cache if one
+// is configured. The cache is keyed by the input bytes, so hits skip
+// parsing as well.
+static py::bytes OptimizeBytes(
+    const py::bytes& bytes,
+    const std::vector<std::string>& names,
+    const bool fixed_point) {
+  char* buffer = nullptr;
+  Py_ssize_t length;
+  PyBytes_AsStringAndSize(bytes.ptr(), &buffer, &length);
+
+  std::shared_ptr<optimization::OptimizerCache> cache =
+      optimization::GetOptimizerCache();
+  optimization::OptimizerCache::EntryKey key{0, 0};
+  if (cache != nullptr) {
+    key = optimization::OptimizerCache::Key(buffer, length, names, fixed_point);
+    std::string cached;
+    if (cache->lookup(key, &cached)) {
+      return py::bytes(cached);
+    }
+  }
+
+  ModelProto proto{};
+  if (!ParseProtoFromBytes(&proto, buffer, length)) {
+    throw std::runtime_error("Unable to parse the model to optimize.");
+  }
+  PyBytesOutputStream output;
+  if (!optimization::Optimizer(names, fixed_point).optimize(proto, &output)) {
+    throw std::runtime_error("Unable to serialize the optimized model.");
+  }
+  py::bytes result = output.ToPyBytes();
+  // Only results written in full reach the cache.
+  if (cache != nullptr) {
+    cache->insert(
+        key, PyBytes_AS_STRING(result.ptr()), PyBytes_GET_SIZE(result.ptr()));
+  }
+  return result;
+}
+
 PYBIND11_MODULE(onnx_cpp2py_export, onnx_cpp2py_export) {
   onnx_cpp2py_export.doc() = "Python interface to onnx";
 
@@ -242,24 +282,13 @@ PYBIND11_MODULE(onnx_cpp2py_export, onnx_cpp2py_export) {
   optimizer.def(
       "optimize",
       [](const py::bytes& bytes, const std::vector<std::string>& names) {
-        ModelProto proto{};
-        ParseProtoFromPyBytes(&proto, bytes);
-        auto const result = optimization::Optimize(std::move(proto), names);
-        std::string out;
-        result.SerializeToString(&out);
-        return py::bytes(out);
+        return OptimizeBytes(bytes, names, false);
       });
 
   optimizer.def(
       "optimize_fixedpoint",
       [](const py::bytes& bytes, const std::vector<std::string>& names) {
-        ModelProto proto{};
-        ParseProtoFromPyBytes(&proto, bytes);
-        auto const result =
-            optimization::OptimizeFixed(std::move(proto), names);
-        std::string out;
-        result.SerializeToString(&out);
-        return py::bytes(out);
+        return OptimizeBytes(bytes, names, true);
       });
   optimizer.def("get_available_passes", &optimization::GetAvailablePasses);
 
@@ -782,11 +782,9 @@ ONNX_OPERATOR_SET_SCHEMA(
               fail_shape_inference("First input does not have rank 2");
             if (second_input_shape.dim_size() != 2)
               fail_shape_inference("Second input does not have rank 2");
-            updateOutputShape(
-                ctx,
-                0,
-                {first_input_shape.dim(transA ? 1 : 0),
-                 second_input_shape.dim(transB ? 0 : 1)});
+            auto* output_shape = getOutputShape(ctx, 0);
+            *output_shape->add_dim() = first_input_shape.dim(transA ? 1 : 0);
+            *output_shape->add_dim() = second_input_shape.dim(transB ? 0 : 1);
           }
         }));
 
@@ -798,69 +796,71 @@ void matmulShapeInference(
     return;
   }
 
-  const auto shape0 = ctx.getInputType(input1Idx)->tensor_type().shape();
-  const auto shape1 = ctx.getInputType(input2Idx)->tensor_type().shape();
+  const auto& shape0 = getInputShape(ctx, input1Idx);
+  const auto& shape1 = getInputShape(ctx, input2Idx);
 
   if (shape0.dim_size() == 0 || shape1.dim_size() == 0) {
     fail_shape_inference("Input tensors of wrong rank (0).");
   }
 
-  ONNX_NAMESPACE::TensorShapeProto shapeL, shapeR;
+  InlinedShape shapeL, shapeR;
 
   // First promote each shape to at least rank-2. This logic is
   // specific to matmul, not generic broadcasting.
   {
     if (shape0.dim_size() == 1) {
-      shapeL.add_dim()->set_dim_value(1);
-      *shapeL.add_dim() = shape0.dim(0);
+      shapeL.add_dim(DimRef(1));
+      shapeL.add_dim(shape0.dim(0));
     } else {
-      *shapeL.mutable_dim() = shape0.dim();
+      shapeL = InlinedShape(shape0);
     }
     if (shape1.dim_size() == 1) {
-      *shapeR.add_dim() = shape1.dim(0);
-      shapeR.add_dim()->set_dim_value(1);
+      shapeR.add_dim(shape1.dim(0));
+      shapeR.add_dim(DimRef(1));
     } else {
-      *shapeR.mutable_dim() = shape1.dim();
+      shapeR = InlinedShape(shape1);
     }
   }
 
   // Check for compatible matrix multiply dimensions
   {
-    auto dimL = shapeL.dim(shapeL.dim_size() - 1);
-    auto dimR = shapeR.dim(shapeR.dim_size() - 2);
+    const DimRef& dimL = shapeL.dim(shapeL.dim_size() - 1);
+    const DimRef& dimR = shapeR.dim(shapeR.dim_size() - 2);
     if (dimL.has_dim_value() && dimR.has_dim_value() &&
         dimL.dim_value() != dimR.dim_value()) {
       fail_shape_inference("Incompatible dimensions for matrix multiplication");
     }
   }
 
-  ONNX_NAMESPACE::TensorShapeProto resultShape;
+  InlinedShape resultShape;
 
   // Now call out to generic multidimensional broadcasting for
   // the broadcastable prefixes.
   {
-    ONNX_NAMESPACE::TensorShapeProto prefixShapeL, prefixShapeR;
+    InlinedShape prefixShapes[2];
     for (int i = 0; i < shapeL.dim_size() - 2; ++i) {
-      *prefixShapeL.add_dim() = shapeL.dim(i);
+      prefixShapes[0].add_dim(shapeL.dim(i));
     }
     for (int i = 0; i < shapeR.dim_size() - 2; ++i) {
-      *prefixShapeR.add_dim() = shapeR.dim(i);
+      prefixShapes[1].add_dim(shapeR.dim(i));
     }
-    bidirectionalBroadcastShapeInference(
-        prefixShapeL, prefixShapeR, resultShape);
+    multidirectionalBroadcastShapeInference(prefixShapes, 2, resultShape);
   }
 
   // Back to matmul-specific. Add the trailing dimensions back in.
   {
     if (shape0.dim_size() != 1) {
-      *resultShape.add_dim() = shapeL.dim(shapeL.dim_size() - 2);
+      resultShape.add_dim(shapeL.dim(shapeL.dim_size() - 2));
     }
     if (shape1.dim_size() != 1) {
-      *resultShape.add_dim() = shapeR.dim(shapeR.dim_size() - 1);
+      resultShape.add_dim(shapeR.dim(shapeR.dim_size() - 1));
     }
   }
 
-  *ctx.getOutputType(0)->mutable_tensor_type()->mutable_shape() = resultShape;
+  auto* output_shape =
+      ctx.getOutputType(0)->mutable_tensor_type()->mutable_shape();
+  output_shape->clear_dim();
+  resultShape.appendTo(output_shape);
 }
 
 static const char* MatMul_ver9_doc = R"DOC(
@@ -39,7 +39,7 @@ void convPoolShapeInference(
     return;
   }
 
-  auto input_shape = ctx.getInputType(input1Idx)->tensor_type().shape();
+  const auto& input_shape = getInputShape(ctx, input1Idx);
   if (input_shape.dim_size() < 2) {
     fail_shape_inference("Input tensor must have atleast 2 dimensions");
   }
@@ -50,7 +50,7 @@ void convPoolShapeInference(
   // Only MaxPool and Conv support dilation. For
   // simplicity of the code, we just treat the rest of them as having all-1s
   // dilation.
-  std::vector<int64_t> dilations;
+  InlinedInts dilations;
   if (use_dilation && getRepeatedAttribute(ctx, "dilations", dilations)) {
     if (dilations.size() != n_input_dims) {
       fail_shape_inference("Attribute dilations has incorrect size");
@@ -59,7 +59,7 @@ void convPoolShapeInference(
     dilations.assign(n_input_dims, 1);
   }
 
-  std::vector<int64_t> strides;
+  InlinedInts strides;
   if (getRepeatedAttribute(ctx, "strides", strides)) {
     if (strides.size() != n_input_dims) {
       fail_shape_inference("Attribute strides has incorrect size");
@@ -68,7 +68,7 @@ void convPoolShapeInference(
     strides.assign(n_input_dims, 1);
   }
 
-  std::vector<int64_t> kernel_shape;
+  InlinedInts kernel_shape;
   if (getRepeatedAttribute(ctx, "kernel_shape", kernel_shape)) {
     if (kernel_shape.size() != n_input_dims) {
       fail_shape_inference("Attribute kernel_shape has incorrect size");
@@ -76,8 +76,7 @@ void convPoolShapeInference(
   } else if (require_kernel_shape) {
     fail_shape_inference("Attribute kernel_shape must be specified");
   } else {
-    auto second_input_shape =
-        ctx.getInputType(input2Idx)->tensor_type().shape();
+    const auto& second_input_shape = getInputShape(ctx, input2Idx);
     for (int i = 2; i < second_input_shape.dim_size(); ++i) {
       if (!second_input_shape.dim(i).has_dim_value()) {
         return;
@@ -86,14 +85,14 @@ void convPoolShapeInference(
     }
   }
 
-  std::vector<int64_t> effective_kernel_shape = kernel_shape;
+  InlinedInts effective_kernel_shape = kernel_shape;
   for (int i = 0; i < static_cast<int>(kernel_shape.size()); i++) {
     // accounting for dilation, how big is the kernel in this dimension
     effective_kernel_shape[i] = (effective_kernel_shape[i] - 1) * dilations[i] + 1;
   }
 
 
-  std::vector<int64_t> pads;
+  InlinedInts pads;
   if (getRepeatedAttribute(ctx, "pads", pads)) {
     if (pads.size() != n_input_dims * 2) {
       fail_shape_inference("Attribute pads has incorrect size");
@@ -147,6 +146,9 @@ void convPoolShapeInference(
     *output_shape->add_dim() = second_input_shape.dim(0);
   }
 
+  // default is floor mode .i.e. ceil_mode is set to 0
+  auto ceil_mode = getAttribute(ctx, "ceil_mode", 0);
+
   int kernel_shape_size = static_cast<int>(kernel_shape.size());
   for (int i = 0; i < kernel_shape_size; ++i) {
     auto newdim = output_shape->add_dim();
@@ -158,9 +160,6 @@ void convPoolShapeInference(
     effective_input_size += pads[i];
     effective_input_size += pads[i + kernel_shape_size];
 
-    // default is floor mode .i.e. ceil_mode is set to 0
-    auto ceil_mode = getAttribute(ctx, "ceil_mode", 0);
-
     // how many times we can move the kernel from it's initial position, based
     // on the stride
     int64_t strided_kernel_positions;
@@ -492,7 +491,7 @@ void maxUnpoolShapeInference(InferenceContext& ctx) {
   if (!hasInputShape(ctx, 0)) {
     return; // If first input does not have shape, we cannot infer much.
   }
-  auto input_shape = ctx.getInputType(0)->tensor_type().shape();
+  const auto& input_shape = getInputShape(ctx, 0);
   if (input_shape.dim_size() < 2) {
     fail_shape_inference("Input tensor X must have atleast 2 dimensions.");
   }
@@ -500,7 +499,7 @@ void maxUnpoolShapeInference(InferenceContext& ctx) {
   // first dim is the batch axis and the next is the number of channels.
   size_t n_input_dims = static_cast<size_t>(input_shape.dim_size() - 2);
 
-  std::vector<int64_t> pads;
+  InlinedInts pads;
   if (getRepeatedAttribute(ctx, "pads", pads)) {
     if (pads.size() != n_input_dims * 2) {
       fail_shape_inference("Attribute pads has incorrect size.");
@@ -509,7 +508,7 @@ void maxUnpoolShapeInference(InferenceContext& ctx) {
     pads.assign(n_input_dims * 2, 0);
   }
 
-  std::vector<int64_t> strides;
+  InlinedInts strides;
   if (getRepeatedAttribute(ctx, "strides", strides)) {
     if (strides.size() != n_input_dims) {
       fail_shape_inference("Attribute strides has incorrect size.");
@@ -518,7 +517,7 @@ void maxUnpoolShapeInference(InferenceContext& ctx) {
     strides.assign(n_input_dims, 1);
   }
 
-  std::vector<int64_t> kernel_shape;
+  InlinedInts kernel_shape;
   if (getRepeatedAttribute(ctx, "kernel_shape", kernel_shape)) {
     if (kernel_shape.size() != n_input_dims) {
       fail_shape_inference("Attribute kernel_shape has incorrect size.");
@@ -730,8 +729,8 @@ void roiPoolTypeShapeInference(InferenceContext& ctx) {
     return;
   }
 
-  auto input_shape = ctx.getInputType(0)->tensor_type().shape();
-  auto rios_shape = ctx.getInputType(1)->tensor_type().shape();
+  const auto& input_shape = getInputShape(ctx, 0);
+  const auto& rios_shape = getInputShape(ctx, 1);
 
   if (input_shape.dim_size() < 2) {
     fail_shape_inference("Input tensor must have at least 2 dimensions");
@@ -743,7 +742,7 @@ void roiPoolTypeShapeInference(InferenceContext& ctx) {
   // first dim is the batch axis and the next is the number of channels.
   size_t n_input_dims = static_cast<size_t>(input_shape.dim_size() - 2);
 
-  std::vector<int64_t> pooled_shape;
+  InlinedInts pooled_shape;
   if (getRepeatedAttribute(ctx, "pooled_shape", pooled_shape)) {
     if (pooled_shape.size() != n_input_dims) {
       fail_shape_inference("Attribute pooled_shape has incorrect length");
@@ -1211,7 +1210,7 @@ void convTransposeShapeInference(InferenceContext& ctx) {
 
   int64_t group = getAttribute(ctx, "group", 1);
 
-  auto input_shape = ctx.getInputType(0)->tensor_type().shape();
+  const auto& input_shape = getInputShape(ctx, 0);
   if (input_shape.dim_size() < 2) {
     return; // Input tensor should have at least two dimensions.
   }
@@ -1219,7 +1218,7 @@ void convTransposeShapeInference(InferenceContext& ctx) {
   // first dim is the batch axis and the next is the number of channels.
   size_t n_input_dims = static_cast<size_t>(input_shape.dim_size() - 2);
 
-  std::vector<int64_t> dilations;
+  InlinedInts dilations;
   if (getRepeatedAttribute(ctx, "dilations", dilations)) {
     if (dilations.size() != n_input_dims) {
       return;
@@ -1228,7 +1227,7 @@ void convTransposeShapeInference(InferenceContext& ctx) {
     dilations.assign(n_input_dims, 1);
   }
 
-  std::vector<int64_t> strides;
+  InlinedInts strides;
   if (getRepeatedAttribute(ctx, "strides", strides)) {
     if (strides.size() != n_input_dims) {
       return;
@@ -1237,13 +1236,13 @@ void convTransposeShapeInference(InferenceContext& ctx) {
     strides.assign(n_input_dims, 1);
   }
 
-  std::vector<int64_t> kernel_shape;
+  InlinedInts kernel_shape;
   if (getRepeatedAttribute(ctx, "kernel_shape", kernel_shape)) {
     if (kernel_shape.size() != n_input_dims) {
       return;
     }
   } else {
-    auto second_input_shape = ctx.getInputType(1)->tensor_type().shape();
+    const auto& second_input_shape = getInputShape(ctx, 1);
     for (int i = 2; i < second_input_shape.dim_size(); ++i) {
       if (!second_input_shape.dim(i).has_dim_value()) {
         return;
@@ -1252,14 +1251,14 @@ void convTransposeShapeInference(InferenceContext& ctx) {
     }
   }
 
-  std::vector<int64_t> effective_kernel_shape = kernel_shape;
+  InlinedInts effective_kernel_shape = kernel_shape;
   for (int i = 0; i < static_cast<int>(kernel_shape.size()); i++) {
     // accounting for dilation, how big is the kernel in this dimension
     effective_kernel_shape[i] =
         (effective_kernel_shape[i] - 1) * dilations[i] + 1;
   }
 
-  std::vector<int64_t> pads;
+  InlinedInts pads;
   if (getRepeatedAttribute(ctx, "pads", pads)) {
     if (pads.size() != n_input_dims * 2) {
       fail_shape_inference("Attribute pads has incorrect size");
@@ -1299,7 +1298,7 @@ void convTransposeShapeInference(InferenceContext& ctx) {
     }
   }
     
-  std::vector<int64_t> output_shape;
+  InlinedInts output_shape;
   bool output_shape_presented = true;
   if (getRepeatedAttribute(ctx, "output_shape", output_shape)) {
     if (output_shape.size() != n_input_dims) {
@@ -1309,7 +1308,7 @@ void convTransposeShapeInference(InferenceContext& ctx) {
     output_shape_presented = false;
   }
 
-  std::vector<int64_t> output_padding;
+  InlinedInts output_padding;
   if (getRepeatedAttribute(ctx, "output_padding", output_padding)) {
     if (output_padding.size() != n_input_dims) { // Added only to one side.
       return;
@@ -1472,7 +1471,7 @@ void globalPoolTypeShapeInference(InferenceContext& ctx) {
     return;
   }
 
-  auto input_shape = ctx.getInputType(0)->tensor_type().shape();
+  const auto& input_shape = getInputShape(ctx, 0);
   if (input_shape.dim_size() < 2) {
     return;
   }
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
 #include "onnx/defs/data_type_utils.h"
 #include "onnx/proto_utils.h"
 #include "onnx/string_utils.h"
@@ -82,6 +87,169 @@ inline bool getRepeatedAttribute(
   }
 }
 
+// A std::vector-like container that keeps up to N elements inline, so that
+// the per-node temporaries of inference functions (strides, pads,
+// permutations, dimensions) don't allocate for the usual tensor ranks.
+template <typename T, size_t N>
+class InlinedVector {
+ public:
+  InlinedVector() : data_(inline_), size_(0), capacity_(N) {}
+  InlinedVector(const InlinedVector& other) : InlinedVector() {
+    *this = other;
+  }
+  InlinedVector& operator=(const InlinedVector& other) {
+    if (this != &other) {
+      clear();
+      for (const T& x : other) {
+        push_back(x);
+      }
+    }
+    return *this;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  T& operator[](size_t i) {
+    return data_[i];
+  }
+  const T& operator[](size_t i) const {
+    return data_[i];
+  }
+  T& back() {
+    return data_[size_ - 1];
+  }
+  T* begin() {
+    return data_;
+  }
+  T* end() {
+    return data_ + size_;
+  }
+  const T* begin() const {
+    return data_;
+  }
+  const T* end() const {
+    return data_ + size_;
+  }
+
+  void push_back(const T& x) {
+    if (size_ == capacity_) {
+      grow(2 * capacity_);
+    }
+    data_[size_++] = x;
+  }
+  void assign(size_t n, const T& x) {
+    clear();
+    if (n > capacity_) {
+      grow(n);
+    }
+    std::fill(data_, data_ + n, x);
+    size_ = n;
+  }
+  template <
+      typename It,
+      typename = typename std::enable_if<!std::is_integral<It>::value>::type>
+  void assign(It first, It last) {
+    clear();
+    for (; first != last; ++first) {
+      push_back(*first);
+    }
+  }
+  void clear() {
+    size_ = 0;
+  }
+
+ private:
+  void grow(size_t capacity) {
+    std::unique_ptr<T[]> heap(new T[capacity]);
+    std::copy(begin(), end(), heap.get());
+    heap_ = std::move(heap);
+    data_ = heap_.get();
+    capacity_ = capacity;
+  }
+
+  T inline_[N];
+  std::unique_ptr<T[]> heap_;
+  T* data_;
+  size_t size_;
+  size_t capacity_;
+};
+
+// Per-axis integers such as strides, pads or dimension values.
+using InlinedInts = InlinedVector<int64_t, 8>;
+
+// Read-only view of the values of an INTS or FLOATS attribute.
+template <typename T>
+class AttributeValues {
+ public:
+  AttributeValues() : data_(nullptr), size_(0) {}
+  AttributeValues(const google::protobuf::RepeatedField<T>& values)
+      : data_(values.data()), size_(static_cast<size_t>(values.size())) {}
+
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  const T& operator[](size_t i) const {
+    return data_[i];
+  }
+  const T* begin() const {
+    return data_;
+  }
+  const T* end() const {
+    return data_ + size_;
+  }
+
+ private:
+  const T* data_;
+  size_t size_;
+};
+
+// Overloads of getRepeatedAttribute that don't copy the values into a
+// std::vector: the first two point into the AttributeProto, the last copies
+// into inline storage.
+inline bool getRepeatedAttribute(
+    InferenceContext& ctx,
+    const std::string& attr_name,
+    AttributeValues<int64_t>& values) {
+  const auto* attr = ctx.getAttribute(attr_name);
+  if (attr) {
+    values = AttributeValues<int64_t>(attr->ints());
+    return true;
+  }
+  return false;
+}
+
+inline bool getRepeatedAttribute(
+    InferenceContext& ctx,
+    const std::string& attr_name,
+    AttributeValues<float>& values) {
+  const auto* attr = ctx.getAttribute(attr_name);
+  if (attr) {
+    values = AttributeValues<float>(attr->floats());
+    return true;
+  }
+  return false;
+}
+
+template <typename T, size_t N>
+inline bool getRepeatedAttribute(
+    InferenceContext& ctx,
+    const std::string& attr_name,
+    InlinedVector<T, N>& values) {
+  AttributeValues<T> view;
+  if (getRepeatedAttribute(ctx, attr_name, view)) {
+    values.assign(view.begin(), view.end());
+    return true;
+  }
+  return false;
+}
+
 inline int64_t getAttribute(
     InferenceContext& ctx,
     const std::string& attributeName,
@@ -153,6 +321,79 @@ multiplyDims(const TensorShapeProto& shape, int from, int upto_exclusive) {
   return dim;
 }
 
+// A dimension of an InlinedShape: a reference to a Dim of some
+// TensorShapeProto, or a known value. Has the read accessors of Dim.
+class DimRef {
+ public:
+  // An unknown dimension.
+  DimRef() : dim_(&Dim::default_instance()), value_(0) {}
+  DimRef(const Dim& dim) : dim_(&dim), value_(0) {}
+  explicit DimRef(int64_t value) : dim_(nullptr), value_(value) {}
+
+  bool has_dim_value() const {
+    return dim_ == nullptr || dim_->has_dim_value();
+  }
+  int64_t dim_value() const {
+    return dim_ == nullptr ? value_ : dim_->dim_value();
+  }
+  bool has_dim_param() const {
+    return dim_ != nullptr && dim_->has_dim_param();
+  }
+  const std::string& dim_param() const {
+    return (dim_ == nullptr ? Dim::default_instance() : *dim_).dim_param();
+  }
+
+  void copyTo(Dim* dim) const {
+    if (dim_ == nullptr) {
+      dim->set_dim_value(value_);
+    } else {
+      *dim = *dim_;
+    }
+  }
+
+ private:
+  const Dim* dim_;
+  int64_t value_;
+};
+
+// A tensor shape that refers to the dimensions of existing
+// TensorShapeProtos instead of copying them, with inline storage for
+// common ranks. Use it to take apart, reorder or extend input shapes, and
+// write the result to an output with appendTo(). The TensorShapeProtos it
+// was built from must outlive it.
+class InlinedShape {
+ public:
+  InlinedShape() = default;
+  explicit InlinedShape(const TensorShapeProto& shape)
+      : InlinedShape(shape, 0, shape.dim_size()) {}
+  // Dimensions [from, upto_exclusive) of shape.
+  InlinedShape(const TensorShapeProto& shape, int from, int upto_exclusive) {
+    for (int i = from; i < upto_exclusive; ++i) {
+      dims_.push_back(shape.dim(i));
+    }
+  }
+
+  int dim_size() const {
+    return static_cast<int>(dims_.size());
+  }
+  const DimRef& dim(int i) const {
+    return dims_[static_cast<size_t>(i)];
+  }
+  void add_dim(const DimRef& dim) {
+    dims_.push_back(dim);
+  }
+
+  // Appends the dimensions to shape.
+  void appendTo(TensorShapeProto* shape) const {
+    for (const DimRef& dim : dims_) {
+      dim.copyTo(shape->add_dim());
+    }
+  }
+
+ private:
+  InlinedVector<DimRef, 8> dims_;
+};
+
 // propagate the element type from an input type to an output type.
 // if an existing output element type exists, validate it matches.
 inline void propagateElemTypeWithValidation(
@@ -435,28 +676,29 @@ inline void propagateShapeFromAttributeToOutput(
 }
 
 inline void multidirectionalBroadcastShapeInference(
-    const std::vector<const TensorShapeProto*>& shapes,
-    TensorShapeProto& resultShape) {
+    const InlinedShape* shapes,
+    size_t num_shapes,
+    InlinedShape& resultShape) {
   int result_shape_size = 0;
   // Get the result shape size.
-  for (size_t i = 0; i < shapes.size(); ++i) {
-    if (shapes[i]->dim_size() > result_shape_size) {
-      result_shape_size = shapes[i]->dim_size();
+  for (size_t i = 0; i < num_shapes; ++i) {
+    if (shapes[i].dim_size() > result_shape_size) {
+      result_shape_size = shapes[i].dim_size();
     }
   }
 
   for (int i = 0; i < result_shape_size; ++i) {
     int64_t dim_value = 1;
-    TensorShapeProto_Dimension symbolic_dim;
+    const DimRef* symbolic_dim = nullptr;
     int num_symbolic_dims = 0;
-    for (size_t j = 0; j < shapes.size(); ++j) {
-      if (i < result_shape_size - shapes[j]->dim_size()) {
+    for (size_t j = 0; j < num_shapes; ++j) {
+      if (i < result_shape_size - shapes[j].dim_size()) {
         // Shape j will be filled with 1 at dimension i;
         continue;
       }
 
-      auto dim_i_j =
-          shapes[j]->dim(i - result_shape_size + shapes[j]->dim_size());
+      const DimRef& dim_i_j =
+          shapes[j].dim(i - result_shape_size + shapes[j].dim_size());
       if (dim_i_j.has_dim_value()) {
         if (dim_i_j.dim_value() != 1) {
           if (dim_value != dim_i_j.dim_value() && dim_value != 1) {
@@ -467,32 +709,45 @@ inline void multidirectionalBroadcastShapeInference(
         }
       } else {
         if (num_symbolic_dims == 0) {
-          symbolic_dim = dim_i_j;
+          symbolic_dim = &dim_i_j;
           ++num_symbolic_dims;
-        } else if (dim_i_j.dim_param() != symbolic_dim.dim_param()) {
+        } else if (dim_i_j.dim_param() != symbolic_dim->dim_param()) {
           ++num_symbolic_dims;
         }
       }
     }
 
     if (dim_value != 1 || num_symbolic_dims == 0) {
-      resultShape.add_dim()->set_dim_value(dim_value);
+      resultShape.add_dim(DimRef(dim_value));
     } else if (num_symbolic_dims == 1) {
-      *resultShape.add_dim() = symbolic_dim;
+      resultShape.add_dim(*symbolic_dim);
     } else {
-      resultShape.add_dim();
+      resultShape.add_dim(DimRef());
     }
   }
 }
 
+inline void multidirectionalBroadcastShapeInference(
+    const std::vector<const TensorShapeProto*>& shapes,
+    TensorShapeProto& resultShape) {
+  InlinedVector<InlinedShape, 4> inlined_shapes;
+  for (const TensorShapeProto* shape : shapes) {
+    inlined_shapes.push_back(InlinedShape(*shape));
+  }
+  InlinedShape result;
+  multidirectionalBroadcastShapeInference(
+      inlined_shapes.begin(), inlined_shapes.size(), result);
+  result.appendTo(&resultShape);
+}
+
 inline void bidirectionalBroadcastShapeInference(
     const TensorShapeProto& shapeL,
     const TensorShapeProto& shapeR,
     TensorShapeProto& resultShape) {
-  std::vector<const TensorShapeProto*> shapes;
-  shapes.push_back(&shapeL);
-  shapes.push_back(&shapeR);
-  multidirectionalBroadcastShapeInference(shapes, resultShape);
+  const InlinedShape shapes[] = {InlinedShape(shapeL), InlinedShape(shapeR)};
+  InlinedShape result;
+  multidirectionalBroadcastShapeInference(shapes, 2, result);
+  result.appendTo(&resultShape);
 }
 
 /*
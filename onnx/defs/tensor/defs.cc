@@ -116,16 +116,15 @@ ONNX_OPERATOR_SET_SCHEMA(
           }
           // Make targetShape (0 -> same as originalShape, -1 -> inferred).
           // The targetShape vector represents the specified shape for output.
-          std::vector<int64_t> targetShape;
+          InlinedInts targetShape;
           if (targetShapeInitializer->has_raw_data()) {
             const std::string& bytes = targetShapeInitializer->raw_data();
-            targetShape.insert(
-                targetShape.end(),
+            targetShape.assign(
                 reinterpret_cast<const int64_t*>(bytes.c_str()),
                 reinterpret_cast<const int64_t*>(bytes.c_str() + bytes.size()));
           } else {
             const auto& data = targetShapeInitializer->int64_data();
-            targetShape.insert(targetShape.end(), data.begin(), data.end());
+            targetShape.assign(data.begin(), data.end());
           }
 
           // Iterate through targetShape, adding dimensions in the outputShape
@@ -142,7 +141,8 @@ ONNX_OPERATOR_SET_SCHEMA(
               ctx.getOutputType(0)->mutable_tensor_type()->mutable_shape();
           TensorShapeProto::Dimension* negativeOneDim = nullptr;
           const auto& dataInputTensorType = ctx.getInputType(0)->tensor_type();
-          std::vector<bool> unresolvedZeros(targetShape.size(), false);
+          InlinedVector<bool, 8> unresolvedZeros;
+          unresolvedZeros.assign(targetShape.size(), false);
           int64_t outputProduct = 1;
           for (int i = 0; i < static_cast<int>(targetShape.size()); ++i) {
             // Add a new dimension to outputShape
@@ -708,7 +708,7 @@ ONNX_OPERATOR_SET_SCHEMA(
           }
           auto input_type = ctx.getInputType(0);
           const TensorShapeProto& shape = input_type->tensor_type().shape();
-          std::vector<int64_t> perm;
+          InlinedInts perm;
           bool has_perm_attr = getRepeatedAttribute(ctx, "perm", perm);
           if (!has_perm_attr) {
             for (int i = shape.dim_size() - 1; i >= 0; --i)
@@ -734,10 +734,15 @@ ONNX_OPERATOR_SET_SCHEMA(
               }
           }
 
-          propagateElemTypeFromInputToOutput(ctx, 0, 0);
-          for (size_t i = 0; i < perm.size(); ++i) {
-            appendSingleDimCopiedFromInputTypeToOutputType(
-                ctx, 0, 0, static_cast<size_t>(perm[i]));
+          // A perm of another rank, such as an explicit empty one, leaves the
+          // output shape unknown.
+          if (static_cast<int>(perm.size()) != shape.dim_size()) {
+            return;
+          }
+          auto* output_shape = getOutputShape(ctx, 0);
+          for (int64_t fromDimIndex : perm) {
+            *output_shape->add_dim() =
+                shape.dim(static_cast<int>(fromDimIndex));
           }
         }));
 
@@ -908,14 +913,9 @@ ONNX_OPERATOR_SET_SCHEMA(
           }
           int out_rank = q + r - 1;
 
-          if (out_rank == 0) {
-            ctx.getOutputType(0)->mutable_tensor_type()->mutable_shape();
-          }
+          auto* output_shape = getOutputShape(ctx, 0);
           for (int i = 0; i < out_rank; ++i) {
-            *ctx.getOutputType(0)
-                 ->mutable_tensor_type()
-                 ->mutable_shape()
-                 ->add_dim() = (i < axis) ? data_shape.dim(i) : // i < axis < r
+            *output_shape->add_dim() = (i < axis) ? data_shape.dim(i) : // i < axis < r
                 (i >= axis && i < axis + q) ? indices_shape.dim(i - axis)
                                             : // i - axis < q
                     data_shape.dim(i - q + 1); // i < out_rank < q + r - 1
@@ -0,0 +1,243 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/optimizer/batch_optimize.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "onnx/checker.h"
+#include "onnx/common/parallel.h"
+#include "onnx/optimizer/optimize.h"
+#include "onnx/proto_utils.h"
+#include "onnx/shape_inference/implementation.h"
+#include "onnx/version_converter/convert.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+void MemoryBudget::acquire(size_t bytes) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  released_.wait(lock, [this, bytes]() {
+    if (capacity_ == 0 || in_use_ == 0) {
+      return true;
+    }
+    const size_t held = measure_ ? std::max(in_use_, measure_()) : in_use_;
+    return held + bytes <= capacity_;
+  });
+  in_use_ += bytes;
+}
+
+void MemoryBudget::release(size_t bytes) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    in_use_ -= bytes;
+  }
+  released_.notify_all();
+}
+
+size_t MemoryBudget::in_use() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return in_use_;
+}
+
+size_t ResidentMemoryBytes() {
+#ifdef __linux__
+  // The second field is the resident set size in pages.
+  std::ifstream statm("/proc/self/statm");
+  size_t total_pages = 0;
+  size_t resident_pages = 0;
+  if (statm >> total_pages >> resident_pages) {
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  }
+#endif
+  return 0;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+struct Reservation {
+  Reservation(MemoryBudget& budget, size_t bytes)
+      : budget(budget), bytes(bytes) {
+    budget.acquire(bytes);
+  }
+  ~Reservation() {
+    budget.release(bytes);
+  }
+  MemoryBudget& budget;
+  const size_t bytes;
+};
+
+void writeJsonString(std::ostream& out, const std::string& s) {
+  out << '"';
+  for (char c : s) {
+    switch (c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      case '\t':
+        out << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+              << static_cast<int>(c) << std::dec << std::setfill(' ');
+        } else {
+          out << c;
+        }
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+BatchResult RunBatchJob(
+    const BatchJob& job,
+    const BatchOptimizeOptions& options,
+    MemoryBudget& budget) {
+  const Clock::time_point start = Clock::now();
+  BatchResult result;
+  result.input = job.input;
+  result.output = job.output;
+
+  std::ifstream in(job.input, std::ios::binary | std::ios::ate);
+  if (!in) {
+    result.failed_stage = "load";
+    result.error = "cannot open " + job.input;
+    result.total_ms = millisecondsSince(start);
+    return result;
+  }
+  result.input_bytes = static_cast<size_t>(in.tellg());
+  in.seekg(0);
+
+  Reservation reservation(
+      budget,
+      static_cast<size_t>(
+          static_cast<double>(result.input_bytes) * options.memory_factor));
+  result.wait_ms = millisecondsSince(start);
+
+  const char* stage = "load";
+  Clock::time_point stage_start = Clock::now();
+  auto finish_stage = [&](const char* next) {
+    result.stage_ms.emplace_back(stage, millisecondsSince(stage_start));
+    stage = next;
+    stage_start = Clock::now();
+  };
+  try {
+    ModelProto model;
+    {
+      std::string bytes(result.input_bytes, '\0');
+      if (!in.read(&bytes[0], static_cast<std::streamsize>(bytes.size())) ||
+          !ParseProtoFromBytes(&model, bytes.data(), bytes.size())) {
+        throw std::runtime_error("cannot parse " + job.input);
+      }
+    }
+    in.close();
+    if (options.check) {
+      finish_stage("check");
+      checker::check_model(model);
+    }
+    if (options.infer_shapes) {
+      finish_stage("infer_shapes");
+      shape_inference::InferShapes(model);
+    }
+    if (!options.passes.empty()) {
+      finish_stage("optimize");
+      model = options.fixed_point ? OptimizeFixed(model, options.passes)
+                                  : Optimize(model, options.passes);
+    }
+    if (options.target_opset > 0) {
+      finish_stage("convert");
+      model = version_conversion::ConvertVersion(model, options.target_opset);
+    }
+    finish_stage("save");
+    std::ofstream out(job.output, std::ios::binary | std::ios::trunc);
+    // Closing flushes the last buffered bytes, which can fail too.
+    const bool written = model.SerializeToOstream(&out);
+    out.close();
+    if (!written || !out) {
+      throw std::runtime_error("cannot write " + job.output);
+    }
+    result.output_bytes = model.ByteSizeLong();
+    finish_stage(nullptr);
+    result.ok = true;
+  } catch (const std::exception& e) {
+    finish_stage(nullptr);
+    result.failed_stage = result.stage_ms.back().first;
+    result.error = e.what();
+  }
+  result.total_ms = millisecondsSince(start);
+  return result;
+}
+
+std::vector<BatchResult> RunBatch(
+    const std::vector<BatchJob>& jobs,
+    const BatchOptimizeOptions& options) {
+  const size_t baseline = ResidentMemoryBytes();
+  MemoryBudget budget(options.memory_budget, [baseline]() {
+    const size_t resident = ResidentMemoryBytes();
+    return resident > baseline ? resident - baseline : 0;
+  });
+  std::vector<BatchResult> results(jobs.size());
+  parallel_for(jobs.size(), options.num_threads, [&](size_t i) {
+    results[i] = RunBatchJob(jobs[i], options, budget);
+  });
+  return results;
+}
+
+void WriteBatchResultsJson(
+    std::ostream& out,
+    const std::vector<BatchResult>& results) {
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3) << "[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BatchResult& r = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "  {\"input\": ";
+    writeJsonString(out, r.input);
+    out << ", \"output\": ";
+    writeJsonString(out, r.output);
+    out << ", \"status\": " << (r.ok ? "\"ok\"" : "\"failed\"");
+    if (!r.ok) {
+      out << ", \"failed_stage\": ";
+      writeJsonString(out, r.failed_stage);
+      out << ", \"error\": ";
+      writeJsonString(out, r.error);
+    }
+    out << ", \"input_bytes\": " << r.input_bytes
+        << ", \"output_bytes\": " << r.output_bytes
+        << ", \"wait_ms\": " << r.wait_ms << ", \"stage_ms\": {";
+    for (size_t s = 0; s < r.stage_ms.size(); ++s) {
+      out << (s == 0 ? "" : ", ");
+      writeJsonString(out, r.stage_ms[s].first);
+      out << ": " << r.stage_ms[s].second;
+    }
+    out << "}, \"total_ms\": " << r.total_ms << "}";
+  }
+  out << (results.empty() ? "]\n" : "\n]\n");
+  out.flags(flags);
+  out.precision(precision);
+}
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
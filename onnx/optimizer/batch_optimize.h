@@ -0,0 +1,116 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+struct BatchOptimizeOptions {
+  // Optimizer passes to run; none means the model is not optimized.
+  std::vector<std::string> passes;
+  bool fixed_point = false;
+  bool check = true;
+  bool infer_shapes = true;
+  // Opset version to convert the models to after optimizing; 0 means no
+  // conversion.
+  int target_opset = 0;
+  // Models processed at once, 0 meaning one per hardware thread.
+  size_t num_threads = 0;
+  // Bound on the memory taken by the models in flight, in bytes; 0 means
+  // no bound. A model is estimated to take memory_factor times its file
+  // size while it is processed (the bytes read, the ModelProto, the IR
+  // and the result), and is admitted once both the estimates of the
+  // models in flight and the growth of the process's resident memory
+  // since the batch started leave room for its estimate. Resident memory
+  // is sampled when models are admitted and when they finish, where the
+  // platform reports it (Linux); memory the allocator keeps after a model
+  // finishes counts until it is reused or returned.
+  size_t memory_budget = 0;
+  double memory_factor = 4;
+};
+
+struct BatchJob {
+  std::string input;
+  std::string output;
+};
+
+struct BatchResult {
+  std::string input;
+  std::string output;
+  bool ok = false;
+  // If !ok, the stage that failed ("load", "check", "infer_shapes",
+  // "optimize", "convert" or "save") and why.
+  std::string failed_stage;
+  std::string error;
+  size_t input_bytes = 0;
+  size_t output_bytes = 0;
+  // Milliseconds spent waiting for memory to be admitted.
+  double wait_ms = 0;
+  // Milliseconds spent in each stage that ran, in order.
+  std::vector<std::pair<std::string, double>> stage_ms;
+  double total_ms = 0;
+};
+
+// Admission control for work of known memory cost: acquire() blocks until
+// the memory held, plus the request, fits in the capacity. The memory held
+// is the sum of the requests admitted or, if larger, what `measure`
+// reports, which acquire() samples when it is called and after each
+// release(). A request larger than the capacity is admitted once nothing
+// else holds memory, so it runs alone instead of never.
+class MemoryBudget {
+ public:
+  // capacity 0 means no bound.
+  explicit MemoryBudget(
+      size_t capacity,
+      std::function<size_t()> measure = std::function<size_t()>())
+      : capacity_(capacity), in_use_(0), measure_(std::move(measure)) {}
+
+  void acquire(size_t bytes);
+  void release(size_t bytes);
+
+  size_t in_use() const;
+
+ private:
+  const size_t capacity_;
+  size_t in_use_;
+  const std::function<size_t()> measure_;
+  mutable std::mutex mutex_;
+  std::condition_variable released_;
+};
+
+// The resident memory of the process in bytes, or 0 where it can't be
+// read.
+size_t ResidentMemoryBytes();
+
+// Loads job.input, runs the stages `options` asks for and saves the
+// result to job.output, holding its memory estimate from `budget`. Errors
+// are reported in the result rather than thrown.
+BatchResult RunBatchJob(
+    const BatchJob& job,
+    const BatchOptimizeOptions& options,
+    MemoryBudget& budget);
+
+// Runs the jobs on options.num_threads threads under one MemoryBudget of
+// options.memory_budget bytes, which measures the growth of
+// ResidentMemoryBytes() since the call. Results are in the order of the
+// jobs.
+std::vector<BatchResult> RunBatch(
+    const std::vector<BatchJob>& jobs,
+    const BatchOptimizeOptions& options);
+
+// Writes the results as a JSON array with one object per model.
+void WriteBatchResultsJson(
+    std::ostream& out,
+    const std::vector<BatchResult>& results);
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
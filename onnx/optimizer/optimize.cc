@@ -2,6 +2,7 @@
 // Adventurous users should note that the APIs will probably change.
 
 #include "onnx/optimizer/optimize.h"
+#include "onnx/optimizer/optimizer_cache.h"
 
 namespace ONNX_NAMESPACE {
 namespace optimization {
@@ -23,19 +24,54 @@ Optimizer::Optimizer(
     this->pass_manager->add(pass);
   }
 }
+Optimizer::Optimizer(
+    const std::vector<std::string>& names,
+    std::shared_ptr<PassManager> pass_manager)
+    : pass_manager(std::move(pass_manager)) {
+  for (const auto& name : names) {
+    this->pass_manager->add(passes.find(name));
+  }
+}
 Optimizer::~Optimizer() {}
 
+// Runs the optimizer, unless the configured OptimizerCache already has
+// the result.
+static ModelProto OptimizeCached(
+    const ModelProto& mp_in,
+    const std::vector<std::string>& names,
+    const bool fixed_point) {
+  std::shared_ptr<OptimizerCache> cache = GetOptimizerCache();
+  if (cache == nullptr) {
+    Optimizer current_opt(names, fixed_point);
+    return current_opt.optimize(mp_in);
+  }
+
+  const OptimizerCache::EntryKey key =
+      OptimizerCache::Key(mp_in, names, fixed_point);
+  std::string cached;
+  ModelProto mp_out;
+  if (cache->lookup(key, &cached) &&
+      ParseProtoFromBytes(&mp_out, cached.data(), cached.size())) {
+    return mp_out;
+  }
+  Optimizer current_opt(names, fixed_point);
+  mp_out = current_opt.optimize(mp_in);
+  std::string bytes;
+  if (mp_out.SerializeToString(&bytes)) {
+    cache->insert(key, bytes);
+  }
+  return mp_out;
+}
+
 ModelProto Optimize(
     const ModelProto& mp_in,
     const std::vector<std::string>& names) {
-  Optimizer current_opt(names, false);
-  return current_opt.optimize(mp_in);
+  return OptimizeCached(mp_in, names, false);
 }
 ModelProto OptimizeFixed(
     const ModelProto& mp_in,
     const std::vector<std::string>& names) {
-  Optimizer current_opt(names, true);
-  return current_opt.optimize(mp_in);
+  return OptimizeCached(mp_in, names, true);
 }
 const std::vector<std::string> GetAvailablePasses() {
   return Optimizer::passes.GetAvailablePasses();
@@ -20,26 +20,56 @@ struct Optimizer {
 
  public:
   Optimizer(const std::vector<std::string>& names, const bool fixed_point);
+  // Runs the passes with the given manager, e.g. a RewritePassManager.
+  Optimizer(
+      const std::vector<std::string>& names,
+      std::shared_ptr<PassManager> pass_manager);
   ~Optimizer();
 
   ModelProto optimize(const ModelProto& mp_in) {
-    std::shared_ptr<Graph> g(ImportModelProto(mp_in));
-
+    std::shared_ptr<Graph> g = run(mp_in);
     if (g.get() == nullptr) {
-      std::cerr << "Warning: onnx optimizer is unable to parse input model. "
-                << "(The IR version of the ONNX model may be too old.)"
-                << std::endl;
       // If we can't parse the file, just return the input.
       return mp_in;
     }
 
     ModelProto mp_out = PrepareOutput(mp_in);
-    this->pass_manager->run(*g);
     ExportModelProto(&mp_out, g);
     return mp_out;
   }
 
+  // Like optimize(), but writes the serialized result to `output` without
+  // building the output ModelProto. Returns false if writing failed.
+  bool optimize(
+      const ModelProto& mp_in,
+      google::protobuf::io::ZeroCopyOutputStream* output) {
+    std::shared_ptr<Graph> g = run(mp_in);
+    if (g.get() == nullptr) {
+      return mp_in.SerializeToZeroCopyStream(output);
+    }
+    return ExportModelProto(output, mp_in, g);
+  }
+
  private:
+  // Imports mp_in and runs the passes on it. Returns null if the model
+  // can't be imported. mp_in must outlive the returned Graph.
+  std::shared_ptr<Graph> run(const ModelProto& mp_in) {
+    // Most passes never look at most initializers, so they are decoded on
+    // demand. The caller keeps mp_in alive, so the handle doesn't own it.
+    std::shared_ptr<Graph> g(ImportModelProtoLazy(
+        std::shared_ptr<const ModelProto>(&mp_in, [](const ModelProto*) {})));
+
+    if (g.get() == nullptr) {
+      std::cerr << "Warning: onnx optimizer is unable to parse input model. "
+                << "(The IR version of the ONNX model may be too old.)"
+                << std::endl;
+      return nullptr;
+    }
+
+    this->pass_manager->run(*g);
+    return g;
+  }
+
   std::shared_ptr<PassManager> pass_manager;
 };
 
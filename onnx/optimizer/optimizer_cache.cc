@@ -0,0 +1,421 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/optimizer/optimizer_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include "onnx/common/graph_hash.h"
+
+#ifndef ONNX_VERSION_STRING
+#define ONNX_VERSION_STRING "unknown"
+#endif
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+namespace {
+
+using EntryKey = OptimizerCache::EntryKey;
+
+// An entry is the magic, the key's digest, the size of the model and the
+// model.
+const char kEntryMagic[8] = {'O', 'N', 'N', 'X', 'O', 'P', 'T', '2'};
+const size_t kEntryHeaderSize = sizeof(kEntryMagic) + 2 * sizeof(uint64_t);
+const uint64_t kDefaultMaxBytes = uint64_t(1) << 30;
+// The seed of EntryKey::digest, which makes it independent of the hash.
+const uint64_t kDigestSeed = 0x9e3779b97f4a7c15ULL;
+
+// Serialized models are hashed in blocks of this size, each block's hash
+// seeding the next one's, so that a model can be hashed while it is being
+// serialized without buffering all of it.
+enum { kHashBlockSize = 64 << 10 };
+
+EntryKey hashBlock(const char* data, size_t size, const EntryKey& h) {
+  return EntryKey{HashBytes(data, size, h.hash),
+                  HashBytes(data, size, h.digest)};
+}
+
+EntryKey hashSerialized(const void* data, size_t size) {
+  const char* p = static_cast<const char*>(data);
+  EntryKey h{0, kDigestSeed};
+  do {
+    const size_t n = std::min(size, static_cast<size_t>(kHashBlockSize));
+    h = hashBlock(p, n, h);
+    p += n;
+    size -= n;
+  } while (size > 0);
+  return h;
+}
+
+// A ZeroCopyOutputStream that computes hashSerialized() of its output.
+class HashingOutputStream final
+    : public google::protobuf::io::ZeroCopyOutputStream {
+ public:
+  bool Next(void** data, int* size) override {
+    if (used_ == kHashBlockSize) {
+      hash_ = hashBlock(buffer_, used_, hash_);
+      used_ = 0;
+    }
+    *data = buffer_ + used_;
+    *size = kHashBlockSize - used_;
+    byte_count_ += *size;
+    used_ = kHashBlockSize;
+    return true;
+  }
+
+  void BackUp(int count) override {
+    used_ -= count;
+    byte_count_ -= count;
+  }
+
+  int64_t ByteCount() const override {
+    return byte_count_;
+  }
+
+  EntryKey Finish() {
+    // Empty output still hashes one (empty) block.
+    if (used_ > 0 || byte_count_ == 0) {
+      hash_ = hashBlock(buffer_, used_, hash_);
+      used_ = 0;
+    }
+    return hash_;
+  }
+
+ private:
+  char buffer_[kHashBlockSize];
+  int used_ = 0;
+  int64_t byte_count_ = 0;
+  EntryKey hash_{0, kDigestSeed};
+};
+
+uint64_t hashString(const std::string& s, uint64_t seed) {
+  // Hash the length too, so that {"ab", "c"} and {"a", "bc"} differ.
+  const uint64_t size = s.size();
+  return HashBytes(s.data(), s.size(), HashBytes(&size, sizeof(size), seed));
+}
+
+uint64_t combineKey(
+    uint64_t model_hash,
+    const std::vector<std::string>& names,
+    bool fixed_point) {
+  uint64_t h = hashString(ONNX_VERSION_STRING, model_hash);
+  const int64_t ir_version = IR_VERSION;
+  h = HashBytes(&ir_version, sizeof(ir_version), h);
+  const uint8_t fixed = fixed_point ? 1 : 0;
+  h = HashBytes(&fixed, sizeof(fixed), h);
+  for (const auto& name : names) {
+    h = hashString(name, h);
+  }
+  return h;
+}
+
+EntryKey combineKey(
+    const EntryKey& model_hash,
+    const std::vector<std::string>& names,
+    bool fixed_point) {
+  return EntryKey{combineKey(model_hash.hash, names, fixed_point),
+                  combineKey(model_hash.digest, names, fixed_point)};
+}
+
+std::string keyToString(uint64_t key) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016" PRIx64, key);
+  return buf;
+}
+
+int currentProcessId() {
+#ifdef _WIN32
+  return _getpid();
+#else
+  return getpid();
+#endif
+}
+
+void makeDirectory(const std::string& path) {
+#ifdef _WIN32
+  _mkdir(path.c_str());
+#else
+  mkdir(path.c_str(), 0755);
+#endif
+}
+
+// Writes `size` bytes, preceded by `header_size` bytes of header, to a
+// temporary file next to `path` and renames it over `path`.
+bool writeFileAtomically(
+    const std::string& path,
+    const void* header,
+    size_t header_size,
+    const void* data,
+    size_t size) {
+  static std::atomic<uint64_t> counter(0);
+  const std::string tmp_path = path + ".tmp" +
+      std::to_string(currentProcessId()) + "-" + std::to_string(counter++);
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(static_cast<const char*>(header), header_size);
+    out.write(static_cast<const char*>(data), size);
+    out.close();
+    if (!out) {
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+#ifdef _WIN32
+    // rename() doesn't replace existing files on Windows.
+    std::remove(path.c_str());
+    if (std::rename(tmp_path.c_str(), path.c_str()) == 0) {
+      return true;
+    }
+#endif
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+OptimizerCache::OptimizerCache(std::string directory, uint64_t max_bytes)
+    : directory_(std::move(directory)), max_bytes_(max_bytes) {
+  makeDirectory(directory_);
+}
+
+OptimizerCache::~OptimizerCache() {
+  if (!uses_.empty()) {
+    std::vector<Entry> entries = readIndex();
+    applyUses(&entries);
+    writeIndex(entries);
+  }
+}
+
+EntryKey OptimizerCache::Key(
+    const ModelProto& mp_in,
+    const std::vector<std::string>& names,
+    bool fixed_point) {
+  HashingOutputStream output;
+  mp_in.SerializeToZeroCopyStream(&output);
+  return combineKey(output.Finish(), names, fixed_point);
+}
+
+EntryKey OptimizerCache::Key(
+    const void* serialized_model,
+    size_t size,
+    const std::vector<std::string>& names,
+    bool fixed_point) {
+  return combineKey(
+      hashSerialized(serialized_model, size), names, fixed_point);
+}
+
+std::string OptimizerCache::entryPath(uint64_t key) const {
+  return directory_ + "/" + keyToString(key) + ".onnx";
+}
+
+// The index has one line per entry: key, size in bytes and a use counter
+// that grows with every use written to it.
+std::vector<OptimizerCache::Entry> OptimizerCache::readIndex() const {
+  std::vector<Entry> entries;
+  std::ifstream in(directory_ + "/index");
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    Entry entry;
+    fields >> std::hex >> entry.key >> std::dec >> entry.size >>
+        entry.last_use;
+    if (fields) {
+      entries.push_back(entry);
+    }
+  }
+  return entries;
+}
+
+void OptimizerCache::writeIndex(const std::vector<Entry>& entries) const {
+  std::string contents;
+  for (const auto& entry : entries) {
+    contents += keyToString(entry.key) + " " + std::to_string(entry.size) +
+        " " + std::to_string(entry.last_use) + "\n";
+  }
+  writeFileAtomically(
+      directory_ + "/index", nullptr, 0, contents.data(), contents.size());
+}
+
+uint64_t OptimizerCache::nextUse(const std::vector<Entry>& entries) {
+  uint64_t last = 0;
+  for (const auto& entry : entries) {
+    last = std::max(last, entry.last_use);
+  }
+  return last + 1;
+}
+
+void OptimizerCache::applyUses(std::vector<Entry>* entries) {
+  std::vector<Entry> uses;
+  uses.reserve(uses_.size());
+  for (const auto& use : uses_) {
+    uses.push_back(use.second);
+  }
+  std::sort(uses.begin(), uses.end(), [](const Entry& a, const Entry& b) {
+    return a.last_use < b.last_use;
+  });
+  uint64_t next = nextUse(*entries);
+  std::unordered_map<uint64_t, size_t> positions;
+  for (size_t i = 0; i < entries->size(); ++i) {
+    positions.emplace((*entries)[i].key, i);
+  }
+  for (const Entry& use : uses) {
+    auto it = positions.find(use.key);
+    if (it != positions.end()) {
+      (*entries)[it->second].last_use = next++;
+    } else {
+      // Written by a process whose index update was lost.
+      entries->push_back(Entry{use.key, use.size, next++});
+    }
+  }
+  uses_.clear();
+}
+
+bool OptimizerCache::lookup(
+    const EntryKey& key,
+    std::string* serialized_model) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::string path = entryPath(key.hash);
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  char header[kEntryHeaderSize];
+  uint64_t digest = 0;
+  uint64_t size = 0;
+  if (!in.read(header, kEntryHeaderSize) ||
+      std::memcmp(header, kEntryMagic, sizeof(kEntryMagic)) != 0) {
+    return false;
+  }
+  std::memcpy(&digest, header + sizeof(kEntryMagic), sizeof(digest));
+  std::memcpy(
+      &size, header + sizeof(kEntryMagic) + sizeof(digest), sizeof(size));
+  if (digest != key.digest || size > max_bytes_) {
+    return false;
+  }
+  serialized_model->resize(size);
+  if (!in.read(&(*serialized_model)[0], size) || in.peek() != EOF) {
+    serialized_model->clear();
+    return false;
+  }
+  uses_[key.hash] = Entry{key.hash, kEntryHeaderSize + size, ++num_uses_};
+  return true;
+}
+
+void OptimizerCache::insert(
+    const EntryKey& key,
+    const void* serialized_model,
+    size_t size) {
+  const uint64_t entry_size = kEntryHeaderSize + size;
+  if (entry_size > max_bytes_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  char header[kEntryHeaderSize];
+  const uint64_t size64 = size;
+  std::memcpy(header, kEntryMagic, sizeof(kEntryMagic));
+  std::memcpy(header + sizeof(kEntryMagic), &key.digest, sizeof(key.digest));
+  std::memcpy(
+      header + sizeof(kEntryMagic) + sizeof(key.digest),
+      &size64,
+      sizeof(size64));
+  if (!writeFileAtomically(
+          entryPath(key.hash),
+          header,
+          kEntryHeaderSize,
+          serialized_model,
+          size)) {
+    return;
+  }
+
+  std::vector<Entry> entries = readIndex();
+  uses_.erase(key.hash);
+  applyUses(&entries);
+  const uint64_t use = nextUse(entries);
+  entries.erase(
+      std::remove_if(
+          entries.begin(),
+          entries.end(),
+          [&key](const Entry& entry) { return entry.key == key.hash; }),
+      entries.end());
+  entries.push_back(Entry{key.hash, entry_size, use});
+
+  // Evict least recently used entries until the rest fit.
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    return a.last_use > b.last_use;
+  });
+  uint64_t total = 0;
+  size_t keep = 0;
+  while (keep < entries.size() && total + entries[keep].size <= max_bytes_) {
+    total += entries[keep].size;
+    ++keep;
+  }
+  for (size_t i = keep; i < entries.size(); ++i) {
+    std::remove(entryPath(entries[i].key).c_str());
+  }
+  entries.resize(keep);
+  writeIndex(entries);
+}
+
+void OptimizerCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uses_.clear();
+  for (const auto& entry : readIndex()) {
+    std::remove(entryPath(entry.key).c_str());
+  }
+  std::remove((directory_ + "/index").c_str());
+}
+
+namespace {
+
+std::mutex global_cache_mutex;
+bool global_cache_initialized = false;
+std::shared_ptr<OptimizerCache> global_cache;
+
+} // namespace
+
+std::shared_ptr<OptimizerCache> GetOptimizerCache() {
+  std::lock_guard<std::mutex> lock(global_cache_mutex);
+  if (!global_cache_initialized) {
+    global_cache_initialized = true;
+    const char* dir = std::getenv("ONNX_OPTIMIZER_CACHE_DIR");
+    if (dir != nullptr && dir[0] != '\0') {
+      uint64_t max_bytes = kDefaultMaxBytes;
+      const char* size = std::getenv("ONNX_OPTIMIZER_CACHE_SIZE");
+      if (size != nullptr && size[0] != '\0') {
+        max_bytes = std::strtoull(size, nullptr, 10);
+      }
+      global_cache = std::make_shared<OptimizerCache>(dir, max_bytes);
+    }
+  }
+  return global_cache;
+}
+
+void SetOptimizerCache(std::shared_ptr<OptimizerCache> cache) {
+  std::lock_guard<std::mutex> lock(global_cache_mutex);
+  global_cache_initialized = true;
+  global_cache = std::move(cache);
+}
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
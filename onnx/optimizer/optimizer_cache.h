@@ -0,0 +1,118 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// Persistent cache of optimizer results, so that optimizing an unchanged
+// model with the same passes again only reads a file.
+//
+// Entries are serialized output models stored in `directory`, one file per
+// key. A key covers the serialized input model, the pass list, the
+// fixed-point flag and the ONNX version the library was built as, so a
+// library upgrade never reuses old results; when changing the passes
+// themselves without bumping the version, clear() the cache.
+//
+// The `index` file in the directory records each entry's size and when it
+// was last used; once the entries exceed `max_bytes`, the least recently
+// used ones are evicted. Uses by lookup() are kept in memory and written
+// to the index by the next insert() or by the destructor. Entries and the
+// index are written to a temporary file and renamed into place, so readers
+// never see partial files. Accesses through one OptimizerCache are
+// serialized; several processes may share a directory, at worst losing
+// each other's index updates.
+class OptimizerCache {
+ public:
+  // `hash` names the entry's file. `digest`, an independent hash of the
+  // same inputs, is stored in the entry and compared by lookup(), so that
+  // colliding hashes don't return the result for another model.
+  struct EntryKey {
+    uint64_t hash;
+    uint64_t digest;
+  };
+
+  // Creates `directory` if it doesn't exist.
+  OptimizerCache(std::string directory, uint64_t max_bytes);
+  // Writes the uses recorded since the last insert() to the index.
+  ~OptimizerCache();
+
+  static EntryKey Key(
+      const ModelProto& mp_in,
+      const std::vector<std::string>& names,
+      bool fixed_point);
+  // Same as above for an already serialized input model; equal bytes give
+  // equal keys.
+  static EntryKey Key(
+      const void* serialized_model,
+      size_t size,
+      const std::vector<std::string>& names,
+      bool fixed_point);
+
+  // Reads the entry for `key` into `serialized_model` and marks it as
+  // recently used. Returns false if there is no such entry.
+  bool lookup(const EntryKey& key, std::string* serialized_model);
+
+  // Stores an entry for `key`, evicting least recently used entries as
+  // needed. Entries larger than max_bytes() are not stored. Failing to
+  // write is not an error: the cache just stays cold.
+  void insert(const EntryKey& key, const void* serialized_model, size_t size);
+  void insert(const EntryKey& key, const std::string& serialized_model) {
+    insert(key, serialized_model.data(), serialized_model.size());
+  }
+
+  // Removes all entries.
+  void clear();
+
+  const std::string& directory() const {
+    return directory_;
+  }
+  uint64_t max_bytes() const {
+    return max_bytes_;
+  }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    uint64_t size;
+    uint64_t last_use;
+  };
+
+  std::vector<Entry> readIndex() const;
+  void writeIndex(const std::vector<Entry>& entries) const;
+  std::string entryPath(uint64_t key) const;
+  static uint64_t nextUse(const std::vector<Entry>& entries);
+  // Marks the entries used by lookup() since the last call as recently
+  // used, in the order of their last use.
+  void applyUses(std::vector<Entry>* entries);
+
+  const std::string directory_;
+  const uint64_t max_bytes_;
+  std::mutex mutex_;
+  // The entries found by lookup() that aren't written to the index yet,
+  // by key; last_use orders them.
+  std::unordered_map<uint64_t, Entry> uses_;
+  uint64_t num_uses_ = 0;
+};
+
+// The cache consulted by Optimize() and OptimizeFixed(), or null if
+// caching is off. It is off unless enabled with SetOptimizerCache() or by
+// setting the ONNX_OPTIMIZER_CACHE_DIR environment variable, in which case
+// ONNX_OPTIMIZER_CACHE_SIZE may give its size in bytes (1GB by default).
+std::shared_ptr<OptimizerCache> GetOptimizerCache();
+
+// Replaces the cache used by Optimize() and OptimizeFixed(); null turns
+// caching off.
+void SetOptimizerCache(std::shared_ptr<OptimizerCache> cache);
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
@@ -1,4 +1,5 @@
 #include "onnx/optimizer/pass.h"
+#include <algorithm>
 #include "onnx/common/assertions.h"
 
 namespace ONNX_NAMESPACE {
@@ -52,6 +53,10 @@ void Pass::DescendOnGraphAttributesUnconstrained(
 PredicateBasedPass::~PredicateBasedPass() {}
 
 unsigned int PredicateBasedPass::_runPassInternal(Graph& graph) {
+  const std::vector<NodeKind> anchor_kinds = this->getAnchorKinds();
+  if (!anchor_kinds.empty()) {
+    return _runPassOnAnchors(graph, anchor_kinds);
+  }
   unsigned int num_changes = false;
   for (auto it = graph.begin(); it != graph.end(); ++it) {
     auto* n = *it;
@@ -73,6 +78,91 @@ unsigned int PredicateBasedPass::_runPassInternal(Graph& graph) {
   return num_changes;
 }
 
+AnchoredNodeWalk::AnchoredNodeWalk(Graph& graph, std::vector<NodeKind> kinds)
+    : graph_(graph), kinds_(std::move(kinds)), cur_(nullptr) {
+  seek(*graph.begin());
+}
+
+void AnchoredNodeWalk::seek(Node* n) {
+  std::vector<NodeKind> kinds = kinds_;
+  kinds.insert(
+      kinds.end(),
+      graph_.kindsWithSubgraphs().begin(),
+      graph_.kindsWithSubgraphs().end());
+  std::sort(kinds.begin(), kinds.end());
+  kinds.erase(std::unique(kinds.begin(), kinds.end()), kinds.end());
+  size_t num_candidates = 0;
+  for (NodeKind kind : kinds) {
+    num_candidates += graph_.nodesOfKind(kind).size();
+  }
+  // Finding a node through the per-kind lists costs about four times as
+  // much as walking past one in the node list.
+  walk_list_ = num_candidates * 4 >= graph_.numNodes();
+  cur_ = n;
+  cursors_.clear();
+  if (walk_list_ || n == graph_.return_node()) {
+    return;
+  }
+  for (NodeKind kind : kinds) {
+    const NodeMap& nodes = graph_.nodesOfKind(kind);
+    cursors_.emplace_back(nodes.lower_bound(n->position()), nodes.end());
+  }
+}
+
+Node* AnchoredNodeWalk::next() {
+  if (walk_list_) {
+    const auto& subgraph_kinds = graph_.kindsWithSubgraphs();
+    for (Node* n = cur_; n != graph_.return_node(); n = *(++n->iterator())) {
+      if (std::find(kinds_.begin(), kinds_.end(), n->kind()) != kinds_.end() ||
+          subgraph_kinds.count(n->kind())) {
+        cur_ = *(++n->iterator());
+        return n;
+      }
+    }
+    cur_ = graph_.return_node();
+    return nullptr;
+  }
+  auto next = cursors_.end();
+  for (auto c = cursors_.begin(); c != cursors_.end(); ++c) {
+    if (c->first != c->second &&
+        (next == cursors_.end() || c->first->first < next->first->first)) {
+      next = c;
+    }
+  }
+  if (next == cursors_.end()) {
+    return nullptr;
+  }
+  return (next->first++)->second;
+}
+
+// Visits the same nodes, in the same order, as the walk over every node in
+// _runPassInternal, except those patternMatchPredicate would reject anyway.
+unsigned int PredicateBasedPass::_runPassOnAnchors(
+    Graph& graph,
+    const std::vector<NodeKind>& anchor_kinds) {
+  unsigned int num_changes = 0;
+  AnchoredNodeWalk walk(graph, anchor_kinds);
+  while (Node* n = walk.next()) {
+    num_changes += this->DescendOnGraphAttributesAndCount(
+        n, [this](Graph& g) { return _runPassInternal(g); });
+    if (!this->patternMatchPredicate(n)) {
+      continue;
+    }
+    NodeDestroyType destroy_type = NodeDestroyType::DestroyZero;
+    num_changes += this->runTransform(n, graph, destroy_type);
+    auto it = n->iterator();
+    if (destroy_type == NodeDestroyType::DestroyOne) {
+      it.destroyCurrent();
+    }
+    if (destroy_type == NodeDestroyType::DestroyTwo) {
+      it.destroyCurrent();
+      it.destroyCurrent();
+    }
+    walk.seek(*(++it));
+  }
+  return num_changes;
+}
+
 PassAnalysisType PredicateBasedPass::getPassAnalysisType() const {
   return PassAnalysisType::CountBased;
 }
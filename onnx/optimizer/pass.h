@@ -165,6 +165,34 @@ struct CountBasedPassAnalysis : PostPassAnalysis {
   }
 };
 
+// Walks the nodes of a graph that are of the given kinds, or that hold
+// subgraphs, in topological order. When those are a small share of the
+// graph, only they are visited, by merging the lists of Graph::nodesOfKind;
+// otherwise the node list is walked. Changing the graph may invalidate the
+// walk, so after a change it must be made to continue with seek().
+class AnchoredNodeWalk {
+ public:
+  AnchoredNodeWalk(Graph& graph, std::vector<NodeKind> kinds);
+
+  // Returns the next node, or nullptr at the end.
+  Node* next();
+  // Continues the walk from n, which is visited next if it is of the kinds.
+  // n may be the return node, to end the walk.
+  void seek(Node* n);
+
+ private:
+  using NodeMap = std::map<uint64_t, Node*>;
+
+  Graph& graph_;
+  std::vector<NodeKind> kinds_;
+  bool walk_list_;
+  // The next node of the node list, when walking it.
+  Node* cur_;
+  // Otherwise the remaining nodes of each kind.
+  std::vector<std::pair<NodeMap::const_iterator, NodeMap::const_iterator>>
+      cursors_;
+};
+
 // A pass that is based on pattern matching. The majority of passes will
 // implement this pass. In order for the pass to work the patternMatchPredicate
 // function must be implemented witch matches a subgraph to the respective
@@ -180,6 +208,13 @@ class PredicateBasedPass : public Pass {
       : Pass(pass_type, pass_efficiency, pass_optimization_type) {}
   ~PredicateBasedPass() override;
 
+  // The kinds of the nodes patternMatchPredicate may accept. If not empty,
+  // the pass only visits nodes of these kinds, and nodes holding subgraphs
+  // to descend into them, with an AnchoredNodeWalk, still in topological
+  // order. By default every node is visited.
+  virtual std::vector<NodeKind> getAnchorKinds() const {
+    return {};
+  }
   virtual bool patternMatchPredicate(Node* node) = 0;
   // Run transform is given the current node in the iterator, a reference to the
   // current graph as well as a reference describing how to treat the current
@@ -195,6 +230,9 @@ class PredicateBasedPass : public Pass {
 
  private:
   unsigned int _runPassInternal(Graph& graph);
+  unsigned int _runPassOnAnchors(
+      Graph& graph,
+      const std::vector<NodeKind>& anchor_kinds);
 };
 
 // The most general pass which allows the user to run a pass given only a graph.
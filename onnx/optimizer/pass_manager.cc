@@ -1,5 +1,7 @@
 #include "onnx/optimizer/pass_manager.h"
 
+#include <algorithm>
+
 namespace ONNX_NAMESPACE {
 namespace optimization {
 
@@ -43,5 +45,137 @@ std::shared_ptr<PassManagerAnalysis> FixedPointPassManager::run(Graph& graph) {
 
   return std::shared_ptr<PassManagerAnalysis>(new EmptyPassManagerAnalysis());
 }
+std::shared_ptr<PassManagerAnalysis> RewritePassManager::run(Graph& graph) {
+  std::vector<PredicateBasedPass*> sequence;
+  auto run_sequence = [&]() {
+    if (sequence.empty()) {
+      return;
+    }
+    DispatchTable table;
+    for (PredicateBasedPass* pass : sequence) {
+      pass->initializePass(graph);
+      for (NodeKind kind : pass->getAnchorKinds()) {
+        auto& passes = table[kind];
+        if (std::find(passes.begin(), passes.end(), pass) == passes.end()) {
+          passes.push_back(pass);
+        }
+      }
+    }
+    runSequence(graph, table);
+    for (PredicateBasedPass* pass : sequence) {
+      pass->finalizePass(graph);
+    }
+    sequence.clear();
+  };
+  for (const std::shared_ptr<Pass>& pass : this->passes) {
+    auto* predicate_pass = dynamic_cast<PredicateBasedPass*>(pass.get());
+    if (predicate_pass != nullptr &&
+        !predicate_pass->getAnchorKinds().empty()) {
+      sequence.push_back(predicate_pass);
+      continue;
+    }
+    run_sequence();
+    pass->runPass(graph);
+  }
+  run_sequence();
+  return std::shared_ptr<PassManagerAnalysis>(new EmptyPassManagerAnalysis());
+}
+
+unsigned int RewritePassManager::runSequence(
+    Graph& graph,
+    const DispatchTable& table) {
+  std::vector<NodeKind> kinds;
+  for (const auto& entry : table) {
+    kinds.push_back(entry.first);
+  }
+  unsigned int num_changes = 0;
+  AnchoredNodeWalk walk(graph, kinds);
+  while (Node* n = walk.next()) {
+    for (auto name : n->attributeNames()) {
+      auto kind = n->kindOf(name);
+      if (kind == AttributeKind::g) {
+        num_changes += runSequence(*n->g(name), table);
+      }
+      if (kind == AttributeKind::gs) {
+        for (auto& g : n->gs(name)) {
+          num_changes += runSequence(*g, table);
+        }
+      }
+    }
+
+    bool transformed = false;
+    NodeDestroyType destroy_type = NodeDestroyType::DestroyZero;
+    auto entry = table.find(n->kind());
+    if (entry != table.end()) {
+      for (PredicateBasedPass* pass : entry->second) {
+        if (!pass->patternMatchPredicate(n)) {
+          continue;
+        }
+        destroy_type = NodeDestroyType::DestroyZero;
+        const bool changed = pass->runTransform(n, graph, destroy_type);
+        num_changes += changed;
+        if (changed || destroy_type != NodeDestroyType::DestroyZero) {
+          transformed = true;
+          break;
+        }
+      }
+    }
+    if (!transformed) {
+      continue;
+    }
+
+    // The node DestroyTwo removes along with n.
+    Node* destroyed = nullptr;
+    if (destroy_type == NodeDestroyType::DestroyTwo) {
+      destroyed = *(++n->reverseIterator());
+    }
+    const bool keeps_n = destroy_type == NodeDestroyType::DestroyZero;
+    Node* resume = keeps_n ? n : nullptr;
+    auto requeue = [&](Node* m) {
+      if (m == n || m == destroyed || m->kind() == kParam ||
+          m->kind() == kReturn) {
+        return;
+      }
+      if (m->isBefore(resume == nullptr ? n : resume)) {
+        resume = m;
+      }
+    };
+    // Predicates look at a node's inputs, their producers and how many uses
+    // they have, so a transform can only create a match at n, after it, or
+    // at the one user left of an input of n or of a node it removes.
+    auto requeue_last_users = [&](Node* m) {
+      for (Value* input : m->inputs()) {
+        Node* last_user = nullptr;
+        size_t num_users = 0;
+        for (const Use& use : input->uses()) {
+          if (use.user == destroyed || (use.user == n && !keeps_n)) {
+            continue;
+          }
+          last_user = use.user;
+          ++num_users;
+        }
+        if (num_users == 1) {
+          requeue(last_user);
+        }
+      }
+    };
+    requeue_last_users(n);
+    if (destroyed != nullptr) {
+      requeue_last_users(destroyed);
+    }
+
+    auto it = n->iterator();
+    if (destroy_type == NodeDestroyType::DestroyOne) {
+      it.destroyCurrent();
+    }
+    if (destroy_type == NodeDestroyType::DestroyTwo) {
+      it.destroyCurrent();
+      it.destroyCurrent();
+    }
+    walk.seek(resume != nullptr ? resume : *(++it));
+  }
+  return num_changes;
+}
+
 } // namespace optimization
 } // namespace ONNX_NAMESPACE
@@ -2,6 +2,7 @@
 // ATTENTION: The code in this file is highly EXPERIMENTAL.
 // Adventurous users should note that the APIs will probably change.
 
+#include <unordered_map>
 #include <vector>
 #include "onnx/optimizer/pass.h"
 #include "onnx/optimizer/passes/eliminate_deadend.h"
@@ -47,5 +48,28 @@ class FixedPointPassManager : public GeneralPassManager {
   std::shared_ptr<PassManagerAnalysis> run(Graph& graph) override;
 };
 
+// Runs each maximal sequence of consecutive PredicateBasedPasses with
+// anchor kinds as a single walk over the graph, dispatching every node to
+// the passes anchored on its kind. The passes are tried in the order they
+// were added, which is their priority: the first one whose predicate
+// matches transforms the node. After a transform the walk resumes from the
+// node, or from the last user of one of its inputs if that comes first, so
+// patterns the transform creates are matched too and each sequence runs
+// to a fixed point.
+//
+// Other passes, such as split_init and split_predict, run on their own
+// between the sequences, so passes added last still run last.
+class RewritePassManager : public GeneralPassManager {
+ public:
+  std::shared_ptr<PassManagerAnalysis> run(Graph& graph) override;
+
+ private:
+  // Anchor kind -> passes anchored on it, in priority order.
+  using DispatchTable =
+      std::unordered_map<NodeKind, std::vector<PredicateBasedPass*>>;
+
+  static unsigned int runSequence(Graph& graph, const DispatchTable& table);
+};
+
 } // namespace optimization
 } // namespace ONNX_NAMESPACE
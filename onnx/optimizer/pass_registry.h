@@ -6,7 +6,9 @@
 #include "onnx/common/ir.h"
 #include "onnx/common/ir_pb_converter.h"
 #include "onnx/common/stl_backports.h"
+#include "onnx/optimizer/passes/compact_tree_ensembles.h"
 #include "onnx/optimizer/passes/eliminate_deadend.h"
+#include "onnx/optimizer/passes/eliminate_duplicate_initializer.h"
 #include "onnx/optimizer/passes/eliminate_identity.h"
 #include "onnx/optimizer/passes/eliminate_nop_dropout.h"
 #include "onnx/optimizer/passes/eliminate_nop_monotone_argmax.h"
@@ -14,6 +16,7 @@
 #include "onnx/optimizer/passes/eliminate_nop_transpose.h"
 #include "onnx/optimizer/passes/eliminate_unused_initializer.h"
 #include "onnx/optimizer/passes/extract_constant_to_initializer.h"
+#include "onnx/optimizer/passes/flush_denormals_to_zero.h"
 #include "onnx/optimizer/passes/fuse_add_bias_into_conv.h"
 #include "onnx/optimizer/passes/fuse_bn_into_conv.h"
 #include "onnx/optimizer/passes/fuse_consecutive_concats.h"
@@ -42,7 +45,9 @@ struct GlobalPassRegistry {
   GlobalPassRegistry() {
     // Register the optimization passes to the optimizer.
     registerPass<NopEmptyPass>();
+    registerPass<CompactTreeEnsembles>();
     registerPass<EliminateDeadEnd>();
+    registerPass<EliminateDuplicateInitializer>();
     registerPass<EliminateNopDropout>();
     registerPass<EliminateIdentity>();
     registerPass<EliminateNopMonotoneArgmax>();
@@ -50,6 +55,7 @@ struct GlobalPassRegistry {
     registerPass<EliminateNopTranspose>();
     registerPass<EliminateUnusedInitializer>();
     registerPass<ExtractConstantToInitializer>();
+    registerPass<FlushDenormalsToZero>();
     registerPass<FuseAddBiasIntoConv>();
     registerPass<FuseBNIntoConv>();
     registerPass<FuseConsecutiveConcats>();
@@ -0,0 +1,492 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+// Before:
+//   TreeEnsembleRegressor or TreeEnsembleClassifier (ai.onnx.ml) whose
+//   trees hold nodes their root does not reach, identical leaves or
+//   subtrees, or nodes in arbitrary order
+// After:
+//   each tree holds the nodes its root reaches, listed breadth-first with
+//   node ids renumbered in that order, and identical subtrees of a tree
+//   are stored once and shared by the branches leading to them. A branch
+//   whose two sides are identical is replaced by them.
+//
+// The root of a tree is its first node, as in the runtimes. Weights of
+// the removed leaves are dropped. Ensembles whose parallel attributes are
+// inconsistent (different lengths, unknown modes, dangling or cyclic
+// child ids, weights of missing or non-leaf nodes) are left unchanged;
+// checking them takes linear time. nodes_modes stays a list of strings, as
+// the operator schemas require.
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "onnx/common/constants.h"
+#include "onnx/optimizer/pass.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// How much CompactTreeEnsembles shrank the ensembles it rewrote.
+struct TreeEnsembleCompactionAnalysis : CountBasedPassAnalysis {
+  TreeEnsembleCompactionAnalysis(
+      Pass* pass,
+      unsigned int num_compacted,
+      size_t nodes_before,
+      size_t nodes_after,
+      size_t weights_before,
+      size_t weights_after)
+      : CountBasedPassAnalysis(pass, num_compacted, false, false),
+        nodes_before(nodes_before),
+        nodes_after(nodes_after),
+        weights_before(weights_before),
+        weights_after(weights_after) {}
+
+  size_t nodes_before;
+  size_t nodes_after;
+  size_t weights_before;
+  size_t weights_after;
+};
+
+struct CompactTreeEnsembles final : public FullGraphBasedPass {
+  explicit CompactTreeEnsembles()
+      : FullGraphBasedPass(
+            PassType::Other,
+            PassEfficiency::Complete,
+            PassOptimizationType::ComputeMemory) {}
+
+  std::string getPassName() const override {
+    return "compact_tree_ensembles";
+  }
+
+  PassAnalysisType getPassAnalysisType() const override {
+    return PassAnalysisType::CountBased;
+  }
+
+  std::shared_ptr<PostPassAnalysis> runPass(Graph& graph) override {
+    Totals totals;
+    compact_graph(graph, &totals);
+    return std::make_shared<TreeEnsembleCompactionAnalysis>(
+        this,
+        totals.num_compacted,
+        totals.nodes_before,
+        totals.nodes_after,
+        totals.weights_before,
+        totals.weights_after);
+  }
+
+ private:
+  enum class Mode : uint8_t {
+    BranchLeq,
+    BranchLt,
+    BranchGte,
+    BranchGt,
+    BranchEq,
+    BranchNeq,
+    Leaf
+  };
+
+  struct Totals {
+    unsigned int num_compacted = 0;
+    size_t nodes_before = 0;
+    size_t nodes_after = 0;
+    size_t weights_before = 0;
+    size_t weights_after = 0;
+  };
+
+  // The parallel attributes of an ensemble. The weights are the target_*
+  // attributes of a regressor and the class_* ones of a classifier.
+  // hitrates and missing_tracks may be empty.
+  struct Ensemble {
+    std::vector<int64_t> tree_ids;
+    std::vector<int64_t> node_ids;
+    std::vector<int64_t> feature_ids;
+    std::vector<double> values;
+    std::vector<double> hitrates;
+    std::vector<Mode> modes;
+    std::vector<int64_t> true_ids;
+    std::vector<int64_t> false_ids;
+    std::vector<int64_t> missing_tracks;
+    std::vector<int64_t> weight_tree_ids;
+    std::vector<int64_t> weight_node_ids;
+    std::vector<int64_t> weight_ids;
+    std::vector<double> weights;
+  };
+
+  struct TreeNodeId {
+    int64_t tree;
+    int64_t node;
+    bool operator==(const TreeNodeId& other) const {
+      return tree == other.tree && node == other.node;
+    }
+  };
+
+  struct TreeNodeIdHash {
+    size_t operator()(const TreeNodeId& id) const {
+      return std::hash<int64_t>()(id.tree) * 31 + std::hash<int64_t>()(id.node);
+    }
+  };
+
+  static const char* mode_name(Mode mode) {
+    static const char* const kNames[] = {"BRANCH_LEQ",
+                                         "BRANCH_LT",
+                                         "BRANCH_GTE",
+                                         "BRANCH_GT",
+                                         "BRANCH_EQ",
+                                         "BRANCH_NEQ",
+                                         "LEAF"};
+    return kNames[static_cast<int>(mode)];
+  }
+
+  static bool parse_mode(const std::string& name, Mode* mode) {
+    for (int m = 0; m <= static_cast<int>(Mode::Leaf); ++m) {
+      if (name == mode_name(static_cast<Mode>(m))) {
+        *mode = static_cast<Mode>(m);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static const size_t kAnySize = static_cast<size_t>(-1);
+
+  // Reads an ints attribute of `size` values, or none if it is optional
+  // and absent.
+  static bool read_ints(
+      Node* n,
+      const std::string& name,
+      bool required,
+      size_t size,
+      std::vector<int64_t>* out) {
+    const Symbol sym(name);
+    if (!n->hasAttribute(sym)) {
+      return !required;
+    }
+    if (n->kindOf(sym) != AttributeKind::is) {
+      return false;
+    }
+    *out = n->is(sym);
+    return size == kAnySize || out->size() == size;
+  }
+
+  static bool read_floats(
+      Node* n,
+      const std::string& name,
+      bool required,
+      size_t size,
+      std::vector<double>* out) {
+    const Symbol sym(name);
+    if (!n->hasAttribute(sym)) {
+      return !required;
+    }
+    if (n->kindOf(sym) != AttributeKind::fs) {
+      return false;
+    }
+    *out = n->fs(sym);
+    return size == kAnySize || out->size() == size;
+  }
+
+  static bool read_ensemble(Node* n, const std::string& prefix, Ensemble* e) {
+    if (!read_ints(n, "nodes_treeids", true, kAnySize, &e->tree_ids)) {
+      return false;
+    }
+    const size_t num_nodes = e->tree_ids.size();
+    const Symbol modes_sym("nodes_modes");
+    if (!n->hasAttribute(modes_sym) ||
+        n->kindOf(modes_sym) != AttributeKind::ss ||
+        n->ss(modes_sym).size() != num_nodes) {
+      return false;
+    }
+    e->modes.resize(num_nodes);
+    for (size_t i = 0; i < num_nodes; ++i) {
+      if (!parse_mode(n->ss(modes_sym)[i], &e->modes[i])) {
+        return false;
+      }
+    }
+    if (!read_ints(n, "nodes_nodeids", true, num_nodes, &e->node_ids) ||
+        !read_ints(n, "nodes_featureids", true, num_nodes, &e->feature_ids) ||
+        !read_floats(n, "nodes_values", true, num_nodes, &e->values) ||
+        !read_ints(n, "nodes_truenodeids", true, num_nodes, &e->true_ids) ||
+        !read_ints(n, "nodes_falsenodeids", true, num_nodes, &e->false_ids) ||
+        !read_floats(n, "nodes_hitrates", false, num_nodes, &e->hitrates) ||
+        !read_ints(
+            n,
+            "nodes_missing_value_tracks_true",
+            false,
+            num_nodes,
+            &e->missing_tracks) ||
+        !read_ints(
+            n, prefix + "treeids", true, kAnySize, &e->weight_tree_ids)) {
+      return false;
+    }
+    const size_t num_weights = e->weight_tree_ids.size();
+    return read_ints(
+               n, prefix + "nodeids", true, num_weights, &e->weight_node_ids) &&
+        read_ints(n, prefix + "ids", true, num_weights, &e->weight_ids) &&
+        read_floats(n, prefix + "weights", true, num_weights, &e->weights);
+  }
+
+  static void append_bytes(std::string* key, const void* data, size_t size) {
+    key->append(static_cast<const char*>(data), size);
+  }
+
+  // Rewrites `e` into its compacted form. Returns false, leaving `e` in an
+  // unspecified state, if it is inconsistent.
+  static bool compact_ensemble(Ensemble* e) {
+    const size_t num_nodes = e->tree_ids.size();
+    const size_t num_weights = e->weight_tree_ids.size();
+    const size_t kNone = static_cast<size_t>(-1);
+
+    std::unordered_map<TreeNodeId, size_t, TreeNodeIdHash> index;
+    index.reserve(num_nodes);
+    std::vector<size_t> roots;
+    std::unordered_map<int64_t, size_t> tree_index;
+    for (size_t i = 0; i < num_nodes; ++i) {
+      if (!index.emplace(TreeNodeId{e->tree_ids[i], e->node_ids[i]}, i)
+               .second) {
+        return false;
+      }
+      if (tree_index.emplace(e->tree_ids[i], roots.size()).second) {
+        roots.push_back(i);
+      }
+    }
+
+    // Children as node indices; kNone for leaves.
+    std::vector<size_t> true_child(num_nodes, kNone);
+    std::vector<size_t> false_child(num_nodes, kNone);
+    for (size_t i = 0; i < num_nodes; ++i) {
+      if (e->modes[i] == Mode::Leaf) {
+        continue;
+      }
+      auto t = index.find(TreeNodeId{e->tree_ids[i], e->true_ids[i]});
+      auto f = index.find(TreeNodeId{e->tree_ids[i], e->false_ids[i]});
+      if (t == index.end() || f == index.end()) {
+        return false;
+      }
+      true_child[i] = t->second;
+      false_child[i] = f->second;
+    }
+
+    // The weights of each leaf, as a CSR list of weight indices.
+    std::vector<size_t> weight_begin(num_nodes + 1, 0);
+    std::vector<size_t> weight_node(num_weights);
+    for (size_t w = 0; w < num_weights; ++w) {
+      auto it = index.find(
+          TreeNodeId{e->weight_tree_ids[w], e->weight_node_ids[w]});
+      if (it == index.end() || e->modes[it->second] != Mode::Leaf) {
+        return false;
+      }
+      weight_node[w] = it->second;
+      ++weight_begin[it->second + 1];
+    }
+    for (size_t i = 0; i < num_nodes; ++i) {
+      weight_begin[i + 1] += weight_begin[i];
+    }
+    std::vector<size_t> leaf_weights(num_weights);
+    {
+      std::vector<size_t> next(weight_begin.begin(), weight_begin.end() - 1);
+      for (size_t w = 0; w < num_weights; ++w) {
+        leaf_weights[next[weight_node[w]]++] = w;
+      }
+    }
+
+    // Hash-cons the reachable nodes of each tree bottom-up: canonical[i]
+    // is the first node found with the same key as node i, the key of a
+    // branch being built from the canonical nodes of its children.
+    std::vector<size_t> canonical(num_nodes, kNone);
+    std::vector<uint8_t> visiting(num_nodes, 0);
+    std::unordered_map<std::string, size_t> nodes_by_key;
+    std::vector<std::pair<double, int64_t>> leaf_key;
+    std::string key;
+    for (size_t root : roots) {
+      nodes_by_key.clear();
+      std::vector<size_t> stack(1, root);
+      while (!stack.empty()) {
+        const size_t i = stack.back();
+        if (canonical[i] != kNone) {
+          stack.pop_back();
+          continue;
+        }
+        if (e->modes[i] != Mode::Leaf && !visiting[i]) {
+          visiting[i] = 1;
+          for (size_t child : {true_child[i], false_child[i]}) {
+            if (canonical[child] == kNone) {
+              if (visiting[child]) {
+                return false;
+              }
+              stack.push_back(child);
+            }
+          }
+          continue;
+        }
+        stack.pop_back();
+        key.clear();
+        const uint8_t mode = static_cast<uint8_t>(e->modes[i]);
+        append_bytes(&key, &mode, sizeof(mode));
+        if (e->modes[i] == Mode::Leaf) {
+          // The order of the weights of a leaf does not matter.
+          leaf_key.clear();
+          for (size_t k = weight_begin[i]; k < weight_begin[i + 1]; ++k) {
+            const size_t w = leaf_weights[k];
+            leaf_key.emplace_back(e->weights[w], e->weight_ids[w]);
+          }
+          std::sort(leaf_key.begin(), leaf_key.end());
+          for (const auto& weight : leaf_key) {
+            append_bytes(&key, &weight.first, sizeof(weight.first));
+            append_bytes(&key, &weight.second, sizeof(weight.second));
+          }
+        } else {
+          const size_t t = canonical[true_child[i]];
+          const size_t f = canonical[false_child[i]];
+          if (t == f) {
+            canonical[i] = t;
+            continue;
+          }
+          append_bytes(&key, &e->feature_ids[i], sizeof(int64_t));
+          append_bytes(&key, &e->values[i], sizeof(double));
+          if (!e->hitrates.empty()) {
+            append_bytes(&key, &e->hitrates[i], sizeof(double));
+          }
+          if (!e->missing_tracks.empty()) {
+            append_bytes(&key, &e->missing_tracks[i], sizeof(int64_t));
+          }
+          append_bytes(&key, &t, sizeof(t));
+          append_bytes(&key, &f, sizeof(f));
+        }
+        canonical[i] = nodes_by_key.emplace(key, i).first->second;
+      }
+    }
+
+    // Number the canonical nodes breadth-first from each root.
+    std::vector<int64_t> new_id(num_nodes, -1);
+    std::vector<size_t> order;
+    for (size_t root : roots) {
+      const size_t begin = order.size();
+      new_id[canonical[root]] = 0;
+      order.push_back(canonical[root]);
+      for (size_t k = begin; k < order.size(); ++k) {
+        const size_t i = order[k];
+        if (e->modes[i] == Mode::Leaf) {
+          continue;
+        }
+        for (size_t child : {true_child[i], false_child[i]}) {
+          const size_t c = canonical[child];
+          if (new_id[c] < 0) {
+            new_id[c] = static_cast<int64_t>(order.size() - begin);
+            order.push_back(c);
+          }
+        }
+      }
+    }
+
+    Ensemble out;
+    for (size_t k = 0; k < order.size(); ++k) {
+      const size_t i = order[k];
+      const bool leaf = e->modes[i] == Mode::Leaf;
+      out.tree_ids.push_back(e->tree_ids[i]);
+      out.node_ids.push_back(new_id[i]);
+      out.feature_ids.push_back(e->feature_ids[i]);
+      out.values.push_back(e->values[i]);
+      if (!e->hitrates.empty()) {
+        out.hitrates.push_back(e->hitrates[i]);
+      }
+      out.modes.push_back(e->modes[i]);
+      out.true_ids.push_back(leaf ? 0 : new_id[canonical[true_child[i]]]);
+      out.false_ids.push_back(leaf ? 0 : new_id[canonical[false_child[i]]]);
+      if (!e->missing_tracks.empty()) {
+        out.missing_tracks.push_back(e->missing_tracks[i]);
+      }
+      for (size_t w = weight_begin[i]; w < weight_begin[i + 1]; ++w) {
+        const size_t weight = leaf_weights[w];
+        out.weight_tree_ids.push_back(e->tree_ids[i]);
+        out.weight_node_ids.push_back(new_id[i]);
+        out.weight_ids.push_back(e->weight_ids[weight]);
+        out.weights.push_back(e->weights[weight]);
+      }
+    }
+    *e = std::move(out);
+    return true;
+  }
+
+  static void write_ensemble(Node* n, const std::string& prefix, Ensemble* e) {
+    std::vector<std::string> modes;
+    modes.reserve(e->modes.size());
+    for (Mode mode : e->modes) {
+      modes.emplace_back(mode_name(mode));
+    }
+    n->is_(Symbol("nodes_treeids"), std::move(e->tree_ids));
+    n->is_(Symbol("nodes_nodeids"), std::move(e->node_ids));
+    n->is_(Symbol("nodes_featureids"), std::move(e->feature_ids));
+    n->fs_(Symbol("nodes_values"), std::move(e->values));
+    if (n->hasAttribute(Symbol("nodes_hitrates"))) {
+      n->fs_(Symbol("nodes_hitrates"), std::move(e->hitrates));
+    }
+    n->ss_(Symbol("nodes_modes"), std::move(modes));
+    n->is_(Symbol("nodes_truenodeids"), std::move(e->true_ids));
+    n->is_(Symbol("nodes_falsenodeids"), std::move(e->false_ids));
+    if (n->hasAttribute(Symbol("nodes_missing_value_tracks_true"))) {
+      n->is_(
+          Symbol("nodes_missing_value_tracks_true"),
+          std::move(e->missing_tracks));
+    }
+    n->is_(Symbol(prefix + "treeids"), std::move(e->weight_tree_ids));
+    n->is_(Symbol(prefix + "nodeids"), std::move(e->weight_node_ids));
+    n->is_(Symbol(prefix + "ids"), std::move(e->weight_ids));
+    n->fs_(Symbol(prefix + "weights"), std::move(e->weights));
+  }
+
+  void compact_node(Node* n, const std::string& prefix, Totals* totals) {
+    Ensemble e;
+    if (!read_ensemble(n, prefix, &e)) {
+      return;
+    }
+    const Ensemble before = e;
+    if (!compact_ensemble(&e)) {
+      return;
+    }
+    if (e.tree_ids == before.tree_ids && e.node_ids == before.node_ids &&
+        e.feature_ids == before.feature_ids && e.values == before.values &&
+        e.modes == before.modes && e.weights == before.weights &&
+        e.weight_node_ids == before.weight_node_ids) {
+      // Only the child ids of leaves, which are ignored, can differ.
+      bool same_branches = true;
+      for (size_t i = 0; i < e.modes.size() && same_branches; ++i) {
+        same_branches = e.modes[i] == Mode::Leaf ||
+            (e.true_ids[i] == before.true_ids[i] &&
+             e.false_ids[i] == before.false_ids[i]);
+      }
+      if (same_branches) {
+        return;
+      }
+    }
+    ++totals->num_compacted;
+    totals->nodes_before += before.tree_ids.size();
+    totals->nodes_after += e.tree_ids.size();
+    totals->weights_before += before.weights.size();
+    totals->weights_after += e.weights.size();
+    write_ensemble(n, prefix, &e);
+  }
+
+  void compact_graph(Graph& graph, Totals* totals) {
+    const Symbol regressor("TreeEnsembleRegressor");
+    const Symbol classifier("TreeEnsembleClassifier");
+    for (auto* n : graph.nodes()) {
+      if (n->domain() == AI_ONNX_ML_DOMAIN) {
+        if (n->kind() == regressor) {
+          compact_node(n, "target_", totals);
+        } else if (n->kind() == classifier) {
+          compact_node(n, "class_", totals);
+        }
+      }
+      DescendOnGraphAttributesUnconstrained(
+          n, [this, totals](Graph& subgraph) {
+            compact_graph(subgraph, totals);
+          });
+    }
+  }
+};
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
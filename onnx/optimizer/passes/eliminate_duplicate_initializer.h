@@ -0,0 +1,185 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+// Before:
+//   A and B are initializers (and graph inputs) with the same type, dims
+//   and data
+//   C = Add(X, A)
+//   D = Mul(Y, B)
+// After:
+//   B is erased
+//   C = Add(X, A)
+//   D = Mul(Y, A)
+//
+// Initializers are hashed in parallel and candidate duplicates are
+// compared byte-for-byte with SameTensor, whether their data is in raw_data
+// or in the typed fields. The first of equal initializers is kept.
+// Duplicates that are graph outputs or are captured by a subgraph are
+// kept, as are sparse initializers (hashing would densify them). Each
+// subgraph is deduplicated on its own.
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "onnx/common/graph_hash.h"
+#include "onnx/common/parallel.h"
+#include "onnx/optimizer/pass.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// The initializers EliminateDuplicateInitializer erased, each with the one
+// its uses were moved to, and the bytes of data they held.
+struct DuplicateInitializerAnalysis : CountBasedPassAnalysis {
+  DuplicateInitializerAnalysis(
+      Pass* pass,
+      std::vector<std::pair<std::string, std::string>> replaced,
+      size_t bytes_saved)
+      : CountBasedPassAnalysis(
+            pass,
+            static_cast<unsigned int>(replaced.size()),
+            false,
+            false),
+        replaced(std::move(replaced)),
+        bytes_saved(bytes_saved) {}
+
+  std::vector<std::pair<std::string, std::string>> replaced;
+  size_t bytes_saved;
+};
+
+struct EliminateDuplicateInitializer final : public FullGraphBasedPass {
+  // num_threads is the number of threads hashing initializers, 0 meaning
+  // one per hardware thread.
+  explicit EliminateDuplicateInitializer(size_t num_threads = 0)
+      : FullGraphBasedPass(
+            PassType::Nop,
+            PassEfficiency::Complete,
+            PassOptimizationType::Memory),
+        num_threads_(num_threads) {}
+
+  std::string getPassName() const override {
+    return "eliminate_duplicate_initializer";
+  }
+
+  PassAnalysisType getPassAnalysisType() const override {
+    return PassAnalysisType::CountBased;
+  }
+
+  std::shared_ptr<PostPassAnalysis> runPass(Graph& graph) override {
+    std::vector<std::pair<std::string, std::string>> replaced;
+    size_t bytes_saved = 0;
+    eliminate_duplicates(graph, &replaced, &bytes_saved);
+    return std::make_shared<DuplicateInitializerAnalysis>(
+        this, std::move(replaced), bytes_saved);
+  }
+
+ private:
+  static size_t data_bytes(const Tensor& t) {
+    if (t.is_raw_data()) {
+      return t.raw_data_size();
+    }
+    size_t bytes = t.floats().size() * sizeof(float) +
+        t.doubles().size() * sizeof(double) +
+        t.int32s().size() * sizeof(int32_t) +
+        t.int64s().size() * sizeof(int64_t) +
+        t.uint64s().size() * sizeof(uint64_t);
+    for (const auto& s : t.strings()) {
+      bytes += s.size();
+    }
+    return bytes;
+  }
+
+  void collect_captured_names(
+      Graph& graph,
+      std::unordered_set<std::string>* names) {
+    for (auto* n : graph.nodes()) {
+      if (n->kind() == kCaptured) {
+        names->insert(n->output()->uniqueName());
+      }
+      DescendOnGraphAttributesUnconstrained(
+          n, [this, names](Graph& subgraph) {
+            collect_captured_names(subgraph, names);
+          });
+    }
+  }
+
+  void eliminate_duplicates(
+      Graph& graph,
+      std::vector<std::pair<std::string, std::string>>* replaced,
+      size_t* bytes_saved) {
+    for (auto* n : graph.nodes()) {
+      DescendOnGraphAttributesUnconstrained(
+          n, [this, replaced, bytes_saved](Graph& subgraph) {
+            eliminate_duplicates(subgraph, replaced, bytes_saved);
+          });
+    }
+
+    const std::vector<Tensor>& tensors = graph.initializers();
+    const std::vector<std::string>& names = graph.initializer_names();
+    std::unordered_map<std::string, Value*> inputs;
+    for (Value* input : graph.inputs()) {
+      inputs.emplace(input->uniqueName(), input);
+    }
+    // Initializers that are not graph inputs cannot be used by nodes.
+    std::vector<Value*> values(tensors.size(), nullptr);
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      auto it = inputs.find(names[i]);
+      if (it != inputs.end() && !tensors[i].is_sparse()) {
+        values[i] = it->second;
+      }
+    }
+
+    std::vector<uint64_t> hashes(tensors.size(), 0);
+    parallel_for(tensors.size(), num_threads_, [&](size_t i) {
+      if (values[i] != nullptr) {
+        hashes[i] = HashTensor(tensors[i]);
+      }
+    });
+
+    std::unordered_set<std::string> kept_names;
+    for (Value* output : graph.outputs()) {
+      kept_names.insert(output->uniqueName());
+    }
+    for (auto* n : graph.nodes()) {
+      DescendOnGraphAttributesUnconstrained(
+          n, [this, &kept_names](Graph& subgraph) {
+            collect_captured_names(subgraph, &kept_names);
+          });
+    }
+
+    // Initializers with distinct data, by hash.
+    std::unordered_map<uint64_t, std::vector<size_t>> distinct;
+    std::vector<Value*> erased;
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      if (values[i] == nullptr) {
+        continue;
+      }
+      std::vector<size_t>& candidates = distinct[hashes[i]];
+      size_t original = tensors.size();
+      for (size_t c : candidates) {
+        if (SameTensor(tensors[c], tensors[i])) {
+          original = c;
+          break;
+        }
+      }
+      if (original == tensors.size()) {
+        candidates.push_back(i);
+      } else if (kept_names.count(names[i]) == 0) {
+        values[i]->replaceAllUsesWith(values[original]);
+        replaced->emplace_back(names[i], names[original]);
+        *bytes_saved += data_bytes(tensors[i]);
+        erased.push_back(values[i]);
+      }
+    }
+    if (!erased.empty()) {
+      graph.eraseInitializersAndInputs(erased);
+    }
+  }
+
+  size_t num_threads_;
+};
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
@@ -19,6 +19,10 @@ struct EliminateNopDropout final : public PredicateBasedPass {
     return "eliminate_nop_dropout";
   }
 
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kDropout};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return (node->kind() == kDropout && node->hasAttribute(kratio)) &&
         node->f(kratio) == 0.0;
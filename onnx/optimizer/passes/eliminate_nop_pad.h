@@ -25,6 +25,10 @@ struct EliminateNopPad final : public PredicateBasedPass {
     return true;
   }
 
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kPad};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return (node->kind() == kPad && node->hasAttribute(kpads)) &&
         is_nop_pad(node->is(kpads));
@@ -26,6 +26,10 @@ struct EliminateNopTranspose final : public PredicateBasedPass {
     return true;
   }
 
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kTranspose};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return (node->kind() == kTranspose && node->hasAttribute(kperm)) &&
         is_nop_transpose(node->is(kperm));
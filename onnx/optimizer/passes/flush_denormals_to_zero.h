@@ -0,0 +1,81 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+// Before:
+//   W is a float initializer holding denormals, e.g. 1e-40
+// After:
+//   those elements of W are (signed) zeros
+//
+// Denormal weights make x86 inference slow unless the runtime sets FTZ/DAZ,
+// which would read them as zero anyway. Initializers of subgraphs are
+// flushed too.
+
+#include "onnx/common/special_values.h"
+#include "onnx/optimizer/pass.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// The initializers changed by FlushDenormalsToZero, with the number of
+// denormals flushed in each.
+struct FlushedDenormalsAnalysis : CountBasedPassAnalysis {
+  FlushedDenormalsAnalysis(
+      Pass* pass,
+      std::vector<std::pair<std::string, size_t>> flushed)
+      : CountBasedPassAnalysis(
+            pass,
+            static_cast<unsigned int>(flushed.size()),
+            false,
+            false),
+        flushed(std::move(flushed)) {}
+
+  std::vector<std::pair<std::string, size_t>> flushed;
+};
+
+struct FlushDenormalsToZero final : public FullGraphBasedPass {
+  explicit FlushDenormalsToZero()
+      : FullGraphBasedPass(
+            PassType::Other,
+            PassEfficiency::Complete,
+            PassOptimizationType::Compute) {}
+
+  std::string getPassName() const override {
+    return "flush_denormals_to_zero";
+  }
+
+  PassAnalysisType getPassAnalysisType() const override {
+    return PassAnalysisType::CountBased;
+  }
+
+  void flush_denormals(
+      Graph& graph,
+      std::vector<std::pair<std::string, size_t>>* flushed) {
+    for (size_t i = 0; i < graph.initializers().size(); ++i) {
+      // Only the tensors with denormals are written, and so logged when
+      // the pass runs in a transaction.
+      const size_t n = CountSpecialValues(graph.initializers()[i]).denormals;
+      if (n > 0) {
+        FlushCountedTensorDenormalsToZero(graph.mutableInitializer(i));
+        flushed->emplace_back(graph.initializer_names()[i], n);
+      }
+    }
+    for (auto* n : graph.nodes()) {
+      DescendOnGraphAttributesUnconstrained(
+          n, [this, flushed](Graph& subgraph) {
+            flush_denormals(subgraph, flushed);
+          });
+    }
+  }
+
+  std::shared_ptr<PostPassAnalysis> runPass(Graph& graph) override {
+    std::vector<std::pair<std::string, size_t>> flushed;
+    flush_denormals(graph, &flushed);
+    return std::make_shared<FlushedDenormalsAnalysis>(
+        this, std::move(flushed));
+  }
+};
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
@@ -16,24 +16,25 @@
 #include <numeric>
 
 #include "onnx/common/assertions.h"
-#include "onnx/optimizer/pass.h"
+#include "onnx/optimizer/pattern.h"
 
 namespace ONNX_NAMESPACE {
 namespace optimization {
 
-struct FuseAddBiasIntoConv final : public PredicateBasedPass {
+// Z = Conv(X, Y) and B = Z + A, where only the Add uses Z.
+using AddBiasIntoConvPattern =
+    Op<kAdd, Input<0, SingleUse<Op<kConv, NumInputs<2>>>>>;
+
+struct FuseAddBiasIntoConv final
+    : public PatternBasedPass<AddBiasIntoConvPattern> {
   explicit FuseAddBiasIntoConv()
-      : PredicateBasedPass(
+      : PatternBasedPass(
             PassType::Fuse,
             PassEfficiency::Complete,
             PassOptimizationType::Compute) {}
   std::string getPassName() const override {
     return "fuse_add_bias_into_conv";
   }
-  bool patternMatchPredicate(Node* node) override {
-    return node->kind() == kAdd && node->inputs()[0]->node()->kind() == kConv &&
-        node->inputs()[0]->node()->inputs().size() == 2;
-  }
   bool runTransform(Node* n, Graph& graph, NodeDestroyType& destroy_current)
       override {
     // due to current broadcasting's constraint, Conv has to be the first
@@ -46,10 +47,6 @@ struct FuseAddBiasIntoConv final : public PredicateBasedPass {
         orig_bias->node()->kind() != kParam) {
       return false;
     }
-    // check if conv is only used by Add
-    if (orig_conv->uses().size() > 1) {
-      return false;
-    }
     auto conv_shape = orig_conv->sizes();
     auto bias_shape = orig_bias->sizes();
     auto weight_shape = orig_conv->node()->inputs()[1]->sizes();
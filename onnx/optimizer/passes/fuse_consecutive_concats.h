@@ -19,6 +19,10 @@ struct FuseConsecutiveConcats final : public PredicateBasedPass {
     return "fuse_consecutive_concats";
   }
 
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kConcat};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     // we don't check if our concat node has inputs which are also concat nodes
     // because this requires a for loop through the inputs. If it turns out
@@ -3,14 +3,19 @@
 
 #pragma once
 
-#include "onnx/optimizer/pass.h"
+#include "onnx/optimizer/pattern.h"
 
 namespace ONNX_NAMESPACE {
 namespace optimization {
 
-struct FuseConsecutiveLogSoftmax final : public PredicateBasedPass {
+// Log(Softmax(X)), where only the Log uses the Softmax.
+using ConsecutiveLogSoftmaxPattern =
+    Op<kLog, Input<0, SingleUse<Op<kSoftmax>>>>;
+
+struct FuseConsecutiveLogSoftmax final
+    : public PatternBasedPass<ConsecutiveLogSoftmaxPattern> {
   explicit FuseConsecutiveLogSoftmax()
-      : PredicateBasedPass(
+      : PatternBasedPass(
             PassType::Fuse,
             PassEfficiency::Complete,
             PassOptimizationType::Compute) {}
@@ -19,10 +24,6 @@ struct FuseConsecutiveLogSoftmax final : public PredicateBasedPass {
     return "fuse_consecutive_log_softmax";
   }
 
-  bool patternMatchPredicate(Node* node) override {
-    return node->kind() == kLog && node->input()->node()->kind() == kSoftmax &&
-        node->input()->uses().size() == 1;
-  }
   bool runTransform(
       Node* log_node,
       Graph& graph,
@@ -3,25 +3,41 @@
 
 #pragma once
 
-#include "onnx/optimizer/pass.h"
+#include "onnx/optimizer/pattern.h"
 
 namespace ONNX_NAMESPACE {
 namespace optimization {
 
-const std::unordered_set<NodeKind> reduction_operators{kReduceL1,
-                                                       kReduceL2,
-                                                       kReduceLogSum,
-                                                       kReduceLogSumExp,
-                                                       kReduceMax,
-                                                       kReduceMean,
-                                                       kReduceMin,
-                                                       kReduceProd,
-                                                       kReduceSum,
-                                                       kReduceSumSquare};
+using ReductionKinds = Kinds<
+    kReduceL1,
+    kReduceL2,
+    kReduceLogSum,
+    kReduceLogSumExp,
+    kReduceMax,
+    kReduceMean,
+    kReduceMin,
+    kReduceProd,
+    kReduceSum,
+    kReduceSumSquare>;
 
-struct FuseConsecutiveReduceUnsqueeze final : public PredicateBasedPass {
+// An Unsqueeze of a reduction that does not keep the reduced dimensions,
+// over the same axes.
+using ConsecutiveReduceUnsqueezePattern = Op<
+    kUnsqueeze,
+    HasAttribute<kaxes>,
+    Input<
+        0,
+        AnyOp<
+            ReductionKinds,
+            HasAttribute<kaxes>,
+            IntAttribute<kkeepdims, 0>,
+            Capture<0>>>,
+    SameAttributeAs<kaxes, 0>>;
+
+struct FuseConsecutiveReduceUnsqueeze final
+    : public PatternBasedPass<ConsecutiveReduceUnsqueezePattern> {
   explicit FuseConsecutiveReduceUnsqueeze()
-      : PredicateBasedPass(
+      : PatternBasedPass(
             PassType::Fuse,
             PassEfficiency::Complete,
             PassOptimizationType::Compute) {}
@@ -29,24 +45,6 @@ struct FuseConsecutiveReduceUnsqueeze final : public PredicateBasedPass {
   std::string getPassName() const override {
     return "fuse_consecutive_reduce_unsqueeze";
   }
-  bool patternMatchPredicate(Node* node) override {
-    // check that the current node is of type Unsqueeze and has defined axes
-    bool cur_node_check =
-        node->kind() == kUnsqueeze && node->hasAttribute(kaxes);
-    if (cur_node_check) {
-      Node* prev_node = node->input()->node();
-      // check that the previous node a reduction operator and has defined
-      // axes/keepdims
-      bool reduction_node_check = reduction_operators.find(prev_node->kind()) !=
-              reduction_operators.end() &&
-          prev_node->hasAttribute(kaxes) && prev_node->hasAttribute(kkeepdims);
-      if (reduction_node_check) {
-        // insure that keepdims is set to false currently
-        return prev_node->i(kkeepdims) == 0 && node->is(kaxes) == prev_node->is(kaxes);
-      }
-    }
-    return false;
-  }
   bool runTransform(Node* node, Graph&, NodeDestroyType& destroy_current)
       override {
     Node* reduction_op = node->input()->node();
@@ -36,6 +36,10 @@ struct FuseConsecutiveTransposes final : public PredicateBasedPass {
     return ret;
   }
 
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kTranspose};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kTranspose &&
         node->input()->node()->kind() == kTranspose;
@@ -63,7 +67,7 @@ struct FuseConsecutiveTransposes final : public PredicateBasedPass {
       origInput->node()->destroy();
     }
     destroy_current = NodeDestroyType::DestroyZero;
-    return false;
+    return true;
   }
 };
 
@@ -17,24 +17,25 @@
 #include <numeric>
 
 #include "onnx/common/assertions.h"
-#include "onnx/optimizer/pass.h"
+#include "onnx/optimizer/pattern.h"
 
 namespace ONNX_NAMESPACE {
 namespace optimization {
 
-struct FuseMatMulAddBiasIntoGemm final : public PredicateBasedPass {
+// Z = MatMul(X, Y) and A = Z + Bias, where only the Add uses Z.
+using MatMulAddBiasIntoGemmPattern =
+    Op<kAdd, Input<0, SingleUse<Op<kMatMul>>>>;
+
+struct FuseMatMulAddBiasIntoGemm final
+    : public PatternBasedPass<MatMulAddBiasIntoGemmPattern> {
   explicit FuseMatMulAddBiasIntoGemm()
-      : PredicateBasedPass(
+      : PatternBasedPass(
             PassType::Fuse,
             PassEfficiency::Complete,
             PassOptimizationType::Compute) {}
   std::string getPassName() const override {
     return "fuse_matmul_add_bias_into_gemm";
   }
-  bool patternMatchPredicate(Node* node) override {
-    return node->kind() == kAdd &&
-        node->inputs()[0]->node()->kind() == kMatMul;
-  }
   bool runTransform(Node* n, Graph& graph, NodeDestroyType& destroy_current)
       override {
     // due to current broadcasting's constraint, MatMul has to be the first
@@ -47,10 +48,6 @@ struct FuseMatMulAddBiasIntoGemm final : public PredicateBasedPass {
         orig_bias->node()->kind() != kParam) {
       return false;
     }
-    // check if MatMul is only used by Add
-    if (orig_matmul->uses().size() > 1) {
-      return false;
-    }
     auto x_shape = orig_matmul->node()->inputs()[0]->sizes();
     auto y_shape = orig_matmul->node()->inputs()[1]->sizes();
     int64_t z_N = -1;
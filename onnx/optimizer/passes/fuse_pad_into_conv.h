@@ -29,6 +29,10 @@ struct FusePadIntoConv final : public PredicateBasedPass {
   std::string getPassName() const override {
     return "fuse_pad_into_conv";
   }
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kConv};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kConv && node->inputs()[0]->node()->kind() == kPad;
   }
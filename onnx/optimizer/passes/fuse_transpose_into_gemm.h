@@ -17,6 +17,10 @@ struct FuseTransposeIntoGemm final : public PredicateBasedPass {
   std::string getPassName() const override {
     return "fuse_transpose_into_gemm";
   }
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kGemm};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kGemm;
   }
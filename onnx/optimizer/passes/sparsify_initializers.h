@@ -0,0 +1,99 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+// Before:
+//   W is a pruned initializer, most of whose elements are zero
+// After:
+//   W is a sparse Tensor: the indices and values of its nonzero elements
+//
+// Sparse initializers stay small in memory and in the IR binary format
+// until something reads their data, which densifies them; ModelProto
+// export always writes them dense. Initializers of subgraphs are
+// analyzed and sparsified too.
+//
+// Since the optimizer returns a ModelProto, this pass is not in
+// GlobalPassRegistry: run it directly on a Graph that is then written
+// with SaveGraphBinary.
+
+#include "onnx/common/sparsity.h"
+#include "onnx/optimizer/pass.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// The sparsity of every initializer SparsifyInitializers analyzed, and
+// the names of those it made sparse.
+struct InitializerSparsityAnalysis : CountBasedPassAnalysis {
+  InitializerSparsityAnalysis(
+      Pass* pass,
+      std::vector<InitializerSparsityReport> reports,
+      std::vector<std::string> sparsified)
+      : CountBasedPassAnalysis(
+            pass,
+            static_cast<unsigned int>(sparsified.size()),
+            false,
+            false),
+        reports(std::move(reports)),
+        sparsified(std::move(sparsified)) {}
+
+  std::vector<InitializerSparsityReport> reports;
+  std::vector<std::string> sparsified;
+};
+
+struct SparsifyInitializers final : public FullGraphBasedPass {
+  // Pruned weights are typically 70% or more zeros; below that, 8-byte
+  // indices eat most of the savings.
+  explicit SparsifyInitializers(double min_zero_fraction = 0.7)
+      : FullGraphBasedPass(
+            PassType::Other,
+            PassEfficiency::Complete,
+            PassOptimizationType::Memory),
+        min_zero_fraction_(min_zero_fraction) {}
+
+  std::string getPassName() const override {
+    return "sparsify_initializers";
+  }
+
+  PassAnalysisType getPassAnalysisType() const override {
+    return PassAnalysisType::CountBased;
+  }
+
+  void sparsify_initializers(
+      Graph& graph,
+      std::vector<InitializerSparsityReport>* reports,
+      std::vector<std::string>* sparsified) {
+    for (auto& report : AnalyzeInitializerSparsity(graph)) {
+      // The analysis counts -0.0 as zero, so it never rules out a tensor
+      // that SparsifyTensor would change.
+      const size_t i = report.index;
+      if (!graph.initializers()[i].is_sparse() &&
+          report.stats.zero_fraction() >= min_zero_fraction_ &&
+          SparsifyTensor(graph.mutableInitializer(i), min_zero_fraction_)) {
+        sparsified->push_back(graph.initializer_names()[i]);
+      }
+      reports->push_back(std::move(report));
+    }
+    for (auto* n : graph.nodes()) {
+      DescendOnGraphAttributesUnconstrained(
+          n, [this, reports, sparsified](Graph& subgraph) {
+            sparsify_initializers(subgraph, reports, sparsified);
+          });
+    }
+  }
+
+  std::shared_ptr<PostPassAnalysis> runPass(Graph& graph) override {
+    std::vector<InitializerSparsityReport> reports;
+    std::vector<std::string> sparsified;
+    sparsify_initializers(graph, &reports, &sparsified);
+    return std::make_shared<InitializerSparsityAnalysis>(
+        this, std::move(reports), std::move(sparsified));
+  }
+
+ private:
+  double min_zero_fraction_;
+};
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
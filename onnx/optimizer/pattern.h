@@ -0,0 +1,325 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+// Patterns describe a node, and recursively the nodes producing its inputs,
+// as types. Matching one is compiled into the same straight-line code as a
+// hand-written predicate, so a pass loses nothing by using them. For
+// example, an Add whose first input is computed by a Conv with two inputs,
+// which nothing but the Add uses, capturing the Conv in slot 0:
+//
+//   using AddConv =
+//       Op<kAdd, Input<0, SingleUse<Op<kConv, NumInputs<2>, Capture<0>>>>>;
+//
+// AddConv::matches(node) tests a node, AddConv::match(node, &match) also
+// binds the captured nodes, and AddConv::kinds() lists the kinds of the
+// nodes it may match, for a pass to anchor on. The checks of a node run
+// in order, so a check that reads a captured node goes after the Input
+// capturing it.
+//
+// AnyOf<P...> matches the first of several patterns that matches. Where
+// alternatives for the same kinds start with the same checks, these are
+// shared: AnyOf compiles them into a single pattern that runs them once,
+// before trying what differs.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "onnx/common/assertions.h"
+#include "onnx/common/graph_hash.h"
+#include "onnx/common/ir.h"
+#include "onnx/optimizer/pass.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// The nodes a match captured, by slot.
+class PatternMatch {
+ public:
+  static const size_t kMaxCaptures = 8;
+
+  Node* node(size_t slot) const {
+    return nodes_[slot];
+  }
+  void capture(size_t slot, Node* n) {
+    nodes_[slot] = n;
+  }
+
+ private:
+  Node* nodes_[kMaxCaptures] = {};
+};
+
+// A set of node kinds.
+template <BuiltinSymbol... Ks>
+struct Kinds;
+template <>
+struct Kinds<> {
+  static bool contains(NodeKind) {
+    return false;
+  }
+  static void list(std::vector<NodeKind>*) {}
+};
+template <BuiltinSymbol K, BuiltinSymbol... Ks>
+struct Kinds<K, Ks...> {
+  static bool contains(NodeKind kind) {
+    return kind == K || Kinds<Ks...>::contains(kind);
+  }
+  static void list(std::vector<NodeKind>* kinds) {
+    kinds->push_back(K);
+    Kinds<Ks...>::list(kinds);
+  }
+};
+
+// Checks of a node. Each has a static check(Node*, PatternMatch*).
+
+// All of the checks, in order.
+template <typename... Checks>
+struct AllOf;
+template <>
+struct AllOf<> {
+  static bool check(Node*, PatternMatch*) {
+    return true;
+  }
+};
+template <typename C, typename... Cs>
+struct AllOf<C, Cs...> {
+  static bool check(Node* n, PatternMatch* m) {
+    return C::check(n, m) && AllOf<Cs...>::check(n, m);
+  }
+};
+
+// Either AllOf, trying the first one first.
+template <typename A, typename B>
+struct FirstOf {
+  static bool check(Node* n, PatternMatch* m) {
+    return A::check(n, m) || B::check(n, m);
+  }
+};
+
+// The node has exactly N inputs.
+template <size_t N>
+struct NumInputs {
+  static bool check(Node* n, PatternMatch*) {
+    return n->inputs().size() == N;
+  }
+};
+
+// Input I is computed by a node matching the pattern P.
+template <size_t I, typename P>
+struct Input {
+  static bool check(Node* n, PatternMatch* m) {
+    return I < n->inputs().size() && P::matchValue(n->inputs()[I], m);
+  }
+};
+
+template <BuiltinSymbol Name>
+struct HasAttribute {
+  static bool check(Node* n, PatternMatch*) {
+    return n->findAttribute(Name) != nullptr;
+  }
+};
+
+// The node has an int attribute with the given value.
+template <BuiltinSymbol Name, int64_t Value>
+struct IntAttribute {
+  static bool check(Node* n, PatternMatch*) {
+    const AttributeValue* a = n->findAttribute(Name);
+    return a != nullptr && a->kind() == AttributeKind::i &&
+        static_cast<const IntAttr*>(a)->value() == Value;
+  }
+};
+
+// The node has the attribute, with the same kind and value as the node
+// captured in Slot.
+template <BuiltinSymbol Name, size_t Slot>
+struct SameAttributeAs {
+  static bool check(Node* n, PatternMatch* m) {
+    return SameAttribute(n, m->node(Slot), Name);
+  }
+};
+
+// Any other check: F::check(const Node*, const PatternMatch&).
+template <typename F>
+struct Where {
+  static bool check(Node* n, PatternMatch* m) {
+    return F::check(n, *m);
+  }
+};
+
+// Makes the node available as match.node(Slot).
+template <size_t Slot>
+struct Capture {
+  static_assert(Slot < PatternMatch::kMaxCaptures, "capture slot too large");
+  static bool check(Node* n, PatternMatch* m) {
+    m->capture(Slot, n);
+    return true;
+  }
+};
+
+// Patterns. Each has static match(Node*, PatternMatch*), matches(Node*)
+// and kinds(), and matchValue(Value*, PatternMatch*) to match the node
+// computing an input.
+
+// A node of one of KindSet, passing the checks.
+template <typename KindSet, typename... Checks>
+struct NodePattern {
+  static std::vector<NodeKind> kinds() {
+    std::vector<NodeKind> result;
+    KindSet::list(&result);
+    return result;
+  }
+  static bool match(Node* n, PatternMatch* m) {
+    return KindSet::contains(n->kind()) && AllOf<Checks...>::check(n, m);
+  }
+  static bool matchValue(Value* v, PatternMatch* m) {
+    return match(v->node(), m);
+  }
+  static bool matches(Node* n) {
+    PatternMatch m;
+    return match(n, &m);
+  }
+};
+
+template <BuiltinSymbol K, typename... Checks>
+using Op = NodePattern<Kinds<K>, Checks...>;
+
+template <typename KindSet, typename... Checks>
+using AnyOp = NodePattern<KindSet, Checks...>;
+
+// Either pattern, trying the first one first.
+template <typename P, typename Q>
+struct EitherPattern {
+  static std::vector<NodeKind> kinds() {
+    std::vector<NodeKind> result = P::kinds();
+    for (NodeKind kind : Q::kinds()) {
+      if (std::find(result.begin(), result.end(), kind) == result.end()) {
+        result.push_back(kind);
+      }
+    }
+    return result;
+  }
+  static bool match(Node* n, PatternMatch* m) {
+    return P::match(n, m) || Q::match(n, m);
+  }
+  static bool matchValue(Value* v, PatternMatch* m) {
+    return match(v->node(), m);
+  }
+  static bool matches(Node* n) {
+    PatternMatch m;
+    return match(n, &m);
+  }
+};
+
+// An input computed by a node matching P, which nothing but the node
+// reading it uses, so a rewrite can remove that node. Only for Input.
+template <typename P>
+struct SingleUse {
+  static bool matchValue(Value* v, PatternMatch* m) {
+    return P::matchValue(v, m) && v->uses().size() == 1;
+  }
+};
+
+template <typename... Ps>
+struct MergePatterns;
+
+// Merges the check lists A and B, both AllOf, into an AllOf running their
+// common leading checks once and then either rest.
+template <typename A, typename B>
+struct MergeChecks {
+  using type = AllOf<FirstOf<A, B>>;
+};
+template <typename C, typename... As, typename... Bs>
+struct MergeChecks<AllOf<C, As...>, AllOf<C, Bs...>> {
+  template <typename Merged>
+  struct Prepend;
+  template <typename... Ms>
+  struct Prepend<AllOf<Ms...>> {
+    using type = AllOf<C, Ms...>;
+  };
+  using type = typename Prepend<
+      typename MergeChecks<AllOf<As...>, AllOf<Bs...>>::type>::type;
+};
+// Last checks on the same input load it once.
+template <size_t I, typename P, typename Q>
+struct MergeChecks<AllOf<Input<I, P>>, AllOf<Input<I, Q>>> {
+  using type = AllOf<Input<I, typename MergePatterns<P, Q>::type>>;
+};
+template <size_t I, typename P>
+struct MergeChecks<AllOf<Input<I, P>>, AllOf<Input<I, P>>> {
+  using type = AllOf<Input<I, P>>;
+};
+
+template <typename KindSet, typename Checks>
+struct NodePatternOf;
+template <typename KindSet, typename... Checks>
+struct NodePatternOf<KindSet, AllOf<Checks...>> {
+  using type = NodePattern<KindSet, Checks...>;
+};
+
+// The pattern matching what P or else Q matches.
+template <typename P, typename Q>
+struct MergePatterns<P, Q> {
+  using type = EitherPattern<P, Q>;
+};
+template <typename KindSet, typename... As, typename... Bs>
+struct MergePatterns<NodePattern<KindSet, As...>, NodePattern<KindSet, Bs...>> {
+  using type = typename NodePatternOf<
+      KindSet,
+      typename MergeChecks<AllOf<As...>, AllOf<Bs...>>::type>::type;
+};
+template <typename P, typename Q>
+struct MergePatterns<SingleUse<P>, SingleUse<Q>> {
+  using type = SingleUse<typename MergePatterns<P, Q>::type>;
+};
+template <typename P>
+struct MergePatterns<P> {
+  using type = P;
+};
+template <typename P, typename Q, typename R, typename... Rs>
+struct MergePatterns<P, Q, R, Rs...> {
+  using type = typename MergePatterns<
+      typename MergePatterns<P, Q>::type,
+      R,
+      Rs...>::type;
+};
+
+template <typename... Ps>
+using AnyOf = typename MergePatterns<Ps...>::type;
+
+// A PredicateBasedPass whose predicate is the pattern P, anchored on the
+// kinds of the nodes it matches. runTransform can call match() to get the
+// nodes the pattern captures.
+template <typename P>
+class PatternBasedPass : public PredicateBasedPass {
+ public:
+  explicit PatternBasedPass(
+      PassType pass_type,
+      PassEfficiency pass_efficiency,
+      PassOptimizationType pass_optimization_type)
+      : PredicateBasedPass(
+            pass_type,
+            pass_efficiency,
+            pass_optimization_type) {}
+
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return P::kinds();
+  }
+  bool patternMatchPredicate(Node* node) override {
+    return P::matches(node);
+  }
+
+ protected:
+  // The match of node, which the pattern must match.
+  static PatternMatch match(Node* node) {
+    PatternMatch m;
+    const bool matched = P::match(node, &m);
+    ONNX_ASSERT(matched);
+    return m;
+  }
+};
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,159 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#include "onnx/optimizer/specialize_shapes.h"
+
+#include <unordered_set>
+
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/defs/shape_inference.h"
+#include "onnx/optimizer/optimize.h"
+#include "onnx/shape_inference/implementation.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+namespace {
+
+bool sameDimension(const Dimension& a, const Dimension& b) {
+  return a.is_int == b.is_int && (a.is_int ? a.dim == b.dim : a.param == b.param);
+}
+
+// Records that dim_param `param` becomes `dim`.
+void bindParam(
+    std::unordered_map<std::string, Dimension>* bindings,
+    const std::string& param,
+    const Dimension& dim) {
+  auto it = bindings->find(param);
+  if (it == bindings->end()) {
+    bindings->emplace(param, dim);
+  } else if (!sameDimension(it->second, dim)) {
+    fail_shape_inference(
+        "Conflicting values for dimension ", param, ": ",
+        it->second.is_int ? ONNX_NAMESPACE::to_string(it->second.dim)
+                          : it->second.param,
+        " and ", dim.is_int ? ONNX_NAMESPACE::to_string(dim.dim) : dim.param);
+  }
+}
+
+void substituteValue(
+    Value* v,
+    const std::unordered_map<std::string, Dimension>& bindings) {
+  if (!v->has_sizes()) {
+    return;
+  }
+  std::vector<Dimension> sizes = v->sizes();
+  bool changed = false;
+  for (auto& d : sizes) {
+    if (d.is_int || d.param.empty()) {
+      continue;
+    }
+    auto it = bindings.find(d.param);
+    if (it != bindings.end()) {
+      d = it->second;
+      changed = true;
+    }
+  }
+  if (changed) {
+    v->setSizes(std::move(sizes));
+  }
+}
+
+void substituteGraph(
+    Graph& g,
+    const std::unordered_map<std::string, Dimension>& bindings) {
+  for (Value* v : g.inputs()) {
+    substituteValue(v, bindings);
+  }
+  for (Node* n : g.nodes()) {
+    for (Value* v : n->outputs()) {
+      substituteValue(v, bindings);
+    }
+    for (Symbol name : n->attributeNames()) {
+      if (n->kindOf(name) == AttributeKind::g) {
+        substituteGraph(*n->g(name), bindings);
+      } else if (n->kindOf(name) == AttributeKind::gs) {
+        for (const auto& subgraph : n->gs(name)) {
+          substituteGraph(*subgraph, bindings);
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+void SpecializeGraphShapes(Graph& g, const ShapeSpecialization& spec) {
+  std::unordered_map<std::string, Dimension> bindings;
+  for (const auto& kv : spec.dims) {
+    bindings.emplace(kv.first, kv.second);
+  }
+
+  const std::unordered_set<std::string> initializers(
+      g.initializer_names().begin(), g.initializer_names().end());
+  for (Value* input : g.inputs()) {
+    if (initializers.count(input->uniqueName()) != 0 || !input->has_sizes()) {
+      continue;
+    }
+    std::vector<Dimension> sizes = input->sizes();
+    std::vector<std::pair<int64_t, Dimension>> updates;
+    if (spec.batch_size >= 0 && !sizes.empty() && !sizes[0].is_int) {
+      updates.emplace_back(0, Dimension(spec.batch_size));
+    }
+    auto it = spec.input_dims.find(input->uniqueName());
+    if (it != spec.input_dims.end()) {
+      updates.insert(updates.end(), it->second.begin(), it->second.end());
+    }
+    for (const auto& update : updates) {
+      const int64_t rank = static_cast<int64_t>(sizes.size());
+      const int64_t axis = update.first < 0 ? update.first + rank : update.first;
+      if (axis < 0 || axis >= rank) {
+        fail_shape_inference(
+            "Axis ", update.first, " is out of range for input ",
+            input->uniqueName(), " of rank ", rank);
+      }
+      Dimension& d = sizes[axis];
+      if (!d.is_int && !d.param.empty()) {
+        bindParam(&bindings, d.param, update.second);
+      }
+      d = update.second;
+    }
+    if (!updates.empty()) {
+      input->setSizes(std::move(sizes));
+    }
+  }
+  substituteGraph(g, bindings);
+}
+
+std::vector<std::string> GetShapeDependentPasses() {
+  return {"fuse_add_bias_into_conv",
+          "fuse_bn_into_conv",
+          "fuse_consecutive_log_softmax",
+          "fuse_consecutive_reduce_unsqueeze",
+          "fuse_matmul_add_bias_into_gemm"};
+}
+
+ModelProto SpecializeShapes(
+    const ModelProto& mp_in,
+    const ShapeSpecialization& spec,
+    const std::vector<std::string>& passes) {
+  std::shared_ptr<Graph> g = ImportModelProto(mp_in);
+  if (g == nullptr) {
+    fail_convert("Unable to import the model (its IR version may be too old)");
+  }
+  SpecializeGraphShapes(*g, spec);
+  ModelProto specialized = PrepareOutput(mp_in);
+  ExportModelProto(&specialized, g);
+  g.reset();
+
+  shape_inference::InferShapes(specialized);
+  if (passes.empty()) {
+    return specialized;
+  }
+  ModelProto optimized = Optimize(specialized, passes);
+  shape_inference::InferShapes(optimized);
+  return optimized;
+}
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,51 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "onnx/common/ir.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// How to rewrite the dimensions of a model, e.g. to compile one static
+// variant of it per batch size.
+struct ShapeSpecialization {
+  // Symbolic dimensions, by dim_param, to replace wherever they appear: an
+  // int Dimension makes them static, a string one renames them.
+  std::unordered_map<std::string, Dimension> dims;
+  // Dimensions of graph inputs, by input name, as (axis, dimension).
+  std::unordered_map<std::string, std::vector<std::pair<int64_t, Dimension>>>
+      input_dims;
+  // If non-negative, the value of the first dimension of every graph input
+  // (other than initializers) where it is not static already.
+  int64_t batch_size = -1;
+};
+
+// Rewrites the dimensions of g's inputs as `spec` says. A symbolic input
+// dimension given a new value is replaced everywhere it appears in g and
+// its subgraphs, so the shapes of other Values stay consistent. Fails with
+// an InferenceError if one dim_param would get two different values or an
+// axis is out of range.
+void SpecializeGraphShapes(Graph& g, const ShapeSpecialization& spec);
+
+// The passes whose rewrites depend on Value::sizes() being static.
+std::vector<std::string> GetShapeDependentPasses();
+
+// Specializes the shapes of mp_in, then propagates them with shape
+// inference and runs `passes` (by default the shape dependent ones) on the
+// result. Shapes are inferred again after the passes, so every Value
+// whose shape follows from static inputs has a static shape.
+ModelProto SpecializeShapes(
+    const ModelProto& mp_in,
+    const ShapeSpecialization& spec,
+    const std::vector<std::string>& passes = GetShapeDependentPasses());
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
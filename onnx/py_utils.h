@@ -1,6 +1,9 @@
 #pragma once
 
 #include <pybind11/pybind11.h>
+#include <cstring>
+#include <memory>
+#include <vector>
 #include "onnx/proto_utils.h"
 
 namespace ONNX_NAMESPACE {
@@ -15,4 +18,53 @@ bool ParseProtoFromPyBytes(Proto* proto, const py::bytes& bytes) {
 
   return ParseProtoFromBytes(proto, buffer, length);
 }
+
+// A ZeroCopyOutputStream that collects its output in fixed-size blocks,
+// so that serializing a large model never reallocates and copies a
+// growing buffer. ToPyBytes() then makes a bytes object of the exact size.
+class PyBytesOutputStream final
+    : public ::google::protobuf::io::ZeroCopyOutputStream {
+ public:
+  bool Next(void** data, int* size) override {
+    blocks_.emplace_back(std::unique_ptr<char[]>(new char[kBlockSize]), kBlockSize);
+    *data = blocks_.back().first.get();
+    *size = kBlockSize;
+    byte_count_ += kBlockSize;
+    return true;
+  }
+
+  void BackUp(int count) override {
+    blocks_.back().second -= count;
+    byte_count_ -= count;
+  }
+
+  int64_t ByteCount() const override {
+    return byte_count_;
+  }
+
+  // Copies the output into a new bytes object, freeing each block once it
+  // has been copied.
+  py::bytes ToPyBytes() {
+    py::bytes bytes = py::reinterpret_steal<py::bytes>(
+        PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(byte_count_)));
+    if (!bytes) {
+      throw py::error_already_set();
+    }
+    char* out = PyBytes_AS_STRING(bytes.ptr());
+    for (auto& block : blocks_) {
+      std::memcpy(out, block.first.get(), block.second);
+      out += block.second;
+      block.first.reset();
+    }
+    blocks_.clear();
+    byte_count_ = 0;
+    return bytes;
+  }
+
+ private:
+  enum { kBlockSize = 4 << 20 };
+
+  std::vector<std::pair<std::unique_ptr<char[]>, int>> blocks_;
+  int64_t byte_count_ = 0;
+};
 } // namespace ONNX_NAMESPACE
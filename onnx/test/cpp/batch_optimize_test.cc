@@ -0,0 +1,157 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "onnx/onnx_pb.h"
+#include "onnx/optimizer/batch_optimize.h"
+#include "onnx/proto_utils.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+TEST(BatchOptimizeTest, MemoryBudgetAdmission) {
+  optimization::MemoryBudget budget(100);
+  budget.acquire(60);
+  std::atomic<bool> admitted(false);
+  std::thread waiter([&]() {
+    budget.acquire(50);
+    admitted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(admitted);
+  budget.release(60);
+  waiter.join();
+  EXPECT_TRUE(admitted);
+  EXPECT_EQ(budget.in_use(), 50);
+  budget.release(50);
+
+  // A request over the capacity still runs, alone.
+  budget.acquire(500);
+  EXPECT_EQ(budget.in_use(), 500);
+  budget.release(500);
+}
+
+TEST(BatchOptimizeTest, MemoryBudgetCountsMeasuredMemory) {
+  std::atomic<size_t> measured(80);
+  optimization::MemoryBudget budget(100, [&]() { return measured.load(); });
+  budget.acquire(10);
+  budget.acquire(5);
+  std::atomic<bool> admitted(false);
+  std::thread waiter([&]() {
+    budget.acquire(30);
+    admitted = true;
+  });
+  // 15 bytes are requested, but 80 are measured.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(admitted);
+  measured = 40;
+  budget.release(5);
+  waiter.join();
+  EXPECT_TRUE(admitted);
+  EXPECT_EQ(budget.in_use(), 40);
+  budget.release(40);
+
+#ifdef __linux__
+  EXPECT_GT(optimization::ResidentMemoryBytes(), 0);
+#endif
+}
+
+// x -> Identity -> Relu -> y
+static void WriteModel(const std::string& path) {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("test");
+  for (ValueInfoProto* info : {graph->add_input(), graph->add_output()}) {
+    auto* tensor_type = info->mutable_type()->mutable_tensor_type();
+    tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+    tensor_type->mutable_shape()->add_dim()->set_dim_value(4);
+  }
+  graph->mutable_input(0)->set_name("x");
+  graph->mutable_output(0)->set_name("y");
+  NodeProto* identity = graph->add_node();
+  identity->set_op_type("Identity");
+  identity->add_input("x");
+  identity->add_output("i");
+  NodeProto* relu = graph->add_node();
+  relu->set_op_type("Relu");
+  relu->add_input("i");
+  relu->add_output("y");
+  std::ofstream out(path, std::ios::binary);
+  model.SerializeToOstream(&out);
+}
+
+TEST(BatchOptimizeTest, RunsJobsAndReportsFailures) {
+  WriteModel("batch_optimize_test_a.onnx");
+  WriteModel("batch_optimize_test_b.onnx");
+  std::ofstream("batch_optimize_test_bad.onnx") << "not a model";
+  const std::vector<optimization::BatchJob> jobs = {
+      {"batch_optimize_test_a.onnx", "batch_optimize_test_a.out.onnx"},
+      {"batch_optimize_test_bad.onnx", "batch_optimize_test_bad.out.onnx"},
+      {"batch_optimize_test_missing.onnx", "batch_optimize_test_c.out.onnx"},
+      {"batch_optimize_test_b.onnx", "batch_optimize_test_b.out.onnx"}};
+  optimization::BatchOptimizeOptions options;
+  options.passes = {"eliminate_identity"};
+  options.num_threads = 2;
+  options.memory_budget = 1;
+  const std::vector<optimization::BatchResult> results =
+      optimization::RunBatch(jobs, options);
+
+  ASSERT_EQ(results.size(), 4);
+  for (size_t i : {0, 3}) {
+    EXPECT_TRUE(results[i].ok) << results[i].error;
+    ASSERT_EQ(results[i].stage_ms.size(), 5);
+    EXPECT_EQ(results[i].stage_ms[2].first, "infer_shapes");
+    EXPECT_EQ(results[i].stage_ms[3].first, "optimize");
+    std::ifstream in(results[i].output, std::ios::binary);
+    ModelProto model;
+    ASSERT_TRUE(model.ParseFromIstream(&in));
+    ASSERT_EQ(model.graph().node_size(), 1);
+    EXPECT_EQ(model.graph().node(0).op_type(), "Relu");
+    EXPECT_EQ(results[i].output_bytes, model.ByteSizeLong());
+  }
+  EXPECT_FALSE(results[1].ok);
+  EXPECT_EQ(results[1].failed_stage, "load");
+  EXPECT_FALSE(results[2].ok);
+  EXPECT_EQ(results[2].error, "cannot open batch_optimize_test_missing.onnx");
+
+  std::ostringstream json;
+  optimization::WriteBatchResultsJson(json, results);
+  EXPECT_NE(
+      json.str().find("\"input\": \"batch_optimize_test_a.onnx\", "
+                      "\"output\": \"batch_optimize_test_a.out.onnx\", "
+                      "\"status\": \"ok\""),
+      std::string::npos);
+  EXPECT_NE(
+      json.str().find("\"status\": \"failed\", \"failed_stage\": \"load\""),
+      std::string::npos);
+
+  for (const char* path :
+       {"batch_optimize_test_a.onnx",
+        "batch_optimize_test_b.onnx",
+        "batch_optimize_test_bad.onnx",
+        "batch_optimize_test_a.out.onnx",
+        "batch_optimize_test_b.out.onnx"}) {
+    std::remove(path);
+  }
+}
+
+#ifdef __linux__
+// Writes to /dev/full only fail when the buffered bytes are flushed.
+TEST(BatchOptimizeTest, ReportsFailedFlush) {
+  WriteModel("batch_optimize_test_full.onnx");
+  optimization::BatchOptimizeOptions options;
+  optimization::MemoryBudget budget(0);
+  const optimization::BatchResult result = optimization::RunBatchJob(
+      {"batch_optimize_test_full.onnx", "/dev/full"}, options, budget);
+  EXPECT_FALSE(result.ok);
+  EXPECT_EQ(result.failed_stage, "save");
+  std::remove("batch_optimize_test_full.onnx");
+}
+#endif
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
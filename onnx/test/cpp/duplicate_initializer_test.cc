@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/optimizer/pass_registry.h"
+#include "onnx/test/cpp/tensor_test_utils.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+TEST(DuplicateInitializerTest, MergesEqualInitializers) {
+  std::shared_ptr<Graph> g(new Graph());
+  Value* x = g->addInput();
+  x->setUniqueName("x");
+  x->setElemType(TensorProto_DataType_FLOAT);
+  x->setSizes({Dimension(3)});
+  Value* a = g->addInitializerAndInput(FloatTensor({1, 2, 3}, true), "a");
+  Value* b = g->addInitializerAndInput(FloatTensor({1, 2, 3}, true), "b");
+  Value* c = g->addInitializerAndInput(FloatTensor({1, 2, -3}, true), "c");
+  Value* d = g->addInitializerAndInput(FloatTensor({1, 2, 3}, false), "d");
+  Value* e = g->addInitializerAndInput(FloatTensor({1, 2, 3}, false), "e");
+  Value* f = g->addInitializerAndInput(FloatTensor({1, 2, 3}, true), "f");
+
+  // y = x + a + b + c + d + e; f is an output.
+  Value* sum = x;
+  for (Value* v : {a, b, c, d, e}) {
+    Node* add = g->create(Symbol("Add"));
+    add->addInput(sum);
+    add->addInput(v);
+    g->appendNode(add);
+    sum = add->output();
+    sum->setUniqueName("sum_" + v->uniqueName());
+  }
+  g->registerOutput(sum);
+  g->registerOutput(f);
+
+  optimization::GlobalPassRegistry registry;
+  auto analysis = std::static_pointer_cast<
+      optimization::DuplicateInitializerAnalysis>(
+      registry.find("eliminate_duplicate_initializer")->runPass(*g));
+  // d and e hold the same data as a, in the typed field rather than in
+  // raw_data.
+  ASSERT_EQ(analysis->replaced.size(), 3);
+  EXPECT_EQ(analysis->replaced[0], std::make_pair(std::string("b"), std::string("a")));
+  EXPECT_EQ(analysis->replaced[1], std::make_pair(std::string("d"), std::string("a")));
+  EXPECT_EQ(analysis->replaced[2], std::make_pair(std::string("e"), std::string("a")));
+  EXPECT_EQ(analysis->bytes_saved, 3 * 3 * sizeof(float));
+
+  EXPECT_EQ(
+      g->initializer_names(),
+      (std::vector<std::string>{"a", "c", "f"}));
+  ASSERT_EQ(g->inputs().size(), 4);
+  for (size_t i = 0; i < g->inputs().size(); ++i) {
+    EXPECT_EQ(g->inputs()[i]->offset(), i);
+  }
+  EXPECT_EQ(g->inputs()[3]->uniqueName(), "f");
+  std::vector<std::string> operands;
+  for (Node* n : g->nodes()) {
+    operands.push_back(n->inputs()[1]->uniqueName());
+  }
+  EXPECT_EQ(operands, (std::vector<std::string>{"a", "a", "c", "a", "a"}));
+
+  ModelProto model;
+  ExportModelProto(&model, g);
+  EXPECT_EQ(model.graph().initializer_size(), 3);
+  EXPECT_EQ(model.graph().input_size(), 4);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,205 @@
+#include <iostream>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "onnx/common/graph_diff.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+// x -> Mul(w) -> LeakyRelu -> Add(b) -> Softmax -> y
+static ModelProto CreateModel() {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("test");
+  for (const char* name : {"x", "w", "b"}) {
+    ValueInfoProto* input = graph->add_input();
+    input->set_name(name);
+    auto* tensor_type = input->mutable_type()->mutable_tensor_type();
+    tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+    tensor_type->mutable_shape()->add_dim()->set_dim_value(4);
+  }
+  for (const char* name : {"w", "b"}) {
+    TensorProto* t = graph->add_initializer();
+    t->set_name(name);
+    t->set_data_type(TensorProto_DataType_FLOAT);
+    t->add_dims(4);
+    for (float v : {1.f, 2.f, 3.f, 4.f}) {
+      t->add_float_data(v);
+    }
+  }
+  auto add_node = [graph](
+                      const std::string& op_type,
+                      const std::vector<std::string>& inputs,
+                      const std::string& output) {
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op_type);
+    for (const auto& input : inputs) {
+      node->add_input(input);
+    }
+    node->add_output(output);
+    return node;
+  };
+  add_node("Mul", {"x", "w"}, "m");
+  AttributeProto* alpha = add_node("LeakyRelu", {"m"}, "r")->add_attribute();
+  alpha->set_name("alpha");
+  alpha->set_type(AttributeProto::FLOAT);
+  alpha->set_f(0.1f);
+  add_node("Add", {"r", "b"}, "a");
+  add_node("Softmax", {"a"}, "y");
+  graph->add_output()->set_name("y");
+  return model;
+}
+
+static GraphDiff Diff(
+    const ModelProto& before,
+    const ModelProto& after,
+    const GraphDiffOptions& options = GraphDiffOptions()) {
+  std::unique_ptr<Graph> a(ImportModelProto(before));
+  std::unique_ptr<Graph> b(ImportModelProto(after));
+  GraphDiff diff = DiffGraphs(*a, *b, options);
+  // The Graphs go away; only keep what the tests look at.
+  for (auto& d : diff.modified) {
+    d.before = d.after = nullptr;
+  }
+  diff.removed.assign(diff.removed.size(), nullptr);
+  diff.added.assign(diff.added.size(), nullptr);
+  return diff;
+}
+
+TEST(GraphDiffTest, EqualModelsHaveNoDiff) {
+  ModelProto renamed = CreateModel();
+  renamed.mutable_graph()->mutable_node(1)->set_output(0, "relu");
+  renamed.mutable_graph()->mutable_node(2)->set_input(0, "relu");
+  GraphDiff diff = Diff(CreateModel(), renamed);
+  EXPECT_TRUE(diff.empty());
+  EXPECT_EQ(diff.num_unchanged, 4);
+}
+
+TEST(GraphDiffTest, ReportsChangedAttributesOnly) {
+  ModelProto after = CreateModel();
+  after.mutable_graph()->mutable_node(1)->mutable_attribute(0)->set_f(0.2f);
+  std::unique_ptr<Graph> a(ImportModelProto(CreateModel()));
+  std::unique_ptr<Graph> b(ImportModelProto(after));
+  GraphDiff diff = DiffGraphs(*a, *b);
+  // The nodes after the LeakyRelu are matched through their inputs.
+  ASSERT_EQ(diff.modified.size(), 1);
+  EXPECT_EQ(diff.modified[0].before->kind(), Symbol("LeakyRelu"));
+  EXPECT_EQ(diff.modified[0].attributes, std::vector<std::string>{"alpha"});
+  EXPECT_FALSE(diff.modified[0].inputs_changed);
+  EXPECT_EQ(diff.num_unchanged, 3);
+  EXPECT_TRUE(diff.added.empty());
+  EXPECT_TRUE(diff.removed.empty());
+
+  std::ostringstream out;
+  PrintGraphDiff(out, diff);
+  EXPECT_EQ(
+      out.str(),
+      "~ node LeakyRelu -> r: attributes alpha\n"
+      "3 nodes unchanged, 1 modified, 0 removed, 0 added, "
+      "0 initializers changed\n");
+}
+
+TEST(GraphDiffTest, ReportsAddedAndRemovedNodes) {
+  // Remove the Softmax and return the Add's output through an Identity.
+  ModelProto after = CreateModel();
+  GraphProto* graph = after.mutable_graph();
+  graph->mutable_node()->RemoveLast();
+  NodeProto* identity = graph->add_node();
+  identity->set_op_type("Identity");
+  identity->add_input("a");
+  identity->add_output("y");
+  GraphDiff diff = Diff(CreateModel(), after);
+  EXPECT_EQ(diff.removed.size(), 1);
+  EXPECT_EQ(diff.added.size(), 1);
+  EXPECT_TRUE(diff.modified.empty());
+  EXPECT_EQ(diff.num_unchanged, 3);
+}
+
+TEST(GraphDiffTest, ComparesInitializersWithTolerance) {
+  ModelProto after = CreateModel();
+  GraphProto* graph = after.mutable_graph();
+  graph->mutable_initializer(0)->set_float_data(1, 2.001f);
+  graph->mutable_initializer(0)->set_float_data(3, 4.5f);
+  // Same values in raw_data compare equal.
+  TensorProto* b = graph->mutable_initializer(1);
+  const float values[] = {1.f, 2.f, 3.f, 4.f};
+  b->clear_float_data();
+  b->set_raw_data(values, sizeof(values));
+
+  GraphDiffOptions options;
+  options.atol = 0.01;
+  GraphDiff diff = Diff(CreateModel(), after, options);
+  EXPECT_EQ(diff.num_unchanged, 4);
+  ASSERT_EQ(diff.initializers.size(), 1);
+  EXPECT_EQ(diff.initializers[0].kind, InitializerDiff::ValuesChanged);
+  EXPECT_EQ(diff.initializers[0].name, "w");
+  EXPECT_EQ(diff.initializers[0].num_mismatches, 1);
+  EXPECT_NEAR(diff.initializers[0].max_abs_diff, 0.5, 1e-6);
+
+  graph->mutable_initializer(0)->add_dims(1);
+  diff = Diff(CreateModel(), after, options);
+  ASSERT_EQ(diff.initializers.size(), 1);
+  EXPECT_EQ(diff.initializers[0].kind, InitializerDiff::ShapeChanged);
+}
+
+TEST(GraphDiffTest, ComparesSubgraphsExactly) {
+  // An If of x whose branches return the LeakyRelu output.
+  auto with_if = [](const std::string& else_op) {
+    ModelProto model = CreateModel();
+    GraphProto* graph = model.mutable_graph();
+    NodeProto* branch = graph->add_node();
+    branch->set_op_type("If");
+    branch->add_input("x");
+    branch->add_output("z");
+    for (const char* name : {"then_branch", "else_branch"}) {
+      AttributeProto* attr = branch->add_attribute();
+      attr->set_name(name);
+      attr->set_type(AttributeProto::GRAPH);
+      GraphProto* body = attr->mutable_g();
+      NodeProto* node = body->add_node();
+      node->set_op_type(
+          std::string(name) == "else_branch" ? else_op : "Identity");
+      node->add_input("r");
+      node->add_output(std::string(name) + "_out");
+      body->add_output()->set_name(std::string(name) + "_out");
+    }
+    graph->add_output()->set_name("z");
+    return model;
+  };
+  GraphDiff diff = Diff(with_if("Identity"), with_if("Identity"));
+  EXPECT_TRUE(diff.empty());
+  EXPECT_EQ(diff.num_unchanged, 5);
+
+  diff = Diff(with_if("Identity"), with_if("Neg"));
+  ASSERT_EQ(diff.modified.size(), 1);
+  EXPECT_EQ(
+      diff.modified[0].attributes, std::vector<std::string>{"else_branch"});
+  EXPECT_EQ(diff.num_unchanged, 4);
+}
+
+TEST(GraphDiffTest, MatchesReorderedInputsByName) {
+  // Move x after the initializers, add an input z and turn the b
+  // initializer into a plain input.
+  ModelProto after = CreateModel();
+  GraphProto* graph = after.mutable_graph();
+  *graph->add_input() = graph->input(0);
+  graph->mutable_input()->DeleteSubrange(0, 1);
+  *graph->add_input() = graph->input(0);
+  graph->mutable_input(3)->set_name("z");
+  graph->mutable_initializer()->RemoveLast();
+  GraphDiff diff = Diff(CreateModel(), after);
+  EXPECT_EQ(diff.added_inputs, std::vector<std::string>({"b", "z"}));
+  EXPECT_TRUE(diff.removed_inputs.empty());
+  ASSERT_EQ(diff.initializers.size(), 1);
+  EXPECT_EQ(diff.initializers[0].kind, InitializerDiff::Removed);
+  EXPECT_EQ(diff.initializers[0].name, "b");
+  EXPECT_TRUE(diff.removed.empty());
+  EXPECT_TRUE(diff.added.empty());
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,196 @@
+#include <cstring>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "onnx/common/graph_hash.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+// x -> Relu -> Add(w) -> y, where w is an initializer, and an If whose
+// branch captures the Relu output. `prefix` is prepended to every name.
+static ModelProto CreateModel(const std::string& prefix, bool raw) {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name(prefix + "graph");
+  for (const char* name : {"x", "w", "cond"}) {
+    ValueInfoProto* input = graph->add_input();
+    input->set_name(prefix + name);
+    auto* tensor_type = input->mutable_type()->mutable_tensor_type();
+    tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+    tensor_type->mutable_shape()->add_dim()->set_dim_param(prefix + "N");
+  }
+
+  TensorProto* w = graph->add_initializer();
+  w->set_name(prefix + "w");
+  w->set_data_type(TensorProto_DataType_INT8);
+  w->add_dims(3);
+  const int8_t values[] = {1, -2, 3};
+  if (raw) {
+    w->set_raw_data(values, sizeof(values));
+  } else {
+    for (int8_t v : values) {
+      w->add_int32_data(v);
+    }
+  }
+
+  NodeProto* relu = graph->add_node();
+  relu->set_op_type("Relu");
+  relu->set_name(prefix + "relu");
+  relu->add_input(prefix + "x");
+  relu->add_output(prefix + "r");
+
+  NodeProto* add = graph->add_node();
+  add->set_op_type("Add");
+  add->add_input(prefix + "r");
+  add->add_input(prefix + "w");
+  add->add_output(prefix + "y");
+
+  NodeProto* branch = graph->add_node();
+  branch->set_op_type("If");
+  branch->add_input(prefix + "cond");
+  branch->add_output(prefix + "z");
+  for (const char* name : {"then_branch", "else_branch"}) {
+    AttributeProto* attr = branch->add_attribute();
+    attr->set_name(name);
+    attr->set_type(AttributeProto::GRAPH);
+    GraphProto* body = attr->mutable_g();
+    NodeProto* identity = body->add_node();
+    identity->set_op_type("Identity");
+    identity->add_input(prefix + "r");
+    identity->add_output(prefix + name);
+    body->add_output()->set_name(prefix + name);
+  }
+
+  graph->add_output()->set_name(prefix + "y");
+  graph->add_output()->set_name(prefix + "z");
+  return model;
+}
+
+static uint64_t Hash(const ModelProto& model) {
+  std::unique_ptr<Graph> g(ImportModelProto(model));
+  return HashGraph(*g);
+}
+
+TEST(GraphHashTest, HashBytesMatchesXXH64) {
+  EXPECT_EQ(HashBytes("", 0), 0xEF46DB3751D8E999ULL);
+  EXPECT_EQ(HashBytes("abc", 3), 0x44BC2CF5AD770999ULL);
+}
+
+TEST(GraphHashTest, IgnoresNamesAndStorage) {
+  const uint64_t h = Hash(CreateModel("", true));
+  EXPECT_EQ(Hash(CreateModel("renamed_", true)), h);
+  EXPECT_EQ(Hash(CreateModel("", false)), h);
+}
+
+TEST(GraphHashTest, DetectsStructuralChanges) {
+  const uint64_t h = Hash(CreateModel("", true));
+
+  ModelProto model = CreateModel("", true);
+  model.mutable_graph()->mutable_node(0)->set_op_type("Sigmoid");
+  EXPECT_NE(Hash(model), h);
+
+  model = CreateModel("", true);
+  model.mutable_graph()->mutable_initializer(0)->mutable_raw_data()->at(1) = 5;
+  EXPECT_NE(Hash(model), h);
+
+  // The subgraph now captures x instead of the Relu output.
+  model = CreateModel("", true);
+  model.mutable_graph()
+      ->mutable_node(2)
+      ->mutable_attribute(0)
+      ->mutable_g()
+      ->mutable_node(0)
+      ->set_input(0, "x");
+  EXPECT_NE(Hash(model), h);
+
+  model = CreateModel("", true);
+  AttributeProto* attr = model.mutable_graph()->mutable_node(0)->add_attribute();
+  attr->set_name("alpha");
+  attr->set_type(AttributeProto::FLOAT);
+  attr->set_f(0.1f);
+  EXPECT_NE(Hash(model), h);
+}
+
+TEST(GraphHashTest, EqualNodesHashEqual) {
+  ModelProto model = CreateModel("", true);
+  // A second Relu of x, anywhere in the graph, computes the same value.
+  NodeProto* relu = model.mutable_graph()->add_node();
+  relu->set_op_type("Relu");
+  relu->add_input("x");
+  relu->add_output("r2");
+  model.mutable_graph()->add_output()->set_name("r2");
+
+  std::unique_ptr<Graph> g(ImportModelProto(model));
+  GraphHasher hasher(*g);
+  std::vector<Node*> relus;
+  Node* add = nullptr;
+  for (Node* n : g->nodes()) {
+    if (n->kind() == Symbol("Relu")) {
+      relus.push_back(n);
+    } else if (n->kind() == Symbol("Add")) {
+      add = n;
+    }
+  }
+  ASSERT_EQ(relus.size(), 2);
+  EXPECT_EQ(hasher.hash(relus[0]), hasher.hash(relus[1]));
+  EXPECT_EQ(hasher.hash(relus[0]->output()), hasher.hash(relus[1]->output()));
+  EXPECT_NE(hasher.hash(relus[0]), hasher.hash(add));
+}
+
+TEST(GraphHashTest, SameChecksAgreeWithHashes) {
+  std::unique_ptr<Graph> raw(ImportModelProto(CreateModel("", true)));
+  std::unique_ptr<Graph> typed(ImportModelProto(CreateModel("", false)));
+  EXPECT_TRUE(SameTensor(raw->initializers()[0], typed->initializers()[0]));
+  ModelProto model = CreateModel("", true);
+  model.mutable_graph()->mutable_initializer(0)->mutable_raw_data()->at(1) = 5;
+  std::unique_ptr<Graph> changed(ImportModelProto(model));
+  EXPECT_FALSE(SameTensor(raw->initializers()[0], changed->initializers()[0]));
+
+  auto find = [](Graph& g, const char* kind) -> Node* {
+    for (Node* n : g.nodes()) {
+      if (n->kind() == Symbol(kind)) {
+        return n;
+      }
+    }
+    return nullptr;
+  };
+  EXPECT_TRUE(SameLocal(find(*raw, "Relu"), find(*typed, "Relu")));
+  EXPECT_FALSE(SameLocal(find(*raw, "Relu"), find(*typed, "Add")));
+  // The Ifs hold equal subgraphs of distinct Graphs.
+  Node* if_a = find(*raw, "If");
+  Node* if_b = find(*typed, "If");
+  EXPECT_FALSE(SameLocal(if_a, if_b));
+  EXPECT_TRUE(SameLocal(if_a, if_b, [](Graph& g, Graph& h) {
+    return HashGraph(g) == HashGraph(h);
+  }));
+
+  Tensor zero;
+  zero.elem_type() = TensorProto_DataType_FLOAT;
+  zero.floats().push_back(0.f);
+  Tensor negative_zero = zero;
+  negative_zero.floats()[0] = -0.f;
+  EXPECT_FALSE(SameTensor(zero, negative_zero));
+
+  // Data of an unknown type cannot be compared.
+  Tensor unknown = zero;
+  unknown.elem_type() = TensorProto_DataType_UNDEFINED;
+  Tensor other_unknown = negative_zero;
+  other_unknown.elem_type() = TensorProto_DataType_UNDEFINED;
+  EXPECT_FALSE(SameTensor(unknown, other_unknown));
+  EXPECT_FALSE(SameTensor(unknown, unknown));
+
+  Tensor strings;
+  strings.elem_type() = TensorProto_DataType_STRING;
+  strings.strings().push_back("a");
+  Tensor other_strings = strings;
+  EXPECT_TRUE(SameTensor(strings, other_strings));
+  other_strings.strings()[0] = "b";
+  EXPECT_FALSE(SameTensor(strings, other_strings));
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+#include "onnx/checker.h"
+#include "onnx/common/graph_partition.h"
+#include "onnx/common/ir_pb_converter.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+static void SetType(ValueInfoProto* info, const std::string& name, int64_t n) {
+  info->set_name(name);
+  auto* tensor_type = info->mutable_type()->mutable_tensor_type();
+  tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+  tensor_type->mutable_shape()->add_dim()->set_dim_value(n);
+}
+
+// a = Relu(x), b = Add(a, w), c = Relu(b), y = Add(c, a), where x and a
+// have 10 floats and w, b, c and y have 1000.
+static ModelProto CreateModel() {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("chain");
+  SetType(graph->add_input(), "x", 10);
+  SetType(graph->add_input(), "w", 1000);
+  TensorProto* w = graph->add_initializer();
+  w->set_name("w");
+  w->set_data_type(TensorProto_DataType_FLOAT);
+  w->add_dims(1000);
+  for (int i = 0; i < 1000; ++i) {
+    w->add_float_data(1.f);
+  }
+  auto add_node = [graph](
+                      const std::string& op_type,
+                      const std::vector<std::string>& inputs,
+                      const std::string& output,
+                      int64_t n) {
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op_type);
+    for (const auto& input : inputs) {
+      node->add_input(input);
+    }
+    node->add_output(output);
+    if (output != "y") {
+      SetType(graph->add_value_info(), output, n);
+    }
+  };
+  add_node("Relu", {"x"}, "a", 10);
+  add_node("Add", {"a", "w"}, "b", 1000);
+  add_node("Relu", {"b"}, "c", 1000);
+  add_node("Add", {"c", "a"}, "y", 1000);
+  SetType(graph->add_output(), "y", 1000);
+  return model;
+}
+
+static std::vector<size_t> PartitionSizes(const GraphPartitioning& p) {
+  std::vector<size_t> sizes;
+  for (const auto& partition : p.partitions) {
+    sizes.push_back(partition.nodes.size());
+  }
+  return sizes;
+}
+
+TEST(GraphPartitionTest, TradesBalanceForCutBytes) {
+  const ModelProto model = CreateModel();
+  std::shared_ptr<Graph> g = ImportModelProto(model);
+
+  // Balanced halves must pass b (4000 bytes) and a (40 bytes).
+  GraphPartitionOptions options;
+  GraphPartitioning balanced = PartitionGraph(*g, options);
+  EXPECT_EQ(PartitionSizes(balanced), (std::vector<size_t>{2, 2}));
+  EXPECT_EQ(balanced.cut_bytes, 4040);
+  ASSERT_EQ(balanced.partitions[1].inputs.size(), 2);
+  EXPECT_EQ(balanced.partitions[1].inputs[0]->uniqueName(), "b");
+  EXPECT_EQ(balanced.partitions[1].inputs[1]->uniqueName(), "a");
+  EXPECT_EQ(balanced.partitions[0].memory_bytes, 4000);
+
+  // With more slack, cutting after the first node only passes a.
+  options.max_imbalance = 0.5;
+  GraphPartitioning cheap = PartitionGraph(*g, options);
+  EXPECT_EQ(PartitionSizes(cheap), (std::vector<size_t>{1, 3}));
+  EXPECT_EQ(cheap.cut_bytes, 40);
+
+  // a is counted at both boundaries of a three-way split.
+  options.num_partitions = 3;
+  options.max_imbalance = 0;
+  GraphPartitioning three = PartitionGraph(*g, options);
+  EXPECT_EQ(three.cut_bytes, 40 + 40 + 4000);
+}
+
+TEST(GraphPartitionTest, RespectsMemoryCaps) {
+  const ModelProto model = CreateModel();
+  std::shared_ptr<Graph> g = ImportModelProto(model);
+  GraphPartitionOptions options;
+  // w must go to the second partition, so the balance bound is relaxed.
+  options.memory_caps = {100, 0};
+  options.node_cost = [](const Node* n) {
+    return n->kind() == Symbol("Add") ? 2.0 : 1.0;
+  };
+  GraphPartitioning p = PartitionGraph(*g, options);
+  EXPECT_EQ(PartitionSizes(p), (std::vector<size_t>{1, 3}));
+  EXPECT_EQ(p.partitions[0].memory_bytes, 0);
+  EXPECT_EQ(p.partitions[1].cost, 5);
+
+  options.memory_caps = {100, 100};
+  EXPECT_THROW(PartitionGraph(*g, options), assert_error);
+}
+
+TEST(GraphPartitionTest, ExportsStandaloneModels) {
+  const ModelProto model = CreateModel();
+  std::shared_ptr<Graph> g = ImportModelProto(model);
+  GraphPartitioning p = PartitionGraph(*g, GraphPartitionOptions());
+  const std::vector<ModelProto> parts = ExportPartitions(model, g, p);
+  ASSERT_EQ(parts.size(), 2);
+
+  const GraphProto& first = parts[0].graph();
+  ASSERT_EQ(first.input_size(), 2);
+  EXPECT_EQ(first.input(0).name(), "x");
+  EXPECT_EQ(first.input(1).name(), "w");
+  ASSERT_EQ(first.initializer_size(), 1);
+  ASSERT_EQ(first.output_size(), 2);
+  EXPECT_EQ(first.output(0).name(), "a");
+  EXPECT_EQ(first.output(1).name(), "b");
+  EXPECT_EQ(first.value_info_size(), 0);
+
+  const GraphProto& second = parts[1].graph();
+  ASSERT_EQ(second.input_size(), 2);
+  EXPECT_EQ(second.input(0).name(), "b");
+  EXPECT_EQ(second.input(1).name(), "a");
+  EXPECT_EQ(
+      second.input(0).type().tensor_type().shape().dim(0).dim_value(), 1000);
+  EXPECT_EQ(second.initializer_size(), 0);
+  ASSERT_EQ(second.output_size(), 1);
+  EXPECT_EQ(second.output(0).name(), "y");
+  ASSERT_EQ(second.value_info_size(), 1);
+  EXPECT_EQ(second.value_info(0).name(), "c");
+
+  for (const auto& part : parts) {
+    EXPECT_NO_THROW(checker::check_model(part));
+  }
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
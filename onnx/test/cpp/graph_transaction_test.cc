@@ -0,0 +1,234 @@
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "onnx/common/ir.h"
+#include "onnx/optimizer/optimize.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+// Everything rollback must restore: the nodes in order with their names,
+// inputs, outputs and attributes, the use lists in order, the initializers,
+// and the kind index.
+static std::string Describe(Graph& g) {
+  std::ostringstream out;
+  out << g.name() << "\n";
+  auto describe_value = [&out](const Value* v) {
+    out << " " << v << ":" << v->uniqueName() << "@" << v->offset() << "[";
+    for (const Use& use : v->uses()) {
+      out << use.user << "." << use.offset << " ";
+    }
+    out << "]";
+  };
+  for (const Value* v : g.inputs()) {
+    describe_value(v);
+  }
+  out << "\n";
+  for (Node* n : g.nodes()) {
+    out << n << " " << n->kind().toString() << " " << n->name() << " (";
+    for (const Value* v : n->inputs()) {
+      out << " " << v;
+    }
+    out << " ) ->";
+    for (const Value* v : n->outputs()) {
+      describe_value(v);
+    }
+    for (Symbol name : n->attributeNames()) {
+      out << " " << name.toString();
+      if (n->kindOf(name) == AttributeKind::i) {
+        out << "=" << n->i(name);
+      }
+    }
+    out << "\n";
+    auto& same_kind = g.nodesOfKind(n->kind());
+    auto it = same_kind.find(n->position());
+    EXPECT_TRUE(it != same_kind.end() && it->second == n);
+  }
+  for (const Value* v : g.outputs()) {
+    out << " " << v;
+  }
+  out << "\n";
+  for (size_t i = 0; i < g.initializers().size(); i++) {
+    out << g.initializer_names()[i] << "=" << g.initializers()[i].name() << ":"
+        << g.initializers()[i].floats().size() << " ";
+  }
+  out << "\n" << g.numNodes();
+  return out.str();
+}
+
+static Tensor FloatTensor(const std::string& name, size_t n) {
+  Tensor t;
+  t.elem_type() = TensorProto_DataType_FLOAT;
+  t.sizes().push_back(n);
+  t.floats().assign(n, 1.f);
+  t.setName(name);
+  return t;
+}
+
+// x, w0, w1 -> Add -> Relu -> Mul -> Neg -> y, where w0 and w1 are
+// initializers.
+static std::vector<Node*> CreateGraph(Graph& g) {
+  g.setName("graph");
+  Value* x = g.addInput();
+  x->setUniqueName("x");
+  Value* w0 = g.addInitializerAndInput(FloatTensor("w0", 4), "w0");
+  Value* w1 = g.addInitializerAndInput(FloatTensor("w1", 4), "w1");
+  std::vector<Node*> nodes;
+  Value* v = x;
+  for (const char* kind : {"Add", "Relu", "Mul", "Neg"}) {
+    Node* n = g.create(Symbol(kind));
+    n->addInput(v);
+    if (nodes.size() % 2 == 0) {
+      n->addInput(nodes.empty() ? w0 : w1);
+    }
+    n->setName(kind);
+    n->i_(Symbol("index"), nodes.size());
+    g.appendNode(n);
+    nodes.push_back(n);
+    v = n->output();
+  }
+  g.registerOutput(v);
+  return nodes;
+}
+
+TEST(GraphTransactionTest, RollbackRestoresGraph) {
+  Graph g;
+  std::vector<Node*> nodes = CreateGraph(g);
+  const std::string before = Describe(g);
+
+  g.beginTransaction();
+  EXPECT_TRUE(g.inTransaction());
+  g.setName("edited");
+  // Remove the Relu and the second initializer.
+  nodes[1]->output()->replaceAllUsesWith(nodes[1]->input(0));
+  nodes[1]->destroy();
+  nodes[2]->removeInput(1);
+  g.eraseInitializerAndInput(g.inputs()[2]);
+  // Rewrite the other initializer and add one.
+  g.mutableInitializer(0).floats()[0] = 2.f;
+  g.addInitializerAndInput(FloatTensor("w2", 8), "w2");
+  // Edit attributes.
+  nodes[0]->i_(Symbol("index"), 10);
+  nodes[0]->i_(Symbol("extra"), 1);
+  nodes[3]->removeAttribute(Symbol("index"));
+  nodes[2]->copyAttributes(*nodes[3]);
+  nodes[3]->setName("renamed");
+  // Insert enough nodes at one place to relabel the nodes around it.
+  for (int i = 0; i < 50; ++i) {
+    Node* n = g.create(Symbol("Sigmoid"));
+    n->addInput(nodes[0]->output());
+    n->i_(Symbol("index"), i);
+    n->insertAfter(nodes[0]);
+  }
+  nodes[3]->moveBefore(nodes[0]);
+  EXPECT_NE(Describe(g), before);
+  g.rollbackTransaction();
+
+  EXPECT_FALSE(g.inTransaction());
+  EXPECT_EQ(Describe(g), before);
+  EXPECT_TRUE(g.nodesOfKind(Symbol("Sigmoid")).empty());
+  EXPECT_EQ(g.initializers()[0].floats()[0], 1.f);
+
+  // The restored graph can be edited as before.
+  nodes[1]->output()->replaceAllUsesWith(nodes[1]->input(0));
+  nodes[1]->destroy();
+  EXPECT_EQ(g.numNodes(), 3);
+  EXPECT_EQ(nodes[2]->input(0), nodes[0]->output());
+}
+
+TEST(GraphTransactionTest, CommitKeepsEdits) {
+  Graph g;
+  std::vector<Node*> nodes = CreateGraph(g);
+  const std::string before = Describe(g);
+
+  g.beginTransaction();
+  nodes[1]->output()->replaceAllUsesWith(nodes[1]->input(0));
+  nodes[1]->destroy();
+  g.commitTransaction();
+  const std::string committed = Describe(g);
+  EXPECT_NE(committed, before);
+  EXPECT_EQ(g.numNodes(), 3);
+
+  // A later transaction rolls back to the committed graph.
+  g.beginTransaction();
+  nodes[3]->output()->replaceAllUsesWith(nodes[2]->output());
+  nodes[3]->destroy();
+  g.clearInitializers();
+  g.rollbackTransaction();
+  EXPECT_EQ(Describe(g), committed);
+}
+
+TEST(GraphTransactionTest, RollsBackNodeCreatedAndDestroyed) {
+  Graph g;
+  std::vector<Node*> nodes = CreateGraph(g);
+  const std::string before = Describe(g);
+
+  g.beginTransaction();
+  Node* n = g.create(Symbol("Relu"), 1);
+  n->addInput(nodes[0]->output());
+  g.appendNode(n);
+  n->destroy();
+  g.rollbackTransaction();
+
+  EXPECT_EQ(Describe(g), before);
+}
+
+TEST(GraphTransactionTest, RollsBackRepeatedInitializerWrites) {
+  Graph g;
+  CreateGraph(g);
+  g.addInitializerAndInput(FloatTensor("w2", 4), "w2");
+  const std::string before = Describe(g);
+
+  g.beginTransaction();
+  g.mutableInitializer(2).floats()[0] = 2.f;
+  g.mutableInitializer(2).floats()[0] = 3.f;
+  g.mutableInitializer(1).floats()[0] = 6.f;
+  // Erasing w0 shifts w2 to index 1, where it is saved again.
+  g.eraseInitializer("w0");
+  g.mutableInitializer(1).floats()[1] = 4.f;
+  g.mutableInitializer(0).floats()[1] = 5.f;
+  g.rollbackTransaction();
+
+  EXPECT_EQ(Describe(g), before);
+  for (const Tensor& t : g.initializers()) {
+    EXPECT_EQ(t.floats(), std::vector<float>(4, 1.f));
+  }
+}
+
+TEST(GraphTransactionTest, RollsBackPassAndSubgraphs) {
+  Graph g;
+  Value* v = g.addInput();
+  for (const char* kind : {"Identity", "Relu", "Identity", "Neg"}) {
+    Node* n = g.create(Symbol(kind));
+    n->addInput(v);
+    g.appendNode(n);
+    v = n->output();
+  }
+  std::shared_ptr<Graph> body(new Graph());
+  Node* inner = body->create(kIdentity);
+  inner->addInput(body->addInput());
+  body->appendNode(inner);
+  body->registerOutput(inner->output());
+  Node* loop = g.create(Symbol("Loop"));
+  loop->addInput(v);
+  loop->g_(Symbol("body"), body);
+  g.appendNode(loop);
+  g.registerOutput(loop->output());
+  const std::string before = Describe(g);
+  const std::string body_before = Describe(*body);
+
+  g.beginTransaction();
+  EXPECT_TRUE(body->inTransaction());
+  optimization::Optimizer::passes.find("eliminate_identity")->runPass(g);
+  EXPECT_TRUE(g.nodesOfKind(kIdentity).empty());
+  EXPECT_TRUE(body->nodesOfKind(kIdentity).empty());
+  g.rollbackTransaction();
+
+  EXPECT_FALSE(body->inTransaction());
+  EXPECT_EQ(Describe(g), before);
+  EXPECT_EQ(Describe(*body), body_before);
+  EXPECT_EQ(g.nodesOfKind(kIdentity).size(), 2);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,283 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "onnx/common/ir_binary_format.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/common/sparsity.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+static void SetTensorType(ValueInfoProto* value_info, const std::string& name) {
+  value_info->set_name(name);
+  auto* tensor_type = value_info->mutable_type()->mutable_tensor_type();
+  tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+  tensor_type->mutable_shape()->add_dim()->set_dim_param("N");
+  tensor_type->mutable_shape()->add_dim()->set_dim_value(4);
+}
+
+// Exercises every attribute kind, both tensor encodings, an optional
+// input left empty and a subgraph that captures an outer value.
+static ModelProto CreateTestModel() {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.set_producer_name("ir_binary_format_test");
+  model.add_opset_import()->set_version(9);
+  auto* prop = model.add_metadata_props();
+  prop->set_key("key");
+  prop->set_value("value");
+
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("test");
+  graph->set_doc_string("doc");
+  SetTensorType(graph->add_input(), "x");
+  SetTensorType(graph->add_input(), "w");
+
+  TensorProto* w = graph->add_initializer();
+  w->set_name("w");
+  w->set_data_type(TensorProto_DataType_FLOAT);
+  w->add_dims(4);
+  const float values[] = {1.f, 2.f, 3.f, 4.f};
+  w->set_raw_data(values, sizeof(values));
+
+  NodeProto* constant = graph->add_node();
+  constant->set_op_type("Constant");
+  constant->add_output("c");
+  AttributeProto* value = constant->add_attribute();
+  value->set_name("value");
+  value->set_type(AttributeProto::TENSOR);
+  value->mutable_t()->set_data_type(TensorProto_DataType_INT64);
+  value->mutable_t()->add_dims(2);
+  value->mutable_t()->add_int64_data(7);
+  value->mutable_t()->add_int64_data(-7);
+
+  NodeProto* custom = graph->add_node();
+  custom->set_op_type("Custom");
+  custom->set_domain("test.domain");
+  custom->set_name("custom");
+  custom->set_doc_string("custom node");
+  custom->add_input("x");
+  custom->add_input("");
+  custom->add_input("w");
+  custom->add_output("y");
+  auto add_attr = [custom](const std::string& name, AttributeProto::AttributeType type) {
+    AttributeProto* attr = custom->add_attribute();
+    attr->set_name(name);
+    attr->set_type(type);
+    return attr;
+  };
+  add_attr("f", AttributeProto::FLOAT)->set_f(0.5f);
+  auto* fs = add_attr("fs", AttributeProto::FLOATS);
+  fs->add_floats(1.f);
+  fs->add_floats(2.f);
+  add_attr("i", AttributeProto::INT)->set_i(-3);
+  auto* is = add_attr("is", AttributeProto::INTS);
+  is->add_ints(4);
+  is->add_ints(5);
+  add_attr("s", AttributeProto::STRING)->set_s("string");
+  auto* ss = add_attr("ss", AttributeProto::STRINGS);
+  ss->add_strings("a");
+  ss->add_strings("string");
+  auto* ts = add_attr("ts", AttributeProto::TENSORS);
+  TensorProto* strings = ts->add_tensors();
+  strings->set_data_type(TensorProto_DataType_STRING);
+  strings->add_dims(1);
+  strings->add_string_data("text");
+  TensorProto* doubles = ts->add_tensors();
+  doubles->set_data_type(TensorProto_DataType_DOUBLE);
+  doubles->add_dims(1);
+  doubles->add_double_data(2.5);
+  GraphProto* body = add_attr("g", AttributeProto::GRAPH)->mutable_g();
+  body->set_name("body");
+  NodeProto* identity = body->add_node();
+  identity->set_op_type("Identity");
+  identity->add_input("c");
+  identity->add_output("out");
+  SetTensorType(body->add_output(), "out");
+  auto* gs = add_attr("gs", AttributeProto::GRAPHS);
+  gs->add_graphs()->CopyFrom(*body);
+  gs->add_graphs()->CopyFrom(*body);
+
+  SetTensorType(graph->add_output(), "y");
+  return model;
+}
+
+class IRBinaryFormatTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = testing::TempDir() + "ir_binary_format_test.onnxb";
+  }
+  void TearDown() override {
+    std::remove(path_.c_str());
+  }
+
+  std::string path_;
+};
+
+TEST_F(IRBinaryFormatTest, RoundTripMatchesProtobufRoundTrip) {
+  ModelProto model = CreateTestModel();
+  std::shared_ptr<Graph> g(ImportModelProto(model));
+  ModelProto expected = PrepareOutput(model);
+  ExportModelProto(&expected, g);
+
+  ModelProtoToGraphBinary(model, path_);
+  ModelProto actual = GraphBinaryToModelProto(path_);
+  EXPECT_EQ(actual.SerializeAsString(), expected.SerializeAsString());
+  EXPECT_EQ(actual.producer_name(), "ir_binary_format_test");
+  ASSERT_EQ(actual.metadata_props_size(), 1);
+  EXPECT_EQ(actual.graph().node(1).input(1), "");
+}
+
+TEST_F(IRBinaryFormatTest, RawDataIsMappedNotCopied) {
+  ModelProtoToGraphBinary(CreateTestModel(), path_);
+  std::unique_ptr<Graph> g = LoadGraphBinary(path_);
+  ASSERT_EQ(g->initializers().size(), 1);
+  const Tensor& w = g->initializers()[0];
+  EXPECT_TRUE(w.has_external_raw_data());
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(w.raw_data_ptr()) % 64, 0);
+  EXPECT_EQ(w.data<float>()[3], 4.f);
+
+  // Mutation copies the data; the file is left untouched.
+  Tensor copy = w;
+  copy.data<float>()[3] = 8.f;
+  EXPECT_FALSE(copy.has_external_raw_data());
+  EXPECT_EQ(w.data<float>()[3], 4.f);
+  std::unique_ptr<Graph> reloaded = LoadGraphBinary(path_);
+  EXPECT_EQ(reloaded->initializers()[0].data<float>()[3], 4.f);
+}
+
+TEST_F(IRBinaryFormatTest, SparseTensorsStaySparse) {
+  std::shared_ptr<Graph> g(ImportModelProto(CreateTestModel()));
+  std::vector<float> dense(64 * 64, 0.f);
+  dense[5] = 1.f;
+  dense[4000] = -2.f;
+  Tensor s;
+  s.setName("s");
+  s.elem_type() = TensorProto_DataType_FLOAT;
+  s.sizes() = {64, 64};
+  s.set_raw_data(std::string(
+      reinterpret_cast<const char*>(dense.data()),
+      dense.size() * sizeof(float)));
+  ASSERT_TRUE(SparsifyTensor(s, 0.5));
+  g->addInitializer(s, "s");
+  SaveGraphBinary(path_, g);
+
+  std::unique_ptr<Graph> loaded = LoadGraphBinary(path_);
+  ASSERT_EQ(loaded->initializers().size(), 2);
+  const Tensor& t = loaded->initializers()[1];
+  ASSERT_TRUE(t.is_sparse());
+  EXPECT_EQ(t.sparse_indices(), (std::vector<int64_t>{5, 4000}));
+  EXPECT_TRUE(t.sparse_values().has_external_raw_data());
+  EXPECT_EQ(t.sizes(), (std::vector<int64_t>{64, 64}));
+  const float* data = t.data<float>();
+  EXPECT_FALSE(t.is_sparse());
+  EXPECT_EQ(std::vector<float>(data, data + dense.size()), dense);
+}
+
+TEST_F(IRBinaryFormatTest, RejectsBadSparseTensors) {
+  auto values = [](int32_t elem_type, std::vector<int64_t> sizes) {
+    Tensor v;
+    v.elem_type() = elem_type;
+    v.sizes() = sizes;
+    v.set_raw_data(std::string(8, '\0'));
+    return v;
+  };
+  auto sparse = [](Tensor v, std::vector<int64_t> indices) {
+    Tensor t;
+    t.elem_type() = v.elem_type();
+    t.sizes() = {8};
+    t.set_sparse_data(std::move(v), std::move(indices));
+    return t;
+  };
+  auto load = [this](const Tensor& t) {
+    std::shared_ptr<Graph> g(ImportModelProto(CreateTestModel()));
+    g->addInitializer(t, "s");
+    SaveGraphBinary(path_, g);
+    LoadGraphBinary(path_);
+  };
+  const int32_t kFloat = TensorProto_DataType_FLOAT;
+  load(sparse(values(kFloat, {2}), {1, 6}));
+  // Values that are sparse themselves.
+  Tensor nested = sparse(values(kFloat, {2}), {1, 6});
+  nested.sizes() = {2};
+  EXPECT_THROW(load(sparse(nested, {1, 6})), ConvertError);
+  // Values of another type or shape, and indices out of order.
+  Tensor other_type = sparse(values(kFloat, {2}), {1, 6});
+  other_type.elem_type() = TensorProto_DataType_DOUBLE;
+  EXPECT_THROW(load(other_type), ConvertError);
+  EXPECT_THROW(load(sparse(values(kFloat, {1, 2}), {1, 6})), ConvertError);
+  EXPECT_THROW(load(sparse(values(kFloat, {2}), {1, 6, 7})), ConvertError);
+  EXPECT_THROW(load(sparse(values(kFloat, {2}), {6, 1})), ConvertError);
+  EXPECT_THROW(load(sparse(values(kFloat, {2}), {1, 1})), ConvertError);
+}
+
+TEST_F(IRBinaryFormatTest, RejectsCorruptFiles) {
+  ModelProtoToGraphBinary(CreateTestModel(), path_);
+  std::string contents;
+  {
+    std::ifstream in(path_, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  // Truncate the file right after the header.
+  {
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), 80);
+  }
+  EXPECT_THROW(LoadGraphBinary(path_), ConvertError);
+  // Bad magic.
+  contents[0] = 'X';
+  {
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size());
+  }
+  EXPECT_THROW(LoadGraphBinary(path_), ConvertError);
+}
+
+TEST_F(IRBinaryFormatTest, RejectsBadGraphTables) {
+  ModelProtoToGraphBinary(CreateTestModel(), path_);
+  std::string contents;
+  {
+    std::ifstream in(path_, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  auto load = [&](const std::string& file) {
+    {
+      std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+      out.write(file.data(), file.size());
+    }
+    LoadGraphBinary(path_);
+  };
+  // The header's graph count, then the graph section offset.
+  const size_t num_graphs_at = 12;
+  const size_t graphs_offset_at = 32;
+  uint64_t graphs_offset;
+  std::memcpy(&graphs_offset, &contents[graphs_offset_at], sizeof(graphs_offset));
+
+  // A count that cannot fit in the section is rejected before allocating.
+  std::string huge_count = contents;
+  const uint32_t num_graphs = 0xFFFFFFFFu;
+  std::memcpy(&huge_count[num_graphs_at], &num_graphs, sizeof(num_graphs));
+  EXPECT_THROW(load(huge_count), ConvertError);
+
+  // The first subgraph's record is the root's, whose node refers to the
+  // first subgraph again.
+  std::string cycle = contents;
+  std::memcpy(&cycle[graphs_offset + 8], &cycle[graphs_offset], 8);
+  EXPECT_THROW(load(cycle), ConvertError);
+
+  // The gs attribute refers to its first graph twice.
+  const std::string gs_indices("\x02\0\0\0\0\0\0\0\x02\0\0\0\x03\0\0\0", 16);
+  const size_t gs_at = contents.find(gs_indices);
+  ASSERT_NE(gs_at, std::string::npos);
+  std::string shared = contents;
+  shared[gs_at + 12] = '\x02';
+  EXPECT_THROW(load(shared), ConvertError);
+
+  load(contents);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,305 @@
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "gtest/gtest.h"
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+static void SetTensorType(ValueInfoProto* value_info, int64_t dim) {
+  auto* tensor_type = value_info->mutable_type()->mutable_tensor_type();
+  tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+  tensor_type->mutable_shape()->add_dim()->set_dim_value(dim);
+}
+
+static void AddFloatInitializer(
+    GraphProto* graph,
+    const std::string& name,
+    int64_t size,
+    bool raw) {
+  TensorProto* t = graph->add_initializer();
+  t->set_name(name);
+  t->set_data_type(TensorProto_DataType_FLOAT);
+  t->add_dims(size);
+  std::vector<float> values(size);
+  for (int64_t i = 0; i < size; ++i) {
+    values[i] = static_cast<float>(i) * 0.5f;
+  }
+  if (raw) {
+    t->set_raw_data(values.data(), values.size() * sizeof(float));
+  } else {
+    for (float v : values) {
+      t->add_float_data(v);
+    }
+  }
+  SetTensorType(graph->add_input(), size);
+  graph->mutable_input(graph->input_size() - 1)->set_name(name);
+}
+
+// A model with initializers in both encodings, a Constant node and an If
+// node whose branches capture values from the enclosing graph.
+static ModelProto CreateTestModel(int num_layers) {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("test");
+  SetTensorType(graph->add_input(), 4);
+  graph->mutable_input(0)->set_name("x0");
+  SetTensorType(graph->add_input(), 1);
+  graph->mutable_input(1)->set_name("cond");
+  graph->mutable_input(1)
+      ->mutable_type()
+      ->mutable_tensor_type()
+      ->set_elem_type(TensorProto_DataType_BOOL);
+
+  for (int i = 0; i < num_layers; ++i) {
+    const std::string idx = std::to_string(i);
+    AddFloatInitializer(graph, "w" + idx, 4, i % 2 == 0);
+
+    NodeProto* constant = graph->add_node();
+    constant->set_op_type("Constant");
+    constant->add_output("c" + idx);
+    AttributeProto* value = constant->add_attribute();
+    value->set_name("value");
+    value->set_type(AttributeProto::TENSOR);
+    value->mutable_t()->set_data_type(TensorProto_DataType_INT64);
+    value->mutable_t()->add_dims(2);
+    value->mutable_t()->add_int64_data(i);
+    value->mutable_t()->add_int64_data(-i);
+
+    NodeProto* mul = graph->add_node();
+    mul->set_op_type("Mul");
+    mul->set_name("mul" + idx);
+    mul->add_input("x" + idx);
+    mul->add_input("w" + idx);
+    mul->add_output("y" + idx);
+
+    NodeProto* branch = graph->add_node();
+    branch->set_op_type("If");
+    branch->add_input("cond");
+    branch->add_output("x" + std::to_string(i + 1));
+    for (const char* name : {"then_branch", "else_branch"}) {
+      AttributeProto* attr = branch->add_attribute();
+      attr->set_name(name);
+      attr->set_type(AttributeProto::GRAPH);
+      GraphProto* body = attr->mutable_g();
+      body->set_name(name);
+      NodeProto* identity = body->add_node();
+      identity->set_op_type("Identity");
+      // Captured from the enclosing graph.
+      identity->add_input("y" + idx);
+      identity->add_output("out");
+      SetTensorType(body->add_output(), 4);
+      body->mutable_output(0)->set_name("out");
+    }
+  }
+  SetTensorType(graph->add_output(), 4);
+  graph->mutable_output(0)->set_name("x" + std::to_string(num_layers));
+  return model;
+}
+
+static std::string RoundTrip(
+    const ModelProto& model,
+    size_t import_threads,
+    size_t export_threads) {
+  std::shared_ptr<Graph> g(ImportModelProto(model, import_threads));
+  EXPECT_TRUE(g != nullptr);
+  ModelProto exported;
+  ExportModelProto(&exported, g, export_threads);
+  return exported.SerializeAsString();
+}
+
+TEST(IRConverterTest, RoundTripPreservesInitializers) {
+  ModelProto model = CreateTestModel(3);
+  std::shared_ptr<Graph> g(ImportModelProto(model));
+  ASSERT_EQ(g->initializers().size(), 3);
+  ModelProto exported;
+  ExportModelProto(&exported, g);
+  const GraphProto& graph = exported.graph();
+  ASSERT_EQ(graph.initializer_size(), 3);
+  for (int i = 0; i < graph.initializer_size(); ++i) {
+    EXPECT_EQ(graph.initializer(i).name(), model.graph().initializer(i).name());
+    EXPECT_EQ(
+        graph.initializer(i).SerializeAsString(),
+        model.graph().initializer(i).SerializeAsString());
+  }
+  EXPECT_EQ(graph.node_size(), model.graph().node_size());
+}
+
+TEST(IRConverterTest, ParallelConversionIsDeterministic) {
+  ModelProto model = CreateTestModel(16);
+  const std::string expected = RoundTrip(model, 1, 1);
+  for (size_t num_threads : {2, 4, 0}) {
+    EXPECT_EQ(RoundTrip(model, num_threads, 1), expected);
+    EXPECT_EQ(RoundTrip(model, 1, num_threads), expected);
+  }
+}
+
+TEST(IRConverterTest, ParallelImportRecordsSubgraphKinds) {
+  // 400 If nodes, whose subgraph attributes are converted concurrently.
+  ModelProto model = CreateTestModel(400);
+  for (size_t num_threads : {1, 8}) {
+    std::shared_ptr<Graph> g(ImportModelProto(model, num_threads));
+    EXPECT_EQ(g->kindsWithSubgraphs(), std::unordered_set<NodeKind>{kIf});
+    EXPECT_EQ(g->nodesOfKind(kIf).size(), 400);
+  }
+}
+
+TEST(IRConverterTest, ParallelConversionPropagatesErrors) {
+  ModelProto model = CreateTestModel(4);
+  model.mutable_graph()->mutable_initializer(2)->set_data_type(
+      TensorProto_DataType_UNDEFINED);
+  EXPECT_THROW(ImportModelProto(model, 1), ConvertError);
+  EXPECT_THROW(ImportModelProto(model, 4), ConvertError);
+}
+
+TEST(IRConverterTest, ExportInitializersAsRawData) {
+  ModelProto model = CreateTestModel(2);
+  TensorProto* int8s = model.mutable_graph()->add_initializer();
+  int8s->set_name("int8s");
+  int8s->set_data_type(TensorProto_DataType_INT8);
+  int8s->add_dims(3);
+  int8s->add_int32_data(-1);
+  int8s->add_int32_data(2);
+  int8s->add_int32_data(-128);
+
+  std::shared_ptr<Graph> g(ImportModelProto(model));
+  ModelProto exported;
+  ExportModelProto(&exported, g, 1, true);
+  const GraphProto& graph = exported.graph();
+  ASSERT_EQ(graph.initializer_size(), 3);
+  for (const auto& t : graph.initializer()) {
+    EXPECT_TRUE(t.has_raw_data());
+    EXPECT_EQ(t.float_data_size(), 0);
+    EXPECT_EQ(t.int32_data_size(), 0);
+  }
+  // Initializer w1 was stored as float_data in the input model.
+  EXPECT_EQ(
+      graph.initializer(1).raw_data().size(),
+      model.graph().initializer(1).float_data_size() * sizeof(float));
+  EXPECT_EQ(
+      std::memcmp(
+          graph.initializer(1).raw_data().data(),
+          model.graph().initializer(1).float_data().data(),
+          graph.initializer(1).raw_data().size()),
+      0);
+  EXPECT_EQ(graph.initializer(2).raw_data(), std::string("\xff\x02\x80", 3));
+}
+
+TEST(IRConverterTest, LazyImportPassesUntouchedInitializersThrough) {
+  std::shared_ptr<const ModelProto> model =
+      std::make_shared<ModelProto>(CreateTestModel(4));
+  const std::string expected = RoundTrip(*model, 1, 1);
+
+  std::shared_ptr<Graph> g(ImportModelProtoLazy(model));
+  ASSERT_EQ(g->initializers().size(), 4);
+  for (const auto& t : g->initializers()) {
+    EXPECT_TRUE(t.lazy_source() != nullptr);
+    EXPECT_EQ(t.sizes(), std::vector<int64_t>{4});
+    EXPECT_EQ(t.elem_type(), TensorProto_DataType_FLOAT);
+  }
+  ModelProto exported;
+  ExportModelProto(&exported, g);
+  EXPECT_EQ(exported.SerializeAsString(), expected);
+  EXPECT_TRUE(g->initializers()[0].lazy_source() != nullptr);
+
+  // Accessing the data decodes it; the export is unchanged.
+  const Tensor& raw = g->initializers()[0];
+  const Tensor& typed = g->initializers()[1];
+  EXPECT_EQ(raw.data<float>()[1], 0.5f);
+  EXPECT_EQ(typed.floats().size(), 4);
+  EXPECT_TRUE(raw.lazy_source() == nullptr);
+  EXPECT_TRUE(typed.lazy_source() == nullptr);
+  EXPECT_TRUE(raw.is_raw_data());
+  EXPECT_TRUE(g->initializers()[2].lazy_source() != nullptr);
+  exported.Clear();
+  ExportModelProto(&exported, g);
+  EXPECT_EQ(exported.SerializeAsString(), expected);
+}
+
+TEST(IRConverterTest, LazyInitializersWithNewMetadataAreDecoded) {
+  std::shared_ptr<const ModelProto> model =
+      std::make_shared<ModelProto>(CreateTestModel(4));
+  std::shared_ptr<Graph> g(ImportModelProtoLazy(model));
+  Tensor& reshaped = g->mutableInitializer(0);
+  Tensor& retyped = g->mutableInitializer(1);
+  reshaped.sizes() = {2, 2};
+  retyped.elem_type() = TensorProto_DataType_INT32;
+  EXPECT_TRUE(reshaped.lazy_source() == nullptr);
+  EXPECT_TRUE(retyped.lazy_source() == nullptr);
+  EXPECT_TRUE(g->initializers()[2].lazy_source() != nullptr);
+
+  // The data is decoded from the source as it was imported, and exported
+  // with the new metadata, not passed through with it.
+  ModelProto exported;
+  ExportModelProto(&exported, g);
+  const TensorProto& w0 = exported.graph().initializer(0);
+  EXPECT_EQ(
+      std::vector<int64_t>(w0.dims().begin(), w0.dims().end()),
+      (std::vector<int64_t>{2, 2}));
+  ASSERT_EQ(w0.raw_data().size(), 4 * sizeof(float));
+  float value;
+  std::memcpy(&value, w0.raw_data().data() + sizeof(float), sizeof(float));
+  EXPECT_EQ(value, 0.5f);
+  const TensorProto& w1 = exported.graph().initializer(1);
+  // The float data of the source is not exported as INT32.
+  EXPECT_EQ(w1.data_type(), TensorProto_DataType_INT32);
+  EXPECT_EQ(w1.float_data_size(), 0);
+  EXPECT_EQ(reshaped.data<float>()[1], 0.5f);
+}
+
+TEST(IRConverterTest, LazyInitializersDecodeOnceFromThreads) {
+  std::shared_ptr<const ModelProto> model =
+      std::make_shared<ModelProto>(CreateTestModel(4));
+  std::shared_ptr<Graph> g(ImportModelProtoLazy(model));
+  const std::vector<Tensor>& initializers = g->initializers();
+  std::vector<std::thread> threads;
+  std::vector<std::vector<float>> read(8);
+  for (size_t i = 0; i < read.size(); ++i) {
+    threads.emplace_back([&initializers, &read, i]() {
+      for (const Tensor& t : initializers) {
+        Tensor copy = t;
+        const float* data = t.data<float>();
+        read[i].insert(read[i].end(), data, data + 4);
+        EXPECT_EQ(copy.data<float>()[1], data[1]);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& values : read) {
+    EXPECT_EQ(values, read[0]);
+  }
+  EXPECT_EQ(read[0][1], 0.5f);
+  EXPECT_TRUE(initializers[0].lazy_source() == nullptr);
+}
+
+TEST(IRConverterTest, StreamingExportMatchesExportModelProto) {
+  std::shared_ptr<const ModelProto> model =
+      std::make_shared<ModelProto>(CreateTestModel(4));
+  for (bool lazy : {false, true}) {
+    for (bool use_raw_data : {false, true}) {
+      std::shared_ptr<Graph> g(
+          lazy ? ImportModelProtoLazy(model) : ImportModelProto(*model));
+      ModelProto expected = PrepareOutput(*model);
+      ExportModelProto(&expected, g, 1, use_raw_data);
+
+      std::string bytes;
+      {
+        google::protobuf::io::StringOutputStream output(&bytes);
+        ASSERT_TRUE(ExportModelProto(&output, *model, g, use_raw_data));
+      }
+      ModelProto actual;
+      ASSERT_TRUE(actual.ParseFromString(bytes));
+      EXPECT_EQ(actual.SerializeAsString(), expected.SerializeAsString());
+    }
+  }
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "onnx/common/ir.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+// Checks that the uses of the values match the inputs of the nodes.
+static void ExpectConsistentUses(
+    const std::vector<Value*>& values,
+    const std::vector<Node*>& nodes) {
+  size_t num_uses = 0;
+  for (Value* v : values) {
+    for (const Use& use : v->uses()) {
+      ASSERT_LT(use.offset, use.user->inputs().size());
+      EXPECT_EQ(use.user->inputs()[use.offset], v);
+    }
+    num_uses += v->uses().size();
+  }
+  size_t num_inputs = 0;
+  for (Node* n : nodes) {
+    num_inputs += n->inputs().size();
+  }
+  EXPECT_EQ(num_uses, num_inputs);
+}
+
+TEST(IRUseListTest, EditsKeepUsesConsistent) {
+  Graph g;
+  std::vector<Value*> values;
+  for (int i = 0; i < 4; ++i) {
+    values.push_back(g.addInput());
+  }
+  std::vector<Node*> nodes;
+  for (int i = 0; i < 100; ++i) {
+    Node* n = g.create(Symbol("Sum"), 1);
+    for (int k = 0; k < 3; ++k) {
+      n->addInput(values[(i + k) % 2]);
+    }
+    g.appendNode(n);
+    nodes.push_back(n);
+  }
+  EXPECT_EQ(values[0]->uses().size(), 150);
+  ExpectConsistentUses(values, nodes);
+
+  for (size_t i = 0; i < nodes.size(); i += 3) {
+    nodes[i]->replaceInput(1, values[2]);
+  }
+  ExpectConsistentUses(values, nodes);
+  for (size_t i = 0; i < nodes.size(); i += 5) {
+    nodes[i]->removeInput(0);
+  }
+  ExpectConsistentUses(values, nodes);
+  for (size_t i = 1; i < nodes.size(); i += 7) {
+    nodes[i]->replaceInputWith(values[1], values[3]);
+  }
+  ExpectConsistentUses(values, nodes);
+  values[0]->replaceAllUsesWith(values[3]);
+  EXPECT_TRUE(values[0]->uses().empty());
+  ExpectConsistentUses(values, nodes);
+  for (size_t i = 0; i < nodes.size(); i += 2) {
+    nodes[i]->destroy();
+  }
+  std::vector<Node*> remaining;
+  for (size_t i = 1; i < nodes.size(); i += 2) {
+    remaining.push_back(nodes[i]);
+  }
+  ExpectConsistentUses(values, remaining);
+  for (Node* n : remaining) {
+    n->removeAllInputs();
+  }
+  for (Value* v : values) {
+    EXPECT_TRUE(v->uses().empty());
+  }
+}
+
+TEST(IRUseListTest, RemovalMovesLastUse) {
+  Graph g;
+  Value* v = g.addInput();
+  std::vector<Node*> nodes;
+  for (int i = 0; i < 4; ++i) {
+    Node* n = g.create(Symbol("Neg"), 1);
+    n->addInput(v);
+    g.appendNode(n);
+    nodes.push_back(n);
+  }
+  nodes[1]->removeAllInputs();
+  ASSERT_EQ(v->uses().size(), 3);
+  EXPECT_EQ(v->uses()[0].user, nodes[0]);
+  EXPECT_EQ(v->uses()[1].user, nodes[3]);
+  EXPECT_EQ(v->uses()[2].user, nodes[2]);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
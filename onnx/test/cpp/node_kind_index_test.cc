@@ -0,0 +1,174 @@
+#include "gtest/gtest.h"
+#include "onnx/common/ir.h"
+#include "onnx/optimizer/pass.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+// Checks that nodesOfKind lists exactly the nodes of each kind in the node
+// list, in order.
+static void ExpectIndexMatchesList(Graph& g, const std::vector<Symbol>& kinds) {
+  for (Symbol kind : kinds) {
+    std::vector<Node*> expected;
+    for (Node* n : g.nodes()) {
+      if (n->kind() == kind) {
+        expected.push_back(n);
+      }
+    }
+    std::vector<Node*> indexed;
+    for (const auto& kv : g.nodesOfKind(kind)) {
+      EXPECT_EQ(kv.first, kv.second->position());
+      indexed.push_back(kv.second);
+    }
+    EXPECT_EQ(indexed, expected);
+  }
+  Node* prev = nullptr;
+  for (Node* n : g.nodes()) {
+    if (prev != nullptr) {
+      EXPECT_TRUE(prev->isBefore(n));
+      EXPECT_FALSE(n->isBefore(prev));
+    }
+    prev = n;
+  }
+}
+
+TEST(NodeKindIndexTest, FollowsListEdits) {
+  const Symbol relu("Relu"), neg("Neg");
+  Graph g;
+  Value* x = g.addInput();
+  std::vector<Node*> nodes;
+  for (int i = 0; i < 10; ++i) {
+    Node* n = g.create(i % 2 == 0 ? relu : neg);
+    n->addInput(x);
+    g.appendNode(n);
+    nodes.push_back(n);
+  }
+  ExpectIndexMatchesList(g, {relu, neg});
+
+  // Inserting repeatedly at one place uses up the free positions there, so
+  // the nodes around it are relabeled.
+  Node* after = nodes[3];
+  for (int i = 0; i < 50; ++i) {
+    Node* n = g.create(i % 3 == 0 ? neg : relu);
+    n->addInput(x);
+    n->insertAfter(after);
+  }
+  for (int i = 0; i < 30; ++i) {
+    Node* n = g.create(relu);
+    n->addInput(x);
+    g.prependNode(n);
+  }
+  ExpectIndexMatchesList(g, {relu, neg});
+
+  nodes[9]->moveBefore(nodes[0]);
+  nodes[2]->moveAfter(nodes[7]);
+  nodes[5]->destroy();
+  ExpectIndexMatchesList(g, {relu, neg});
+  EXPECT_TRUE(g.nodesOfKind(Symbol("Transpose")).empty());
+}
+
+TEST(NodeKindIndexTest, RelabelsOnlyNearInsertions) {
+  const Symbol relu("Relu"), neg("Neg");
+  Graph g;
+  Value* x = g.addInput();
+  std::vector<Node*> nodes;
+  for (int i = 0; i < 10000; ++i) {
+    Node* n = g.create(i % 2 == 0 ? relu : neg);
+    n->addInput(x);
+    g.appendNode(n);
+    nodes.push_back(n);
+  }
+  const uint64_t last_position = nodes.back()->position();
+
+  for (int i = 0; i < 1000; ++i) {
+    Node* n = g.create(i % 3 == 0 ? neg : relu);
+    n->addInput(x);
+    n->insertBefore(nodes[1]);
+    Node* m = g.create(relu);
+    m->addInput(x);
+    g.prependNode(m);
+  }
+  ExpectIndexMatchesList(g, {relu, neg});
+  EXPECT_EQ(nodes.back()->position(), last_position);
+  EXPECT_EQ(g.numNodes(), 12000);
+}
+
+// Records the nodes it visits and removes the Identity nodes.
+class RemoveIdentity final : public optimization::PredicateBasedPass {
+ public:
+  explicit RemoveIdentity(std::vector<Node*>* visited)
+      : PredicateBasedPass(
+            optimization::PassType::Nop,
+            optimization::PassEfficiency::Complete,
+            optimization::PassOptimizationType::Compute),
+        visited_(visited) {}
+  std::string getPassName() const override {
+    return "remove_identity";
+  }
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return {kIdentity};
+  }
+  bool patternMatchPredicate(Node* node) override {
+    visited_->push_back(node);
+    return node->kind() == kIdentity;
+  }
+  bool runTransform(
+      Node* node,
+      Graph&,
+      optimization::NodeDestroyType& destroy_current) override {
+    node->output()->replaceAllUsesWith(node->input());
+    destroy_current = optimization::NodeDestroyType::DestroyOne;
+    return true;
+  }
+
+ private:
+  std::vector<Node*>* visited_;
+};
+
+TEST(NodeKindIndexTest, PassVisitsAnchorsAndSubgraphs) {
+  Graph g;
+  Value* v = g.addInput();
+  std::vector<Node*> identities;
+  for (int i = 0; i < 12; ++i) {
+    Node* n = g.create(i % 4 == 1 ? kIdentity : Symbol("Relu"));
+    n->addInput(v);
+    g.appendNode(n);
+    v = n->output();
+    if (n->kind() == kIdentity) {
+      identities.push_back(n);
+    }
+  }
+  // A node holding a subgraph between the second and third Identity.
+  std::shared_ptr<Graph> body(new Graph());
+  Node* inner = body->create(kIdentity);
+  inner->addInput(body->addInput());
+  body->appendNode(inner);
+  body->registerOutput(inner->output());
+  Node* loop = g.create(Symbol("Loop"));
+  loop->addInput(identities[1]->output());
+  loop->g_(Symbol("body"), body);
+  loop->insertAfter(identities[1]);
+  g.registerOutput(v);
+  ASSERT_EQ(g.kindsWithSubgraphs().count(Symbol("Loop")), 1);
+
+  std::vector<Node*> visited;
+  RemoveIdentity pass(&visited);
+  auto analysis = std::static_pointer_cast<optimization::CountBasedPassAnalysis>(
+      pass.runPass(g));
+  EXPECT_EQ(analysis->num_positive_transforms, 4);
+  EXPECT_EQ(
+      visited,
+      (std::vector<Node*>{
+          identities[0], identities[1], inner, loop, identities[2]}));
+  EXPECT_TRUE(g.nodesOfKind(kIdentity).empty());
+  EXPECT_TRUE(body->nodesOfKind(kIdentity).empty());
+  size_t num_nodes = 0;
+  for (Node* n : g.nodes()) {
+    EXPECT_NE(n->kind(), kIdentity);
+    ++num_nodes;
+  }
+  EXPECT_EQ(num_nodes, 10);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,181 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "gtest/gtest.h"
+#include "onnx/optimizer/optimize.h"
+#include "onnx/optimizer/optimizer_cache.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+using optimization::OptimizerCache;
+
+static OptimizerCache::EntryKey TestKey(uint64_t hash) {
+  return OptimizerCache::EntryKey{hash, ~hash};
+}
+
+static std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(
+      std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// x -> Identity -> Relu -> y
+static ModelProto CreateIdentityModel(const std::string& producer) {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.set_producer_name(producer);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("test");
+  auto set_type = [](ValueInfoProto* value_info, const std::string& name) {
+    value_info->set_name(name);
+    auto* tensor_type = value_info->mutable_type()->mutable_tensor_type();
+    tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+    tensor_type->mutable_shape()->add_dim()->set_dim_value(4);
+  };
+  set_type(graph->add_input(), "x");
+  NodeProto* identity = graph->add_node();
+  identity->set_op_type("Identity");
+  identity->add_input("x");
+  identity->add_output("i");
+  NodeProto* relu = graph->add_node();
+  relu->set_op_type("Relu");
+  relu->add_input("i");
+  relu->add_output("y");
+  set_type(graph->add_output(), "y");
+  return model;
+}
+
+class OptimizerCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    cache_ = std::make_shared<OptimizerCache>(
+        testing::TempDir() + "optimizer_cache_test", 1 << 20);
+    cache_->clear();
+  }
+  void TearDown() override {
+    optimization::SetOptimizerCache(nullptr);
+    cache_->clear();
+  }
+
+  std::shared_ptr<OptimizerCache> cache_;
+};
+
+TEST_F(OptimizerCacheTest, KeyCoversModelPassesAndMode) {
+  const std::vector<std::string> passes = {"eliminate_identity"};
+  ModelProto model = CreateIdentityModel("a");
+  const OptimizerCache::EntryKey key =
+      OptimizerCache::Key(model, passes, false);
+  EXPECT_NE(key.hash, key.digest);
+  const std::string bytes = model.SerializeAsString();
+  const OptimizerCache::EntryKey bytes_key =
+      OptimizerCache::Key(bytes.data(), bytes.size(), passes, false);
+  EXPECT_EQ(key.hash, bytes_key.hash);
+  EXPECT_EQ(key.digest, bytes_key.digest);
+  EXPECT_NE(key.hash, OptimizerCache::Key(model, passes, true).hash);
+  EXPECT_NE(key.hash, OptimizerCache::Key(model, {}, false).hash);
+  const OptimizerCache::EntryKey other_key =
+      OptimizerCache::Key(CreateIdentityModel("b"), passes, false);
+  EXPECT_NE(key.hash, other_key.hash);
+  EXPECT_NE(key.digest, other_key.digest);
+
+  // Models above the hash block size hash the same either way.
+  model.set_doc_string(std::string(200000, 'd'));
+  const std::string large = model.SerializeAsString();
+  const OptimizerCache::EntryKey large_key =
+      OptimizerCache::Key(model, passes, false);
+  EXPECT_EQ(
+      large_key.hash,
+      OptimizerCache::Key(large.data(), large.size(), passes, false).hash);
+  EXPECT_EQ(
+      large_key.digest,
+      OptimizerCache::Key(large.data(), large.size(), passes, false).digest);
+}
+
+TEST_F(OptimizerCacheTest, OptimizeUsesCachedResult) {
+  optimization::SetOptimizerCache(cache_);
+  const std::vector<std::string> passes = {"eliminate_identity"};
+  ModelProto model = CreateIdentityModel("a");
+  ModelProto optimized = optimization::Optimize(model, passes);
+  ASSERT_EQ(optimized.graph().node_size(), 1);
+
+  const OptimizerCache::EntryKey key =
+      OptimizerCache::Key(model, passes, false);
+  std::string cached;
+  ASSERT_TRUE(cache_->lookup(key, &cached));
+  EXPECT_EQ(cached, optimized.SerializeAsString());
+
+  // Replace the entry to show that the optimizer doesn't run again.
+  ModelProto marked = optimized;
+  marked.set_doc_string("from cache");
+  cache_->insert(key, marked.SerializeAsString());
+  EXPECT_EQ(optimization::Optimize(model, passes).doc_string(), "from cache");
+  // Fixed-point optimization is a different entry.
+  EXPECT_EQ(optimization::OptimizeFixed(model, passes).doc_string(), "");
+}
+
+TEST_F(OptimizerCacheTest, EvictsLeastRecentlyUsed) {
+  const std::string entry(300 << 10, 'e');
+  auto cache = std::make_shared<OptimizerCache>(cache_->directory(), 1 << 20);
+  cache->insert(TestKey(1), entry);
+  cache->insert(TestKey(2), entry);
+  cache->insert(TestKey(3), entry);
+  std::string out;
+  ASSERT_TRUE(cache->lookup(TestKey(1), &out));
+  EXPECT_EQ(out, entry);
+  // Only three entries fit; 2 is the least recently used.
+  cache->insert(TestKey(4), entry);
+  EXPECT_TRUE(cache->lookup(TestKey(1), &out));
+  EXPECT_FALSE(cache->lookup(TestKey(2), &out));
+  EXPECT_TRUE(cache->lookup(TestKey(3), &out));
+  EXPECT_TRUE(cache->lookup(TestKey(4), &out));
+
+  // Entries larger than the whole cache are not stored.
+  cache->insert(TestKey(5), std::string(2 << 20, 'e'));
+  EXPECT_FALSE(cache->lookup(TestKey(5), &out));
+  EXPECT_TRUE(cache->lookup(TestKey(4), &out));
+}
+
+TEST_F(OptimizerCacheTest, IgnoresTruncatedEntries) {
+  cache_->insert(TestKey(1), std::string(1000, 'e'));
+  {
+    std::ofstream out(
+        cache_->directory() + "/0000000000000001.onnx",
+        std::ios::binary | std::ios::trunc);
+    out << "ONNXOPT2";
+  }
+  std::string out;
+  EXPECT_FALSE(cache_->lookup(TestKey(1), &out));
+}
+
+TEST_F(OptimizerCacheTest, RejectsEntriesWithAnotherDigest) {
+  cache_->insert(TestKey(1), std::string(1000, 'e'));
+  std::string out;
+  EXPECT_FALSE(cache_->lookup(OptimizerCache::EntryKey{1, 2}, &out));
+  EXPECT_TRUE(cache_->lookup(TestKey(1), &out));
+}
+
+TEST_F(OptimizerCacheTest, WritesUsesOnInsertAndDestruction) {
+  const std::string entry(300 << 10, 'e');
+  const std::string index_path = cache_->directory() + "/index";
+  std::string out;
+  {
+    OptimizerCache cache(cache_->directory(), 1 << 20);
+    cache.insert(TestKey(1), entry);
+    cache.insert(TestKey(2), entry);
+    cache.insert(TestKey(3), entry);
+    const std::string index = ReadFile(index_path);
+    ASSERT_TRUE(cache.lookup(TestKey(1), &out));
+    EXPECT_EQ(ReadFile(index_path), index);
+  }
+  // The use of 1 was written when the cache went away, so 2 is evicted.
+  OptimizerCache cache(cache_->directory(), 1 << 20);
+  cache.insert(TestKey(4), entry);
+  EXPECT_TRUE(cache.lookup(TestKey(1), &out));
+  EXPECT_FALSE(cache.lookup(TestKey(2), &out));
+  EXPECT_TRUE(cache.lookup(TestKey(3), &out));
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
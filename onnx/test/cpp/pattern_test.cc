@@ -0,0 +1,184 @@
+#include <type_traits>
+
+#include "gtest/gtest.h"
+#include "onnx/common/ir.h"
+#include "onnx/optimizer/passes/fuse_consecutive_reduce_unsqueeze.h"
+#include "onnx/optimizer/pattern.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+using namespace optimization;
+
+static Node* AppendNode(Graph& g, NodeKind kind, std::vector<Value*> inputs) {
+  Node* n = g.create(kind, 1);
+  for (Value* input : inputs) {
+    n->addInput(input);
+  }
+  return g.appendNode(n);
+}
+
+using AddOfMul = Op<kAdd, NumInputs<2>, Input<0, Op<kMul, Capture<0>>>>;
+
+TEST(PatternTest, MatchesInputsAndCaptures) {
+  Graph g;
+  Value* x = g.addInput();
+  Node* mul = AppendNode(g, kMul, {x, x});
+  Node* add = AppendNode(g, kAdd, {mul->output(), x});
+  Node* other = AppendNode(g, kAdd, {x, mul->output()});
+  Node* unary = AppendNode(g, kAdd, {mul->output()});
+
+  PatternMatch m;
+  EXPECT_TRUE(AddOfMul::match(add, &m));
+  EXPECT_EQ(m.node(0), mul);
+  EXPECT_FALSE(AddOfMul::matches(other));
+  EXPECT_FALSE(AddOfMul::matches(unary));
+  EXPECT_FALSE(AddOfMul::matches(mul));
+  EXPECT_EQ(AddOfMul::kinds(), std::vector<NodeKind>{kAdd});
+
+  // mul has three uses.
+  using AddOfUnsharedMul = Op<kAdd, Input<0, SingleUse<Op<kMul>>>>;
+  EXPECT_FALSE(AddOfUnsharedMul::matches(add));
+  other->destroy();
+  unary->destroy();
+  EXPECT_TRUE(AddOfUnsharedMul::matches(add));
+}
+
+TEST(PatternTest, ChecksAttributes) {
+  Graph g;
+  Value* x = g.addInput();
+  Node* a = AppendNode(g, kSoftmax, {x});
+  Node* b = AppendNode(g, kSoftmax, {a->output()});
+  a->i_(kaxis, 1);
+  b->i_(kaxis, 1);
+
+  using SameAxis = Op<
+      kSoftmax,
+      Input<0, Op<kSoftmax, HasAttribute<kaxis>, Capture<0>>>,
+      SameAttributeAs<kaxis, 0>>;
+  EXPECT_TRUE((Op<kSoftmax, IntAttribute<kaxis, 1>>::matches(b)));
+  EXPECT_FALSE((Op<kSoftmax, IntAttribute<kaxis, 0>>::matches(b)));
+  EXPECT_TRUE(SameAxis::matches(b));
+  b->i_(kaxis, 0);
+  EXPECT_FALSE(SameAxis::matches(b));
+  b->is_(kaxis, {1});
+  EXPECT_FALSE(SameAxis::matches(b));
+  EXPECT_FALSE((Op<kSoftmax, IntAttribute<kaxis, 1>>::matches(b)));
+}
+
+using NegOfNeg = Op<kNeg, Input<0, Op<kNeg, Capture<0>>>>;
+using NegOfExp = Op<kNeg, Input<0, Op<kExp, Capture<0>>>>;
+using NegOfLog = Op<kNeg, Input<0, Op<kLog, Capture<0>>>>;
+
+// Alternatives for the same kind load the shared input once, and try the
+// patterns for its node in order.
+static_assert(
+    std::is_same<
+        AnyOf<NegOfNeg, NegOfExp>,
+        Op<kNeg,
+           Input<
+               0,
+               EitherPattern<Op<kNeg, Capture<0>>, Op<kExp, Capture<0>>>>>>::
+        value,
+    "AnyOf does not share the checks of the Neg");
+static_assert(
+    std::is_same<
+        AnyOf<AddOfMul, Op<kAdd, NumInputs<2>, HasAttribute<kaxis>>>,
+        Op<kAdd,
+           NumInputs<2>,
+           FirstOf<
+               AllOf<Input<0, Op<kMul, Capture<0>>>>,
+               AllOf<HasAttribute<kaxis>>>>>::value,
+    "AnyOf does not share the leading checks of the Add");
+static_assert(
+    std::is_same<
+        AnyOf<
+            Op<kAdd, Input<0, SingleUse<Op<kMul>>>>,
+            Op<kAdd, Input<0, SingleUse<Op<kExp>>>>>,
+        Op<kAdd, Input<0, SingleUse<EitherPattern<Op<kMul>, Op<kExp>>>>>>::
+        value,
+    "AnyOf does not share the use check of the input");
+
+TEST(PatternTest, AnyOfMatchesTheFirstAlternative) {
+  Graph g;
+  Value* x = g.addInput();
+  Node* exp = AppendNode(g, kExp, {x});
+  Node* log = AppendNode(g, kLog, {exp->output()});
+  Node* neg_exp = AppendNode(g, kNeg, {exp->output()});
+  Node* neg_log = AppendNode(g, kNeg, {log->output()});
+  Node* neg_x = AppendNode(g, kNeg, {x});
+  Node* neg_neg = AppendNode(g, kNeg, {neg_x->output()});
+
+  using Negations = AnyOf<NegOfNeg, NegOfExp, NegOfLog>;
+  PatternMatch m;
+  EXPECT_TRUE(Negations::match(neg_exp, &m));
+  EXPECT_EQ(m.node(0), exp);
+  EXPECT_TRUE(Negations::match(neg_log, &m));
+  EXPECT_EQ(m.node(0), log);
+  EXPECT_TRUE(Negations::match(neg_neg, &m));
+  EXPECT_EQ(m.node(0), neg_x);
+  EXPECT_FALSE(Negations::matches(neg_x));
+
+  using Either = AnyOf<Op<kExp>, Op<kLog>, Op<kExp, Capture<0>>>;
+  EXPECT_EQ(Either::kinds(), (std::vector<NodeKind>{kExp, kLog}));
+  EXPECT_TRUE(Either::matches(log));
+}
+
+// Replaces Neg(Neg(x)) by x.
+struct EliminateDoubleNeg final : public PatternBasedPass<NegOfNeg> {
+  explicit EliminateDoubleNeg()
+      : PatternBasedPass(
+            PassType::Nop,
+            PassEfficiency::Complete,
+            PassOptimizationType::Compute) {}
+  std::string getPassName() const override {
+    return "eliminate_double_neg";
+  }
+  bool runTransform(Node* n, Graph&, NodeDestroyType& destroy_current)
+      override {
+    const PatternMatch m = match(n);
+    n->output()->replaceAllUsesWith(m.node(0)->input());
+    destroy_current = NodeDestroyType::DestroyOne;
+    return true;
+  }
+};
+
+TEST(PatternTest, PatternBasedPassRewritesMatches) {
+  Graph g;
+  Value* x = g.addInput();
+  Node* neg = AppendNode(g, kNeg, {x});
+  Node* neg_neg = AppendNode(g, kNeg, {neg->output()});
+  Node* relu = AppendNode(g, Symbol("Relu"), {neg_neg->output()});
+  g.registerOutput(relu->output());
+
+  EliminateDoubleNeg pass;
+  EXPECT_EQ(pass.getAnchorKinds(), std::vector<NodeKind>{kNeg});
+  pass.runPass(g);
+  EXPECT_EQ(relu->input(), x);
+}
+
+TEST(PatternTest, FusesReduceUnsqueezeOnlyOverTheSameAxes) {
+  Graph g;
+  Value* x = g.addInput();
+  auto add_pair = [&](const std::vector<int64_t>& unsqueeze_axes) {
+    Node* reduce = AppendNode(g, kReduceSum, {x});
+    reduce->is_(kaxes, {1});
+    reduce->i_(kkeepdims, 0);
+    Node* unsqueeze = AppendNode(g, kUnsqueeze, {reduce->output()});
+    unsqueeze->is_(kaxes, std::vector<int64_t>(unsqueeze_axes));
+    g.registerOutput(unsqueeze->output());
+    return reduce;
+  };
+  Node* same = add_pair({1});
+  Node* other = add_pair({0});
+
+  FuseConsecutiveReduceUnsqueeze pass;
+  pass.runPass(g);
+  EXPECT_EQ(g.outputs()[0], same->output());
+  EXPECT_EQ(same->i(kkeepdims), 1);
+  EXPECT_EQ(g.outputs()[1]->node()->kind(), kUnsqueeze);
+  EXPECT_EQ(other->i(kkeepdims), 0);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,135 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/common/repeated_subgraphs.h"
+#include "onnx/onnx_pb.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+static void AddInitializer(GraphProto* graph, const std::string& name, int rows) {
+  ValueInfoProto* input = graph->add_input();
+  input->set_name(name);
+  auto* tensor_type = input->mutable_type()->mutable_tensor_type();
+  tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+  tensor_type->mutable_shape()->add_dim()->set_dim_value(rows);
+  tensor_type->mutable_shape()->add_dim()->set_dim_value(4);
+  TensorProto* w = graph->add_initializer();
+  w->set_name(name);
+  w->set_data_type(TensorProto_DataType_FLOAT);
+  w->add_dims(rows);
+  w->add_dims(4);
+  for (int i = 0; i < rows * 4; ++i) {
+    w->add_float_data(static_cast<float>(graph->initializer_size() + i));
+  }
+}
+
+static void AddNode(
+    GraphProto* graph,
+    const std::string& op_type,
+    const std::vector<std::string>& inputs,
+    const std::string& output) {
+  NodeProto* node = graph->add_node();
+  node->set_op_type(op_type);
+  for (const auto& input : inputs) {
+    node->add_input(input);
+  }
+  node->add_output(output);
+}
+
+// A chain of residual blocks x + Relu(MatMul(x, w)) followed by a Softmax.
+// Block `odd_block`, if any, reads a weight of another shape.
+static ModelProto CreateChainModel(int num_blocks, int odd_block = -1) {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("chain");
+  ValueInfoProto* x = graph->add_input();
+  x->set_name("x0");
+  x->mutable_type()->mutable_tensor_type()->set_elem_type(
+      TensorProto_DataType_FLOAT);
+  for (int i = 0; i < num_blocks; ++i) {
+    const std::string n = std::to_string(i);
+    AddInitializer(graph, "w" + n, i == odd_block ? 2 : 4);
+    AddNode(graph, "MatMul", {"x" + n, "w" + n}, "m" + n);
+    AddNode(graph, "Relu", {"m" + n}, "r" + n);
+    AddNode(graph, "Add", {"x" + n, "r" + n}, "x" + std::to_string(i + 1));
+  }
+  AddNode(graph, "Softmax", {"x" + std::to_string(num_blocks)}, "y");
+  graph->add_output()->set_name("y");
+  return model;
+}
+
+TEST(RepeatedSubgraphsTest, FindsRepeatedBlocks) {
+  std::unique_ptr<Graph> g(ImportModelProto(CreateChainModel(3)));
+  std::vector<RepeatedSubgraph> found = FindRepeatedSubgraphs(*g);
+  ASSERT_EQ(found.size(), 1);
+  const RepeatedSubgraph& blocks = found[0];
+  ASSERT_EQ(blocks.numInstances(), 3);
+  ASSERT_EQ(blocks.size(), 3);
+  for (size_t i = 0; i < 3; ++i) {
+    const std::string n = std::to_string(i);
+    EXPECT_EQ(blocks.node(i, 0)->kind(), Symbol("MatMul"));
+    EXPECT_EQ(blocks.node(i, 2)->kind(), Symbol("Add"));
+    EXPECT_EQ(blocks.node(i, 0)->outputs()[0]->uniqueName(), "m" + n);
+
+    // x is read by both MatMul and Add.
+    std::vector<Value*> inputs = blocks.inputs(i);
+    ASSERT_EQ(inputs.size(), 3);
+    EXPECT_EQ(inputs[0]->uniqueName(), "x" + n);
+    EXPECT_EQ(inputs[1]->uniqueName(), "w" + n);
+    EXPECT_EQ(inputs[2]->uniqueName(), "x" + n);
+    std::vector<Value*> outputs = blocks.outputs(i);
+    ASSERT_EQ(outputs.size(), 1);
+    EXPECT_EQ(outputs[0]->uniqueName(), "x" + std::to_string(i + 1));
+  }
+  EXPECT_EQ(blocks.counterpart(blocks.node(2, 1), 0), blocks.node(0, 1));
+  EXPECT_EQ(blocks.instanceOf(blocks.node(1, 2)), 1);
+  EXPECT_EQ(blocks.instanceOf(blocks.node(2, 2)->output()->uses()[0].user), -1);
+}
+
+TEST(RepeatedSubgraphsTest, InitializerShapesMustMatch) {
+  std::unique_ptr<Graph> g(ImportModelProto(CreateChainModel(3, 1)));
+  std::vector<RepeatedSubgraph> found = FindRepeatedSubgraphs(*g);
+  // Blocks 0 and 2 still match, except for the MatMul of block 1.
+  for (const auto& repeated : found) {
+    for (size_t i = 0; i < repeated.numInstances(); ++i) {
+      for (Node* n : repeated.instance(i)) {
+        EXPECT_NE(n->outputs()[0]->uniqueName(), "m1");
+      }
+    }
+  }
+  // With a large enough minimum, nothing is left.
+  EXPECT_TRUE(FindRepeatedSubgraphs(*g, 4).empty());
+}
+
+TEST(RepeatedSubgraphsTest, AttributesMustMatch) {
+  ModelProto model = CreateChainModel(3);
+  // Give every Relu an alpha, and block 1 a different one.
+  for (NodeProto& node : *model.mutable_graph()->mutable_node()) {
+    if (node.op_type() == "Relu") {
+      node.set_op_type("LeakyRelu");
+      AttributeProto* alpha = node.add_attribute();
+      alpha->set_name("alpha");
+      alpha->set_type(AttributeProto_AttributeType_FLOAT);
+      alpha->set_f(node.output(0) == "r1" ? 0.2f : 0.1f);
+    }
+  }
+  std::unique_ptr<Graph> g(ImportModelProto(model));
+  std::vector<RepeatedSubgraph> found = FindRepeatedSubgraphs(*g);
+  bool matched_alpha = false;
+  for (const auto& repeated : found) {
+    for (size_t i = 0; i < repeated.numInstances(); ++i) {
+      for (Node* n : repeated.instance(i)) {
+        EXPECT_NE(n->outputs()[0]->uniqueName(), "r1");
+        matched_alpha |= n->outputs()[0]->uniqueName() == "r0";
+      }
+    }
+  }
+  // The LeakyRelus of blocks 0 and 2 still correspond.
+  EXPECT_TRUE(matched_alpha);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,113 @@
+#include "gtest/gtest.h"
+#include "onnx/optimizer/optimize.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+using namespace optimization;
+
+// x -> Transpose -> Identity -> Transpose -> Relu -> y, where both
+// Transposes swap the two axes of x.
+static ModelProto CreateModel() {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("transposes");
+  for (ValueInfoProto* info : {graph->add_input(), graph->add_output()}) {
+    auto* tensor_type = info->mutable_type()->mutable_tensor_type();
+    tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+    tensor_type->mutable_shape()->add_dim()->set_dim_value(2);
+    tensor_type->mutable_shape()->add_dim()->set_dim_value(3);
+  }
+  graph->mutable_input(0)->set_name("x");
+  graph->mutable_output(0)->set_name("y");
+  auto add_node = [graph](
+                      const std::string& op_type,
+                      const std::string& input,
+                      const std::string& output) {
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op_type);
+    node->add_input(input);
+    node->add_output(output);
+    if (op_type == "Transpose") {
+      AttributeProto* perm = node->add_attribute();
+      perm->set_name("perm");
+      perm->set_type(AttributeProto_AttributeType_INTS);
+      perm->add_ints(1);
+      perm->add_ints(0);
+    }
+  };
+  add_node("Transpose", "x", "a");
+  add_node("Identity", "a", "b");
+  add_node("Transpose", "b", "c");
+  add_node("Relu", "c", "y");
+  return model;
+}
+
+static std::vector<std::string> OpTypes(const ModelProto& model) {
+  std::vector<std::string> op_types;
+  for (const auto& node : model.graph().node()) {
+    op_types.push_back(node.op_type());
+  }
+  return op_types;
+}
+
+TEST(RewritePassManagerTest, RunsMergedPassesToFixedPoint) {
+  const std::vector<std::string> names = {
+      "eliminate_nop_transpose", "eliminate_identity",
+      "fuse_consecutive_transposes"};
+  const ModelProto model = CreateModel();
+
+  // One walk per pass leaves the Transpose that the fusion made a no-op.
+  ModelProto general = Optimize(model, names);
+  EXPECT_EQ(OpTypes(general), (std::vector<std::string>{"Transpose", "Relu"}));
+
+  Optimizer optimizer(
+      names, std::shared_ptr<PassManager>(new RewritePassManager()));
+  ModelProto rewritten = optimizer.optimize(model);
+  EXPECT_EQ(OpTypes(rewritten), std::vector<std::string>{"Relu"});
+  EXPECT_EQ(rewritten.graph().node(0).input(0), "x");
+  EXPECT_EQ(rewritten.graph().node(0).output(0), "y");
+}
+
+// Records how many Transpose nodes the graph has when it runs.
+struct CountTransposes final : public FullGraphBasedPass {
+  explicit CountTransposes(std::vector<size_t>* counts)
+      : FullGraphBasedPass(
+            PassType::Immutable,
+            PassEfficiency::Complete,
+            PassOptimizationType::None),
+        counts_(counts) {}
+  std::string getPassName() const override {
+    return "count_transposes";
+  }
+  PassAnalysisType getPassAnalysisType() const override {
+    return PassAnalysisType::Empty;
+  }
+  std::shared_ptr<PostPassAnalysis> runPass(Graph& graph) override {
+    counts_->push_back(graph.nodesOfKind(kTranspose).size());
+    return std::make_shared<PostPassAnalysis>();
+  }
+
+ private:
+  std::vector<size_t>* counts_;
+};
+
+TEST(RewritePassManagerTest, OtherPassesRunBetweenSequences) {
+  const ModelProto model = CreateModel();
+  std::shared_ptr<Graph> g = ImportModelProto(model);
+  std::vector<size_t> counts;
+  RewritePassManager manager;
+  manager.add(std::make_shared<CountTransposes>(&counts));
+  manager.add(Optimizer::passes.find("eliminate_identity"));
+  manager.add(Optimizer::passes.find("fuse_consecutive_transposes"));
+  manager.add(std::make_shared<CountTransposes>(&counts));
+  manager.add(Optimizer::passes.find("eliminate_nop_transpose"));
+  manager.add(std::make_shared<CountTransposes>(&counts));
+  manager.run(*g);
+  EXPECT_EQ(counts, (std::vector<size_t>{2, 1, 0}));
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <map>
 #include "gtest/gtest.h"
 #include "onnx/defs/schema.h"
 #include "onnx/defs/shape_inference.h"
@@ -229,6 +230,167 @@ TEST(ShapeInferenceTest, mergeShapeInfo_Mismatches) {
   }
 }
 
+// Dimensions are values, params or "?" for unknown.
+static TensorShapeProto MakeShape(const std::vector<std::string>& dims) {
+  TensorShapeProto shape;
+  for (const auto& d : dims) {
+    auto* dim = shape.add_dim();
+    if (d == "?") {
+      continue;
+    } else if (isdigit(d[0])) {
+      dim->set_dim_value(std::stoll(d));
+    } else {
+      dim->set_dim_param(d);
+    }
+  }
+  return shape;
+}
+
+static std::string ShapeString(const TensorShapeProto& shape) {
+  std::string result;
+  for (const auto& dim : shape.dim()) {
+    if (!result.empty()) {
+      result += ",";
+    }
+    if (dim.has_dim_value()) {
+      result += ONNX_NAMESPACE::to_string(dim.dim_value());
+    } else if (dim.has_dim_param()) {
+      result += dim.dim_param();
+    } else {
+      result += "?";
+    }
+  }
+  return result;
+}
+
+TEST(ShapeInferenceTest, bidirectionalBroadcast) {
+  TensorShapeProto result;
+  bidirectionalBroadcastShapeInference(
+      MakeShape({"N", "1", "3"}), MakeShape({"4", "1"}), result);
+  EXPECT_EQ(ShapeString(result), "N,4,3");
+
+  result.Clear();
+  bidirectionalBroadcastShapeInference(
+      MakeShape({"N", "M", "1"}), MakeShape({"N", "K", "?"}), result);
+  EXPECT_EQ(ShapeString(result), "N,?,?");
+
+  EXPECT_THROW(
+      bidirectionalBroadcastShapeInference(
+          MakeShape({"2"}), MakeShape({"3"}), result),
+      ONNX_NAMESPACE::InferenceError);
+}
+
+TEST(ShapeInferenceTest, InlinedVectorGrows) {
+  InlinedVector<int64_t, 2> values;
+  for (int64_t i = 0; i < 10; ++i) {
+    values.push_back(i);
+  }
+  InlinedVector<int64_t, 2> copy(values);
+  ASSERT_EQ(copy.size(), 10);
+  for (int64_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(copy[i], i);
+  }
+  copy.assign(3, 7);
+  EXPECT_EQ(
+      std::vector<int64_t>(copy.begin(), copy.end()),
+      std::vector<int64_t>(3, 7));
+}
+
+// Conv -> Transpose -> MatMul with a symbolic batch dimension.
+TEST(ShapeInferenceTest, ConvTransposeMatMul) {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(10);
+  GraphProto* graph = model.mutable_graph();
+  auto add_input = [graph](
+                       const std::string& name,
+                       const std::vector<std::string>& dims) {
+    auto* tensor_type =
+        graph->add_input()->mutable_type()->mutable_tensor_type();
+    graph->mutable_input(graph->input_size() - 1)->set_name(name);
+    tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+    *tensor_type->mutable_shape() = MakeShape(dims);
+  };
+  add_input("x", {"N", "3", "8", "8"});
+  add_input("w", {"16", "3", "3", "3"});
+  add_input("v", {"16"});
+
+  NodeProto* conv = graph->add_node();
+  conv->set_op_type("Conv");
+  conv->add_input("x");
+  conv->add_input("w");
+  conv->add_output("c");
+  AttributeProto* strides = conv->add_attribute();
+  strides->set_name("strides");
+  strides->set_type(AttributeProto::INTS);
+  strides->add_ints(2);
+  strides->add_ints(2);
+  AttributeProto* pads = conv->add_attribute();
+  pads->set_name("pads");
+  pads->set_type(AttributeProto::INTS);
+  for (int i = 0; i < 4; ++i) {
+    pads->add_ints(1);
+  }
+
+  NodeProto* transpose = graph->add_node();
+  transpose->set_op_type("Transpose");
+  transpose->add_input("c");
+  transpose->add_output("t");
+  AttributeProto* perm = transpose->add_attribute();
+  perm->set_name("perm");
+  perm->set_type(AttributeProto::INTS);
+  for (int axis : {0, 2, 3, 1}) {
+    perm->add_ints(axis);
+  }
+
+  NodeProto* matmul = graph->add_node();
+  matmul->set_op_type("MatMul");
+  matmul->add_input("t");
+  matmul->add_input("v");
+  matmul->add_output("y");
+
+  InferShapes(model);
+  std::map<std::string, std::string> shapes;
+  for (const auto& value_info : graph->value_info()) {
+    shapes[value_info.name()] =
+        ShapeString(value_info.type().tensor_type().shape());
+  }
+  EXPECT_EQ(shapes["c"], "N,16,4,4");
+  EXPECT_EQ(shapes["t"], "N,4,4,16");
+  EXPECT_EQ(shapes["y"], "N,4,4");
+}
+
+// Transpose infers a shape only from a perm of the input's rank.
+TEST(ShapeInferenceTest, TransposePermRank) {
+  for (int rank : {0, 2}) {
+    ModelProto model;
+    model.set_ir_version(IR_VERSION);
+    model.add_opset_import()->set_version(10);
+    GraphProto* graph = model.mutable_graph();
+    ValueInfoProto* input = graph->add_input();
+    input->set_name("x");
+    auto* tensor_type = input->mutable_type()->mutable_tensor_type();
+    tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+    *tensor_type->mutable_shape() =
+        MakeShape(std::vector<std::string>(rank, "3"));
+
+    NodeProto* transpose = graph->add_node();
+    transpose->set_op_type("Transpose");
+    transpose->add_input("x");
+    transpose->add_output("t");
+    AttributeProto* perm = transpose->add_attribute();
+    perm->set_name("perm");
+    perm->set_type(AttributeProto::INTS);
+
+    InferShapes(model);
+    ASSERT_EQ(graph->value_info_size(), 1);
+    const auto& t = graph->value_info(0).type().tensor_type();
+    EXPECT_EQ(t.elem_type(), TensorProto_DataType_FLOAT);
+    EXPECT_EQ(t.has_shape(), rank == 0);
+    EXPECT_EQ(t.shape().dim_size(), 0);
+  }
+}
+
 // Check subgraph inferencing via GraphInferencer using a Scan
 static void doInferencingTest(bool use_scan_opset8) {
   auto* schemaRegistry = OpSchemaRegistry::Instance();
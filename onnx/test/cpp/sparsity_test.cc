@@ -0,0 +1,156 @@
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include "gtest/gtest.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/common/sparsity.h"
+#include "onnx/optimizer/passes/sparsify_initializers.h"
+#include "onnx/test/cpp/tensor_test_utils.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+// An 8x8 float tensor that is zero but for one 1x4 block of the first row
+// and a single element of the last one, plus a -0, which the analysis
+// counts as zero but sparse storage keeps.
+static std::vector<float> PrunedFloats() {
+  std::vector<float> values(64, 0.f);
+  for (int i = 4; i < 8; ++i) {
+    values[i] = float(i);
+  }
+  values[3] = -0.f;
+  values[63] = 1.f;
+  return values;
+}
+
+TEST(SparsityTest, AnalyzesZerosAndBlocks) {
+  for (bool raw : {false, true}) {
+    const SparsityStats stats =
+        AnalyzeSparsity(FloatTensor(PrunedFloats(), {8, 8}, raw));
+    EXPECT_EQ(stats.num_elements, 64);
+    EXPECT_EQ(stats.zeros, 59);
+    EXPECT_EQ(stats.blocks_1x4, 16);
+    EXPECT_EQ(stats.zero_blocks_1x4, 14);
+    EXPECT_EQ(stats.blocks_4x4, 4);
+    EXPECT_EQ(stats.zero_blocks_4x4, 2);
+  }
+
+  // Leading dimensions are folded into rows; partial blocks are ignored.
+  Tensor t;
+  t.elem_type() = TensorProto_DataType_INT8;
+  t.sizes() = {2, 2, 6};
+  t.int32s().assign(24, 0);
+  t.int32s()[11] = -1;
+  const SparsityStats stats = AnalyzeSparsity(t);
+  EXPECT_EQ(stats.zeros, 23);
+  EXPECT_EQ(stats.blocks_1x4, 4);
+  EXPECT_EQ(stats.zero_blocks_1x4, 4);
+  EXPECT_EQ(stats.blocks_4x4, 1);
+  EXPECT_EQ(stats.zero_blocks_4x4, 1);
+}
+
+TEST(SparsityTest, SparsifiesAndDensifies) {
+  for (bool raw : {false, true}) {
+    Tensor t = FloatTensor(PrunedFloats(), {8, 8}, raw);
+    EXPECT_FALSE(SparsifyTensor(t, 0.95));
+    ASSERT_TRUE(SparsifyTensor(t, 0.9));
+    ASSERT_TRUE(t.is_sparse());
+    EXPECT_EQ(t.sparse_indices(), (std::vector<int64_t>{3, 4, 5, 6, 7, 63}));
+    EXPECT_EQ(t.sparse_values().sizes(), std::vector<int64_t>{6});
+    EXPECT_EQ(t.is_raw_data(), raw);
+
+    // The analysis of a sparse tensor does not densify it.
+    EXPECT_EQ(AnalyzeSparsity(t).zero_blocks_4x4, 2);
+    EXPECT_TRUE(t.is_sparse());
+
+    Tensor copy = t;
+    const float* data = t.data<float>();
+    EXPECT_FALSE(t.is_sparse());
+    EXPECT_EQ(data[6], 6.f);
+    EXPECT_EQ(data[63], 1.f);
+    EXPECT_EQ(data[62], 0.f);
+    EXPECT_TRUE(std::signbit(data[3]));
+    EXPECT_FALSE(std::signbit(data[2]));
+    EXPECT_TRUE(copy.is_sparse());
+    copy.densify();
+    EXPECT_EQ(copy.data<float>()[5], 5.f);
+  }
+}
+
+TEST(SparsityTest, ConcurrentConstReadsDensifyOnce) {
+  Tensor t = FloatTensor(PrunedFloats(), {8, 8}, true);
+  ASSERT_TRUE(SparsifyTensor(t, 0.9));
+  const Tensor& shared = t;
+  std::vector<std::vector<float>> read(8);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < read.size(); ++i) {
+    threads.emplace_back([&shared, &read, i]() {
+      Tensor copy = shared;
+      const float* data = shared.data<float>();
+      read[i].assign(data, data + 64);
+      EXPECT_EQ(copy.data<float>()[63], 1.f);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(t.is_sparse());
+  for (const auto& values : read) {
+    EXPECT_EQ(values, read[0]);
+    EXPECT_EQ(values[5], 5.f);
+  }
+}
+
+TEST(SparsityTest, ExportIsDense) {
+  std::shared_ptr<Graph> g(new Graph());
+  Tensor w = FloatTensor(PrunedFloats(), {8, 8}, true);
+  w.setName("w");
+  ASSERT_TRUE(SparsifyTensor(w, 0.5));
+  g->addInitializer(w, "w");
+  Value* input = g->addInput();
+  input->setUniqueName("w");
+  input->setElemType(TensorProto_DataType_FLOAT);
+  input->setSizes({Dimension(8), Dimension(8)});
+  g->registerOutput(input);
+
+  ModelProto model;
+  ExportModelProto(&model, g);
+  ASSERT_EQ(model.graph().initializer_size(), 1);
+  const TensorProto& tp = model.graph().initializer(0);
+  std::vector<float> exported(64);
+  ASSERT_EQ(tp.raw_data().size(), exported.size() * sizeof(float));
+  std::memcpy(exported.data(), tp.raw_data().data(), tp.raw_data().size());
+  EXPECT_EQ(exported, PrunedFloats());
+  EXPECT_TRUE(g->initializers()[0].is_sparse());
+}
+
+TEST(SparsityTest, SparsifyPassReportsInitializers) {
+  Graph g;
+  Tensor w = FloatTensor(PrunedFloats(), {8, 8}, false);
+  w.setName("w");
+  g.addInitializer(w, "w");
+  Tensor b = FloatTensor({1.f, 0.f}, {2}, false);
+  b.setName("b");
+  g.addInitializer(b, "b");
+  Tensor names;
+  names.elem_type() = TensorProto_DataType_STRING;
+  names.sizes().push_back(1);
+  names.strings().push_back("");
+  names.setName("names");
+  g.addInitializer(names, "names");
+
+  optimization::SparsifyInitializers pass;
+  auto analysis = std::static_pointer_cast<
+      optimization::InitializerSparsityAnalysis>(pass.runPass(g));
+  ASSERT_EQ(analysis->reports.size(), 2);
+  EXPECT_EQ(analysis->reports[0].name, "w");
+  EXPECT_EQ(analysis->reports[0].stats.zeros, 59);
+  EXPECT_DOUBLE_EQ(analysis->reports[1].stats.zero_fraction(), 0.5);
+  ASSERT_EQ(analysis->sparsified.size(), 1);
+  EXPECT_EQ(analysis->sparsified[0], "w");
+  EXPECT_TRUE(g.initializers()[0].is_sparse());
+  EXPECT_FALSE(g.initializers()[1].is_sparse());
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,129 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "gtest/gtest.h"
+#include "onnx/common/special_values.h"
+#include "onnx/optimizer/pass_registry.h"
+#include "onnx/test/cpp/tensor_test_utils.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+static const float kDenormal = 1e-40f;
+
+static std::vector<float> SpecialFloats() {
+  return {1.f,
+          kDenormal,
+          -kDenormal,
+          std::numeric_limits<float>::quiet_NaN(),
+          std::numeric_limits<float>::infinity(),
+          -std::numeric_limits<float>::infinity(),
+          0.f,
+          std::numeric_limits<float>::min()};
+}
+
+TEST(SpecialValuesTest, CountsFloatValues) {
+  for (bool raw : {false, true}) {
+    const SpecialValueCounts counts =
+        CountSpecialValues(FloatTensor(SpecialFloats(), raw));
+    EXPECT_EQ(counts.num_elements, 8);
+    EXPECT_EQ(counts.denormals, 2);
+    EXPECT_EQ(counts.nans, 1);
+    EXPECT_EQ(counts.infs, 2);
+  }
+}
+
+TEST(SpecialValuesTest, CountsDoubleAndFloat16Values) {
+  Tensor d;
+  d.elem_type() = TensorProto_DataType_DOUBLE;
+  d.sizes().push_back(3);
+  d.doubles() = {1e-310, std::nan(""), 1.0};
+  const SpecialValueCounts double_counts = CountSpecialValues(d);
+  EXPECT_EQ(double_counts.denormals, 1);
+  EXPECT_EQ(double_counts.nans, 1);
+  EXPECT_EQ(double_counts.infs, 0);
+
+  // 0x0001 is the smallest denormal, 0x7C00 is +inf, 0x3C00 is 1.
+  Tensor h;
+  h.elem_type() = TensorProto_DataType_FLOAT16;
+  h.sizes().push_back(3);
+  const uint16_t halves[] = {0x0001, 0x7C00, 0x3C00};
+  h.set_raw_data(
+      std::string(reinterpret_cast<const char*>(halves), sizeof(halves)));
+  const SpecialValueCounts half_counts = CountSpecialValues(h);
+  EXPECT_EQ(half_counts.num_elements, 3);
+  EXPECT_EQ(half_counts.denormals, 1);
+  EXPECT_EQ(half_counts.infs, 1);
+
+  Tensor typed_h;
+  typed_h.elem_type() = TensorProto_DataType_FLOAT16;
+  typed_h.int32s() = {0x8001, 0x7E00};
+  const SpecialValueCounts typed_counts = CountSpecialValues(typed_h);
+  EXPECT_EQ(typed_counts.denormals, 1);
+  EXPECT_EQ(typed_counts.nans, 1);
+}
+
+TEST(SpecialValuesTest, FlushesDenormalsKeepingSign) {
+  for (bool raw : {false, true}) {
+    Tensor t = FloatTensor(SpecialFloats(), raw);
+    EXPECT_EQ(FlushTensorDenormalsToZero(t), 2);
+    const float* data = t.data<float>();
+    EXPECT_EQ(data[1], 0.f);
+    EXPECT_FALSE(std::signbit(data[1]));
+    EXPECT_EQ(data[2], 0.f);
+    EXPECT_TRUE(std::signbit(data[2]));
+    EXPECT_TRUE(std::isnan(data[3]));
+    EXPECT_EQ(data[7], std::numeric_limits<float>::min());
+    EXPECT_EQ(CountSpecialValues(t).denormals, 0);
+    EXPECT_EQ(FlushTensorDenormalsToZero(t), 0);
+  }
+}
+
+TEST(SpecialValuesTest, FlushesRawHalfDenormals) {
+  // 0x8001 is the smallest negative denormal, 0x0400 the smallest normal.
+  // External bytes are copied into the Tensor rather than written in place.
+  std::shared_ptr<const uint16_t> halves(
+      new uint16_t[3]{0x0001, 0x8001, 0x0400},
+      std::default_delete<uint16_t[]>());
+  Tensor h;
+  h.elem_type() = TensorProto_DataType_FLOAT16;
+  h.sizes().push_back(3);
+  h.set_external_raw_data(
+      halves, reinterpret_cast<const char*>(halves.get()), 6);
+  EXPECT_EQ(FlushTensorDenormalsToZero(h), 2);
+  EXPECT_FALSE(h.has_external_raw_data());
+  uint16_t flushed[3];
+  std::memcpy(flushed, h.raw_data_ptr(), sizeof(flushed));
+  EXPECT_EQ(flushed[0], 0x0000);
+  EXPECT_EQ(flushed[1], 0x8000);
+  EXPECT_EQ(flushed[2], 0x0400);
+  EXPECT_EQ(halves.get()[0], 0x0001);
+}
+
+TEST(SpecialValuesTest, FlushDenormalsPassReportsTensors) {
+  Graph g;
+  Tensor w = FloatTensor(SpecialFloats(), true);
+  w.setName("w");
+  g.addInitializer(w, "w");
+  Tensor b = FloatTensor({1.f, 2.f}, false);
+  b.setName("b");
+  g.addInitializer(b, "b");
+
+  std::vector<InitializerValueReport> reports = ScanInitializerValues(g);
+  ASSERT_EQ(reports.size(), 2);
+  EXPECT_EQ(reports[0].name, "w");
+  EXPECT_EQ(reports[0].counts.denormals, 2);
+  EXPECT_FALSE(reports[1].counts.any());
+
+  optimization::GlobalPassRegistry registry;
+  auto analysis = std::static_pointer_cast<
+      optimization::FlushedDenormalsAnalysis>(
+      registry.find("flush_denormals_to_zero")->runPass(g));
+  ASSERT_EQ(analysis->flushed.size(), 1);
+  EXPECT_EQ(analysis->flushed[0].first, "w");
+  EXPECT_EQ(analysis->flushed[0].second, 2);
+  EXPECT_EQ(ScanInitializerValues(g)[0].counts.denormals, 0);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/defs/shape_inference.h"
+#include "onnx/optimizer/specialize_shapes.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+static void SetShape(
+    ValueInfoProto* info,
+    const std::vector<std::string>& dims) {
+  auto* tensor_type = info->mutable_type()->mutable_tensor_type();
+  tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+  auto* shape = tensor_type->mutable_shape();
+  for (const auto& d : dims) {
+    if (d[0] >= '0' && d[0] <= '9') {
+      shape->add_dim()->set_dim_value(std::stoll(d));
+    } else {
+      shape->add_dim()->set_dim_param(d);
+    }
+  }
+}
+
+// y = MatMul(x[N, 3], w[3, 4]) + b[4]; r = Relu(z[N, S]); y and r are
+// outputs with their symbolic shapes.
+static ModelProto CreateModel() {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  model.add_opset_import()->set_version(9);
+  GraphProto* graph = model.mutable_graph();
+  graph->set_name("test");
+  SetShape(graph->add_input(), {"N", "3"});
+  graph->mutable_input(0)->set_name("x");
+  SetShape(graph->add_input(), {"N", "S"});
+  graph->mutable_input(1)->set_name("z");
+  SetShape(graph->add_input(), {"3", "4"});
+  graph->mutable_input(2)->set_name("w");
+  SetShape(graph->add_input(), {"4"});
+  graph->mutable_input(3)->set_name("b");
+  TensorProto* w = graph->add_initializer();
+  w->set_name("w");
+  w->set_data_type(TensorProto_DataType_FLOAT);
+  w->add_dims(3);
+  w->add_dims(4);
+  for (int i = 0; i < 12; ++i) {
+    w->add_float_data(static_cast<float>(i));
+  }
+  TensorProto* b = graph->add_initializer();
+  b->set_name("b");
+  b->set_data_type(TensorProto_DataType_FLOAT);
+  b->add_dims(4);
+  for (int i = 0; i < 4; ++i) {
+    b->add_float_data(static_cast<float>(i));
+  }
+
+  NodeProto* matmul = graph->add_node();
+  matmul->set_op_type("MatMul");
+  matmul->add_input("x");
+  matmul->add_input("w");
+  matmul->add_output("m");
+  NodeProto* add = graph->add_node();
+  add->set_op_type("Add");
+  add->add_input("m");
+  add->add_input("b");
+  add->add_output("y");
+  NodeProto* relu = graph->add_node();
+  relu->set_op_type("Relu");
+  relu->add_input("z");
+  relu->add_output("r");
+  SetShape(graph->add_output(), {"N", "4"});
+  graph->mutable_output(0)->set_name("y");
+  SetShape(graph->add_output(), {"N", "S"});
+  graph->mutable_output(1)->set_name("r");
+  return model;
+}
+
+static std::vector<std::string> Dims(const ValueInfoProto& info) {
+  std::vector<std::string> dims;
+  for (const auto& d : info.type().tensor_type().shape().dim()) {
+    dims.push_back(
+        d.has_dim_value() ? ONNX_NAMESPACE::to_string(d.dim_value())
+                          : d.dim_param());
+  }
+  return dims;
+}
+
+TEST(SpecializeShapesTest, BatchSizeMakesShapesStatic) {
+  optimization::ShapeSpecialization spec;
+  spec.batch_size = 8;
+  spec.dims.emplace("S", Dimension("seq"));
+  const ModelProto out = optimization::SpecializeShapes(CreateModel(), spec);
+
+  const GraphProto& graph = out.graph();
+  EXPECT_EQ(Dims(graph.input(0)), (std::vector<std::string>{"8", "3"}));
+  EXPECT_EQ(Dims(graph.input(1)), (std::vector<std::string>{"8", "seq"}));
+  EXPECT_EQ(Dims(graph.output(0)), (std::vector<std::string>{"8", "4"}));
+  EXPECT_EQ(Dims(graph.output(1)), (std::vector<std::string>{"8", "seq"}));
+
+  // MatMul + Add only fuse into Gemm once the batch dimension is static.
+  ASSERT_EQ(graph.node_size(), 2);
+  EXPECT_EQ(graph.node(0).op_type(), "Gemm");
+  EXPECT_EQ(graph.node(1).op_type(), "Relu");
+  const ModelProto symbolic = optimization::SpecializeShapes(
+      CreateModel(), optimization::ShapeSpecialization());
+  EXPECT_EQ(symbolic.graph().node_size(), 3);
+}
+
+TEST(SpecializeShapesTest, InputDimsAndConflicts) {
+  optimization::ShapeSpecialization spec;
+  spec.input_dims["z"].emplace_back(-1, Dimension(16));
+  spec.dims.emplace("N", Dimension(2));
+  const ModelProto out =
+      optimization::SpecializeShapes(CreateModel(), spec, {});
+  EXPECT_EQ(Dims(out.graph().input(1)), (std::vector<std::string>{"2", "16"}));
+  EXPECT_EQ(Dims(out.graph().output(1)), (std::vector<std::string>{"2", "16"}));
+  EXPECT_EQ(out.graph().node_size(), 3);
+
+  optimization::ShapeSpecialization conflict;
+  conflict.input_dims["x"].emplace_back(0, Dimension(4));
+  conflict.input_dims["z"].emplace_back(0, Dimension(5));
+  EXPECT_THROW(
+      optimization::SpecializeShapes(CreateModel(), conflict), InferenceError);
+
+  optimization::ShapeSpecialization out_of_range;
+  out_of_range.input_dims["x"].emplace_back(2, Dimension(4));
+  EXPECT_THROW(
+      optimization::SpecializeShapes(CreateModel(), out_of_range),
+      InferenceError);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "onnx/common/tensor.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+// A float tensor of the given shape holding `values`, in raw_data or in the
+// typed field.
+inline Tensor FloatTensor(
+    const std::vector<float>& values,
+    std::vector<int64_t> sizes,
+    bool raw) {
+  Tensor t;
+  t.elem_type() = TensorProto_DataType_FLOAT;
+  t.sizes() = std::move(sizes);
+  if (raw) {
+    t.set_raw_data(std::string(
+        reinterpret_cast<const char*>(values.data()),
+        values.size() * sizeof(float)));
+  } else {
+    t.floats() = values;
+  }
+  return t;
+}
+
+// A 1-D float tensor holding `values`.
+inline Tensor FloatTensor(const std::vector<float>& values, bool raw) {
+  return FloatTensor(values, {static_cast<int64_t>(values.size())}, raw);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,182 @@
+#include <map>
+#include "gtest/gtest.h"
+#include "onnx/common/constants.h"
+#include "onnx/optimizer/pass_registry.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+struct TreeNodeSpec {
+  int64_t tree;
+  int64_t node;
+  const char* mode;
+  int64_t feature;
+  double value;
+  int64_t true_id;
+  int64_t false_id;
+  double weight; // for leaves
+};
+
+// Tree 0 is listed out of breadth-first order and has an unreachable
+// leaf (3). In tree 1 node 5 repeats the subtree of node 1.
+static const TreeNodeSpec kEnsemble[] = {
+    {0, 0, "BRANCH_LEQ", 0, 1.0, 2, 1, 0},
+    {0, 3, "LEAF", 0, 0, 0, 0, 9},
+    {0, 1, "LEAF", 0, 0, 0, 0, 2},
+    {0, 2, "LEAF", 0, 0, 0, 0, 1},
+    {1, 0, "BRANCH_LT", 0, 0.5, 1, 2, 0},
+    {1, 1, "BRANCH_EQ", 1, 1.0, 3, 4, 0},
+    {1, 2, "BRANCH_GT", 3, 7.0, 5, 6, 0},
+    {1, 3, "LEAF", 0, 0, 0, 0, 10},
+    {1, 4, "LEAF", 0, 0, 0, 0, 20},
+    {1, 5, "BRANCH_EQ", 1, 1.0, 7, 8, 0},
+    {1, 6, "LEAF", 0, 0, 0, 0, 30},
+    {1, 7, "LEAF", 0, 0, 0, 0, 10},
+    {1, 8, "LEAF", 0, 0, 0, 0, 20},
+};
+
+static Node* AddEnsemble(Graph& g, const char* op, const std::string& prefix) {
+  Node* n = g.create(Symbol(op));
+  n->setDomain(AI_ONNX_ML_DOMAIN);
+  std::vector<int64_t> tree_ids, node_ids, features, true_ids, false_ids;
+  std::vector<int64_t> w_trees, w_nodes, w_ids;
+  std::vector<double> values, weights;
+  std::vector<std::string> modes;
+  for (const auto& spec : kEnsemble) {
+    tree_ids.push_back(spec.tree);
+    node_ids.push_back(spec.node);
+    features.push_back(spec.feature);
+    values.push_back(spec.value);
+    modes.push_back(spec.mode);
+    true_ids.push_back(spec.true_id);
+    false_ids.push_back(spec.false_id);
+    if (std::string(spec.mode) == "LEAF") {
+      w_trees.push_back(spec.tree);
+      w_nodes.push_back(spec.node);
+      w_ids.push_back(0);
+      weights.push_back(spec.weight);
+    }
+  }
+  n->is_(Symbol("nodes_treeids"), std::move(tree_ids));
+  n->is_(Symbol("nodes_nodeids"), std::move(node_ids));
+  n->is_(Symbol("nodes_featureids"), std::move(features));
+  n->fs_(Symbol("nodes_values"), std::move(values));
+  n->ss_(Symbol("nodes_modes"), std::move(modes));
+  n->is_(Symbol("nodes_truenodeids"), std::move(true_ids));
+  n->is_(Symbol("nodes_falsenodeids"), std::move(false_ids));
+  n->is_(Symbol(prefix + "treeids"), std::move(w_trees));
+  n->is_(Symbol(prefix + "nodeids"), std::move(w_nodes));
+  n->is_(Symbol(prefix + "ids"), std::move(w_ids));
+  n->fs_(Symbol(prefix + "weights"), std::move(weights));
+  g.appendNode(n);
+  return n;
+}
+
+// Sums the weights of the leaves `x` reaches, starting each tree at its
+// first node.
+static double Evaluate(Node* n, const std::string& prefix, const double* x) {
+  const auto& trees = n->is(Symbol("nodes_treeids"));
+  const auto& nodes = n->is(Symbol("nodes_nodeids"));
+  const auto& features = n->is(Symbol("nodes_featureids"));
+  const auto& values = n->fs(Symbol("nodes_values"));
+  const auto& modes = n->ss(Symbol("nodes_modes"));
+  const auto& true_ids = n->is(Symbol("nodes_truenodeids"));
+  const auto& false_ids = n->is(Symbol("nodes_falsenodeids"));
+  std::map<std::pair<int64_t, int64_t>, size_t> index;
+  std::vector<size_t> roots;
+  for (size_t i = 0; i < trees.size(); ++i) {
+    if (roots.empty() || trees[roots.back()] != trees[i]) {
+      roots.push_back(i);
+    }
+    index[{trees[i], nodes[i]}] = i;
+  }
+  double sum = 0;
+  for (size_t i : roots) {
+    while (modes[i] != "LEAF") {
+      const double v = x[features[i]];
+      const std::string& m = modes[i];
+      const bool go_true = m == "BRANCH_LEQ" ? v <= values[i]
+          : m == "BRANCH_LT"                 ? v < values[i]
+          : m == "BRANCH_GTE"                ? v >= values[i]
+          : m == "BRANCH_GT"                 ? v > values[i]
+          : m == "BRANCH_EQ"                 ? v == values[i]
+                                             : v != values[i];
+      i = index.at({trees[i], go_true ? true_ids[i] : false_ids[i]});
+    }
+    const auto& w_trees = n->is(Symbol(prefix + "treeids"));
+    const auto& w_nodes = n->is(Symbol(prefix + "nodeids"));
+    for (size_t w = 0; w < w_trees.size(); ++w) {
+      if (w_trees[w] == trees[i] && w_nodes[w] == nodes[i]) {
+        sum += n->fs(Symbol(prefix + "weights"))[w];
+      }
+    }
+  }
+  return sum;
+}
+
+TEST(TreeEnsembleCompactionTest, PrunesMergesAndReorders) {
+  const double inputs[][4] = {
+      {0, 1, 0, 9}, {2, 1, 0, 9}, {0, 0, 0, 0}, {0, 2, 0, 8}, {1, 1, 0, 5}};
+  for (const char* op : {"TreeEnsembleRegressor", "TreeEnsembleClassifier"}) {
+    const std::string prefix =
+        std::string(op) == "TreeEnsembleRegressor" ? "target_" : "class_";
+    Graph g;
+    Node* n = AddEnsemble(g, op, prefix);
+    std::vector<double> expected;
+    for (const auto& x : inputs) {
+      expected.push_back(Evaluate(n, prefix, x));
+    }
+
+    optimization::GlobalPassRegistry registry;
+    auto analysis = std::static_pointer_cast<
+        optimization::TreeEnsembleCompactionAnalysis>(
+        registry.find("compact_tree_ensembles")->runPass(g));
+    EXPECT_EQ(analysis->num_positive_transforms, 1);
+    EXPECT_EQ(analysis->nodes_before, 13);
+    EXPECT_EQ(analysis->nodes_after, 9);
+    EXPECT_EQ(analysis->weights_before, 8);
+    EXPECT_EQ(analysis->weights_after, 5);
+
+    EXPECT_EQ(
+        n->is(Symbol("nodes_nodeids")),
+        (std::vector<int64_t>{0, 1, 2, 0, 1, 2, 3, 4, 5}));
+    EXPECT_EQ(
+        n->is(Symbol("nodes_truenodeids")),
+        (std::vector<int64_t>{1, 0, 0, 1, 3, 1, 0, 0, 0}));
+    EXPECT_EQ(
+        n->is(Symbol("nodes_falsenodeids")),
+        (std::vector<int64_t>{2, 0, 0, 2, 4, 5, 0, 0, 0}));
+    for (size_t k = 0; k < expected.size(); ++k) {
+      EXPECT_EQ(Evaluate(n, prefix, inputs[k]), expected[k]);
+    }
+
+    // Compacting again changes nothing.
+    auto again = std::static_pointer_cast<
+        optimization::TreeEnsembleCompactionAnalysis>(
+        registry.find("compact_tree_ensembles")->runPass(g));
+    EXPECT_EQ(again->num_positive_transforms, 0);
+  }
+}
+
+TEST(TreeEnsembleCompactionTest, LeavesInconsistentEnsemblesAlone) {
+  Graph g;
+  Node* dangling = AddEnsemble(g, "TreeEnsembleRegressor", "target_");
+  auto false_ids = dangling->is(Symbol("nodes_falsenodeids"));
+  false_ids[0] = 42;
+  dangling->is_(Symbol("nodes_falsenodeids"), std::move(false_ids));
+  Node* short_values = AddEnsemble(g, "TreeEnsembleRegressor", "target_");
+  short_values->fs_(Symbol("nodes_values"), std::vector<double>{1.0});
+  Node* other_domain = AddEnsemble(g, "TreeEnsembleRegressor", "target_");
+  other_domain->setDomain("");
+
+  optimization::GlobalPassRegistry registry;
+  auto analysis = registry.find("compact_tree_ensembles")->runPass(g);
+  EXPECT_EQ(
+      std::static_pointer_cast<optimization::CountBasedPassAnalysis>(analysis)
+          ->num_positive_transforms,
+      0);
+  EXPECT_EQ(dangling->is(Symbol("nodes_treeids")).size(), 13);
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "gtest/gtest.h"
+#include "onnx/common/weight_arena.h"
+#include "onnx/test/cpp/tensor_test_utils.h"
+
+namespace ONNX_NAMESPACE {
+namespace Test {
+
+static std::vector<float> FloatsOf(const Tensor& t) {
+  std::vector<float> out(t.raw_data_size() / sizeof(float));
+  std::memcpy(out.data(), t.raw_data_ptr(), t.raw_data_size());
+  return out;
+}
+
+static bool Aligned(const void* p) {
+  return reinterpret_cast<uintptr_t>(p) % WeightArena::kAlignment == 0;
+}
+
+TEST(WeightArenaTest, PacksInitializersAligned) {
+  Graph g;
+  g.addInitializerAndInput(FloatTensor({1, 2, 3}, true), "a");
+  g.addInitializerAndInput(FloatTensor({4, 5}, false), "b");
+  Tensor int8s;
+  int8s.elem_type() = TensorProto_DataType_INT8;
+  int8s.sizes().push_back(3);
+  int8s.int32s() = {-1, 0, 127};
+  g.addInitializerAndInput(int8s, "c");
+  Tensor strings;
+  strings.elem_type() = TensorProto_DataType_STRING;
+  strings.sizes().push_back(1);
+  strings.strings().push_back("s");
+  g.addInitializerAndInput(strings, "d");
+
+  WeightArena arena(g);
+  EXPECT_TRUE(Aligned(arena.data()));
+  EXPECT_EQ(arena.size(), 128 + 3);
+  EXPECT_EQ(arena.live_size(), 12 + 8 + 3);
+
+  WeightArena::Entry entry;
+  ASSERT_TRUE(arena.find("b", &entry));
+  EXPECT_EQ(entry.offset, 64);
+  EXPECT_EQ(entry.size, 8);
+  EXPECT_FALSE(arena.find("d", &entry));
+
+  const Tensor& b = *g.getInitializer("b");
+  EXPECT_TRUE(b.is_raw_data());
+  EXPECT_TRUE(b.floats().empty());
+  EXPECT_EQ(b.raw_data_ptr(), arena.data() + 64);
+  EXPECT_EQ(FloatsOf(b), (std::vector<float>{4, 5}));
+  const Tensor& c = *g.getInitializer("c");
+  EXPECT_EQ(c.raw_data_ptr(), arena.data() + 128);
+  EXPECT_EQ(
+      std::string(c.raw_data_ptr(), 3), std::string("\xff\x00\x7f", 3));
+  EXPECT_EQ(g.getInitializer("d")->strings()[0], "s");
+}
+
+TEST(WeightArenaTest, AppendsAndCompactsOnErase) {
+  Graph g;
+  WeightArena arena(g);
+  std::vector<Value*> values;
+  for (int i = 0; i < 10; ++i) {
+    values.push_back(arena.append(
+        FloatTensor({static_cast<float>(i)}, i % 2 == 0),
+        "w" + ONNX_NAMESPACE::to_string(i)));
+  }
+  EXPECT_EQ(arena.size(), 9 * 64 + 4);
+  for (int i = 0; i < 10; ++i) {
+    const Tensor& t = *g.getInitializer("w" + ONNX_NAMESPACE::to_string(i));
+    EXPECT_EQ(t.raw_data_ptr(), arena.data() + 64 * i);
+    EXPECT_EQ(FloatsOf(t), (std::vector<float>{static_cast<float>(i)}));
+  }
+
+  // Erasing leaves holes until they make up half the arena.
+  for (int i = 0; i < 5; ++i) {
+    arena.erase(values[i]);
+  }
+  EXPECT_EQ(arena.size(), 9 * 64 + 4);
+  EXPECT_EQ(arena.live_size(), 5 * 4);
+  arena.erase(values[5]);
+  EXPECT_EQ(arena.size(), 3 * 64 + 4);
+  EXPECT_EQ(g.initializers().size(), 4);
+  for (int i = 6; i < 10; ++i) {
+    WeightArena::Entry entry;
+    ASSERT_TRUE(arena.find("w" + ONNX_NAMESPACE::to_string(i), &entry));
+    EXPECT_EQ(entry.offset, 64 * (i - 6));
+    const Tensor& t = *g.getInitializer("w" + ONNX_NAMESPACE::to_string(i));
+    EXPECT_EQ(FloatsOf(t), (std::vector<float>{static_cast<float>(i)}));
+  }
+
+  // Data mutated outside the arena moves back in on the next pack.
+  g.mutableInitializer(0).data<float>()[0] = 6;
+  WeightArena::Entry entry;
+  EXPECT_FALSE(arena.find("w6", &entry));
+  arena.pack();
+  EXPECT_TRUE(arena.find("w6", &entry));
+}
+
+TEST(WeightArenaTest, ExportsExternalData) {
+  std::shared_ptr<Graph> g(new Graph());
+  g->setName("g");
+  Value* a = g->addInitializerAndInput(FloatTensor({1, 2, 3}, true), "a");
+  g->addInitializerAndInput(FloatTensor({4, 5}, false), "b");
+  g->registerOutput(a);
+  WeightArena arena(*g);
+
+  const std::string path = "weight_arena_test.data";
+  ModelProto model;
+  ExportModelProtoWithExternalData(&model, g, arena, path, "weights.data");
+
+  ASSERT_EQ(model.graph().initializer_size(), 2);
+  const TensorProto& b = model.graph().initializer(1);
+  EXPECT_EQ(b.name(), "b");
+  EXPECT_EQ(b.data_location(), TensorProto::EXTERNAL);
+  EXPECT_FALSE(b.has_raw_data());
+  EXPECT_EQ(b.float_data_size(), 0);
+  ASSERT_EQ(b.external_data_size(), 3);
+  EXPECT_EQ(b.external_data(0).key(), "location");
+  EXPECT_EQ(b.external_data(0).value(), "weights.data");
+  EXPECT_EQ(b.external_data(1).key(), "offset");
+  EXPECT_EQ(b.external_data(1).value(), "64");
+  EXPECT_EQ(b.external_data(2).key(), "length");
+  EXPECT_EQ(b.external_data(2).value(), "8");
+
+  std::ifstream in(path, std::ios::binary);
+  const std::string bytes(
+      (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  std::remove(path.c_str());
+  ASSERT_EQ(bytes.size(), arena.size());
+  float four_five[2];
+  std::memcpy(four_five, bytes.data() + 64, sizeof(four_five));
+  EXPECT_EQ(four_five[0], 4);
+  EXPECT_EQ(four_five[1], 5);
+
+  // The graph keeps its data.
+  EXPECT_EQ(FloatsOf(*g->getInitializer("b")), (std::vector<float>{4, 5}));
+}
+
+} // namespace Test
+} // namespace ONNX_NAMESPACE
@@ -0,0 +1,42 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces operator new and delete in ir-alloc-bench so that the benchmarks
+// of ir-bench.cc can report how much the IR converter allocates per model.
+// Each block is prefixed with its size so that the live and peak heap sizes
+// can be tracked too. This lives in its own file so that the replacements
+// are not inlined into the benchmarks.
+std::atomic<size_t> num_allocs(0);
+std::atomic<size_t> num_alloc_bytes(0);
+std::atomic<size_t> live_bytes(0);
+std::atomic<size_t> peak_bytes(0);
+static const size_t kAllocHeader = 16;
+
+void* operator new(size_t size) {
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+  num_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  char* p = static_cast<char*>(std::malloc(size + kAllocHeader));
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(p) = size;
+  const size_t live = live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  size_t peak = peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+  }
+  return p + kAllocHeader;
+}
+
+void operator delete(void* p) noexcept {
+  if (p == nullptr) {
+    return;
+  }
+  char* block = static_cast<char*>(p) - kAllocHeader;
+  live_bytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+  std::free(block);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  operator delete(p);
+}
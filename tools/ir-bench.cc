@@ -0,0 +1,880 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <unordered_set>
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include <onnx/common/graph_diff.h>
+#include <onnx/common/graph_hash.h>
+#include <onnx/common/ir_binary_format.h>
+#include <onnx/common/ir_pb_converter.h>
+#include <onnx/common/sparsity.h>
+#include <onnx/common/special_values.h>
+#include <onnx/onnx_pb.h>
+#include <onnx/optimizer/optimize.h>
+#include <onnx/optimizer/pass.h>
+#include <onnx/optimizer/passes/eliminate_duplicate_initializer.h>
+#include <onnx/optimizer/passes/fuse_add_bias_into_conv.h>
+#include <onnx/optimizer/passes/fuse_consecutive_log_softmax.h>
+#include <onnx/optimizer/passes/fuse_consecutive_reduce_unsqueeze.h>
+#include <onnx/optimizer/passes/fuse_matmul_add_bias_into_gemm.h>
+
+using namespace ONNX_NAMESPACE;
+
+// The heap counters, kept by the operator new of ir-bench-heap.cc in the
+// ir-alloc-bench build of this file. ir-bench keeps the default allocator,
+// as counting adds atomic updates to every allocation, and does not report
+// them.
+#ifdef ONNX_IR_BENCH_COUNT_HEAP
+extern std::atomic<size_t> num_allocs;
+extern std::atomic<size_t> num_alloc_bytes;
+extern std::atomic<size_t> live_bytes;
+extern std::atomic<size_t> peak_bytes;
+static const bool kCountHeap = true;
+#else
+static std::atomic<size_t> num_allocs(0);
+static std::atomic<size_t> num_alloc_bytes(0);
+static std::atomic<size_t> live_bytes(0);
+static std::atomic<size_t> peak_bytes(0);
+static const bool kCountHeap = false;
+#endif
+
+// Build a chain of Add/Mul pairs where each Add consumes a Constant node
+// carrying a `tensor_size` float tensor and each Mul consumes an
+// initializer of the same size. Tensors are stored in raw_data if `raw`
+// is set and in float_data otherwise.
+static ModelProto
+createConstantChainModel(int num_nodes, int tensor_size, bool raw = true) {
+  ModelProto model;
+  model.set_ir_version(IR_VERSION);
+  OperatorSetIdProto* op_set_id = model.add_opset_import();
+  op_set_id->set_domain("");
+  op_set_id->set_version(9);
+
+  GraphProto* graph = model.mutable_graph();
+  ValueInfoProto* input = graph->add_input();
+  input->set_name("x0");
+  TypeProto_Tensor* tensor_type = input->mutable_type()->mutable_tensor_type();
+  tensor_type->set_elem_type(TensorProto_DataType_FLOAT);
+  tensor_type->mutable_shape()->add_dim()->set_dim_value(tensor_size);
+
+  std::string payload(tensor_size * sizeof(float), '\0');
+  auto set_payload = [&](TensorProto* t) {
+    t->set_data_type(TensorProto_DataType_FLOAT);
+    t->add_dims(tensor_size);
+    if (raw) {
+      t->set_raw_data(payload);
+    } else {
+      t->mutable_float_data()->Resize(tensor_size, 1.f);
+    }
+  };
+  for (int i = 0; i < num_nodes; i++) {
+    const std::string idx = std::to_string(i);
+    NodeProto* constant = graph->add_node();
+    constant->set_op_type("Constant");
+    constant->add_output("c" + idx);
+    AttributeProto* value = constant->add_attribute();
+    value->set_name("value");
+    value->set_type(AttributeProto::TENSOR);
+    set_payload(value->mutable_t());
+
+    TensorProto* init = graph->add_initializer();
+    init->set_name("w" + idx);
+    set_payload(init);
+    ValueInfoProto* init_input = graph->add_input();
+    init_input->set_name("w" + idx);
+    init_input->mutable_type()->CopyFrom(input->type());
+
+    NodeProto* add = graph->add_node();
+    add->set_op_type("Add");
+    add->add_input("x" + idx);
+    add->add_input("c" + idx);
+    add->add_output("y" + idx);
+
+    NodeProto* mul = graph->add_node();
+    mul->set_op_type("Mul");
+    mul->add_input("y" + idx);
+    mul->add_input("w" + idx);
+    mul->add_output("x" + std::to_string(i + 1));
+  }
+  ValueInfoProto* output = graph->add_output();
+  output->set_name("x" + std::to_string(num_nodes));
+  output->mutable_type()->CopyFrom(input->type());
+  return model;
+}
+
+static void ImportModel(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(
+      static_cast<int>(state.range(0)),
+      static_cast<int>(state.range(1)),
+      state.range(2) != 0);
+  const size_t model_bytes = model.ByteSizeLong();
+
+  size_t allocs = 0;
+  size_t alloc_bytes = 0;
+  while (state.KeepRunning()) {
+    const size_t allocs_before = num_allocs.load();
+    const size_t bytes_before = num_alloc_bytes.load();
+    std::unique_ptr<Graph> g = ImportModelProto(model);
+    allocs += num_allocs.load() - allocs_before;
+    alloc_bytes += num_alloc_bytes.load() - bytes_before;
+    benchmark::DoNotOptimize(g.get());
+  }
+
+  if (kCountHeap) {
+    const double iterations = static_cast<double>(state.iterations());
+    state.counters["allocs"] = allocs / iterations;
+    // Bytes allocated during import relative to the serialized model size.
+    state.counters["alloc_ratio"] = alloc_bytes / iterations / model_bytes;
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model_bytes);
+}
+BENCHMARK(ImportModel)
+    ->Args({100, 1 << 10, 1})
+    ->Args({100, 1 << 16, 1})
+    ->Args({100, 1 << 16, 0})
+    ->Args({10000, 16, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+static void ExportModel(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(
+      static_cast<int>(state.range(0)),
+      static_cast<int>(state.range(1)),
+      state.range(2) != 0);
+  const size_t model_bytes = model.ByteSizeLong();
+  std::shared_ptr<Graph> g(ImportModelProto(model));
+
+  size_t allocs = 0;
+  size_t alloc_bytes = 0;
+  while (state.KeepRunning()) {
+    const size_t allocs_before = num_allocs.load();
+    const size_t bytes_before = num_alloc_bytes.load();
+    ModelProto exported;
+    ExportModelProto(&exported, g);
+    allocs += num_allocs.load() - allocs_before;
+    alloc_bytes += num_alloc_bytes.load() - bytes_before;
+    benchmark::DoNotOptimize(exported.graph().node_size());
+  }
+
+  if (kCountHeap) {
+    const double iterations = static_cast<double>(state.iterations());
+    state.counters["allocs"] = allocs / iterations;
+    state.counters["alloc_ratio"] = alloc_bytes / iterations / model_bytes;
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model_bytes);
+}
+BENCHMARK(ExportModel)
+    ->Args({100, 1 << 10, 1})
+    ->Args({100, 1 << 16, 1})
+    ->Args({100, 1 << 16, 0})
+    ->Args({10000, 16, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+// Import without decoding initializers, then export them unchanged, as
+// the optimizer does for initializers its passes never read.
+static void RoundTripModelLazy(benchmark::State& state) {
+  const std::shared_ptr<const ModelProto> model =
+      std::make_shared<ModelProto>(createConstantChainModel(
+          static_cast<int>(state.range(0)),
+          static_cast<int>(state.range(1)),
+          state.range(2) != 0));
+  const bool lazy = state.range(3) != 0;
+  while (state.KeepRunning()) {
+    std::shared_ptr<Graph> g(
+        lazy ? ImportModelProtoLazy(model) : ImportModelProto(*model));
+    ModelProto exported;
+    ExportModelProto(&exported, g);
+    benchmark::DoNotOptimize(exported.graph().node_size());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model->ByteSizeLong());
+}
+BENCHMARK(RoundTripModelLazy)
+    ->Args({100, 1 << 16, 1, 0})
+    ->Args({100, 1 << 16, 1, 1})
+    ->Args({100, 1 << 16, 0, 0})
+    ->Args({100, 1 << 16, 0, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+// Export followed by writing to a file, either through an output
+// ModelProto (argument 0) or streamed (argument 1). peak_ratio, reported by
+// ir-alloc-bench, is the peak heap growth relative to the size of the
+// output.
+static void WriteModel(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(100, 1 << 16);
+  const bool stream = state.range(0) != 0;
+  std::shared_ptr<Graph> g(ImportModelProto(model));
+  const std::string path = "ir-bench-write.onnx";
+
+  size_t peak = 0;
+  while (state.KeepRunning()) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    const size_t live_before = live_bytes.load();
+    peak_bytes.store(live_before);
+    if (stream) {
+      google::protobuf::io::OstreamOutputStream output(&out);
+      ExportModelProto(&output, model, g);
+    } else {
+      ModelProto exported = PrepareOutput(model);
+      ExportModelProto(&exported, g);
+      exported.SerializeToOstream(&out);
+    }
+    peak = std::max(peak, peak_bytes.load() - live_before);
+  }
+  std::remove(path.c_str());
+  if (kCountHeap) {
+    state.counters["peak_ratio"] =
+        static_cast<double>(peak) / model.ByteSizeLong();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model.ByteSizeLong());
+}
+BENCHMARK(WriteModel)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Exports a model with typed float_data initializers, normalizing them to
+// raw_data when the argument is non-zero.
+static void ExportModelRawData(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(100, 1 << 16, false);
+  const bool use_raw_data = state.range(0) != 0;
+  std::shared_ptr<Graph> g(ImportModelProto(model));
+  while (state.KeepRunning()) {
+    ModelProto exported;
+    ExportModelProto(&exported, g, 1, use_raw_data);
+    benchmark::DoNotOptimize(exported.graph().node_size());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model.ByteSizeLong());
+}
+BENCHMARK(ExportModelRawData)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Speedup of the multi-threaded conversion paths; the argument is the
+// number of threads.
+static void ImportModelThreads(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(256, 1 << 16);
+  const size_t num_threads = static_cast<size_t>(state.range(0));
+  while (state.KeepRunning()) {
+    std::unique_ptr<Graph> g = ImportModelProto(model, num_threads);
+    benchmark::DoNotOptimize(g.get());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model.ByteSizeLong());
+}
+BENCHMARK(ImportModelThreads)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void ExportModelThreads(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(256, 1 << 16);
+  const size_t num_threads = static_cast<size_t>(state.range(0));
+  std::shared_ptr<Graph> g(ImportModelProto(model));
+  while (state.KeepRunning()) {
+    ModelProto exported;
+    ExportModelProto(&exported, g, num_threads);
+    benchmark::DoNotOptimize(exported.graph().node_size());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model.ByteSizeLong());
+}
+BENCHMARK(ExportModelThreads)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Time to get from bytes on disk to a Graph: parsing a serialized
+// ModelProto and importing it, versus loading the native binary format.
+// Arguments are as for ImportModel.
+static void LoadModelProto(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(
+      static_cast<int>(state.range(0)),
+      static_cast<int>(state.range(1)),
+      state.range(2) != 0);
+  const std::string bytes = model.SerializeAsString();
+  while (state.KeepRunning()) {
+    ModelProto parsed;
+    parsed.ParseFromString(bytes);
+    std::unique_ptr<Graph> g = ImportModelProto(parsed);
+    benchmark::DoNotOptimize(g.get());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * bytes.size());
+}
+BENCHMARK(LoadModelProto)
+    ->Args({100, 1 << 16, 1})
+    ->Args({100, 1 << 16, 0})
+    ->Args({10000, 16, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+static void LoadBinaryFormat(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(
+      static_cast<int>(state.range(0)),
+      static_cast<int>(state.range(1)),
+      state.range(2) != 0);
+  const std::string path = "ir-bench-load.onnxb";
+  ModelProtoToGraphBinary(model, path);
+  while (state.KeepRunning()) {
+    std::unique_ptr<Graph> g = LoadGraphBinary(path);
+    benchmark::DoNotOptimize(g.get());
+  }
+  std::remove(path.c_str());
+  state.SetBytesProcessed(int64_t(state.iterations()) * model.ByteSizeLong());
+}
+BENCHMARK(LoadBinaryFormat)
+    ->Args({100, 1 << 16, 1})
+    ->Args({100, 1 << 16, 0})
+    ->Args({10000, 16, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+static void HashBytesThroughput(benchmark::State& state) {
+  const std::string data(static_cast<size_t>(state.range(0)), 'x');
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(HashBytes(data.data(), data.size()));
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+}
+BENCHMARK(HashBytesThroughput)->Arg(64)->Arg(1 << 20);
+
+// Structural hash of a whole model, initializer payloads included.
+static void HashModelGraph(benchmark::State& state) {
+  const ModelProto model = createConstantChainModel(
+      static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  std::unique_ptr<Graph> g = ImportModelProto(model);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(HashGraph(*g));
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * model.ByteSizeLong());
+}
+BENCHMARK(HashModelGraph)
+    ->Args({100, 1 << 16})
+    ->Args({10000, 16})
+    ->Unit(benchmark::kMicrosecond);
+
+// Diff of a model against a copy whose first Constant was changed, which
+// changes the hashes of every node after it, so most nodes are matched
+// through their inputs rather than by hash.
+static void DiffModelGraphs(benchmark::State& state) {
+  ModelProto model = createConstantChainModel(
+      static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  std::unique_ptr<Graph> before = ImportModelProto(model);
+  model.mutable_graph()->mutable_node(0)->mutable_attribute(0)->mutable_t()->set_raw_data(
+      std::string(state.range(1) * sizeof(float), '\x01'));
+  std::unique_ptr<Graph> after = ImportModelProto(model);
+  while (state.KeepRunning()) {
+    GraphDiff diff = DiffGraphs(*before, *after);
+    benchmark::DoNotOptimize(diff.modified.size());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0) * 3);
+}
+BENCHMARK(DiffModelGraphs)
+    ->Args({10000, 16})
+    ->Args({1000000 / 3, 1})
+    ->Unit(benchmark::kMillisecond);
+
+// Scan of a float tensor for denormals, NaNs and infinities.
+static void CountSpecialTensorValues(benchmark::State& state) {
+  Tensor t;
+  t.elem_type() = TensorProto_DataType_FLOAT;
+  t.sizes().push_back(state.range(0));
+  t.set_raw_data(std::string(state.range(0) * sizeof(float), '\x01'));
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(CountSpecialValues(t).denormals);
+  }
+  state.SetBytesProcessed(
+      int64_t(state.iterations()) * state.range(0) * sizeof(float));
+}
+BENCHMARK(CountSpecialTensorValues)->Arg(1 << 10)->Arg(1 << 24);
+
+// Zero and block sparsity scan of a square float matrix that is 75% zeros.
+static void AnalyzeTensorSparsity(benchmark::State& state) {
+  const int64_t n = state.range(0);
+  std::vector<float> values(n * n, 0.f);
+  for (size_t i = 0; i < values.size(); i += 4) {
+    values[i] = 1.f;
+  }
+  Tensor t;
+  t.elem_type() = TensorProto_DataType_FLOAT;
+  t.sizes() = {n, n};
+  t.set_raw_data(std::string(
+      reinterpret_cast<const char*>(values.data()),
+      values.size() * sizeof(float)));
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(AnalyzeSparsity(t).zero_blocks_4x4);
+  }
+  state.SetBytesProcessed(
+      int64_t(state.iterations()) * n * n * sizeof(float));
+}
+BENCHMARK(AnalyzeTensorSparsity)->Arg(32)->Arg(4096);
+
+// Deduplication of state.range(0) 1 KiB initializers, every other one a
+// copy of the one before, each used by one node.
+static void EliminateDuplicateInitializers(benchmark::State& state) {
+  const int64_t n = state.range(0);
+  optimization::EliminateDuplicateInitializer pass;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::unique_ptr<Graph> g(new Graph());
+    for (int64_t i = 0; i < n; ++i) {
+      std::vector<float> values(256, float(i / 2));
+      Tensor t;
+      t.elem_type() = TensorProto_DataType_FLOAT;
+      t.sizes().push_back(256);
+      t.set_raw_data(std::string(
+          reinterpret_cast<const char*>(values.data()),
+          values.size() * sizeof(float)));
+      Value* v = g->addInitializerAndInput(t, "w" + std::to_string(i));
+      Node* node = g->create(Symbol("Neg"));
+      node->addInput(v);
+      g->appendNode(node);
+      g->registerOutput(node->output());
+    }
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(pass.runPass(*g));
+    state.PauseTiming();
+    g.reset();
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * n * 1024);
+}
+BENCHMARK(EliminateDuplicateInitializers)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Moves each of the state.range(0) consumers of one Value to another
+// Value and back, as passes rewiring a shared Constant do.
+static void RewireHighFanOut(benchmark::State& state) {
+  const int64_t n = state.range(0);
+  Graph g;
+  Value* a = g.addInput();
+  Value* b = g.addInput();
+  std::vector<Node*> consumers;
+  for (int64_t i = 0; i < n; ++i) {
+    Node* node = g.create(Symbol("Neg"));
+    node->addInput(a);
+    g.appendNode(node);
+    consumers.push_back(node);
+  }
+  while (state.KeepRunning()) {
+    for (Node* node : consumers) {
+      node->replaceInput(0, b);
+    }
+    for (Node* node : consumers) {
+      node->replaceInput(0, a);
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * n * 2);
+}
+BENCHMARK(RewireHighFanOut)
+    ->Arg(100)
+    ->Arg(10000)
+    ->Unit(benchmark::kMicrosecond);
+
+// Runs a pass matching Identity over a chain of state.range(0) nodes, one
+// in 100 of them Identity, visiting every node (state.range(1) == 0) or
+// only those of the anchor kind.
+class FindIdentity final : public optimization::PredicateBasedPass {
+ public:
+  explicit FindIdentity(bool use_anchors)
+      : PredicateBasedPass(
+            optimization::PassType::Other,
+            optimization::PassEfficiency::Complete,
+            optimization::PassOptimizationType::None),
+        use_anchors_(use_anchors) {}
+  std::string getPassName() const override {
+    return "find_identity";
+  }
+  std::vector<NodeKind> getAnchorKinds() const override {
+    return use_anchors_ ? std::vector<NodeKind>{kIdentity}
+                        : std::vector<NodeKind>{};
+  }
+  bool patternMatchPredicate(Node* node) override {
+    return node->kind() == kIdentity;
+  }
+  bool runTransform(Node*, Graph&, optimization::NodeDestroyType&) override {
+    return true;
+  }
+
+ private:
+  const bool use_anchors_;
+};
+
+static void PredicatePassAnchors(benchmark::State& state) {
+  const int64_t n = state.range(0);
+  Graph g;
+  Value* v = g.addInput();
+  for (int64_t i = 0; i < n; ++i) {
+    Node* node = g.create(i % 100 == 0 ? kIdentity : Symbol("Relu"));
+    node->addInput(v);
+    g.appendNode(node);
+    v = node->output();
+  }
+  g.registerOutput(v);
+  FindIdentity pass(state.range(1) != 0);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(pass.runPass(g));
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * n);
+}
+BENCHMARK(PredicatePassAnchors)
+    ->Args({100000, 0})
+    ->Args({100000, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+// Inserts state.range(0) nodes before one node in the middle of a chain of
+// 500k nodes, as a pass emitting several nodes ahead of the one it replaces
+// does, then removes them again.
+static void InsertBeforeOneNode(benchmark::State& state) {
+  const int64_t n = 500000;
+  Graph g;
+  Value* v = g.addInput();
+  Node* middle = nullptr;
+  for (int64_t i = 0; i < n; ++i) {
+    Node* node = g.create(Symbol("Relu"));
+    node->addInput(v);
+    g.appendNode(node);
+    v = node->output();
+    if (i == n / 2) {
+      middle = node;
+    }
+  }
+  g.registerOutput(v);
+  std::vector<Node*> inserted;
+  while (state.KeepRunning()) {
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      Node* node = g.create(Symbol("Neg"));
+      node->addInput(middle->input());
+      node->insertBefore(middle);
+      inserted.push_back(node);
+    }
+    state.PauseTiming();
+    for (Node* node : inserted) {
+      node->destroy();
+    }
+    inserted.clear();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(InsertBeforeOneNode)
+    ->Arg(100)
+    ->Arg(10000)
+    ->Unit(benchmark::kMicrosecond);
+
+// Runs the first state.range(0) of the anchored built-in passes over a
+// chain of 120k nodes of various kinds, none of which match, with one walk
+// per pass (state.range(1) == 0) or a single RewritePassManager walk.
+static void OptimizerPassCount(benchmark::State& state) {
+  static const std::vector<std::string> names = {
+      "eliminate_identity",
+      "eliminate_nop_dropout",
+      "eliminate_nop_monotone_argmax",
+      "eliminate_nop_pad",
+      "eliminate_nop_transpose",
+      "extract_constant_to_initializer",
+      "fuse_add_bias_into_conv",
+      "fuse_bn_into_conv",
+      "fuse_consecutive_concats",
+      "fuse_consecutive_log_softmax",
+      "fuse_consecutive_reduce_unsqueeze",
+      "fuse_consecutive_squeezes",
+      "fuse_consecutive_transposes",
+      "fuse_matmul_add_bias_into_gemm",
+      "fuse_pad_into_conv",
+      "fuse_transpose_into_gemm"};
+  static const std::vector<std::string> kinds = {
+      "Relu", "Add", "Conv", "Gemm", "Transpose", "Concat",
+      "Squeeze", "Unsqueeze", "Log", "Pad", "Dropout", "BatchNormalization"};
+  // The passes don't change the graph, so all runs share it, laid out the
+  // same way in memory.
+  static Graph g;
+  if (g.numNodes() == 0) {
+    Value* v = g.addInput();
+    Value* w = g.addInput();
+    for (int64_t i = 0; i < 120000; ++i) {
+      Node* node = g.create(Symbol(kinds[i % kinds.size()]));
+      node->addInput(v);
+      if (node->kind() == kGemm) {
+        node->addInput(w);
+      }
+      g.appendNode(node);
+      v = node->output();
+    }
+    g.registerOutput(v);
+  }
+  std::unique_ptr<optimization::PassManager> manager;
+  if (state.range(1) == 0) {
+    manager.reset(new optimization::GeneralPassManager());
+  } else {
+    manager.reset(new optimization::RewritePassManager());
+  }
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    manager->add(optimization::Optimizer::passes.find(names[i]));
+  }
+  while (state.KeepRunning()) {
+    manager->run(g);
+  }
+}
+BENCHMARK(OptimizerPassCount)
+    ->ArgsProduct({{1, 4, 8, 16}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Runs fuse_add_bias_into_conv, fuse_matmul_add_bias_into_gemm,
+// fuse_consecutive_log_softmax and fuse_consecutive_reduce_unsqueeze over a
+// graph of 20k blocks, each with a site for every pass, half of which can be
+// fused, so that the passes can be compared across changes to them.
+static void FusionPasses(benchmark::State& state) {
+  static const std::vector<std::string> names = {
+      "fuse_add_bias_into_conv",
+      "fuse_matmul_add_bias_into_gemm",
+      "fuse_consecutive_log_softmax",
+      "fuse_consecutive_reduce_unsqueeze"};
+  optimization::GeneralPassManager manager;
+  for (const std::string& name : names) {
+    manager.add(optimization::Optimizer::passes.find(name));
+  }
+  auto add_input = [](Graph& g, const std::vector<Dimension>& sizes) {
+    Value* v = g.addInput();
+    v->setSizes(sizes);
+    v->setElemType(TensorProto_DataType_FLOAT);
+    return v;
+  };
+  auto append = [](Graph& g, NodeKind kind, const std::vector<Value*>& inputs) {
+    Node* n = g.create(kind);
+    for (Value* input : inputs) {
+      n->addInput(input);
+    }
+    g.appendNode(n);
+    return n;
+  };
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::unique_ptr<Graph> g(new Graph());
+    Value* x = add_input(*g, {1, 4, 8, 8});
+    Value* w = add_input(*g, {4, 4, 3, 3});
+    Value* b = add_input(*g, {4, 1, 1});
+    Value* a = add_input(*g, {2, 3});
+    Value* y = add_input(*g, {3, 4});
+    Value* c = add_input(*g, {4});
+    for (int64_t i = 0; i < 20000; ++i) {
+      const bool fusable = i % 2 == 0;
+      Node* conv = append(*g, kConv, {x, w});
+      conv->output()->setSizes({1, 4, 8, 8});
+      Node* add = append(*g, kAdd, {conv->output(), fusable ? b : x});
+      Node* matmul = append(*g, kMatMul, {a, y});
+      Node* add2 = append(*g, kAdd, {matmul->output(), fusable ? c : a});
+      Node* softmax = append(*g, kSoftmax, {add->output()});
+      softmax->i_(kaxis, 1);
+      Node* log = append(*g, kLog, {softmax->output()});
+      Node* reduce = append(*g, kReduceSum, {log->output()});
+      reduce->is_(kaxes, {1});
+      reduce->i_(kkeepdims, fusable ? 0 : 1);
+      Node* unsqueeze = append(*g, kUnsqueeze, {reduce->output()});
+      unsqueeze->is_(kaxes, {1});
+      g->registerOutput(add2->output());
+      g->registerOutput(unsqueeze->output());
+    }
+    state.ResumeTiming();
+    manager.run(*g);
+    state.PauseTiming();
+    g.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * 20000);
+}
+BENCHMARK(FusionPasses)->Unit(benchmark::kMillisecond);
+
+// The predicates of fuse_add_bias_into_conv, fuse_matmul_add_bias_into_gemm,
+// fuse_consecutive_log_softmax and fuse_consecutive_reduce_unsqueeze, as
+// they were written before the passes used patterns (with the single-use
+// checks that the first two made in their transforms), and the patterns of
+// the passes.
+static const std::unordered_set<NodeKind> reduction_kinds{
+    kReduceL1,
+    kReduceL2,
+    kReduceLogSum,
+    kReduceLogSumExp,
+    kReduceMax,
+    kReduceMean,
+    kReduceMin,
+    kReduceProd,
+    kReduceSum,
+    kReduceSumSquare};
+static bool (*const hand_written_predicates[])(Node*) = {
+    [](Node* node) {
+      return node->kind() == kAdd &&
+          node->inputs()[0]->node()->kind() == kConv &&
+          node->inputs()[0]->node()->inputs().size() == 2 &&
+          node->inputs()[0]->uses().size() == 1;
+    },
+    [](Node* node) {
+      return node->kind() == kAdd &&
+          node->inputs()[0]->node()->kind() == kMatMul &&
+          node->inputs()[0]->uses().size() == 1;
+    },
+    [](Node* node) {
+      return node->kind() == kLog &&
+          node->input()->node()->kind() == kSoftmax &&
+          node->input()->uses().size() == 1;
+    },
+    [](Node* node) {
+      Node* prev = node->input()->node();
+      return node->kind() == kUnsqueeze && node->hasAttribute(kaxes) &&
+          reduction_kinds.count(prev->kind()) && prev->hasAttribute(kaxes) &&
+          prev->hasAttribute(kkeepdims) && prev->i(kkeepdims) == 0 &&
+          node->is(kaxes) == prev->is(kaxes);
+    }};
+static bool (*const pattern_predicates[])(Node*) = {
+    optimization::AddBiasIntoConvPattern::matches,
+    optimization::MatMulAddBiasIntoGemmPattern::matches,
+    optimization::ConsecutiveLogSoftmaxPattern::matches,
+    optimization::ConsecutiveReduceUnsqueezePattern::matches};
+static const NodeKind fusion_anchor_kinds[] = {kAdd, kAdd, kLog, kUnsqueeze};
+
+// Evaluates the four fusion predicates on the nodes of their anchor kinds,
+// in a graph of 100k blocks half of which can be fused, with the
+// hand-written predicates (arg 0) or the patterns (arg 1), so that the
+// patterns are held to the speed of the code they replace.
+static void FusionPredicates(benchmark::State& state) {
+  Graph g;
+  Value* x = g.addInput();
+  auto append = [&g](NodeKind kind, Value* input) {
+    Node* n = g.create(kind);
+    n->addInput(input);
+    g.appendNode(n);
+    return n;
+  };
+  for (int64_t i = 0; i < 100000; ++i) {
+    const bool fusable = i % 2 == 0;
+    Node* conv = append(kConv, x);
+    conv->addInput(x);
+    Node* add = append(kAdd, conv->output());
+    Node* matmul = append(kMatMul, add->output());
+    Node* add2 = append(kAdd, matmul->output());
+    Node* softmax = append(kSoftmax, add2->output());
+    Node* log = append(kLog, softmax->output());
+    Node* reduce = append(kReduceSum, log->output());
+    reduce->is_(kaxes, {1});
+    reduce->i_(kkeepdims, fusable ? 0 : 1);
+    Node* unsqueeze = append(kUnsqueeze, reduce->output());
+    unsqueeze->is_(kaxes, {1});
+    x = unsqueeze->output();
+  }
+  std::vector<std::vector<Node*>> anchors;
+  for (NodeKind kind : fusion_anchor_kinds) {
+    anchors.emplace_back();
+    for (const auto& kv : g.nodesOfKind(kind)) {
+      anchors.back().push_back(kv.second);
+    }
+  }
+  bool (*const* predicates)(Node*) =
+      state.range(0) != 0 ? pattern_predicates : hand_written_predicates;
+  size_t matched = 0;
+  int64_t items = 0;
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < anchors.size(); ++i) {
+      // Called through a pointer either way, as passes call their
+      // predicates through the vtable.
+      bool (*predicate)(Node*) = predicates[i];
+      benchmark::DoNotOptimize(predicate);
+      for (Node* n : anchors[i]) {
+        matched += predicate(n);
+      }
+      items += anchors[i].size();
+    }
+  }
+  benchmark::DoNotOptimize(matched);
+  state.SetItemsProcessed(items);
+}
+BENCHMARK(FusionPredicates)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Runs eliminate_identity speculatively over a chain of 500k nodes, one in
+// 100 of them Identity, and discards its edits: on a copy of the graph
+// exported and imported again (state.range(0) == 0), or in a transaction
+// rolled back.
+static void SpeculativePass(benchmark::State& state) {
+  const int64_t n = 500000;
+  std::shared_ptr<Graph> g(new Graph());
+  Value* v = g->addInput();
+  for (int64_t i = 0; i < n; ++i) {
+    Node* node = g->create(i % 100 == 0 ? kIdentity : Symbol("Relu"));
+    node->addInput(v);
+    g->appendNode(node);
+    v = node->output();
+  }
+  g->registerOutput(v);
+  auto pass = optimization::Optimizer::passes.find("eliminate_identity");
+  while (state.KeepRunning()) {
+    if (state.range(0) == 0) {
+      ModelProto model;
+      model.set_ir_version(IR_VERSION);
+      ExportModelProto(&model, g);
+      std::shared_ptr<Graph> copy(ImportModelProto(model));
+      pass->runPass(*copy);
+      state.PauseTiming();
+      copy.reset();
+      state.ResumeTiming();
+    } else {
+      g->beginTransaction();
+      pass->runPass(*g);
+      g->rollbackTransaction();
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * n);
+}
+BENCHMARK(SpeculativePass)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Runs flush_denormals_to_zero in a transaction rolled back, over 1000
+// initializers of 64 KiB, state.range(0) in 100 of them holding a
+// denormal.
+static void FlushDenormalsTransaction(benchmark::State& state) {
+  Graph g;
+  for (int64_t i = 0; i < 1000; ++i) {
+    std::vector<float> values(16384, 1.f);
+    if (i % 100 < state.range(0)) {
+      values[0] = 1e-40f;
+    }
+    Tensor t;
+    t.elem_type() = TensorProto_DataType_FLOAT;
+    t.sizes().push_back(values.size());
+    t.set_raw_data(std::string(
+        reinterpret_cast<const char*>(values.data()),
+        values.size() * sizeof(float)));
+    Value* v = g.addInitializerAndInput(t, "w" + std::to_string(i));
+    Node* node = g.create(Symbol("Neg"));
+    node->addInput(v);
+    g.appendNode(node);
+    g.registerOutput(node->output());
+  }
+  auto pass = optimization::Optimizer::passes.find("flush_denormals_to_zero");
+  while (state.KeepRunning()) {
+    g.beginTransaction();
+    pass->runPass(g);
+    g.rollbackTransaction();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * 1000 * 65536);
+}
+BENCHMARK(FlushDenormalsTransaction)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(100)
+    ->Unit(benchmark::kMillisecond);
+
+// Opens and commits an empty transaction on a chain of 500k nodes.
+static void BeginTransaction(benchmark::State& state) {
+  Graph g;
+  Value* v = g.addInput();
+  for (int64_t i = 0; i < 500000; ++i) {
+    Node* node = g.create(Symbol("Relu"));
+    node->addInput(v);
+    g.appendNode(node);
+    v = node->output();
+  }
+  g.registerOutput(v);
+  while (state.KeepRunning()) {
+    g.beginTransaction();
+    g.commitTransaction();
+  }
+}
+BENCHMARK(BeginTransaction)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,127 @@
+// Checks, infers shapes for, optimizes and converts many ONNX models in
+// parallel, and prints per-model status and timings as JSON.
+//
+//   onnx-batch-optimize [--passes P1,P2,...] [--fixed-point] [--no-check]
+//                       [--no-infer-shapes] [--target-opset N]
+//                       [--threads N] [--memory-budget-mb N]
+//                       [--memory-factor X] manifest.txt
+//
+// Each non-empty line of the manifest not starting with '#' names an
+// input model and the path to write the result to, separated by
+// whitespace. Models run on --threads threads, admitted only while both
+// the estimated memory of the models in flight (--memory-factor times
+// their file sizes) and the measured growth of the process's resident
+// memory (on Linux) stay within --memory-budget-mb.
+//
+// Exits with 0 if every model succeeded, 1 if some failed and 2 on
+// errors.
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "onnx/optimizer/batch_optimize.h"
+
+using namespace ONNX_NAMESPACE;
+
+static int Usage() {
+  std::cerr << "usage: onnx-batch-optimize [--passes P1,P2,...] "
+               "[--fixed-point] [--no-check] [--no-infer-shapes] "
+               "[--target-opset N] [--threads N] [--memory-budget-mb N] "
+               "[--memory-factor X] manifest.txt"
+            << std::endl;
+  return 2;
+}
+
+static std::vector<std::string> Split(const std::string& s, char sep) {
+  std::vector<std::string> parts;
+  std::istringstream in(s);
+  std::string part;
+  while (std::getline(in, part, sep)) {
+    if (!part.empty()) {
+      parts.push_back(part);
+    }
+  }
+  return parts;
+}
+
+static bool ReadManifest(
+    const char* path,
+    std::vector<optimization::BatchJob>* jobs) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "onnx-batch-optimize: cannot open " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  for (size_t line_number = 1; std::getline(in, line); ++line_number) {
+    std::istringstream fields(line);
+    optimization::BatchJob job;
+    if (!(fields >> job.input) || job.input[0] == '#') {
+      continue;
+    }
+    std::string extra;
+    if (!(fields >> job.output) || (fields >> extra)) {
+      std::cerr << "onnx-batch-optimize: " << path << ":" << line_number
+                << ": expected an input and an output path" << std::endl;
+      return false;
+    }
+    jobs->push_back(job);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  optimization::BatchOptimizeOptions options;
+  const char* manifest = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--passes") == 0 && has_value) {
+      options.passes = Split(argv[++i], ',');
+    } else if (std::strcmp(argv[i], "--fixed-point") == 0) {
+      options.fixed_point = true;
+    } else if (std::strcmp(argv[i], "--no-check") == 0) {
+      options.check = false;
+    } else if (std::strcmp(argv[i], "--no-infer-shapes") == 0) {
+      options.infer_shapes = false;
+    } else if (std::strcmp(argv[i], "--target-opset") == 0 && has_value) {
+      options.target_opset = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--threads") == 0 && has_value) {
+      options.num_threads = static_cast<size_t>(std::atoll(argv[++i]));
+    } else if (std::strcmp(argv[i], "--memory-budget-mb") == 0 && has_value) {
+      options.memory_budget = static_cast<size_t>(std::atoll(argv[++i])) << 20;
+    } else if (std::strcmp(argv[i], "--memory-factor") == 0 && has_value) {
+      options.memory_factor = std::atof(argv[++i]);
+    } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      return Usage();
+    } else if (manifest == nullptr) {
+      manifest = argv[i];
+    } else {
+      return Usage();
+    }
+  }
+  if (manifest == nullptr || options.memory_factor < 0) {
+    return Usage();
+  }
+
+  std::vector<optimization::BatchJob> jobs;
+  if (!ReadManifest(manifest, &jobs)) {
+    return 2;
+  }
+  try {
+    const std::vector<optimization::BatchResult> results =
+        optimization::RunBatch(jobs, options);
+    optimization::WriteBatchResultsJson(std::cout, results);
+    for (const auto& r : results) {
+      if (!r.ok) {
+        return 1;
+      }
+    }
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "onnx-batch-optimize: " << e.what() << std::endl;
+    return 2;
+  }
+}
@@ -0,0 +1,77 @@
+// Prints the structural differences between two ONNX models.
+//
+//   onnx-diff [--atol X] [--rtol X] before.onnx after.onnx
+//
+// Exits with 0 if the models' graphs match, 1 if they differ and 2 on
+// errors, like diff(1).
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "onnx/common/graph_diff.h"
+#include "onnx/common/ir_pb_converter.h"
+#include "onnx/proto_utils.h"
+
+using namespace ONNX_NAMESPACE;
+
+static std::shared_ptr<Graph> LoadGraph(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cerr << "onnx-diff: cannot open " << path << std::endl;
+    return nullptr;
+  }
+  const std::string bytes(
+      (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  ModelProto model;
+  if (!ParseProtoFromBytes(&model, bytes.data(), bytes.size())) {
+    std::cerr << "onnx-diff: cannot parse " << path << std::endl;
+    return nullptr;
+  }
+  std::shared_ptr<Graph> g = ImportModelProto(model);
+  if (g == nullptr) {
+    std::cerr << "onnx-diff: cannot import " << path
+              << " (its IR version may be too old)" << std::endl;
+  }
+  return g;
+}
+
+static int Usage() {
+  std::cerr << "usage: onnx-diff [--atol X] [--rtol X] before.onnx after.onnx"
+            << std::endl;
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  GraphDiffOptions options;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--atol") == 0 && i + 1 < argc) {
+      options.atol = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--rtol") == 0 && i + 1 < argc) {
+      options.rtol = std::atof(argv[++i]);
+    } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      return Usage();
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    return Usage();
+  }
+
+  try {
+    std::shared_ptr<Graph> before = LoadGraph(paths[0]);
+    std::shared_ptr<Graph> after = LoadGraph(paths[1]);
+    if (before == nullptr || after == nullptr) {
+      return 2;
+    }
+    const GraphDiff diff = DiffGraphs(*before, *after, options);
+    PrintGraphDiff(std::cout, diff);
+    return diff.empty() ? 0 : 1;
+  } catch (const std::exception& e) {
+    std::cerr << "onnx-diff: " << e.what() << std::endl;
+    return 2;
+  }
+}
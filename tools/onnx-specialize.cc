@@ -0,0 +1,156 @@
+// Rewrites the input dimensions of an ONNX model to static values (or
+// renames symbolic ones), propagates them with shape inference and runs
+// the shape dependent optimization passes.
+//
+//   onnx-specialize [--batch N] [--dim PARAM=VALUE]...
+//                   [--input NAME:AXIS=VALUE]... [--passes P1,P2,...]
+//                   in.onnx out.onnx
+//
+// VALUE is a dimension size, or else a new dim_param. --passes "" skips
+// the passes. Warns about graph outputs that are still not static.
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "onnx/optimizer/specialize_shapes.h"
+#include "onnx/proto_utils.h"
+
+using namespace ONNX_NAMESPACE;
+
+static int Usage() {
+  std::cerr << "usage: onnx-specialize [--batch N] [--dim PARAM=VALUE]... "
+               "[--input NAME:AXIS=VALUE]... [--passes P1,P2,...] "
+               "in.onnx out.onnx"
+            << std::endl;
+  return 2;
+}
+
+// Parses all of s as a decimal integer.
+static bool ParseInt(const std::string& s, long long* value) {
+  char* end = nullptr;
+  errno = 0;
+  *value = std::strtoll(s.c_str(), &end, 10);
+  return !s.empty() && *end == '\0' && errno == 0;
+}
+
+static Dimension ParseDimension(const std::string& s) {
+  char* end = nullptr;
+  const long long value = std::strtoll(s.c_str(), &end, 10);
+  if (!s.empty() && *end == '\0' && value >= 0) {
+    return Dimension(static_cast<int64_t>(value));
+  }
+  return Dimension(s);
+}
+
+static std::vector<std::string> Split(const std::string& s, char sep) {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  while (begin <= s.size()) {
+    size_t end = s.find(sep, begin);
+    if (end == std::string::npos) {
+      end = s.size();
+    }
+    if (end > begin) {
+      parts.push_back(s.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return parts;
+}
+
+static bool IsStatic(const TypeProto& type) {
+  if (!type.has_tensor_type()) {
+    return true;
+  }
+  const TypeProto_Tensor& tensor = type.tensor_type();
+  if (!tensor.has_shape()) {
+    return false;
+  }
+  for (const auto& d : tensor.shape().dim()) {
+    if (!d.has_dim_value()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  optimization::ShapeSpecialization spec;
+  std::vector<std::string> passes = optimization::GetShapeDependentPasses();
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--batch") == 0 && has_value) {
+      long long batch_size = 0;
+      if (!ParseInt(argv[++i], &batch_size) || batch_size <= 0) {
+        return Usage();
+      }
+      spec.batch_size = batch_size;
+    } else if (std::strcmp(argv[i], "--dim") == 0 && has_value) {
+      const std::string arg = argv[++i];
+      const size_t eq = arg.find('=');
+      if (eq == std::string::npos || eq == 0) {
+        return Usage();
+      }
+      spec.dims.emplace(arg.substr(0, eq), ParseDimension(arg.substr(eq + 1)));
+    } else if (std::strcmp(argv[i], "--input") == 0 && has_value) {
+      const std::string arg = argv[++i];
+      const size_t colon = arg.rfind(':');
+      const size_t eq = arg.find('=', colon);
+      long long axis = 0;
+      if (colon == std::string::npos || eq == std::string::npos ||
+          !ParseInt(arg.substr(colon + 1, eq - colon - 1), &axis)) {
+        return Usage();
+      }
+      spec.input_dims[arg.substr(0, colon)].emplace_back(
+          axis, ParseDimension(arg.substr(eq + 1)));
+    } else if (std::strcmp(argv[i], "--passes") == 0 && has_value) {
+      passes = Split(argv[++i], ',');
+    } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      return Usage();
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    return Usage();
+  }
+
+  try {
+    std::ifstream in(paths[0], std::ios::binary);
+    if (!in) {
+      std::cerr << "onnx-specialize: cannot open " << paths[0] << std::endl;
+      return 2;
+    }
+    const std::string bytes(
+        (std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+    ModelProto model;
+    if (!ParseProtoFromBytes(&model, bytes.data(), bytes.size())) {
+      std::cerr << "onnx-specialize: cannot parse " << paths[0] << std::endl;
+      return 2;
+    }
+
+    const ModelProto specialized =
+        optimization::SpecializeShapes(model, spec, passes);
+    for (const auto& output : specialized.graph().output()) {
+      if (!IsStatic(output.type())) {
+        std::cerr << "onnx-specialize: warning: output " << output.name()
+                  << " does not have a static shape" << std::endl;
+      }
+    }
+
+    std::ofstream out(paths[1], std::ios::binary | std::ios::trunc);
+    if (!specialized.SerializeToOstream(&out)) {
+      std::cerr << "onnx-specialize: cannot write " << paths[1] << std::endl;
+      return 2;
+    }
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "onnx-specialize: " << e.what() << std::endl;
+    return 2;
+  }
+}
@@ -0,0 +1,373 @@
+// Times the type and shape inference of every operator schema in
+// isolation, one benchmark per op:
+//
+//   shape-inference-bench [--node_data=DIR] [benchmark flags]
+//
+// Each op's node, input types and constant inputs are taken from the first
+// node test model in DIR (onnx/backend/test/data/node by default) that uses
+// it, and are synthesized from the schema otherwise. Ops without inference
+// are skipped; ops defined by a function are timed through
+// InferShapeForFunctionNode.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <onnx/defs/schema.h>
+#include <onnx/onnx_pb.h>
+#include <onnx/proto_utils.h>
+#include <onnx/shape_inference/implementation.h>
+
+#ifndef ONNX_NODE_TEST_DATA_DIR
+#define ONNX_NODE_TEST_DATA_DIR "onnx/backend/test/data/node"
+#endif
+
+using namespace ONNX_NAMESPACE;
+
+// An InferenceContext over a single node whose outputs can be reset, so
+// that the inference function can run repeatedly on the same context.
+class NodeInferenceContext final : public InferenceContext {
+ public:
+  NodeInferenceContext(
+      const NodeProto& node,
+      const std::unordered_map<std::string, TypeProto>& types,
+      const std::unordered_map<std::string, TensorProto>& data,
+      const std::unordered_map<std::string, int>& opset_imports)
+      : node_(node),
+        graph_context_(outer_scope_types_, opset_imports),
+        input_types_(node.input_size()),
+        output_types_(node.output_size()) {
+    for (auto& attr : *node_.mutable_attribute()) {
+      attributes_[attr.name()] = &attr;
+    }
+    for (int i = 0; i < node_.input_size(); ++i) {
+      auto type = types.find(node_.input(i));
+      input_types_[i] = type == types.end() ? nullptr : &type->second;
+      auto tensor = data.find(node_.input(i));
+      input_data_.push_back(tensor == data.end() ? nullptr : &tensor->second);
+    }
+  }
+
+  const AttributeProto* getAttribute(const std::string& name) const override {
+    auto it = attributes_.find(name);
+    return it == attributes_.end() ? nullptr : it->second;
+  }
+  size_t getNumInputs() const override {
+    return input_types_.size();
+  }
+  const TypeProto* getInputType(size_t index) const override {
+    return input_types_.at(index);
+  }
+  const TensorProto* getInputData(size_t index) const override {
+    return input_data_.at(index);
+  }
+  size_t getNumOutputs() const override {
+    return output_types_.size();
+  }
+  TypeProto* getOutputType(size_t index) override {
+    return &output_types_.at(index);
+  }
+  GraphInferencer* getGraphAttributeInferencer(
+      const std::string& attribute_name) override {
+    auto& inferencer = graph_inferencers_[attribute_name];
+    if (!inferencer) {
+      for (auto& attr : *node_.mutable_attribute()) {
+        if (attr.name() == attribute_name && attr.has_g()) {
+          inferencer.reset(new shape_inference::GraphInferencerImpl(
+              *attr.mutable_g(), graph_context_));
+        }
+      }
+      if (!inferencer) {
+        fail_type_inference("Attribute ", attribute_name, " is not a graph");
+      }
+    }
+    return inferencer.get();
+  }
+
+  void resetOutputs() {
+    for (auto& type : output_types_) {
+      type.Clear();
+    }
+  }
+
+ private:
+  NodeProto node_;
+  std::unordered_map<std::string, const AttributeProto*> attributes_;
+  const std::unordered_map<std::string, TypeProto*> outer_scope_types_;
+  shape_inference::GraphInferenceContext graph_context_;
+  std::vector<const TypeProto*> input_types_;
+  std::vector<const TensorProto*> input_data_;
+  std::vector<TypeProto> output_types_;
+  std::unordered_map<std::string, std::unique_ptr<GraphInferencer>>
+      graph_inferencers_;
+};
+
+// A node with everything needed to build its inference context.
+struct Fixture {
+  std::string source;
+  NodeProto node;
+  std::unordered_map<std::string, TypeProto> types;
+  std::unordered_map<std::string, TensorProto> data;
+  std::unordered_map<std::string, int> opset_imports;
+};
+
+static std::vector<std::string> ListDirectory(const std::string& dir) {
+  std::vector<std::string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA entry;
+  HANDLE handle = FindFirstFileA((dir + "\\*").c_str(), &entry);
+  if (handle != INVALID_HANDLE_VALUE) {
+    do {
+      names.push_back(entry.cFileName);
+    } while (FindNextFileA(handle, &entry));
+    FindClose(handle);
+  }
+#else
+  if (DIR* d = opendir(dir.c_str())) {
+    while (dirent* entry = readdir(d)) {
+      names.push_back(entry->d_name);
+    }
+    closedir(d);
+  }
+#endif
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+static std::string OpKey(const std::string& domain, const std::string& op) {
+  return domain.empty() || domain == "ai.onnx" ? op : domain + "." + op;
+}
+
+// Maps each op to the first node test model whose graph runs it on the
+// graph's inputs and initializers.
+static std::map<std::string, Fixture> LoadNodeFixtures(const std::string& dir) {
+  std::map<std::string, Fixture> fixtures;
+  for (const std::string& name : ListDirectory(dir)) {
+    std::ifstream in(dir + "/" + name + "/model.onnx", std::ios::binary);
+    if (name[0] == '.' || !in) {
+      continue;
+    }
+    const std::string bytes(
+        (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ModelProto model;
+    if (!ParseProtoFromBytes(&model, bytes.data(), bytes.size()) ||
+        model.graph().node_size() == 0) {
+      continue;
+    }
+    const GraphProto& graph = model.graph();
+    const NodeProto& node = graph.node(0);
+    Fixture& fixture = fixtures[OpKey(node.domain(), node.op_type())];
+    if (!fixture.source.empty()) {
+      continue;
+    }
+    fixture.source = name;
+    fixture.node = node;
+    for (const auto& input : graph.input()) {
+      fixture.types[input.name()] = input.type();
+    }
+    for (const auto& initializer : graph.initializer()) {
+      fixture.data[initializer.name()] = initializer;
+    }
+    for (const auto& opset : model.opset_import()) {
+      fixture.opset_imports[opset.domain()] = static_cast<int>(opset.version());
+    }
+  }
+  return fixtures;
+}
+
+static TypeProto SynthesizeType(
+    const OpSchema::FormalParameter& formal,
+    const std::vector<int64_t>& dims) {
+  const DataTypeSet& types = formal.GetTypes();
+  DataType type = Utils::DataTypeUtils::ToType("tensor(float)");
+  if (!types.count(type)) {
+    // Pick deterministically among the allowed types.
+    type = *std::min_element(
+        types.begin(), types.end(), [](DataType a, DataType b) {
+          return *a < *b;
+        });
+  }
+  TypeProto result = Utils::DataTypeUtils::ToTypeProto(type);
+  if (result.has_tensor_type()) {
+    auto* shape = result.mutable_tensor_type()->mutable_shape();
+    for (int64_t d : dims) {
+      shape->add_dim()->set_dim_value(d);
+    }
+  }
+  return result;
+}
+
+// A node of the schema with one input and output per formal parameter (two
+// for a variadic one), inputs of shape `dims` and the required attributes
+// set to 1, 0.5, "" or a one-element tensor.
+static Fixture SynthesizeFixture(
+    const OpSchema& schema,
+    const std::vector<int64_t>& dims) {
+  Fixture fixture;
+  fixture.source = "synthetic";
+  fixture.opset_imports[schema.domain()] = schema.SinceVersion();
+  NodeProto& node = fixture.node;
+  node.set_op_type(schema.Name());
+  node.set_domain(schema.domain());
+  for (const auto& formal : schema.inputs()) {
+    const int count = formal.GetOption() == OpSchema::Variadic ? 2 : 1;
+    for (int i = 0; i < count; ++i) {
+      const std::string name = "x" + std::to_string(node.input_size());
+      node.add_input(name);
+      fixture.types[name] = SynthesizeType(formal, dims);
+    }
+  }
+  for (const auto& formal : schema.outputs()) {
+    const int count = formal.GetOption() == OpSchema::Variadic ? 2 : 1;
+    for (int i = 0; i < count; ++i) {
+      node.add_output("y" + std::to_string(node.output_size()));
+    }
+  }
+  for (const auto& entry : schema.attributes()) {
+    const OpSchema::Attribute& attr = entry.second;
+    if (!attr.required) {
+      continue;
+    }
+    AttributeProto* a = node.add_attribute();
+    a->set_name(attr.name);
+    a->set_type(attr.type);
+    switch (attr.type) {
+      case AttributeProto::INT:
+        a->set_i(1);
+        break;
+      case AttributeProto::INTS:
+        a->add_ints(1);
+        break;
+      case AttributeProto::FLOAT:
+        a->set_f(0.5f);
+        break;
+      case AttributeProto::FLOATS:
+        a->add_floats(0.5f);
+        break;
+      case AttributeProto::STRING:
+        a->set_s("");
+        break;
+      case AttributeProto::STRINGS:
+        a->add_strings("");
+        break;
+      case AttributeProto::TENSOR:
+        a->mutable_t()->set_data_type(TensorProto_DataType_FLOAT);
+        a->mutable_t()->add_dims(1);
+        a->mutable_t()->add_float_data(1.f);
+        break;
+      default:
+        break;
+    }
+  }
+  return fixture;
+}
+
+static void RunInference(const OpSchema& schema, NodeInferenceContext& ctx) {
+  if (schema.has_type_and_shape_inference_function()) {
+    schema.GetTypeAndShapeInferenceFunction()(ctx);
+  } else {
+    shape_inference::InferShapeForFunctionNode(
+        schema.GetFunction(), OpSchemaRegistry::Instance(), ctx);
+  }
+}
+
+// Whether inference on the fixture succeeds; otherwise sets *error.
+static bool CanInfer(
+    const OpSchema& schema,
+    const Fixture& fixture,
+    std::string* error) {
+  try {
+    NodeInferenceContext ctx(
+        fixture.node, fixture.types, fixture.data, fixture.opset_imports);
+    RunInference(schema, ctx);
+    return true;
+  } catch (const std::exception& e) {
+    *error = fixture.source + ": " + e.what();
+    return false;
+  }
+}
+
+static void RegisterInferenceBenchmarks(const std::string& node_data) {
+  const std::map<std::string, Fixture> node_fixtures =
+      LoadNodeFixtures(node_data);
+  for (const OpSchema& schema : OpSchemaRegistry::get_all_schemas()) {
+    if (schema.Deprecated() ||
+        (!schema.has_type_and_shape_inference_function() &&
+         !schema.HasFunction())) {
+      continue;
+    }
+    const std::string key = OpKey(schema.domain(), schema.Name());
+
+    // Prefer the test model, then synthetic inputs of decreasing rank.
+    std::vector<Fixture> candidates;
+    auto it = node_fixtures.find(key);
+    if (it != node_fixtures.end()) {
+      candidates.push_back(it->second);
+    }
+    for (const auto& dims : std::vector<std::vector<int64_t>>{
+             {1, 3, 8, 8}, {4, 8}, {8}}) {
+      candidates.push_back(SynthesizeFixture(schema, dims));
+    }
+    std::shared_ptr<Fixture> fixture;
+    std::string error;
+    for (const Fixture& candidate : candidates) {
+      std::string candidate_error;
+      if (CanInfer(schema, candidate, &candidate_error)) {
+        fixture = std::make_shared<Fixture>(candidate);
+        break;
+      }
+      if (error.empty()) {
+        error = candidate_error;
+      }
+    }
+
+    benchmark::RegisterBenchmark(
+        ("Infer/" + key).c_str(),
+        [schema, fixture, error](benchmark::State& state) {
+          if (!fixture) {
+            state.SkipWithError(error.c_str());
+            return;
+          }
+          NodeInferenceContext ctx(
+              fixture->node,
+              fixture->types,
+              fixture->data,
+              fixture->opset_imports);
+          for (auto _ : state) {
+            ctx.resetOutputs();
+            RunInference(schema, ctx);
+          }
+          state.SetLabel(fixture->source);
+        });
+  }
+}
+
+int main(int argc, char** argv) {
+  std::string node_data = ONNX_NODE_TEST_DATA_DIR;
+  const char* flag = "--node_data=";
+  int n = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], flag, std::strlen(flag)) == 0) {
+      node_data = argv[i] + std::strlen(flag);
+    } else {
+      argv[n++] = argv[i];
+    }
+  }
+  argc = n;
+
+  RegisterInferenceBenchmarks(node_data);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}